@@ -9,10 +9,12 @@ uniform float lineStartCoord;
 uniform float lineCoordStep;
 
 uniform int lineNumSegments;
+uniform int lineNumAreas;
 uniform float lineSymbolLength;
 uniform float lineSymbolWidth;
 
 uniform vec3 center;
+uniform float verticalScale;
 
 varying vec3 position;
 varying vec3 normal;
@@ -51,13 +53,28 @@ vec4 read(inout float coord)
     return r;
 }
 
+/* the control points are stored on the unscaled globe. Displace them along
+   the vertical by the scaled part of their elevation */
+vec3 scaleToGlobe(in vec3 point, in float elevation)
+{
+    vec3 dir = normalize(center + point);
+    return point + (verticalScale-1.0)*elevation*dir;
+}
+
 Segment readSegment(inout float coord)
 {
     Segment segment;
     segment.symbol = read(coord);
     segment.start  = read(coord);
     segment.end    = read(coord);
-    segment.normal = read(coord).xyz;
+    vec2 elevation = read(coord).xy;
+
+    segment.start.xyz = scaleToGlobe(segment.start.xyz, elevation.x);
+    segment.end.xyz   = scaleToGlobe(segment.end.xyz,   elevation.y);
+
+    //normal of the plane through the center of the globe and the segment
+    segment.normal = normalize(cross(center + segment.start.xyz,
+                                     segment.end.xyz - segment.start.xyz));
     return segment;
 }
 
@@ -120,13 +137,30 @@ void computeSegment(in Segment segment, inout vec4 color)
 }
 
 
+float decodeOffset(in vec2 code)
+{
+    vec2 off = code * vec2(255.0, 255.0*256.0);
+    off.x   -= 64.0*256.0;
+    return off.x + off.y;
+}
+
 void render(inout vec4 fragColor)
 {
-    //does this node contain any lines?
-    if (lineNumSegments == 0)
+    //does this node contain any lines or areas?
+    if (lineNumSegments==0 && lineNumAreas==0)
         return;
 
-    vec2 coverage = ##sampleCoverage#texCoord##.rg;
+    vec4 coverages = ##sampleCoverage#texCoord##;
+    vec2 coverage  = coverages.rg;
+
+    //the fill of the topmost area covering the fragment
+    vec4 color = vec4(0.0);
+    if (coverages.a > 0.0)
+    {
+        float areaOff = decodeOffset(coverages.ba);
+        areaOff       = lineStartCoord + areaOff*lineCoordStep;
+        color         = read(areaOff);
+    }
 #if COVERAGE
     if (coverage.g < 0.5)
     {
@@ -144,20 +178,15 @@ void render(inout vec4 fragColor)
 #if USE_COVERAGE
     //do lines overlap this fragment?
     if (coverage == vec2(0.0))
+    {
+        fragColor = mix(fragColor, color, color.w);
         return;
-#endif //USE_COVERAGE
-
-    vec4 color = vec4(0.0);
+    }
 
-#if USE_COVERAGE
     //optimize for single coverage
     if (coverage.g < 0.5)
     {
-        vec2 coordShift = vec2(255.0, 255.0*256.0);
-
-        vec2 off         = coverage * coordShift;
-        off.x           -= 64.0*256.0;
-        float segmentOff = off.x + off.y;
+        float segmentOff = decodeOffset(coverage);
 
         //read in the segment data
         segmentOff      = lineStartCoord + segmentOff*lineCoordStep;
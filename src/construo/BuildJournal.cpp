@@ -0,0 +1,237 @@
+#include <construo/BuildJournal.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#include <construo/vrui.h>
+
+
+namespace crusta {
+
+
+///identifies the format of the journal
+static const char* JOURNAL_MAGIC = "construo-journal 1";
+
+
+BuildJournal::
+BuildJournal() :
+    file(NULL), finestFrontDone(-1), depth(-1), coarserLevelDone(-1)
+{
+}
+
+BuildJournal::
+~BuildJournal()
+{
+    if (file != NULL)
+        fclose(file);
+}
+
+bool BuildJournal::
+open(const std::string& iPath, const std::string& signature, bool resume)
+{
+    if (file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+    path = iPath;
+
+    if (resume && load(signature))
+    {
+        file = fopen(path.c_str(), "a");
+        if (file == NULL)
+        {
+            Misc::throwStdErr("BuildJournal: unable to append to %s: %s",
+                              path.c_str(), strerror(errno));
+        }
+        return true;
+    }
+
+    start(signature);
+    return false;
+}
+
+void BuildJournal::
+remove()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+    if (!path.empty())
+        unlink(path.c_str());
+}
+
+int BuildJournal::
+getFinestFront() const
+{
+    return finestFrontDone;
+}
+
+bool BuildJournal::
+isFinestComplete() const
+{
+    return depth != -1;
+}
+
+int BuildJournal::
+getDepth() const
+{
+    return depth;
+}
+
+int BuildJournal::
+getCoarserLevel() const
+{
+    return coarserLevelDone;
+}
+
+const BuildJournal::TreeIndices& BuildJournal::
+getSourced() const
+{
+    return sourced;
+}
+
+void BuildJournal::
+finestFront(int front, const TreeIndices& frontSourced)
+{
+    for (TreeIndices::const_iterator it=frontSourced.begin();
+         it!=frontSourced.end(); ++it)
+    {
+        fprintf(file, "node %llx\n", (unsigned long long)it->raw);
+    }
+    fprintf(file, "front %d\n", front);
+    commit();
+
+    sourced.insert(sourced.end(), frontSourced.begin(), frontSourced.end());
+    finestFrontDone = front;
+}
+
+void BuildJournal::
+finestComplete(int iDepth)
+{
+    fprintf(file, "finest %d\n", iDepth);
+    commit();
+
+    depth = iDepth;
+}
+
+void BuildJournal::
+coarserLevel(int level)
+{
+    fprintf(file, "coarser %d\n", level);
+    commit();
+
+    coarserLevelDone = level;
+}
+
+
+bool BuildJournal::
+load(const std::string& signature)
+{
+    FILE* in = fopen(path.c_str(), "r");
+    if (in == NULL)
+        return false;
+
+    char line[256];
+    std::string header = std::string(JOURNAL_MAGIC) + " " + hash(signature) +
+                         "\n";
+    if (fgets(line, sizeof(line), in)==NULL || header!=line)
+    {
+        std::cout << "Discarding the journal " << path << " of a different "
+                     "update\n";
+        fclose(in);
+        return false;
+    }
+
+    /* the records following the last completed front are the remains of an
+       interrupted front. They are dropped, as is any partially written
+       line */
+    TreeIndices pending;
+    long validEnd = ftell(in);
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (line[0]=='\0' || line[strlen(line)-1]!='\n')
+            break;
+
+        unsigned long long raw;
+        int number;
+        if (sscanf(line, "node %llx", &raw) == 1)
+        {
+            TreeIndex index;
+            index.raw = raw;
+            pending.push_back(index);
+            continue;
+        }
+        else if (sscanf(line, "front %d", &number) == 1)
+        {
+            sourced.insert(sourced.end(), pending.begin(), pending.end());
+            pending.clear();
+            finestFrontDone = number;
+        }
+        else if (sscanf(line, "finest %d", &number) == 1)
+            depth = number;
+        else if (sscanf(line, "coarser %d", &number) == 1)
+            coarserLevelDone = number;
+        else
+            break;
+
+        validEnd = ftell(in);
+    }
+    fclose(in);
+
+    if (truncate(path.c_str(), validEnd) != 0)
+    {
+        Misc::throwStdErr("BuildJournal: unable to truncate %s: %s",
+                          path.c_str(), strerror(errno));
+    }
+    return true;
+}
+
+void BuildJournal::
+start(const std::string& signature)
+{
+    finestFrontDone  = -1;
+    depth            = -1;
+    coarserLevelDone = -1;
+    sourced.clear();
+
+    file = fopen(path.c_str(), "w");
+    if (file == NULL)
+    {
+        Misc::throwStdErr("BuildJournal: unable to create %s: %s",
+                          path.c_str(), strerror(errno));
+    }
+    fprintf(file, "%s %s\n", JOURNAL_MAGIC, hash(signature).c_str());
+    commit();
+}
+
+void BuildJournal::
+commit()
+{
+    fflush(file);
+    fsync(fileno(file));
+}
+
+std::string BuildJournal::
+hash(const std::string& signature)
+{
+    //64-bit FNV-1a
+    unsigned long long h = 14695981039346656037ULL;
+    for (std::string::const_iterator it=signature.begin();
+         it!=signature.end(); ++it)
+    {
+        h ^= static_cast<unsigned char>(*it);
+        h *= 1099511628211ULL;
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", h);
+    return std::string(hex);
+}
+
+
+} //namespace crusta
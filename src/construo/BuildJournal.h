@@ -0,0 +1,94 @@
+#ifndef _BuildJournal_H_
+#define _BuildJournal_H_
+
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <crustacore/TreeIndex.h>
+
+
+namespace crusta {
+
+
+/**
+    Journal of the progress of a construo update. The completed fronts of the
+    finest pass and levels of the coarser pass are appended to the journal,
+    together with the nodes that were sourced (whose ancestors must be
+    regenerated), once the corresponding data has been committed to the globe
+    file. An interrupted update can thus be resumed from the last completed
+    front or level. The journal is bound to a signature of the update, such
+    that it is only resumed for the same sources and patches.
+*/
+class BuildJournal
+{
+public:
+    typedef std::vector<TreeIndex> TreeIndices;
+
+    BuildJournal();
+    ~BuildJournal();
+
+    /** open the journal at the given path. If a journal with the same
+        signature exists and resuming is requested, its progress is loaded and
+        further records are appended to it. Otherwise a new journal is
+        started. Returns whether progress was resumed */
+    bool open(const std::string& path, const std::string& signature,
+              bool resume);
+    /** remove the journal from disk once the update has completed */
+    void remove();
+
+    /** last front of the finest pass that was completed (fronts are numbered
+        in processing order). -1 if none */
+    int getFinestFront() const;
+    /** returns whether the finest pass has been completed */
+    bool isFinestComplete() const;
+    /** depth of the update-tree produced by the completed finest pass */
+    int getDepth() const;
+    /** last level of the coarser pass that was completed. The coarser levels
+        are processed from the finest up, hence all the levels down to this
+        one have been completed. -1 if none */
+    int getCoarserLevel() const;
+    /** nodes sourced during the completed fronts of the finest pass */
+    const TreeIndices& getSourced() const;
+
+    /** record the completion of a front of the finest pass, together with the
+        nodes that were sourced for it */
+    void finestFront(int front, const TreeIndices& sourced);
+    /** record the completion of the finest pass */
+    void finestComplete(int depth);
+    /** record the completion of a level of the coarser pass */
+    void coarserLevel(int level);
+
+protected:
+    /** parse the records of an existing journal. Returns false if the journal
+        is not for the given signature */
+    bool load(const std::string& signature);
+    /** reset the progress and start a new journal */
+    void start(const std::string& signature);
+    /** force the appended records to disk */
+    void commit();
+
+    /** hash of the description of an update */
+    static std::string hash(const std::string& signature);
+
+    ///location of the journal
+    std::string path;
+    ///handle to the journal
+    FILE* file;
+
+    ///last completed front of the finest pass
+    int finestFrontDone;
+    ///depth of the update-tree if the finest pass was completed, -1 otherwise
+    int depth;
+    ///last completed level of the coarser pass
+    int coarserLevelDone;
+    ///nodes sourced during the completed fronts of the finest pass
+    TreeIndices sourced;
+};
+
+
+} //namespace crusta
+
+
+#endif //_BuildJournal_H_
@@ -1,12 +1,20 @@
 #ifndef _Builder_H_
 #define _Builder_H_
 
+#include <list>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <construo/BuildJournal.h>
 #include <construo/ImagePatch.h>
+#include <construo/SourceIndex.h>
+#include <construo/TileCache.h>
 #include <construo/Tree.h>
 
+#include <construo/vrui.h>
+
 
 namespace crusta {
 
@@ -30,7 +38,10 @@ public:
         bool        pointSampled;
     };
     typedef std::vector<ImagePatchSource> ImagePatchSources;
+    ///identifiers of base patches of the globe
+    typedef std::vector<int> PatchIds;
 
+    BuilderBase() : resume(true) {}
     virtual ~BuilderBase(){}
 
     ///add a source image patch to be integrated into the spheroid
@@ -38,20 +49,30 @@ public:
     {
         imagePatchSources = sources;
     }
+    /** enable resuming an interrupted update of the same sources from its
+        journal (enabled by default) */
+    void setResume(bool enable)
+    {
+        resume = enable;
+    }
 
     ///update the spheroid with the new patches
     virtual void update() = 0;
 
 protected:
     ImagePatchSources imagePatchSources;
+    ///resume an interrupted update from its journal
+    bool resume;
 };
 
 template <typename PixelParam>
 class Builder : public BuilderBase
 {
 public:
-    ///opens a spheroid file to which new additions are to be made
-    Builder(const std::string& spheroidName, const size_t tileSize[2]);
+    /** opens a spheroid file to which new additions are to be made. Only the
+        given subset of the base patches is built (all of them if empty) */
+    Builder(const std::string& spheroidName, const size_t tileSize[2],
+            const PatchIds& patches=PatchIds());
     ///closes the spheroid file and cleans up scratch data
     ~Builder();
 
@@ -61,48 +82,241 @@ protected:
     typedef Spheroid<PixelParam>  Globe;
     typedef TreeNode<PixelParam>  Node;
     typedef ImagePatch<PixelType> Patch;
+    typedef std::vector<int>      SourceIds;
+    typedef std::set<const Node*> PinnedNodes;
+
+    typedef BuildJournal::TreeIndices TreeIndices;
+
+    ///geometry of a source image gathered when indexing the sources
+    struct SourceInfo
+    {
+        ///coverage of the source on the sphere
+        SphereCoverage coverage;
+        ///finest resolution of the source
+        Point::Scalar resolution;
+    };
+    typedef std::vector<SourceInfo> SourceInfos;
+
+    ///node together with the sources contributing to it (in overwrite order)
+    struct SourceJob
+    {
+        Node* node;
+        SourceIds sources;
+    };
+    typedef std::vector<SourceJob> SourceJobs;
+    ///fronts of nodes pending to be sourced, the last one being next
+    typedef std::vector<SourceJobs> SourceFronts;
+
+    ///scratch buffers used when sourcing the data of a single node
+    struct SourceScratch
+    {
+        SourceScratch(const size_t tileSize[2]);
+        ~SourceScratch();
+
+        ///temporary buffer to hold scope refinements
+        Scope::Scalar* scopeBuf;
+        ///temporary buffer to hold the spherical sample positions of a node
+        Point* sphericalBuf;
+        ///temporary buffer to hold sample positions for sourcing data
+        Point* sampleBuf;
+        ///temporary buffer to hold node data
+        PixelType* nodeDataBuf;
+        ///buffer reused for the rectangles read from the image patch
+        std::vector<PixelType> rectBuf;
+    };
+
+    ///worker sourcing the queued finest level nodes
+    struct SourceWorker
+    {
+        typedef std::list<std::pair<int, Patch*> > OpenPatches;
+
+        SourceWorker();
+        ~SourceWorker();
+
+        void* run();
+        /** retrieve the image patch of a source, opening it if necessary. The
+            least recently used patches are closed to bound the number of open
+            sources */
+        Patch* getPatch(int source);
+
+        Builder* builder;
+        ///private scratch buffers
+        SourceScratch* scratch;
+        /** private handles to the image patches (GDAL handles aren't
+            shareable), most recently used first */
+        OpenPatches patches;
+    };
+
+    ///kin of a node contributing to the node's subsampling domain
+    struct KinRef
+    {
+        ///the kin node. NULL if it doesn't exist or cannot be used
+        Node* node;
+        ///location of the requested kin inside the retrieved (coarser) one
+        int offset[2];
+        ///orientation of the kin relative to the node
+        size_t orientation;
+    };
+    ///node of a coarser level to be regenerated together with its kin
+    struct CoarseJob
+    {
+        Node* node;
+        KinRef kin[16];
+    };
+    typedef std::vector<CoarseJob> CoarseJobs;
+
+    ///scratch buffers used when regenerating a coarser level node
+    struct CoarseScratch
+    {
+        CoarseScratch(const size_t tileSize[2], const size_t domainSize[2]);
+        ~CoarseScratch();
+
+        ///temporary buffer to hold node data
+        PixelType* nodeDataBuf;
+        ///temporary buffer to hold node data that needs to be sampled
+        PixelType* nodeDataSampleBuf;
+        ///temporary buffer to hold the subsampling domain
+        PixelType* domainBuf;
+    };
+
+    ///worker regenerating the queued coarser level nodes
+    struct CoarseWorker
+    {
+        void* run();
+
+        Builder* builder;
+        ///private scratch buffers
+        CoarseScratch* scratch;
+    };
+
+    /** runs the workers, one per thread. The calling thread runs the first
+        worker */
+    template <typename WorkerParam>
+    static void runWorkers(WorkerParam* workers, int numWorkers);
 
     ///subsamples data from the given node into that node's children
     void subsampleChildren(Node* node);
     ///refines a node by adding the children to the build tree
     void refine(Node* node);
 
-    ///flags all the ancestors for an update
-    void flagAncestorsForUpdate(Node* node);
-    ///sources the data for a node from an image patch and commits it to file
-    void sourceFinest(Node* node, Patch* imgPatch, size_t overlap);
-    ///traverse the tree to update it for given patch
-    int updateFiner(Node* node, Patch* imgPatch, Point::Scalar imgResolution);
-    /** sources new patches to create new finer levels or update existing ones.
-        Returns the depth of the update-tree for use during updating of the
-        coarse levels. */
-    int updateFinestLevels(const ImagePatchSource& patchSource);
+    /** transforms the samples of a tile from world to image space. Uses a
+        bilinear approximation from a coarse grid of exactly transformed
+        samples when its error is within the configured bound */
+    void projectSamples(Patch* imgPatch, Point* samples);
+    /** samples an image patch into the node's data. The spherical sample
+        positions of the node must be provided in the scratch buffers */
+    void sampleSource(Node* node, Patch* imgPatch, SourceScratch& scratch);
+    /** sources the data for a node from all its contributing image patches
+        and commits it to file */
+    void sourceFinest(const SourceJob& job, SourceWorker& worker);
+    /** collects, in order, the sources overlapping the node that were too
+        fine for its parent */
+    void findSources(Node* node, Point::Scalar parentResolution,
+                     SourceIds& sources);
+    ///pops the next node to be sourced from the queue. Thread-safe
+    const SourceJob* nextSourceJob();
+    ///sources the nodes of the jobs using a pool of worker threads
+    void sourceNodes(SourceJobs& jobs);
+    ///finest resolution of the image patch, exaggerated for unaligned sampling
+    Point::Scalar getImageResolution(Patch* imgPatch);
+    /** determine the base patches being built that receive data from the
+        image patch. Only depends on the geometry of the patch and the globe,
+        such that independent processes agree on the partitioning */
+    void computeSourcePatches(Patch* imgPatch, PatchIds& basePatches);
+    /** gather the geometry of all the sources and index the ones contributing
+        to the patches being built */
+    void indexSources();
+    /** sources the indexed sources to create new finer levels or update
+        existing ones. Returns the depth of the update-tree for use during
+        updating of the coarse levels. The fronts completed before an
+        interruption are only traversed */
+    int updateFinestLevels();
+    /** describes the update (globe, patches, sources and traversal) such that
+        a journal is only resumed for the same update */
+    std::string getSignature();
+
+    /** load the path from the root to the node of the given index into the
+        tree. Returns NULL if the node doesn't exist in the globe file */
+    Node* loadNode(const TreeIndex& index);
+    /** unload the subtrees not containing any of the pinned nodes. Returns
+        whether the subtree of the node contains pinned nodes */
+    bool unloadSubtrees(Node* node, const PinnedNodes& pinned);
+    /** unload the parts of the tree that aren't needed by the pending fronts
+        if the tree exceeds its memory budget */
+    void unloadNodes(const SourceFronts& pending);
 
+    /** locate the kin required to subsample the node. May load nodes into the
+        tree, hence must not be called concurrently */
+    void resolveSubsamplingKin(Node* node, CoarseJob& job);
+    ///read the data of a node through the tile cache. Thread-safe
+    void readTile(const Node* node, PixelType* buffer);
+    ///write the data of a node through the tile cache. Thread-safe
+    void writeTile(Node* node, PixelType* buffer);
     ///read all the finer data required for subsampling into a continuous region
-    void prepareSubsamplingDomain(Node* node);
-    /** traverse the tree to resample the next level of nodes that have had
-        finer data modified */
-    void updateCoarser(Node* node, int level);
-    ///regenerate interior hierarchy nodes that have had finer levels updated
+    void prepareSubsamplingDomain(const CoarseJob& job, CoarseScratch& scratch);
+    /** gather, in depth-first order, the nodes of the given level that have
+        had finer data modified: the parents of the modified nodes of the finer
+        level and of the nodes sourced at the finer level */
+    void gatherCoarser(int level, const TreeIndices& finer,
+                       TreeIndices& nodes);
+    ///resample a node from its finer data and commit it to file
+    void updateCoarser(const CoarseJob& job, CoarseScratch& scratch);
+    ///pops the next node to be resampled from the queue. Thread-safe
+    const CoarseJob* nextCoarseJob();
+    /** regenerate interior hierarchy nodes that have had finer levels
+        updated. The levels completed before an interruption are skipped */
     void updateCoarserLevels(int depth);
 
     ///new or existing database containing the hierarchy to be updated
     Globe* globe;
+    ///flags the base patches of the globe that are being built
+    std::vector<bool> buildPatches;
 
     ///temporary buffer to hold scope refinements
     Scope::Scalar* scopeBuf;
-    ///temporary buffer to hold sample positions for sourcing data
-    Point* sampleBuf;
     ///temporary buffer to hold node data
     PixelType* nodeDataBuf;
     ///temporary buffer to hold node data that needs to be sampled before use
     PixelType* nodeDataSampleBuf;
     ///size of the tiles to be generated/updated
     size_t tileSize[2];
-    ///temporary buffer to hold the subsampling domain
-    PixelType* domainBuf;
     ///size of the temporary subsampling domain
     size_t domainSize[2];
+    ///maximum number of nodes of the tree kept in memory
+    size_t maxTreeNodes;
+    /** maximum number of nodes in a front of the finest pass. Larger fronts
+        are split and processed depth-first */
+    size_t frontSize;
+
+    ///serializes the access to the globe file from the sourcing workers
+    Threads::Mutex fileMutex;
+    ///geometry of the sources (indexed like the image patch sources)
+    SourceInfos sourceInfos;
+    ///spatial index over the sources contributing to the patches being built
+    SourceIndex sourceIndex;
+    ///sources contributing to each of the base patches
+    std::vector<SourceIds> rootSources;
+
+    ///serializes the access to the queue of nodes to be sourced
+    Threads::Mutex sourceQueueMutex;
+    ///nodes to be sourced by the workers
+    SourceJobs* sourceQueue;
+    ///position of the next node to be sourced in the queue
+    size_t sourceQueueNext;
+
+    ///serializes the access to the queue of nodes to be resampled
+    Threads::Mutex coarseQueueMutex;
+    ///nodes to be resampled by the workers
+    CoarseJobs* coarseQueue;
+    ///position of the next node to be resampled in the queue
+    size_t coarseQueueNext;
+    ///recently accessed tiles of the globe file
+    TileCache<PixelParam>* tileCache;
+
+    ///location of the journal of the update (specific to the built patches)
+    std::string journalPath;
+    ///progress of the update
+    BuildJournal journal;
 
 //- Inherited from BuilderBase
 public:
@@ -2,6 +2,10 @@
 
 //#include "omp.h"
 
+#include <algorithm>
+#include <sstream>
+
+#include <construo/construoGlobals.h>
 #include <construo/ImageFileLoader.h>
 #include <construo/ImagePatch.h>
 #include <construo/SubsampleFilter.h>
@@ -19,10 +23,6 @@
 #define DEBUG_PREPARESUBSAMPLINGDOMAIN 0
 #define DEBUG_SOURCEFINEST 0
 #define DEBUG_SOURCEFINEST_SHOW_TEXELS 0
-#define DEBUG_FLAGANCESTORSFORUPDATE 0
-#if DEBUG_FLAGANCESTORSFORUPDATE
-static float flagAncestorsForUpdateColor[3];
-#endif //DEBUG_FLAGANCESTORSFORUPDATE
 #include <construo/ConstruoVisualizer.h>
 #endif //CRUSTA_ENABLE_DEBUG
 
@@ -30,7 +30,8 @@ namespace crusta {
 
 template <typename PixelParam>
 Builder<PixelParam>::
-Builder(const std::string& spheroidName, const size_t size[2])
+Builder(const std::string& spheroidName, const size_t size[2],
+        const PatchIds& patches)
 {
 ///\todo Frak this is retarded. Reason so far is the getRefinement from scope
 assert(size[0]==size[1]);
@@ -38,16 +39,45 @@ assert(size[0]==size[1]);
     tileSize[0] = size[0];
     tileSize[1] = size[1];
 
-    globe = new Globe(spheroidName, tileSize);
+    globe = new Globe(spheroidName, tileSize, patches);
+
+    buildPatches.resize(globe->baseNodes.size(), patches.empty());
+    for (PatchIds::const_iterator it=patches.begin(); it!=patches.end(); ++it)
+        buildPatches[*it] = true;
 
     scopeBuf          = new Scope::Scalar[tileSize[0]*tileSize[1]*3];
-    sampleBuf         = new Point[tileSize[0]*tileSize[1]];
     nodeDataBuf       = new PixelType[tileSize[0]*tileSize[1]];
     nodeDataSampleBuf = new PixelType[tileSize[0]*tileSize[1]];
     //the -3 takes into account the shared edges of the tiles
     domainSize[0] = 4*tileSize[0] - 3;
     domainSize[1] = 4*tileSize[1] - 3;
-    domainBuf     = new PixelType[domainSize[0]*domainSize[1]];
+
+    sourceQueue     = NULL;
+    sourceQueueNext = 0;
+    coarseQueue     = NULL;
+    coarseQueueNext = 0;
+
+    tileCache = new TileCache<PixelParam>(tileSize[0]*tileSize[1],
+                                          CONSTRUO_SETTINGS.tileCacheSize,
+                                          fileMutex);
+
+    /* the memory of a node is dominated by the node itself and the vertices
+       of its coverage. The fronts are sized to leave room for the pending
+       fronts of the depth-first traversal (at most four per level) and the
+       ancestors */
+    size_t nodeMemory = sizeof(Node) + sizeof(Point) *
+                        globe->baseNodes[0].coverage.getVertices().size();
+    maxTreeNodes = size_t(CONSTRUO_SETTINGS.treeMemory)*1024*1024 / nodeMemory;
+    frontSize    = std::max(maxTreeNodes/128, size_t(1024));
+
+    /* processes building disjoint subsets of the patches keep separate
+       journals */
+    std::ostringstream oss;
+    oss << spheroidName << "/construo";
+    for (PatchIds::const_iterator it=patches.begin(); it!=patches.end(); ++it)
+        oss << "_" << *it;
+    oss << ".journal";
+    journalPath = oss.str();
 }
 
 template <typename PixelParam>
@@ -56,25 +86,171 @@ Builder<PixelParam>::
 {
     delete globe;
     delete[] scopeBuf;
+    delete[] nodeDataBuf;
+    delete[] nodeDataSampleBuf;
+    delete tileCache;
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::SourceScratch::
+SourceScratch(const size_t tileSize[2])
+{
+    scopeBuf     = new Scope::Scalar[tileSize[0]*tileSize[1]*3];
+    sphericalBuf = new Point[tileSize[0]*tileSize[1]];
+    sampleBuf    = new Point[tileSize[0]*tileSize[1]];
+    nodeDataBuf  = new PixelType[tileSize[0]*tileSize[1]];
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::SourceScratch::
+~SourceScratch()
+{
+    delete[] scopeBuf;
+    delete[] sphericalBuf;
     delete[] sampleBuf;
     delete[] nodeDataBuf;
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::SourceWorker::
+SourceWorker() :
+    builder(NULL), scratch(NULL)
+{
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::SourceWorker::
+~SourceWorker()
+{
+    for (typename OpenPatches::iterator it=patches.begin(); it!=patches.end();
+         ++it)
+    {
+        delete it->second;
+    }
+}
+
+template <typename PixelParam>
+void* Builder<PixelParam>::SourceWorker::
+run()
+{
+    const SourceJob* job;
+    while ((job=builder->nextSourceJob()) != NULL)
+        builder->sourceFinest(*job, *this);
+    return NULL;
+}
+
+template <typename PixelParam>
+typename Builder<PixelParam>::Patch* Builder<PixelParam>::SourceWorker::
+getPatch(int source)
+{
+    //move a patch that is already open to the front
+    for (typename OpenPatches::iterator it=patches.begin(); it!=patches.end();
+         ++it)
+    {
+        if (it->first == source)
+        {
+            patches.splice(patches.begin(), patches, it);
+            return it->second;
+        }
+    }
+
+    //close the least recently used patches to make room
+    size_t maxOpen = size_t(std::max(CONSTRUO_SETTINGS.maxOpenSources, 1));
+    while (patches.size() >= maxOpen)
+    {
+        delete patches.back().second;
+        patches.pop_back();
+    }
+
+    const ImagePatchSource& ps = builder->imagePatchSources[source];
+    Patch* patch = new Patch(ps.path, ps.pixelOffset, ps.pixelScale,
+                             ps.nodata, ps.pointSampled);
+    patches.push_front(std::make_pair(source, patch));
+    return patch;
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::CoarseScratch::
+CoarseScratch(const size_t tileSize[2], const size_t domainSize[2])
+{
+    nodeDataBuf       = new PixelType[tileSize[0]*tileSize[1]];
+    nodeDataSampleBuf = new PixelType[tileSize[0]*tileSize[1]];
+    domainBuf         = new PixelType[domainSize[0]*domainSize[1]];
+}
+
+template <typename PixelParam>
+Builder<PixelParam>::CoarseScratch::
+~CoarseScratch()
+{
+    delete[] nodeDataBuf;
     delete[] nodeDataSampleBuf;
     delete[] domainBuf;
 }
 
+template <typename PixelParam>
+void* Builder<PixelParam>::CoarseWorker::
+run()
+{
+    const CoarseJob* job;
+    while ((job=builder->nextCoarseJob()) != NULL)
+        builder->updateCoarser(*job, *scratch);
+    return NULL;
+}
 
 template <typename PixelParam>
+template <typename WorkerParam>
 void Builder<PixelParam>::
-subsampleChildren(Node* node)
+runWorkers(WorkerParam* workers, int numWorkers)
+{
+    //the calling thread acts as the first worker
+    Threads::Thread* threads = new Threads::Thread[numWorkers-1];
+    for (int i=1; i<numWorkers; ++i)
+        threads[i-1].start(&workers[i], &WorkerParam::run);
+    workers[0].run();
+    for (int i=1; i<numWorkers; ++i)
+        threads[i-1].join();
+    delete[] threads;
+}
+
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+readTile(const Node* node, PixelType* buffer)
 {
     typedef GlobeData<PixelParam> gd;
+    typename gd::File* file =
+        node->globeFile->getPatch(node->treeIndex.patch());
+    tileCache->read(file, node->tileIndex, buffer);
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+writeTile(Node* node, PixelType* buffer)
+{
+    typedef GlobeData<PixelParam> gd;
+
+    node->data = buffer;
+    typename gd::TileHeader header;
+    {
+        //the header may require reading the children's headers from file
+        Threads::Mutex::Lock lock(fileMutex);
+        header = node->getTileHeader();
+    }
+    typename gd::File* file =
+        node->globeFile->getPatch(node->treeIndex.patch());
+    tileCache->write(file, node->tileIndex, header, node->data);
+    node->data = NULL;
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+subsampleChildren(Node* node)
+{
     typedef PixelOps<PixelType>   po;
 
     assert(node->children != NULL);
     //read in the node's existing data from file
-    typename gd::File* file =
-        node->globeFile->getPatch(node->treeIndex.patch());
-    file->readTile(node->tileIndex, nodeDataSampleBuf);
+    readTile(node, nodeDataSampleBuf);
 
     const PixelType& nodata = node->globeFile->getNodata();
 
@@ -84,38 +260,19 @@ subsampleChildren(Node* node)
     const int halfSize[2] = { int((tileSize[0]+1)>>1), int((tileSize[1]+1)>>1) };
     for (int i=0; i<4; ++i)
     {
-//        #pragma omp parallel for
         for (int y=0; y<halfSize[1]; ++y)
         {
             PixelType* wbase = nodeDataBuf + y*2*tileSize[0];
             PixelType* rbase = nodeDataSampleBuf + y*tileSize[0] + offsets[i];
-            for (int x=0; x<halfSize[0]; ++x, wbase+=2, ++rbase)
+            po::expandRow(rbase, halfSize[0], nodata, wbase);
+            if (y<halfSize[1]-1)
             {
-                wbase[0] = rbase[0];
-                if (x<halfSize[0]-1)
-                {
-                    wbase[1] = po::average(rbase[0], rbase[1], nodata);
-                }
-                if (y<halfSize[1]-1)
-                {
-                    wbase[tileSize[0]] = po::average(
-                        rbase[0], rbase[tileSize[0]], nodata);
-                }
-                if (x<halfSize[0]-1 && y<halfSize[1]-1)
-                {
-                    wbase[tileSize[0]+1] = po::average(rbase[0], rbase[1],
-                        rbase[tileSize[0]], rbase[tileSize[0]+1], nodata);
-                }
+                po::expandRowPair(rbase, rbase+tileSize[0], halfSize[0],
+                                  nodata, wbase+tileSize[0]);
             }
         }
         //write the subsampled data to the child
-        Node& child = node->children[i];
-        child.data = nodeDataBuf;
-        typename gd::TileHeader header = child.getTileHeader();
-        typename gd::File* childFile =
-            child.globeFile->getPatch(child.treeIndex.patch());
-        childFile->writeTile(child.tileIndex, header, child.data);
-        child.data = NULL;
+        writeTile(&node->children[i], nodeDataBuf);
     }
 }
 
@@ -152,21 +309,6 @@ refine(Node* node)
     }
 }
 
-template <typename PixelParam>
-void Builder<PixelParam>::
-flagAncestorsForUpdate(Node* node)
-{
-    while (node!=NULL && !node->mustBeUpdated)
-    {
-#if DEBUG_FLAGANCESTORSFORUPDATE
-ConstruoVisualizer::addPrimitive(GL_LINES, node->coverage, flagAncestorsForUpdateColor);
-ConstruoVisualizer::show();
-#endif //DEBUG_FLAGANCESTORSFORUPDATE
-        node->mustBeUpdated = true;
-        node = node->parent;
-    }
-}
-
 struct ImgBox
 {
     typedef std::vector<int> Indices;
@@ -206,12 +348,96 @@ struct ImgBox
 typedef std::vector<ImgBox> ImgBoxes;
 
 
-///\todo overlap is apparently unused here
 template <typename PixelParam>
 void Builder<PixelParam>::
-sourceFinest(Node* node, Patch* imgPatch, size_t overlap)
+projectSamples(Patch* imgPatch, Point* samples)
 {
-    typedef GlobeData<PixelParam> gd;
+    //spacing of the control samples that are transformed exactly
+    static const int step = 8;
+
+    const ImageTransform* transform = imgPatch->transform;
+    const int numSamples = int(tileSize[0]*tileSize[1]);
+    const double maxError = CONSTRUO_SETTINGS.transformMaxError;
+    if (maxError<=0.0 || (tileSize[0]-1)%step!=0 || (tileSize[1]-1)%step!=0)
+    {
+        transform->worldToImage(numSamples, samples);
+        return;
+    }
+
+    /* transform a coarse grid of control samples and the centers of its cells
+       exactly */
+    const int ctrlSize[2] = { int(tileSize[0]-1)/step + 1,
+                              int(tileSize[1]-1)/step + 1 };
+    std::vector<Point> ctrl(ctrlSize[0]*ctrlSize[1]);
+    std::vector<Point> check((ctrlSize[0]-1)*(ctrlSize[1]-1));
+    for (int y=0; y<ctrlSize[1]; ++y)
+    {
+        for (int x=0; x<ctrlSize[0]; ++x)
+        {
+            ctrl[y*ctrlSize[0] + x] = samples[y*step*tileSize[0] + x*step];
+            if (x<ctrlSize[0]-1 && y<ctrlSize[1]-1)
+            {
+                check[y*(ctrlSize[0]-1) + x] = samples[
+                    (y*step + step/2)*tileSize[0] + x*step + step/2];
+            }
+        }
+    }
+    transform->worldToImage(int(ctrl.size()),  &ctrl[0]);
+    transform->worldToImage(int(check.size()), &check[0]);
+
+    /* the bilinear interpolation of the control samples must reproduce the
+       exact transformation of the cell centers within the allowed error.
+       Otherwise (e.g. strong distortion, projection failure) transform all the
+       samples exactly */
+    for (int y=0; y<ctrlSize[1]-1; ++y)
+    {
+        for (int x=0; x<ctrlSize[0]-1; ++x)
+        {
+            const Point* c = &ctrl[y*ctrlSize[0] + x];
+            const Point& exact = check[y*(ctrlSize[0]-1) + x];
+            for (int i=0; i<2; ++i)
+            {
+                double approx = 0.25 * (c[0][i] + c[1][i] +
+                                        c[ctrlSize[0]][i] + c[ctrlSize[0]+1][i]);
+                //the negated comparison also catches NaNs
+                if (!(Math::abs(approx - exact[i]) <= maxError))
+                {
+                    transform->worldToImage(numSamples, samples);
+                    return;
+                }
+            }
+        }
+    }
+
+    //interpolate all the samples from the control ones
+    const double invStep = 1.0 / step;
+    for (int y=0; y<int(tileSize[1]); ++y)
+    {
+        int    cy = std::min(y/step, ctrlSize[1]-2);
+        double fy = (y - cy*step) * invStep;
+        for (int x=0; x<int(tileSize[0]); ++x)
+        {
+            int    cx = std::min(x/step, ctrlSize[0]-2);
+            double fx = (x - cx*step) * invStep;
+
+            const Point* c = &ctrl[cy*ctrlSize[0] + cx];
+            Point& p       = samples[y*tileSize[0] + x];
+            for (int i=0; i<2; ++i)
+            {
+                double bottom = c[0][i] + fx*(c[1][i] - c[0][i]);
+                double top    = c[ctrlSize[0]][i] +
+                                fx*(c[ctrlSize[0]+1][i] - c[ctrlSize[0]][i]);
+                p[i] = bottom + fy*(top - bottom);
+            }
+        }
+    }
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+sampleSource(Node* node, Patch* imgPatch, SourceScratch& scratch)
+{
+    Point* sampleBuf = scratch.sampleBuf;
 
     ImgBoxes imgBoxes;
     const int*        imgSize  = imgPatch->image->getSize();
@@ -219,18 +445,13 @@ sourceFinest(Node* node, Patch* imgPatch, size_t overlap)
     const Point::Scalar allowedBoxSize[2] = { Point::Scalar(imgSize[0]>>1), Point::Scalar(imgSize[1]>>1) };
 
     //transform all the sample points into the image space
-    node->scope.getRefinement(tileSize[0], scopeBuf);
+    std::copy(scratch.sphericalBuf,
+              scratch.sphericalBuf + tileSize[0]*tileSize[1], sampleBuf);
+    projectSamples(imgPatch, sampleBuf);
 
     for (int i=0; i<int(tileSize[0]*tileSize[1]); ++i)
     {
-        Point& p = sampleBuf[i];
-
-        //convert the scope sample to a spherical one
-        const Scope::Scalar* curScope = &scopeBuf[i*3];
-        p = Converter::cartesianToSpherical(
-            Scope::Vertex(curScope[0], curScope[1], curScope[2]));
-        //transform the sample into the image space
-        p = imgPatch->transform->worldToImage(p);
+        const Point& p = sampleBuf[i];
 
         //make sure the sample is valid
         if (p[0]<0 || p[0]>imgSize[0]-1 || p[1]<0 || p[1]>imgSize[1]-1)
@@ -254,12 +475,6 @@ sourceFinest(Node* node, Patch* imgPatch, size_t overlap)
         }
     }
 
-    //prepare the node's data buffer
-    node->data = nodeDataBuf;
-    typename gd::File* file =
-        node->globeFile->getPatch(node->treeIndex.patch());
-    file->readTile(node->tileIndex, node->data);
-
     //go through all the image boxes and sample them
     const PixelType& globeNodata = node->globeFile->getNodata();
 //    #pragma omp parallel for
@@ -276,7 +491,8 @@ sourceFinest(Node* node, Patch* imgPatch, size_t overlap)
             rectSize[i]   = static_cast<int>(Math::ceil (ib.max[i])) -
                             rectOrigin[i] + 1;
         }
-        PixelType* rectBuffer = new PixelType[rectSize[0] * rectSize[1]];
+        scratch.rectBuf.resize(rectSize[0] * rectSize[1]);
+        PixelType* rectBuffer = &scratch.rectBuf[0];
         imgPatch->image->readRectangle(rectOrigin, rectSize, rectBuffer);
 
         //sample the points
@@ -305,64 +521,64 @@ ConstruoVisualizer::addPrimitive(GL_POINTS, scopeSample, scopeSampleColor);
 ConstruoVisualizer::show();
 #endif //DEBUG_SOURCEFINEST
         }
-        //clean up the temporary image uffer
-        delete[] rectBuffer;
     }
+}
 
-    //prepare the header
-    typename gd::TileHeader header = node->getTileHeader();
+template <typename PixelParam>
+void Builder<PixelParam>::
+sourceFinest(const SourceJob& job, SourceWorker& worker)
+{
+    Node* node             = job.node;
+    SourceScratch& scratch = *worker.scratch;
+
+    //convert the scope samples to spherical ones
+    node->scope.getRefinement(tileSize[0], scratch.scopeBuf);
+    for (int i=0; i<int(tileSize[0]*tileSize[1]); ++i)
+    {
+        const Scope::Scalar* curScope = &scratch.scopeBuf[i*3];
+        scratch.sphericalBuf[i] = Converter::cartesianToSpherical(
+            Scope::Vertex(curScope[0], curScope[1], curScope[2]));
+    }
+
+    //prepare the node's data buffer
+    node->data = scratch.nodeDataBuf;
+    readTile(node, node->data);
+
+    /* sample all the contributing sources in order, such that later sources
+       overwrite earlier ones */
+    for (SourceIds::const_iterator it=job.sources.begin();
+         it!=job.sources.end(); ++it)
+    {
+        try
+        {
+            sampleSource(node, worker.getPatch(*it), scratch);
+        }
+        catch (std::runtime_error err)
+        {
+            std::cerr << "Ignoring image patch " <<
+                         imagePatchSources[*it].path << " for node " <<
+                         node->treeIndex.med_str() << " due to exception " <<
+                         err.what() << std::endl;
+        }
+    }
 
     //commit the data to file
-    file->writeTile(node->tileIndex, header, node->data);
+    writeTile(node, node->data);
 
 #if 0
 {
 static const float color[3] = { 0.2f, 1.0f, 0.1f };
-ConstruoVisualizer::addScopeRefinement(tileSize[0], scopeBuf, color);
+ConstruoVisualizer::addScopeRefinement(tileSize[0], scratch.scopeBuf, color);
 ConstruoVisualizer::show();
 }
 #endif
-    node->data = NULL;
-
-    if (node->parent != NULL)
-    {
-#if DEBUG_FLAGANCESTORSFORUPDATE
-flagAncestorsForUpdateColor[0] = (float)rand() / RAND_MAX;
-flagAncestorsForUpdateColor[1] = (float)rand() / RAND_MAX;
-flagAncestorsForUpdateColor[2] = (float)rand() / RAND_MAX;
-#endif //DEBUG_FLAGANCESTORSFORUPDATE
-        //make sure that the parent dependent on this new data is also updated
-        flagAncestorsForUpdate(node->parent);
-
-///\TODO Proper filtering will need this, but it is quite broken right now
-#if 0
-        //we musn't forget to update all the adjacent non-sibling nodes either
-/**\todo DANGER: there exist valence 5 corners. Need to account for reaching 2
-different nodes on corners depending on which neighbor we traverse first. Need
-to adjust getKin and its API to allow this */
-        static const int offsets[4][3][2] = {
-            { {-1, 0}, {-1,-1}, { 0,-1} }, { { 0,-1}, { 1,-1}, { 1, 0} },
-            { {-1, 0}, {-1, 1}, { 0, 1} }, { { 0, 1}, { 1, 1}, { 1, 0} }
-        };
-        int off[2];
-        Node* kin;
-        for (size_t i=0; i<3; ++i)
-        {
-            off[0] = offsets[node->treeIndex.child][i][0];
-            off[1] = offsets[node->treeIndex.child][i][1];
-            node->parent->getKin(kin, off);
-            if (kin != NULL)
-                flagAncestorsForUpdate(kin);
-        }
-#endif
-    }
 ///\todo this is debugging code to check tree consistency
 //verifyQuadtreeFile(node);
 }
 
 template <typename PixelParam>
-int Builder<PixelParam>::
-updateFiner(Node* node, Patch* imgPatch, Point::Scalar imgResolution)
+void Builder<PixelParam>::
+findSources(Node* node, Point::Scalar parentResolution, SourceIds& sources)
 {
 ///\todo remove
 #if DEBUG_SOURCEFINEST || 0
@@ -371,45 +587,165 @@ ConstruoVisualizer::addSphereCoverage(node->coverage, -1, covColor);
 ConstruoVisualizer::peek();
 #endif
 
-    //check for an overlap
-    size_t overlap = node->coverage.overlaps(*(imgPatch->sphereCoverage));
-    ///\todo HACK: For some reason if we test coverage at the root nodes it can
-    //  mess up when the patch only 'slightly' goes into a given root node, so
-    //  here we make sure we always go down at least a level.
-    //  Unfortunately this subdivides nodes more than needed... must find the
-    //  root problem at some point...
-    if (overlap == SphereCoverage::SEPARATE && node->parent)
-        return 0;
-
-    //recurse to children if the resolution of the node is too coarse
-    if (node->resolution > imgResolution)
-    {
-        int depth = 0;
-        refine(node);
-        for (size_t i=0; i<4; ++i)
+    /* query the index in the 4 spaces produced by periodicity. The coverage
+       overlap test shifts the sources' coverage, so the query shifts the
+       node's box the opposite way */
+    static const Point::Scalar PI = Math::Constants<Point::Scalar>::pi;
+    static const SphereCoverage::Vector shifts[4] = {
+        SphereCoverage::Vector(0, 0), SphereCoverage::Vector(-2.0*PI, 0),
+        SphereCoverage::Vector(0, -PI), SphereCoverage::Vector(-2.0*PI, -PI)
+    };
+    SourceIds candidates;
+    for (int i=0; i<4; ++i)
+    {
+        Box box = node->coverage.getBoundingBox();
+        box.shift(shifts[i]);
+        sourceIndex.query(box, candidates);
+    }
+    //retain the order of the sources for overwriting
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+
+    /* only the sources that were too fine for the parent reach the node. The
+       exact coverage test is only performed for those */
+    for (SourceIds::const_iterator it=candidates.begin();
+         it!=candidates.end(); ++it)
+    {
+        const SourceInfo& info = sourceInfos[*it];
+        if (parentResolution > info.resolution &&
+            node->coverage.overlaps(info.coverage) != SphereCoverage::SEPARATE)
         {
-            depth = std::max(updateFiner(&node->children[i], imgPatch,
-                                         imgResolution), depth);
+            sources.push_back(*it);
         }
-        return depth;
     }
+}
+
+template <typename PixelParam>
+const typename Builder<PixelParam>::SourceJob* Builder<PixelParam>::
+nextSourceJob()
+{
+    Threads::Mutex::Lock lock(sourceQueueMutex);
+    if (sourceQueue==NULL || sourceQueueNext>=sourceQueue->size())
+        return NULL;
+
+    const SourceJob* job = &(*sourceQueue)[sourceQueueNext++];
 
-    //this node has the appropriate resolution
-//ConstruoVisualizer::show();
-    sourceFinest(node, imgPatch, overlap);
-    return node->treeIndex.level();
+    //report the progress every few percent
+    size_t step = std::max(sourceQueue->size()/20, size_t(1));
+    if (sourceQueueNext%step == 0)
+    {
+        std::cout << ".";
+        std::cout.flush();
+    }
+    return job;
 }
 
 template <typename PixelParam>
-int Builder<PixelParam>::
-updateFinestLevels(const ImagePatchSource& patchSource)
+void Builder<PixelParam>::
+sourceNodes(SourceJobs& jobs)
 {
-    int depth = 0;
+    int numThreads = std::min(CONSTRUO_SETTINGS.numThreads, int(jobs.size()));
+    numThreads     = std::max(numThreads, 1);
+
+    std::cout << "Sourcing " << jobs.size() << " nodes using " <<
+                 numThreads << " thread(s) ";
+    std::cout.flush();
 
-    //create a new image patch
-    Patch patch(patchSource.path,
-                patchSource.pixelOffset, patchSource.pixelScale,
-                patchSource.nodata, patchSource.pointSampled);
+    sourceQueue     = &jobs;
+    sourceQueueNext = 0;
+
+    /* the GDAL datasets and coordinate transformations cannot be shared
+       between threads, so every worker opens its own handles to the sources */
+    SourceWorker* workers = new SourceWorker[numThreads];
+    for (int i=0; i<numThreads; ++i)
+    {
+        workers[i].builder = this;
+        workers[i].scratch = new SourceScratch(tileSize);
+    }
+
+    runWorkers(workers, numThreads);
+
+    for (int i=0; i<numThreads; ++i)
+        delete workers[i].scratch;
+    delete[] workers;
+
+    sourceQueue = NULL;
+
+    std::cout << " done\n";
+    std::cout.flush();
+}
+
+template <typename PixelParam>
+Point::Scalar Builder<PixelParam>::
+getImageResolution(Patch* imgPatch)
+{
+    //grab the smallest resolution from the image
+    Point::Scalar imgResolution = imgPatch->transform->getFinestResolution(
+        imgPatch->image->getSize());
+    /* exaggerate the image's resolution because our sampling is not aligned
+       with the image axis */
+    return imgResolution * Point::Scalar(Math::sqrt(2.0));
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+computeSourcePatches(Patch* imgPatch, PatchIds& basePatches)
+{
+    basePatches.clear();
+
+    Point::Scalar imgResolution = getImageResolution(imgPatch);
+    for (size_t i=0; i<globe->baseNodes.size(); ++i)
+    {
+        if (!buildPatches[i])
+            continue;
+
+        ///\todo HACK: For some reason if we test coverage at the root nodes it
+        //  can mess up when the patch only 'slightly' goes into a given root
+        //  node, so here the test is performed on the children instead.
+        //  A root with a fine enough resolution is always sourced.
+        //  Unfortunately this subdivides nodes more than needed... must find
+        //  the root problem at some point...
+        const Node& root = globe->baseNodes[i];
+        bool overlaps    = root.resolution <= imgResolution;
+
+        Scope childScopes[4];
+        root.scope.split(childScopes);
+        for (int c=0; c<4 && !overlaps; ++c)
+        {
+            StaticSphereCoverage childCoverage(2, childScopes[c]);
+            overlaps = childCoverage.overlaps(*(imgPatch->sphereCoverage)) !=
+                       SphereCoverage::SEPARATE;
+        }
+
+        if (overlaps)
+            basePatches.push_back(int(i));
+    }
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+indexSources()
+{
+    int numSources = static_cast<int>(imagePatchSources.size());
+
+    sourceInfos.clear();
+    sourceInfos.resize(numSources);
+    sourceIndex.clear();
+    rootSources.clear();
+    rootSources.resize(globe->baseNodes.size());
+
+    /* gather the geometry of the sources and determine up front which base
+       patches each source contributes to */
+    std::cout << "*** Indexing " << numSources << " source image(s)\n";
+    PatchIds basePatches;
+    for (int i=0; i<numSources; ++i)
+    {
+        const ImagePatchSource& source = imagePatchSources[i];
+        try
+        {
+            Patch patch(source.path, source.pixelOffset, source.pixelScale,
+                        source.nodata, source.pointSampled);
 
 ///\todo remove
 #if DEBUG_SOURCE_FINEST
@@ -458,61 +794,286 @@ ConstruoVisualizer::addPrimitive(GL_POINTS, centers, centerColor);
 ConstruoVisualizer::show();
 #endif //show image pixels
 
-    //grab the smallest resolution from the image
-    Point::Scalar imgResolution=patch.transform->getFinestResolution(
-        patch.image->getSize());
-    /* exaggerate the image's resolution because our sampling is not aligned
-       with the image axis */
-    imgResolution *= Point::Scalar(Math::sqrt(2.0));
+            computeSourcePatches(&patch, basePatches);
+            sourceInfos[i].coverage   = *patch.sphereCoverage;
+            sourceInfos[i].resolution = getImageResolution(&patch);
+        }
+        catch(std::runtime_error err)
+        {
+            std::cerr << "Ignoring image patch " << source.path <<
+                         " due to exception " << err.what() << std::endl;
+            continue;
+        }
+
+        std::cout << source.path << ":";
+        for (PatchIds::const_iterator it=basePatches.begin();
+             it!=basePatches.end(); ++it)
+        {
+            std::cout << " " << *it;
+            rootSources[*it].push_back(i);
+        }
+        std::cout << "\n";
 
-    //iterate over all the spheroid's base patches to determine overlap
-    for (typename Globe::BaseNodes::iterator bIt=globe->baseNodes.begin();
-         bIt!=globe->baseNodes.end(); ++bIt)
+        //sources not contributing to the patches being built are skipped
+        if (!basePatches.empty())
+            sourceIndex.add(i, sourceInfos[i].coverage.getBoundingBox());
+    }
+    sourceIndex.build();
+
+    std::cout << sourceIndex.size() << " source image(s) contribute to the "
+                 "patches being built\n\n";
+    std::cout.flush();
+}
+
+template <typename PixelParam>
+int Builder<PixelParam>::
+updateFinestLevels()
+{
+    int depth       = 0;
+    int front       = 0;
+    int resumeFront = journal.getFinestFront();
+
+    /* the tree is processed front by front, a front being nodes of the same
+       level. The nodes of a front are sourced from all their contributing
+       sources in a single pass, before the nodes requiring finer data are
+       refined. This way coarser source data is pushed down into new children
+       when they are created. The children form the next front, which is split
+       if too large. The pending fronts are processed depth-first, such that
+       only they and their ancestors need to be kept in memory. The roots
+       consider all the sources assigned to their base patch, as the overlap
+       test is unreliable at that level (see computeSourcePatches) */
+    SourceFronts pending(1);
+    for (size_t i=0; i<globe->baseNodes.size(); ++i)
+    {
+        if (rootSources[i].empty())
+            continue;
+        SourceJob job;
+        job.node    = &globe->baseNodes[i];
+        job.sources = rootSources[i];
+        pending.back().push_back(job);
+    }
+    if (pending.back().empty())
+        pending.clear();
+
+    SourceJobs frontier;
+    SourceJobs jobs;
+    SourceJobs refines;
+    SourceJobs next;
+    TreeIndices sourced;
+    while (!pending.empty())
     {
-        depth = std::max(updateFiner(&(*bIt), &patch, imgResolution), depth);
+        frontier.swap(pending.back());
+        pending.pop_back();
+
+        int  level = int(frontier.front().node->treeIndex.level());
+        bool done  = front <= resumeFront;
+        std::cout << "*** Front " << front << ", level " << level << ": " <<
+                     frontier.size() << " node(s) overlapped by sources\n";
+        if (done)
+            std::cout << "Sourced before the interruption\n";
+        std::cout.flush();
 
-        std::cout << ".";
+        //split the sources of each node into the ones sampled here and finer
+        jobs.clear();
+        refines.clear();
+        sourced.clear();
+        for (typename SourceJobs::iterator it=frontier.begin();
+             it!=frontier.end(); ++it)
+        {
+            Node* node = it->node;
+            SourceJob here;
+            SourceJob finer;
+            here.node  = node;
+            finer.node = node;
+            for (SourceIds::const_iterator sIt=it->sources.begin();
+                 sIt!=it->sources.end(); ++sIt)
+            {
+                if (node->resolution > sourceInfos[*sIt].resolution)
+                    finer.sources.push_back(*sIt);
+                else
+                    here.sources.push_back(*sIt);
+            }
+
+            if (!here.sources.empty())
+            {
+                depth = std::max(depth, level);
+                if (!done)
+                {
+                    jobs.push_back(here);
+                    sourced.push_back(node->treeIndex);
+                }
+            }
+            if (!finer.sources.empty())
+                refines.push_back(finer);
+        }
+
+        //source the data for all the nodes of the front
+        if (!jobs.empty())
+            sourceNodes(jobs);
+
+        /* refine the tree for the finer sources and gather the next front. The
+           tree is only modified serially */
+        next.clear();
+        for (typename SourceJobs::iterator it=refines.begin();
+             it!=refines.end(); ++it)
+        {
+            Node* node = it->node;
+            refine(node);
+            for (int c=0; c<4; ++c)
+            {
+                SourceJob child;
+                child.node = &node->children[c];
+                findSources(child.node, node->resolution, child.sources);
+                if (!child.sources.empty())
+                    next.push_back(child);
+            }
+        }
+
+        /* queue the next front in chunks, the first chunk last such that it is
+           processed next */
+        size_t numChunks = (next.size() + frontSize - 1) / frontSize;
+        for (size_t c=numChunks; c>0; --c)
+        {
+            typename SourceJobs::iterator begin = next.begin() + (c-1)*frontSize;
+            typename SourceJobs::iterator end   =
+                next.begin() + std::min(c*frontSize, next.size());
+            pending.push_back(SourceJobs(begin, end));
+        }
+
+        /* commit the data of the front to disk before recording its
+           completion, such that an interrupted update resumes from here */
+        if (!done)
+        {
+            globe->globeFile.flush();
+            journal.finestFront(front, sourced);
+        }
+        ++front;
+
+        //release the parts of the tree the pending fronts don't need
+        unloadNodes(pending);
+
+        std::cout << "\n";
         std::cout.flush();
-///\todo this is debugging code to check tree consistency
-//verifyQuadtreeFile(&(*bIt));
-//ConstruoVisualizer::show();
     }
-    std::cout << " done\n\n";
-    std::cout.flush();
 
     return depth;
 }
 
+template <typename PixelParam>
+std::string Builder<PixelParam>::
+getSignature()
+{
+    std::ostringstream oss;
+    oss.precision(17);
+    oss << globe->globeFile.getDataType() << " " << tileSize[0] << "x" <<
+           tileSize[1] << " " << frontSize << "\n";
+    for (size_t i=0; i<buildPatches.size(); ++i)
+        oss << (buildPatches[i] ? "1" : "0");
+    oss << "\n";
+    for (ImagePatchSources::const_iterator it=imagePatchSources.begin();
+         it!=imagePatchSources.end(); ++it)
+    {
+        oss << it->path << " " << it->pixelOffset << " " << it->pixelScale <<
+               " " << it->nodata << " " << it->pointSampled << "\n";
+    }
+    return oss.str();
+}
+
+template <typename PixelParam>
+typename Builder<PixelParam>::Node* Builder<PixelParam>::
+loadNode(const TreeIndex& index)
+{
+    //follow the path from the root, loading the nodes along the way
+    Node* node = &globe->baseNodes[index.patch()];
+    for (int l=0; l<int(index.level()); ++l)
+    {
+        if (node->children == NULL)
+            node->loadMissingChildren();
+        if (node->children == NULL)
+            return NULL;
+        node = &node->children[(index.index()>>(2*l)) & 0x3];
+    }
+    return node;
+}
+
+template <typename PixelParam>
+bool Builder<PixelParam>::
+unloadSubtrees(Node* node, const PinnedNodes& pinned)
+{
+    bool isPinned = pinned.find(node) != pinned.end();
+    if (node->children == NULL)
+        return isPinned;
+
+    bool childrenPinned = false;
+    for (int i=0; i<4; ++i)
+    {
+        if (unloadSubtrees(&node->children[i], pinned))
+            childrenPinned = true;
+    }
+
+    //the state of the children is in the globe file, they can be reloaded
+    if (!childrenPinned)
+        node->unloadChildren();
+
+    return isPinned || childrenPinned;
+}
+
 template <typename PixelParam>
 void Builder<PixelParam>::
-prepareSubsamplingDomain(Node* node)
+unloadNodes(const SourceFronts& pending)
 {
-    typedef GlobeData<PixelParam> gd;
+    if (Node::numNodes <= maxTreeNodes)
+        return;
+
+    PinnedNodes pinned;
+    for (typename SourceFronts::const_iterator fIt=pending.begin();
+         fIt!=pending.end(); ++fIt)
+    {
+        for (typename SourceJobs::const_iterator it=fIt->begin();
+             it!=fIt->end(); ++it)
+        {
+            pinned.insert(it->node);
+        }
+    }
 
+    size_t numNodes = Node::numNodes;
+    for (typename Globe::BaseNodes::iterator it=globe->baseNodes.begin();
+         it!=globe->baseNodes.end(); ++it)
+    {
+        unloadSubtrees(&(*it), pinned);
+    }
+
+    std::cout << "Unloaded " << numNodes - Node::numNodes << " of " <<
+                 numNodes << " node(s) of the tree\n";
+    std::cout.flush();
+}
+
+/* specify the order of lower-level nodes manually such that the inner nodes
+   are added last and overwrite the edge value (e.g. if one of the
+   neighboring nodes does not exist or has no valid values, we want to use
+   the inner node ones instead */
+static const int subsamplingKinOffsets[16][2] = {
+    {-1,-1}, { 0,-1}, { 1,-1}, { 2,-1}, {-1, 2}, { 0, 2}, { 1, 2}, { 2, 2},
+    {-1, 1}, {-1, 0}, { 2, 1}, { 2, 0}, { 0, 0}, { 1, 0}, { 0, 1}, { 1, 1}
+};
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+resolveSubsamplingKin(Node* node, CoarseJob& job)
+{
 #if DEBUG_PREPARESUBSAMPLINGDOMAIN
 ConstruoVisualizer::addPrimitive(GL_LINES, node->coverage);
 ConstruoVisualizer::show();
 #endif //DEBUG_PREPARESUBSAMPLINGDOMAIN
 
-    /* specify the order of lower-level nodes manually such that the inner nodes
-       are added last and overwrite the edge value (e.g. if one of the
-       neighboring nodes does not exist or has no valid values, we want to use
-       the inner node ones instead */
-    static const int offsets[16][2] = {
-        {-1,-1}, { 0,-1}, { 1,-1}, { 2,-1}, {-1, 2}, { 0, 2}, { 1, 2}, { 2, 2},
-        {-1, 1}, {-1, 0}, { 2, 1}, { 2, 0}, { 0, 0}, { 1, 0}, { 0, 1}, { 1, 1}
-    };
+    job.node = node;
     for (int i=0; i<16; ++i)
     {
-    //- retrieve the kin
-        Node* kin         = NULL;
-        PixelType* domain = domainBuf + (tileSize[1]-1)*domainSize[0] +
-                             tileSize[0]-1;
-
-        int domainOff[2] = {offsets[i][0], offsets[i][1]};
-        int nodeOff[2]   = {offsets[i][0], offsets[i][1]};
-        size_t kinO;
-        node->getKin(kin, nodeOff, true, 1, &kinO);
+        KinRef& ref = job.kin[i];
+        Node* kin   = NULL;
+        ref.offset[0] = subsamplingKinOffsets[i][0];
+        ref.offset[1] = subsamplingKinOffsets[i][1];
+        node->getKin(kin, ref.offset, true, 1, &ref.orientation);
 #if DEBUG_PREPARESUBSAMPLINGDOMAIN
 const static float scopeRefColor[3] = { 0.3f, 0.8f, 0.3f };
 kin->scope.getRefinement(tileSize[0], scopeBuf);
@@ -520,32 +1081,51 @@ ConstruoVisualizer::addScopeRefinement(tileSize[0], scopeBuf, scopeRefColor);
 ConstruoVisualizer::show();
 #endif //DEBUG_PREPARESUBSAMPLINGDOMAIN
 
-    //- retrieve data as appropriate
-        //default to blank data
-        const PixelType* data = node->globeFile->getBlank();
-
-        //read the data from file
 /**\todo disabled reading from neighbors that aren't from the same base patch.
 reading of neighbor data with differring orientation is currently absolutely
 broken, overwrites random memory regions and breaks fraking everything.
 Note: getKin across patches seem to be broken: e.g. offset==3 returned. */
-        if (kin != NULL && node->treeIndex.patch()==kin->treeIndex.patch())
+        if (kin!=NULL && node->treeIndex.patch()!=kin->treeIndex.patch())
+            kin = NULL;
+        /* sampling from the same patch will always have data (even if that
+           is "nodata" */
+        assert(kin==NULL || kin->tileIndex!=INVALID_TILEINDEX);
+        ref.node = kin;
+    }
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+prepareSubsamplingDomain(const CoarseJob& job, CoarseScratch& scratch)
+{
+    const Node* node = job.node;
+    for (int i=0; i<16; ++i)
+    {
+        const KinRef& ref = job.kin[i];
+        const Node* kin   = ref.node;
+        PixelType* domain = scratch.domainBuf +
+                            (tileSize[1]-1)*domainSize[0] + tileSize[0]-1;
+
+        const int* domainOff = subsamplingKinOffsets[i];
+        const int* nodeOff   = ref.offset;
+
+    //- retrieve data as appropriate
+        //default to blank data
+        const PixelType* data = node->globeFile->getBlank();
+
+        //read the data through the tile cache
+        if (kin != NULL)
         {
-            /* sampling from the same patch will always have data (even if that
-               is "nodata" */
-            assert(kin->tileIndex!=INVALID_TILEINDEX);
-            typename gd::File* file =
-                kin->globeFile->getPatch(kin->treeIndex.patch());
             if (nodeOff[0]==0 && nodeOff[1]==0)
             {
                 //we're grabbing data from a same leveled kin
-                file->readTile(kin->tileIndex, nodeDataBuf);
-                data = nodeDataBuf;
+                readTile(kin, scratch.nodeDataBuf);
+                data = scratch.nodeDataBuf;
             }
             else
             {
                 //need to sample coarser level node as the kin replacement
-                file->readTile(kin->tileIndex, nodeDataSampleBuf);
+                readTile(kin, scratch.nodeDataSampleBuf);
                 //determine the resample step size
                 double scale = 1;
                 for (size_t i=kin->treeIndex.level();
@@ -559,9 +1139,8 @@ Note: getKin across patches seem to be broken: e.g. offset==3 returned. */
                 int rectOrigin[2] = {0,0};
                 int rectSize[2] = {int(tileSize[0]), int(tileSize[1])};
                 const PixelType& nodata = kin->globeFile->getNodata();
-                PixelType* wbase = nodeDataBuf;
+                PixelType* wbase = scratch.nodeDataBuf;
 
-//                #pragma omp parallel for
                 typedef SubsampleFilter<PixelType, DYNAMIC_FILTER_TYPE> Filter;
                 for (size_t ny=0; ny<tileSize[1]; ++ny)
                 {
@@ -569,19 +1148,19 @@ Note: getKin across patches seem to be broken: e.g. offset==3 returned. */
                     at[0] = nodeOff[0]*scale;
                     for (size_t nx=0; nx<tileSize[0]; ++nx,at[0]+=step[0],++wbase)
                     {
-                        *wbase = Filter::sample(nodeDataSampleBuf, rectOrigin,
-                                                at, rectSize, nodata, nodata,
-                                                nodata);
+                        *wbase = Filter::sample(scratch.nodeDataSampleBuf,
+                                                rectOrigin, at, rectSize,
+                                                nodata, nodata, nodata);
                     }
                 }
-                data = nodeDataBuf;
+                data = scratch.nodeDataBuf;
             }
         }
 
 /**\todo disabled reading from neighbors that don't have the same orientation
 reading of neighbor data with differring orientation is currently absolutely
 broken, overwrites random memory regions and breaks fraking everything */
-kinO = 0;
+size_t kinO = 0;
     //- insert the data at the appropriate location
         PixelType* base = domain +
                           domainOff[1] * (tileSize[1]-1) * domainSize[0] +
@@ -590,7 +1169,6 @@ kinO = 0;
         int stepY[4]  = { int(tileSize[0]), 1,  -int(tileSize[0]), -1 };
         int startX[4] = { 0, 0, int(tileSize[0])-1, int(tileSize[0])-1 };
         int stepX[4]  = { 1,  -int(tileSize[1]), -1, int(tileSize[0])};
-//        #pragma omp parallel for
         for (size_t y=0; y<tileSize[1]; ++y)
         {
             PixelType* to         = base + y*domainSize[0];
@@ -602,31 +1180,56 @@ kinO = 0;
     }
 }
 
+/** orders the indices of nodes of the same level following a depth-first
+    traversal of the trees */
+struct TreeIndexDepthFirstLess
+{
+    bool operator()(const TreeIndex& a, const TreeIndex& b) const
+    {
+        if (a.patch() != b.patch())
+            return a.patch() < b.patch();
+
+        //the paths start at the root with the least significant bits
+        uint64_t aPath = a.index();
+        uint64_t bPath = b.index();
+        for (int l=0; l<int(a.level()); ++l, aPath>>=2, bPath>>=2)
+        {
+            if ((aPath&0x3) != (bPath&0x3))
+                return (aPath&0x3) < (bPath&0x3);
+        }
+        return false;
+    }
+};
+
 template <typename PixelParam>
 void Builder<PixelParam>::
-updateCoarser(Node* node, int level)
+gatherCoarser(int level, const TreeIndices& finer, TreeIndices& nodes)
 {
-#if DEBUG_PREPARESUBSAMPLINGDOMAIN
-static const float covColor[3] = { 0.1f, 0.4f, 0.6f };
-ConstruoVisualizer::addPrimitive(GL_LINES, node->coverage, covColor);
-ConstruoVisualizer::peek();
-#endif
-
-    //the nodes on the way must be flagged for update
-    if (!node->mustBeUpdated)
-        return;
+    nodes.clear();
+    for (TreeIndices::const_iterator it=finer.begin(); it!=finer.end(); ++it)
+        nodes.push_back(it->up());
 
-//- recurse until we've hit the requested level
-    if (node->treeIndex.level()!=static_cast<uint8_t>(level) &&
-        node->children!=NULL)
+    const TreeIndices& sourced = journal.getSourced();
+    for (TreeIndices::const_iterator it=sourced.begin(); it!=sourced.end();
+         ++it)
     {
-        for (size_t i=0; i<4; ++i)
-            updateCoarser(&(node->children[i]), level);
-        return;
+        if (int(it->level()) == level+1)
+            nodes.push_back(it->up());
     }
 
-//- we've reached a node that must be updated
-    prepareSubsamplingDomain(node);
+    /* siblings share their parent and neighboring nodes share kin, hence the
+       nodes are processed in depth-first order */
+    std::sort(nodes.begin(), nodes.end(), TreeIndexDepthFirstLess());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+}
+
+template <typename PixelParam>
+void Builder<PixelParam>::
+updateCoarser(const CoarseJob& job, CoarseScratch& scratch)
+{
+    Node* node = job.node;
+
+    prepareSubsamplingDomain(job, scratch);
 
     /* walk the pixels of the node's data and performed filtered look-ups into
        the domain */
@@ -634,31 +1237,33 @@ ConstruoVisualizer::peek();
 
     const PixelType& globeNodata = node->globeFile->getNodata();
 
-    PixelType* data = nodeDataBuf;
-    PixelType* domain;
-    for (domain = domainBuf +   (tileSize[1]-1)*domainSize[0]+  (tileSize[0]-1);
-         domain<= domainBuf + 3*(tileSize[1]-1)*domainSize[0]+3*(tileSize[0]-1);
-         domain+= 2*domainSize[0] - 2*tileSize[0])
+    PixelType* domain = scratch.domainBuf +
+                        (tileSize[1]-1)*domainSize[0] + (tileSize[0]-1);
+    PixelType* data   = scratch.nodeDataBuf;
+    for (size_t y=0; y<tileSize[1]; ++y, domain+=2*domainSize[0],
+         data+=tileSize[0])
     {
-        for (size_t i=0; i<tileSize[0]; ++i, domain+=2, ++data)
-            *data  = Filter::sample(domain, domainSize[0], globeNodata);
+        Filter::sampleRow(domain, domainSize[0], int(tileSize[0]),
+                          globeNodata, data);
     }
 
     //commit the data to file
-    node->data = nodeDataBuf;
-
-    typedef GlobeData<PixelParam> gd;
-    typename gd::TileHeader header = node->getTileHeader();
-    typename gd::File* file =
-        node->globeFile->getPatch(node->treeIndex.patch());
-
-    file->writeTile(node->tileIndex, header, node->data);
-
-    node->data = NULL;
+    writeTile(node, scratch.nodeDataBuf);
 ///\todo this is debugging code to check tree consistency
 //verifyQuadtreeFile(node);
 }
 
+template <typename PixelParam>
+const typename Builder<PixelParam>::CoarseJob* Builder<PixelParam>::
+nextCoarseJob()
+{
+    Threads::Mutex::Lock lock(coarseQueueMutex);
+    if (coarseQueue==NULL || coarseQueueNext>=coarseQueue->size())
+        return NULL;
+
+    return &(*coarseQueue)[coarseQueueNext++];
+}
+
 template <typename PixelParam>
 void Builder<PixelParam>::
 updateCoarserLevels(int depth)
@@ -666,25 +1271,82 @@ updateCoarserLevels(int depth)
     if (depth==0)
         return;
 
+    /* the nodes of a level are regenerated in batches. The nodes of a batch
+       and their kin are loaded serially, then the nodes are regenerated in
+       parallel. The finer tiles read during a batch are shared by the workers
+       through the tile cache. The tree is unloaded between batches if it
+       exceeds its memory budget */
+    static const size_t batchSize = 1024;
+
+    int numThreads = std::max(CONSTRUO_SETTINGS.numThreads, 1);
+    CoarseWorker* workers = new CoarseWorker[numThreads];
+    for (int i=0; i<numThreads; ++i)
+    {
+        workers[i].builder = this;
+        workers[i].scratch = new CoarseScratch(tileSize, domainSize);
+    }
+
+    TreeIndices finer;
+    TreeIndices nodes;
+    CoarseJobs  jobs;
+    int resumeLevel = journal.getCoarserLevel();
     for (int level=depth-1; level>=0; --level)
     {
+        //gather the nodes of the level from the ones modified below
+        gatherCoarser(level, finer, nodes);
+        finer.swap(nodes);
+
         std::cout << "Upsampling level " << level;
+        if (resumeLevel!=-1 && level>=resumeLevel)
+        {
+            std::cout << " done before the interruption" << std::endl;
+            continue;
+        }
         std::cout.flush();
-        for (typename Globe::BaseNodes::iterator it=globe->baseNodes.begin();
-             it!=globe->baseNodes.end(); ++it)
+
+        for (size_t b=0; b<finer.size(); b+=batchSize)
         {
-//ConstruoVisualizer::clear();
-//ConstruoVisualizer::addPrimitive(GL_LINES, it->coverage);
-//ConstruoVisualizer::show();
-            //traverse the tree and update the next level
-            updateCoarser(&(*it), level);
-//verifyQuadtreeFile(&(*it));
+            size_t batchEnd = std::min(b+batchSize, finer.size());
+            jobs.resize(batchEnd - b);
+            size_t numJobs = 0;
+            for (size_t i=b; i<batchEnd; ++i)
+            {
+                Node* node = loadNode(finer[i]);
+                if (node == NULL)
+                {
+                    std::cerr << "Node " << finer[i] << " is missing from the "
+                                 "globe file" << std::endl;
+                    continue;
+                }
+                resolveSubsamplingKin(node, jobs[numJobs++]);
+            }
+            jobs.resize(numJobs);
+
+            if (!jobs.empty())
+            {
+                coarseQueue     = &jobs;
+                coarseQueueNext = 0;
+                runWorkers(workers, std::min(numThreads, int(jobs.size())));
+                coarseQueue     = NULL;
+            }
+
+            unloadNodes(SourceFronts());
+//verifyQuadtreeFile(jobs[0].node);
             std::cout << ".";
             std::cout.flush();
         }
+
+        //commit the level to disk before recording its completion
+        globe->globeFile.flush();
+        journal.coarserLevel(level);
+
         std::cout << " done" << std::endl;
     }
     std::cout << std::endl;
+
+    for (int i=0; i<numThreads; ++i)
+        delete workers[i].scratch;
+    delete[] workers;
 }
 
 
@@ -692,27 +1354,34 @@ template <typename PixelParam>
 void Builder<PixelParam>::
 update()
 {
-    int depth = 0;
-    int numPatches = static_cast<int>(imagePatchSources.size());
-    for (int i=0; i<numPatches; ++i)
+    if (journal.open(journalPath, getSignature(), resume))
     {
-        try
-        {
-            std::cout << "*** Adding source image " << i+1 << " out of " <<
-                         numPatches << "\n\n";
-            std::cout.flush();
+        std::cout << "*** Resuming the interrupted update recorded in " <<
+                     journalPath << "\n\n";
+        std::cout.flush();
+    }
 
-            int newDepth = updateFinestLevels(imagePatchSources[i]);
-            depth = std::max(newDepth, depth);
-        }
-        catch(std::runtime_error err)
-        {
-            std::cerr << "Ignoring image patch " << imagePatchSources[i].path <<
-                         " due to exception " << err.what() << std::endl;
-        }
+    int depth;
+    if (journal.isFinestComplete())
+    {
+        //only the coarser levels of the recorded nodes remain to be updated
+        depth = journal.getDepth();
+    }
+    else
+    {
+        //index the sources, then source all the finest levels in a single pass
+        indexSources();
+        depth = updateFinestLevels();
+        journal.finestComplete(depth);
     }
 
     updateCoarserLevels(depth);
+
+    //the update is complete
+    journal.remove();
+
+    std::cout << "Tile cache: " << tileCache->getNumHits() << " hits, " <<
+                 tileCache->getNumMisses() << " misses" << std::endl;
 }
 
 ///\todo remove
@@ -21,18 +21,78 @@
  02111-1307 USA
  ***********************************************************************/
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
 
 #include <construo/Builder.h>
+#include <construo/TpmConverter.h>
 
 #include <crustacore/LayerData.h>
 
 
 using namespace crusta;
 
+/** replaces the sources with pre-tiled TPM copies in the given directory,
+    converting the sources as needed */
+template <typename PixelType>
+static void
+pretileSources(BuilderBase::ImagePatchSources& sources,
+               const std::string& directory)
+{
+    typedef TpmConverter<PixelType> Converter;
+    for (BuilderBase::ImagePatchSources::iterator it=sources.begin();
+         it!=sources.end(); ++it)
+    {
+        //sources that already are pre-tiled are used as is
+        if (Misc::hasCaseExtension(it->path.c_str(), ".tpm"))
+            continue;
+
+        std::string tpmName = Converter::getTpmName(it->path, directory);
+        Converter::convert(it->path, tpmName);
+        it->path = tpmName;
+    }
+}
+
+/** parses a comma separated list of base patch identifiers or ranges thereof
+    (e.g. "3,7,10-14") */
+static bool
+parsePatchList(const char* list, BuilderBase::PatchIds& patches)
+{
+    const char* at = list;
+    while (*at != '\0')
+    {
+        char* end;
+        long first = strtol(at, &end, 10);
+        if (end==at || first<0)
+            return false;
+        long last = first;
+        at = end;
+        if (*at == '-')
+        {
+            ++at;
+            last = strtol(at, &end, 10);
+            if (end==at || last<first)
+                return false;
+            at = end;
+        }
+        for (long i=first; i<=last; ++i)
+            patches.push_back(int(i));
+
+        if (*at == ',')
+            ++at;
+        else if (*at != '\0')
+            return false;
+    }
+
+    //keep the list sorted and unique
+    std::sort(patches.begin(), patches.end());
+    patches.erase(std::unique(patches.begin(), patches.end()), patches.end());
+    return !patches.empty();
+}
+
 int main(int argc, char* argv[])
 {
     enum BuildType
@@ -59,12 +119,18 @@ int main(int argc, char* argv[])
     bool pointSampled = false;
     /* the current nodata string, initialized to the empty string */
     std::string nodata;
+    /* the number of threads used for building, 0 keeps the default */
+    int numThreads = 0;
+    /* resume an interrupted update of the same sources from its journal */
+    bool resume = true;
 
     //the tile size should only be an internal parameter
     static const size_t tileSize[2] = {TILE_RESOLUTION, TILE_RESOLUTION};
 
     std::string                    globeFileName;
     std::string                    settingsFileName;
+    std::string                    pretileDirectory;
+    BuilderBase::PatchIds          patches;
     BuilderBase::ImagePatchSources imageSources;
     for (int i=1; i<argc; ++i)
     {
@@ -183,6 +249,64 @@ int main(int argc, char* argv[])
         {
             pointSampled = false;
         }
+        else if (strcasecmp(argv[i], "-threads") == 0)
+        {
+            //read the number of threads to be used
+            ++i;
+            if (i<argc)
+            {
+                numThreads = atoi(argv[i]);
+                if (numThreads < 1)
+                {
+                    std::cerr << "Invalid number of threads " << argv[i] <<
+                                 std::endl;
+                    return 1;
+                }
+            }
+            else
+            {
+                std::cerr << "Dangling threads argument" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcasecmp(argv[i], "-pretile") == 0)
+        {
+            //read the directory for the pre-tiled copies of the sources
+            ++i;
+            if (i<argc)
+            {
+                pretileDirectory = std::string(argv[i]);
+            }
+            else
+            {
+                std::cerr << "Dangling pre-tile directory argument" <<
+                             std::endl;
+                return 1;
+            }
+        }
+        else if (strcasecmp(argv[i], "-patches") == 0)
+        {
+            //read the subset of the base patches to be built
+            ++i;
+            if (i<argc)
+            {
+                if (!parsePatchList(argv[i], patches))
+                {
+                    std::cerr << "Invalid patch list " << argv[i] <<
+                                 std::endl;
+                    return 1;
+                }
+            }
+            else
+            {
+                std::cerr << "Dangling patches argument" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcasecmp(argv[i], "-noResume") == 0)
+        {
+            resume = false;
+        }
         else if (strcasecmp(argv[i], "-settings") == 0)
         {
             //read the settings filename
@@ -217,8 +341,10 @@ int main(int argc, char* argv[])
         std::cerr << "Usage:\nconstruo -dem | -color | -layerf <globe file "
                      "name> [-offset <scalar> | -noOffset] [-scale <scalar> | "
                      "-noScale] [-nodata <value> | -defaultNodata] "
-                     "[-pointsampling] [-areasampling] [-settings <settings "
-                     "file>] [-version] <input files>\n";
+                     "[-pointsampling] [-areasampling] [-threads <number>] "
+                     "[-pretile <directory>] [-patches <list>] [-noResume] "
+                     "[-settings <settings file>] "
+                     "[-version] <input files>\n";
         return 1;
     }
 
@@ -241,27 +367,73 @@ int main(int argc, char* argv[])
     }
 
     CONSTRUO_SETTINGS.loadFromFile(settingsFileName);
+    if (numThreads > 0)
+        CONSTRUO_SETTINGS.numThreads = numThreads;
+
+    //ingest from pre-tiled copies of the sources if requested
+    if (!pretileDirectory.empty())
+    {
+        try
+        {
+            switch (buildType)
+            {
+                case DEM_BUILD:
+                    pretileSources<DemHeight::Type>(imageSources,
+                                                    pretileDirectory);
+                    break;
+                case COLORTEXTURE_BUILD:
+                    pretileSources<TextureColor::Type>(imageSources,
+                                                       pretileDirectory);
+                    break;
+                case LAYERF_BUILD:
+                    pretileSources<LayerDataf::Type>(imageSources,
+                                                     pretileDirectory);
+                    break;
+                default:
+                    break;
+            }
+        }
+        catch (std::runtime_error err)
+        {
+            std::cerr << "Failed to pre-tile the sources: " << err.what() <<
+                         std::endl;
+            return 1;
+        }
+    }
 
     //reate the builder object
     BuilderBase* builder = NULL;
-    switch (buildType)
+    try
     {
-        case DEM_BUILD:
-            builder = new Builder<DemHeight>(globeFileName, tileSize);
-            break;
-        case COLORTEXTURE_BUILD:
-            builder = new Builder<TextureColor>(globeFileName, tileSize);
-            break;
-        case LAYERF_BUILD:
-            builder = new Builder<LayerDataf>(globeFileName, tileSize);
-            break;
-        default:
-            std::cerr << "Unsupported build type" << std::endl;
-            return 1;
-            break;
+        switch (buildType)
+        {
+            case DEM_BUILD:
+                builder = new Builder<DemHeight>(globeFileName, tileSize,
+                                                 patches);
+                break;
+            case COLORTEXTURE_BUILD:
+                builder = new Builder<TextureColor>(globeFileName, tileSize,
+                                                    patches);
+                break;
+            case LAYERF_BUILD:
+                builder = new Builder<LayerDataf>(globeFileName, tileSize,
+                                                  patches);
+                break;
+            default:
+                std::cerr << "Unsupported build type" << std::endl;
+                return 1;
+                break;
+        }
+    }
+    catch (std::runtime_error err)
+    {
+        std::cerr << "Failed to open the globe file: " << err.what() <<
+                     std::endl;
+        return 1;
     }
 
     builder->addImagePatches(imageSources);
+    builder->setResume(resume);
 
     //update the spheroid
     builder->update();
@@ -10,7 +10,9 @@ namespace crusta {
 
 ConstruoSettings::
 ConstruoSettings() :
-    globeName("Sphere_Earth"), globeRadius(6371000.0)
+    globeName("Sphere_Earth"), globeRadius(6371000.0), numThreads(1),
+    tileCacheSize(4096), imageCacheSize(256), maxOpenSources(8),
+    transformMaxError(0.125), treeMemory(4096)
 {
 }
 
@@ -52,6 +54,18 @@ loadFromFile(std::string configurationFileName, bool merge)
     cfgFile.setCurrentSection("/Crusta/Globe");
     globeName   = cfgFile.retrieveString("./name", globeName);
     globeRadius = cfgFile.retrieveValue<double>("./radius", globeRadius);
+
+    cfgFile.setCurrentSection("/Crusta/Construo");
+    numThreads    = cfgFile.retrieveValue<int>("./numThreads", numThreads);
+    tileCacheSize = cfgFile.retrieveValue<int>("./tileCacheSize",
+                                               tileCacheSize);
+    imageCacheSize = cfgFile.retrieveValue<int>("./imageCacheSize",
+                                                imageCacheSize);
+    maxOpenSources = cfgFile.retrieveValue<int>("./maxOpenSources",
+                                                maxOpenSources);
+    transformMaxError = cfgFile.retrieveValue<double>("./transformMaxError",
+                                                      transformMaxError);
+    treeMemory = cfgFile.retrieveValue<int>("./treeMemory", treeMemory);
 }
 
 } //namespace crusta
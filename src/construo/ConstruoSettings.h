@@ -21,6 +21,23 @@ public:
     std::string globeName;
     /** radius of the sphere onto which data is mapped */
     double globeRadius;
+
+    /** number of threads used to source and resample the tiles */
+    int numThreads;
+    /** maximum number of tiles kept in memory by the tile cache */
+    int tileCacheSize;
+    /** memory budget (in MB) of the block caches of all the open source
+        images. It is split evenly among the maxOpenSources images of each of
+        the numThreads sourcing threads */
+    int imageCacheSize;
+    /** maximum number of source images kept open by each sourcing thread */
+    int maxOpenSources;
+    /** maximum error (in pixels) allowed when approximating the projection of
+        the tile samples into the source images. 0 disables the approximation */
+    double transformMaxError;
+    /** memory budget (in MB) of the nodes of the build tree. The subtrees
+        that aren't needed by the current work are unloaded to honor it */
+    int treeMemory;
 };
 
 
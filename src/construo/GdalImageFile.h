@@ -23,6 +23,9 @@
 #ifndef _GdalImageFile_H_
 #define _GdalImageFile_H_
 
+#include <list>
+#include <map>
+
 #include <gdal.h>
 #include <gdal_priv.h>
 
@@ -44,7 +47,45 @@ public:
     virtual ~GdalImageFileBase();
 
 protected:
+    ///block of pixels cached from the dataset
+    struct Block
+    {
+        ///linear index of the block in the image
+        size_t index;
+        ///pixels of the block. Edge blocks are cropped to the image
+        PixelType* data;
+    };
+    typedef std::list<Block>                                Blocks;
+    typedef std::map<size_t, typename Blocks::iterator>     BlockIndex;
+
+    /** reads a rectangle of pixels, which must lie inside the image, directly
+        from the dataset and applies the pixel offset and scale */
+    virtual void readRaster(const int rectOrigin[2], const int rectSize[2],
+                            PixelType* rectBuffer) const = 0;
+    /** retrieve the pixels of a block, reading them from the dataset if they
+        aren't cached */
+    const PixelType* getBlock(const int block[2], const int origin[2],
+                              const int size[2]) const;
+
     GDALDataset* dataset;
+
+    ///size of the cached blocks (a multiple of the dataset's native blocks)
+    int blockSize[2];
+    ///number of blocks in each dimension of the image
+    int numBlocks[2];
+    ///maximum number of blocks kept in memory
+    size_t maxBlocks;
+    ///cached blocks ordered from the most to the least recently used
+    mutable Blocks blocks;
+    ///lookup of the cached blocks
+    mutable BlockIndex blockIndex;
+
+//- inherited from ImageFile
+public:
+    /** serves the rectangle from the block cache. Like the dataset the cache
+        must not be accessed concurrently */
+    virtual void readRectangle(const int rectOrigin[2], const int rectSize[2],
+                               PixelType* rectBuffer) const;
 };
 
 template <typename PixelType>
@@ -55,10 +96,10 @@ public:
 
     GdalImageFile(const std::string& imageFileName);
 
-//- inherited from ImageFileBase
-public:
-    virtual void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                               PixelType* rectBuffer) const;
+//- inherited from GdalImageFileBase
+protected:
+    virtual void readRaster(const int rectOrigin[2], const int rectSize[2],
+                            PixelType* rectBuffer) const;
 };
 
 } //namespace crusta
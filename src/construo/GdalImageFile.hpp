@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <iostream>
@@ -6,6 +7,7 @@
 
 #include <crustacore/Vector3ui8.h>
 
+#include <construo/construoGlobals.h>
 #include <construo/vrui.h>
 
 
@@ -111,17 +113,133 @@ GdalImageFileBase(const std::string& imageFileName)
         std::cout << "Source has no geo-transform. Perhaps ground control "
                   << "points?" << std::endl;
     }
+
+    /* cache blocks aligned with the native blocks of the dataset. Small native
+       blocks (e.g. scanlines) are grouped to amortize the cost of a read */
+    blockSize[0] = blockSize[1] = 1;
+    if (dataset->GetRasterCount() > 0)
+        dataset->GetRasterBand(1)->GetBlockSize(&blockSize[0], &blockSize[1]);
+    for (int i=0; i<2; ++i)
+        blockSize[i] = std::max(1, std::min(blockSize[i], this->size[i]));
+    static const int minBlockPixels = 256*256;
+    while (blockSize[0]*blockSize[1] < minBlockPixels &&
+           (blockSize[0]<this->size[0] || blockSize[1]<this->size[1]))
+    {
+        int grow = blockSize[1]<this->size[1] &&
+                   (blockSize[1]<=blockSize[0] ||
+                    blockSize[0]>=this->size[0]) ? 1 : 0;
+        blockSize[grow] = std::min(2*blockSize[grow], this->size[grow]);
+    }
+    for (int i=0; i<2; ++i)
+        numBlocks[i] = (this->size[i] + blockSize[i] - 1) / blockSize[i];
+
+    /* the budget covers all the images the sourcing threads may keep open at
+       once, each getting an equal share */
+    size_t numOpen = size_t(std::max(CONSTRUO_SETTINGS.numThreads, 1)) *
+                     size_t(std::max(CONSTRUO_SETTINGS.maxOpenSources, 1));
+    size_t budget  = size_t(std::max(CONSTRUO_SETTINGS.imageCacheSize, 0)) *
+                     1024 * 1024 / numOpen;
+    maxBlocks = std::max(budget / (blockSize[0]*blockSize[1]*sizeof(PixelType)),
+                         size_t(1));
 }
 
 template <typename PixelType>
 GdalImageFileBase<PixelType>::
 ~GdalImageFileBase()
 {
+    for (typename Blocks::iterator it=blocks.begin(); it!=blocks.end(); ++it)
+        delete[] it->data;
+
     if (dataset != NULL)
         GDALClose((GDALDatasetH)dataset);
 }
 
 
+template <typename PixelType>
+const PixelType* GdalImageFileBase<PixelType>::
+getBlock(const int block[2], const int origin[2], const int size[2]) const
+{
+    size_t index = size_t(block[1])*numBlocks[0] + block[0];
+
+    typename BlockIndex::iterator it = blockIndex.find(index);
+    if (it != blockIndex.end())
+    {
+        //move the block to the front of the LRU list
+        blocks.splice(blocks.begin(), blocks, it->second);
+        return it->second->data;
+    }
+
+    //recycle the least recently used block if the cache is full
+    if (blocks.size() >= maxBlocks)
+    {
+        blocks.splice(blocks.begin(), blocks, --blocks.end());
+        blockIndex.erase(blocks.front().index);
+    }
+    else
+    {
+        Block newBlock;
+        newBlock.data = new PixelType[blockSize[0]*blockSize[1]];
+        blocks.push_front(newBlock);
+    }
+
+    Block& b = blocks.front();
+    b.index  = index;
+    readRaster(origin, size, b.data);
+    blockIndex.insert(typename BlockIndex::value_type(index, blocks.begin()));
+
+    return b.data;
+}
+
+template <typename PixelType>
+void GdalImageFileBase<PixelType>::
+readRectangle(const int rectOrigin[2], const int rectSize[2],
+              PixelType* rectBuffer) const
+{
+    //clip the rectangle against the image's valid region
+    int min[2], max[2];
+    for (int i=0; i<2; ++i)
+    {
+///\todo remove
+assert(rectOrigin[i]>=0);
+        min[i] = std::max(0,             rectOrigin[i]);
+///\todo remove, oh but also fix the max[i]
+assert(rectOrigin[i]+rectSize[i]-1 < this->size[i]);
+        max[i] = std::min(this->size[i], rectOrigin[i]+rectSize[i]);
+    }
+    if (min[0]>=max[0] || min[1]>=max[1])
+        return;
+
+    //assemble the rectangle from the overlapped blocks
+    int first[2] = { min[0]/blockSize[0],     min[1]/blockSize[1]     };
+    int last[2]  = { (max[0]-1)/blockSize[0], (max[1]-1)/blockSize[1] };
+    int block[2];
+    for (block[1]=first[1]; block[1]<=last[1]; ++block[1])
+    {
+        for (block[0]=first[0]; block[0]<=last[0]; ++block[0])
+        {
+            int origin[2], size[2], from[2], to[2];
+            for (int i=0; i<2; ++i)
+            {
+                origin[i] = block[i] * blockSize[i];
+                size[i]   = std::min(blockSize[i], this->size[i]-origin[i]);
+                from[i]   = std::max(min[i], origin[i]);
+                to[i]     = std::min(max[i], origin[i]+size[i]);
+            }
+
+            const PixelType* data = getBlock(block, origin, size);
+            for (int y=from[1]; y<to[1]; ++y)
+            {
+                const PixelType* src = data + (y-origin[1])*size[0] +
+                                       (from[0]-origin[0]);
+                PixelType* dst = rectBuffer + (y-rectOrigin[1])*rectSize[0] +
+                                 (from[0]-rectOrigin[0]);
+                std::copy(src, src + (to[0]-from[0]), dst);
+            }
+        }
+    }
+}
+
+
 //- single channel float -------------------------------------------------------
 
 template <>
@@ -148,9 +266,9 @@ public:
     }
 
 
-public:
-    virtual void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                               float* rectBuffer) const
+protected:
+    virtual void readRaster(const int rectOrigin[2], const int rectSize[2],
+                            float* rectBuffer) const
     {
         //retrieve raster bands from the data set
         int numBands = dataset->GetRasterCount();
@@ -159,25 +277,10 @@ public:
 
         GDALRasterBand* band = dataset->GetRasterBand(1);
 
-        //clip the rectangle against the image's valid region
-        int min[2], max[2];
-        for (int i=0; i<2; ++i)
-        {
-///\todo remove
-assert(rectOrigin[i]>=0);
-            min[i] = std::max(0,       rectOrigin[i]);
-///\todo remove, oh but also fix the max[i]
-assert(rectOrigin[i]+rectSize[i]-1 < size[i]);
-            max[i] = std::min(size[i], rectOrigin[i]+rectSize[i]);
-        }
-
-        int readSize[2] = { max[0] - min[0], max[1] - min[1] };
-        int rowWidth  = rectSize[0] * sizeof(float);
-        float* dst = rectBuffer + ( (min[1]-rectOrigin[1])*rectSize[0] +
-                                        (min[0]-rectOrigin[0]) );
-
-        band->RasterIO(GF_Read, min[0], min[1], readSize[0], readSize[1],
-                       dst, readSize[0], readSize[1], GDT_Float32,
+        int rowWidth = rectSize[0] * sizeof(float);
+        band->RasterIO(GF_Read, rectOrigin[0], rectOrigin[1],
+                       rectSize[0], rectSize[1],
+                       rectBuffer, rectSize[0], rectSize[1], GDT_Float32,
                        sizeof(float), rowWidth);
 
         //scale the pixel values
@@ -231,9 +334,9 @@ public:
     }
 
 
-public:
-    virtual void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                               Geometry::Vector<uint8_t,3>* rectBuffer) const
+protected:
+    virtual void readRaster(const int rectOrigin[2], const int rectSize[2],
+                            Geometry::Vector<uint8_t,3>* rectBuffer) const
     {
         //retrieve raster bands from the data set
         int numBands = dataset->GetRasterCount();
@@ -252,28 +355,14 @@ public:
                                            dataset->GetRasterBand(i+1));
         }
 
-        //clip the rectangle against the image's valid region
-        int min[2], max[2];
-        for (int i=0; i<2; ++i)
-        {
-///\todo remove
-assert(rectOrigin[i]>=0);
-            min[i] = std::max(0,       rectOrigin[i]);
-///\todo remove, oh but also fix the max[i]
-assert(rectOrigin[i]+rectSize[i]-1 < size[i]);
-            max[i] = std::min(size[i], rectOrigin[i]+rectSize[i]);
-        }
-
-        int readSize[2] = { max[0] - min[0], max[1] - min[1] };
-        int rowWidth  = rectSize[0] * sizeof(Geometry::Vector<uint8_t,3>);
-        Geometry::Vector<uint8_t,3>* dst = rectBuffer + ( (min[1]-rectOrigin[1])*rectSize[0] +
-                                         (min[0]-rectOrigin[0]) );
-
+        int rowWidth = rectSize[0] * sizeof(Geometry::Vector<uint8_t,3>);
         for (int i=0; i<Geometry::Vector<uint8_t,3>::dimension; ++i)
         {
-            bands[i]->RasterIO(GF_Read, min[0], min[1], readSize[0],readSize[1],
-                               &dst[0][i], readSize[0], readSize[1], GDT_Byte,
-                               sizeof(Geometry::Vector<uint8_t,3>), rowWidth);
+            bands[i]->RasterIO(GF_Read, rectOrigin[0], rectOrigin[1],
+                               rectSize[0], rectSize[1],
+                               &rectBuffer[0][i], rectSize[0], rectSize[1],
+                               GDT_Byte, sizeof(Geometry::Vector<uint8_t,3>),
+                               rowWidth);
         }
 
         //scale the pixel values
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <construo/construoGlobals.h>
 #include <construo/Converters.h>
@@ -270,6 +271,29 @@ worldToImage(const Point& worldPoint) const
     return systemToImage(p);
 }
 
+void GdalTransform::
+worldToImage(int numPoints, Point* points) const
+{
+    //transform all the points with a single call into the projection library
+    std::vector<double> xs(numPoints);
+    std::vector<double> ys(numPoints);
+    for (int i=0; i<numPoints; ++i)
+    {
+        xs[i] = points[i][0];
+        ys[i] = points[i][1];
+    }
+
+    if (numPoints<1 || !worldToGeo->Transform(numPoints, &xs[0], &ys[0]))
+    {
+        //fall back to transforming the points individually to isolate failures
+        ImageTransform::worldToImage(numPoints, points);
+        return;
+    }
+
+    for (int i=0; i<numPoints; ++i)
+        points[i] = systemToImage(Point(xs[i], ys[i]));
+}
+
 Box GdalTransform::
 imageToWorld(const Box& imageBox) const
 {
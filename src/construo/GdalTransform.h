@@ -60,6 +60,7 @@ public:
     virtual Point imageToWorld(const Point& imagePoint) const;
     virtual Point imageToWorld(int imageX,int imageY) const;
     virtual Point worldToImage(const Point& worldPoint) const;
+    virtual void worldToImage(int numPoints, Point* points) const;
 	virtual Box imageToWorld(const Box& imageBox) const;
 	virtual Box worldToImage(const Box& worldBox) const;
 
@@ -141,6 +141,13 @@ worldToImage(const Point& worldPoint) const
                  (systemPoint[1]-offset[1]) / scale[1]);
 }
 
+void ImageTransform::
+worldToImage(int numPoints, Point* points) const
+{
+    for (Point* p=points; p!=points+numPoints; ++p)
+        *p = worldToImage(*p);
+}
+
 Box ImageTransform::
 imageToWorld(const Box& imageBox) const
 {
@@ -80,6 +80,8 @@ public:
     virtual Point imageToWorld(int imageX, int imageY) const;
     ///directly converts a point from world to image coordinates
     virtual Point worldToImage(const Point& worldPoint) const;
+    ///converts an array of points in place from world to image coordinates
+    virtual void worldToImage(int numPoints, Point* points) const;
     ///directly converts a box from image to world coordinates
     virtual Box imageToWorld(const Box& imageBox) const;
     ///directly converts a box from world to image coordinates
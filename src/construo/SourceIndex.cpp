@@ -0,0 +1,165 @@
+#include <construo/SourceIndex.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace crusta {
+
+
+/** orders entries by the center of their box along one axis */
+struct EntryCenterLess
+{
+    EntryCenterLess(int iAxis) :
+        axis(iAxis)
+    {}
+
+    template <typename EntryParam>
+    bool operator()(const EntryParam& a, const EntryParam& b) const
+    {
+        return (a.box.min[axis] + a.box.max[axis]) <
+               (b.box.min[axis] + b.box.max[axis]);
+    }
+
+    int axis;
+};
+
+
+SourceIndex::
+SourceIndex()
+{
+}
+
+void SourceIndex::
+clear()
+{
+    sources.clear();
+    children.clear();
+    nodes.clear();
+}
+
+void SourceIndex::
+add(int id, const Box& box)
+{
+    Entry entry;
+    entry.box = box;
+    entry.id  = id;
+    sources.push_back(entry);
+}
+
+void SourceIndex::
+build()
+{
+    children.clear();
+    nodes.clear();
+    if (sources.empty())
+        return;
+
+    //pack the sources into the leaves
+    TreeNodes level;
+    pack(sources, level);
+    for (TreeNodes::iterator it=level.begin(); it!=level.end(); ++it)
+        it->leaf = true;
+
+    //pack the nodes of each level into the parent level until one remains
+    while (true)
+    {
+        int levelStart = static_cast<int>(nodes.size());
+        nodes.insert(nodes.end(), level.begin(), level.end());
+        if (level.size() == 1)
+            break;
+
+        Entries entries(level.size());
+        for (size_t i=0; i<level.size(); ++i)
+        {
+            entries[i].box = level[i].box;
+            entries[i].id  = levelStart + static_cast<int>(i);
+        }
+
+        level.clear();
+        pack(entries, level);
+        int childStart = static_cast<int>(children.size());
+        for (Entries::const_iterator it=entries.begin(); it!=entries.end();
+             ++it)
+        {
+            children.push_back(it->id);
+        }
+        for (TreeNodes::iterator it=level.begin(); it!=level.end(); ++it)
+        {
+            it->first += childStart;
+            it->leaf   = false;
+        }
+    }
+}
+
+void SourceIndex::
+query(const Box& box, Ids& ids) const
+{
+    if (nodes.empty())
+        return;
+
+    std::vector<int> stack;
+    stack.push_back(static_cast<int>(nodes.size()) - 1);
+    while (!stack.empty())
+    {
+        const TreeNode& node = nodes[stack.back()];
+        stack.pop_back();
+        if (!node.box.overlaps(box))
+            continue;
+
+        for (int i=node.first; i<node.first+node.count; ++i)
+        {
+            if (node.leaf)
+            {
+                if (sources[i].box.overlaps(box))
+                    ids.push_back(sources[i].id);
+            }
+            else
+                stack.push_back(children[i]);
+        }
+    }
+}
+
+size_t SourceIndex::
+size() const
+{
+    return sources.size();
+}
+
+
+void SourceIndex::
+pack(Entries& entries, TreeNodes& groups)
+{
+    int numEntries = static_cast<int>(entries.size());
+    int numGroups  = (numEntries + FANOUT - 1) / FANOUT;
+    int numSlices  = static_cast<int>(std::ceil(std::sqrt(double(numGroups))));
+    int sliceSize  = numSlices * FANOUT;
+
+    /* sort the entries into vertical slices by longitude, then each slice by
+       latitude, and group consecutive entries */
+    std::sort(entries.begin(), entries.end(), EntryCenterLess(0));
+    for (int slice=0; slice<numEntries; slice+=sliceSize)
+    {
+        int sliceEnd = std::min(slice+sliceSize, numEntries);
+        std::sort(entries.begin()+slice, entries.begin()+sliceEnd,
+                  EntryCenterLess(1));
+
+        for (int first=slice; first<sliceEnd; first+=FANOUT)
+        {
+            TreeNode group;
+            group.box   = Box::empty;
+            group.first = first;
+            group.count = std::min(int(FANOUT), sliceEnd-first);
+            group.leaf  = true;
+            for (int i=first; i<first+group.count; ++i)
+            {
+                group.box.addPoint(entries[i].box.min);
+                group.box.addPoint(entries[i].box.max);
+            }
+            groups.push_back(group);
+        }
+    }
+}
+
+
+} //namespace crusta
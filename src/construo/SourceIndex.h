@@ -0,0 +1,82 @@
+#ifndef _SourceIndex_H_
+#define _SourceIndex_H_
+
+
+#include <vector>
+
+#include <construo/GeometryTypes.h>
+
+
+namespace crusta {
+
+
+/**
+    Static R-tree over the bounding boxes (in spherical coordinates) of the
+    coverages of the source images. The tree is bulk-loaded using the
+    sort-tile-recursive packing once all the sources have been added, and
+    allows retrieving the sources potentially overlapping a region without
+    testing all of them.
+*/
+class SourceIndex
+{
+public:
+    typedef std::vector<int> Ids;
+
+    SourceIndex();
+
+    /** remove all the sources from the index */
+    void clear();
+    /** add a source to the index. The index must be rebuilt before it can be
+        queried */
+    void add(int id, const Box& box);
+    /** pack the added sources into the tree */
+    void build();
+
+    /** append the identifiers of the sources whose bounding box overlaps the
+        given one */
+    void query(const Box& box, Ids& ids) const;
+
+    /** number of sources in the index */
+    size_t size() const;
+
+protected:
+    /** maximum number of children of a tree node */
+    static const int FANOUT = 16;
+
+    /** an indexed box: a source for the leaves, a tree node otherwise */
+    struct Entry
+    {
+        Box box;
+        int id;
+    };
+    typedef std::vector<Entry> Entries;
+
+    /** a node of the tree. The children of a leaf are the sources
+        [first, first+count), those of an interior node are listed in
+        children[first, first+count) */
+    struct TreeNode
+    {
+        Box box;
+        int first;
+        int count;
+        bool leaf;
+    };
+    typedef std::vector<TreeNode> TreeNodes;
+
+    /** group the entries into nodes following the sort-tile-recursive order.
+        Reorders the entries and produces nodes referencing ranges of them */
+    static void pack(Entries& entries, TreeNodes& groups);
+
+    /** the sources added to the index (ordered by leaf after building) */
+    Entries sources;
+    /** the children of the interior nodes */
+    std::vector<int> children;
+    /** the nodes of the tree. The root is the last node */
+    TreeNodes nodes;
+};
+
+
+} //namespace crusta
+
+
+#endif //_SourceIndex_H_
@@ -36,6 +36,10 @@ struct SubsampleFilter
         domain) */
     static PixelType sample(PixelType* at, int rowLen,
                              const PixelType& globeNodata);
+    /** fixed subsampled lookups for a row of the subsampled data: dst[i] is
+        the lookup centered at at[2i] */
+    static void sampleRow(PixelType* at, int rowLen, int num,
+                          const PixelType& globeNodata, PixelType* dst);
 };
 
 
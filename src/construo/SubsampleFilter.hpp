@@ -4,6 +4,7 @@
 
 #include <construo/SubsampleFilter.h>
 
+#include <crustacore/PixelKernels.h>
 #include <crustacore/Vector3ui8.h>
 
 #include <construo/vrui.h>
@@ -41,6 +42,13 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_POINT>
     {
         return *at;
     }
+
+    static void sampleRow(float* at, int rowLen, int num, const float&,
+                          float* dst)
+    {
+        for (int i=0; i<num; ++i)
+            dst[i] = at[2*i];
+    }
 };
 
 template <>
@@ -51,6 +59,14 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_PYRAMID>
         return 1;
     }
 
+    /** the 1D weights of the fixed subsampling, centered on the returned
+        pointer */
+    static const double* weights()
+    {
+        static const double weightStorage[3] = {0.25, 0.50, 0.25};
+        return &weightStorage[1];
+    }
+
     static float sample(const float* img, const int origin[2],
                         const double at[2], const int size[2],
                         const float& imgNodata, const float& defaultValue,
@@ -99,8 +115,7 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_PYRAMID>
     static float sample(float* at, int rowLen,
                         const float& globeNodata)
     {
-        static double weightStorage[3] = {0.25, 0.50, 0.25};
-        double* weights = &weightStorage[1];
+        const double* weights = SubsampleFilter::weights();
 
         double sum        = 0.0;
         double sumWeights = 0.0;
@@ -125,6 +140,13 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_PYRAMID>
 
         return float(sum / sumWeights);
     }
+
+    static void sampleRow(float* at, int rowLen, int num,
+                          const float& globeNodata, float* dst)
+    {
+        PixelKernels::subsampleRow(at, rowLen, num, weights(), 1,
+                                   globeNodata, dst);
+    }
 };
 
 
@@ -138,8 +160,9 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_LANCZOS5>
 
     //no dynamic sample for lanczos5
 
-    static float sample(float* at, int rowLen,
-                        const float& globeNodata)
+    /** the 1D weights of the fixed subsampling, centered on the returned
+        pointer */
+    static const double* weights()
     {
         static const double weightStorage[21] = {
              7.60213661720011e-34,  0.00386785330198227,  -4.5610817871754e-18,
@@ -149,7 +172,13 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_LANCZOS5>
              1.82443271487016e-17,  -0.0911355426727928, -1.47599707142358e-17,
                0.0405539013275657, 9.83998047615722e-18,   -0.0167391813072476,
              -4.5610817871754e-18,  0.00386785330198227,  7.60213661720011e-34};
-        const double* weights = &weightStorage[10];
+        return &weightStorage[10];
+    }
+
+    static float sample(float* at, int rowLen,
+                        const float& globeNodata)
+    {
+        const double* weights = SubsampleFilter::weights();
 
         double sum        = 0.0;
         double sumWeights = 0.0;
@@ -174,6 +203,13 @@ struct SubsampleFilter<float, SUBSAMPLEFILTER_LANCZOS5>
 
         return float(sum / sumWeights);
     }
+
+    static void sampleRow(float* at, int rowLen, int num,
+                          const float& globeNodata, float* dst)
+    {
+        PixelKernels::subsampleRow(at, rowLen, num, weights(), 10,
+                                   globeNodata, dst);
+    }
 };
 
 
@@ -207,6 +243,14 @@ struct SubsampleFilter<Geometry::Vector<uint8_t,3>, SUBSAMPLEFILTER_POINT>
     {
         return *at;
     }
+
+    static void sampleRow(Geometry::Vector<uint8_t,3>* at, int rowLen, int num,
+                          const Geometry::Vector<uint8_t,3>&,
+                          Geometry::Vector<uint8_t,3>* dst)
+    {
+        for (int i=0; i<num; ++i)
+            dst[i] = at[2*i];
+    }
 };
 
 template <>
@@ -316,6 +360,14 @@ struct SubsampleFilter<Geometry::Vector<uint8_t,3>, SUBSAMPLEFILTER_PYRAMID>
 
         return returnValue;
     }
+
+    static void sampleRow(Geometry::Vector<uint8_t,3>* at, int rowLen, int num,
+                          const Geometry::Vector<uint8_t,3>& globeNodata,
+                          Geometry::Vector<uint8_t,3>* dst)
+    {
+        for (int i=0; i<num; ++i)
+            dst[i] = sample(at + 2*i, rowLen, globeNodata);
+    }
 };
 
 template <>
@@ -376,6 +428,14 @@ struct SubsampleFilter<Geometry::Vector<uint8_t,3>, SUBSAMPLEFILTER_LANCZOS5>
 
         return returnValue;
     }
+
+    static void sampleRow(Geometry::Vector<uint8_t,3>* at, int rowLen, int num,
+                          const Geometry::Vector<uint8_t,3>& globeNodata,
+                          Geometry::Vector<uint8_t,3>* dst)
+    {
+        for (int i=0; i<num; ++i)
+            dst[i] = sample(at + 2*i, rowLen, globeNodata);
+    }
 };
 
 
@@ -0,0 +1,92 @@
+#ifndef _TileCache_H_
+#define _TileCache_H_
+
+
+#include <list>
+#include <map>
+
+#include <crustacore/GlobeData.h>
+
+#include <construo/vrui.h>
+
+
+namespace crusta {
+
+
+/**
+    Bounded, thread-safe cache of the pixel data of the tiles of a globe file.
+    Tiles are evicted in least-recently-used order. Writes go through the cache
+    to the file, such that tiles that were just written are read back from
+    memory. All the file accesses are serialized with the provided mutex, which
+    must also guard any other access to the files by the caller.
+*/
+template <typename PixelParam>
+class TileCache
+{
+public:
+    typedef typename PixelParam::Type     PixelType;
+    typedef GlobeData<PixelParam>         gd;
+    typedef typename gd::File             File;
+    typedef typename gd::TileHeader       TileHeader;
+
+    TileCache(size_t iTileNumPixels, size_t iCapacity,
+              Threads::Mutex& iFileMutex);
+    ~TileCache();
+
+    /** copy the pixel data of a tile into the buffer, reading it from the file
+        if it isn't cached */
+    bool read(File* file, TileIndex tileIndex, PixelType* buffer);
+    /** write the header and pixel data of a tile to the file and cache the
+        pixel data */
+    void write(File* file, TileIndex tileIndex, const TileHeader& header,
+               const PixelType* buffer);
+
+    /** drop all the cached tiles */
+    void clear();
+
+    /** retrieve the number of lookups that were served from memory */
+    size_t getNumHits() const;
+    /** retrieve the number of lookups that required reading the file */
+    size_t getNumMisses() const;
+
+protected:
+    typedef std::pair<const File*, TileIndex> Key;
+    struct Entry
+    {
+        Key key;
+        PixelType* data;
+    };
+    typedef std::list<Entry>                          Entries;
+    typedef std::map<Key, typename Entries::iterator> Index;
+
+    /** insert or update the tile's data, evicting the least recently used
+        tile if the cache is full. Must be called with the cache locked */
+    void store(const Key& key, const PixelType* buffer, bool overwrite);
+
+    /** number of pixels in a tile */
+    size_t tileNumPixels;
+    /** maximum number of tiles cached */
+    size_t capacity;
+
+    /** serializes the access to the files */
+    Threads::Mutex& fileMutex;
+    /** serializes the access to the cache */
+    Threads::Mutex cacheMutex;
+
+    /** cached tiles ordered from the most to the least recently used */
+    Entries entries;
+    /** lookup of the cached tiles */
+    Index index;
+
+    size_t numHits;
+    size_t numMisses;
+};
+
+
+} //namespace crusta
+
+
+#include <construo/TileCache.hpp>
+
+
+#endif //_TileCache_H_
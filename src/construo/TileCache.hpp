@@ -0,0 +1,135 @@
+#include <algorithm>
+
+
+namespace crusta {
+
+
+template <typename PixelParam>
+TileCache<PixelParam>::
+TileCache(size_t iTileNumPixels, size_t iCapacity,
+          Threads::Mutex& iFileMutex) :
+    tileNumPixels(iTileNumPixels), capacity(std::max(iCapacity, size_t(1))),
+    fileMutex(iFileMutex), numHits(0), numMisses(0)
+{
+}
+
+template <typename PixelParam>
+TileCache<PixelParam>::
+~TileCache()
+{
+    clear();
+}
+
+
+template <typename PixelParam>
+bool TileCache<PixelParam>::
+read(File* file, TileIndex tileIndex, PixelType* buffer)
+{
+    Key key(file, tileIndex);
+    {
+        Threads::Mutex::Lock lock(cacheMutex);
+        typename Index::iterator it = index.find(key);
+        if (it != index.end())
+        {
+            //move the entry to the front of the LRU list
+            entries.splice(entries.begin(), entries, it->second);
+            std::copy(it->second->data, it->second->data+tileNumPixels, buffer);
+            ++numHits;
+            return true;
+        }
+        ++numMisses;
+    }
+
+    //read the tile without holding the cache to let other lookups proceed
+    bool res;
+    {
+        Threads::Mutex::Lock lock(fileMutex);
+        res = file->readTile(tileIndex, buffer);
+    }
+
+    /* a concurrent write of the same tile might have updated the cache with
+       newer data in the meantime. Don't overwrite it */
+    if (res)
+    {
+        Threads::Mutex::Lock lock(cacheMutex);
+        store(key, buffer, false);
+    }
+    return res;
+}
+
+template <typename PixelParam>
+void TileCache<PixelParam>::
+write(File* file, TileIndex tileIndex, const TileHeader& header,
+      const PixelType* buffer)
+{
+    {
+        Threads::Mutex::Lock lock(fileMutex);
+        file->writeTile(tileIndex, header, buffer);
+    }
+
+    Threads::Mutex::Lock lock(cacheMutex);
+    store(Key(file, tileIndex), buffer, true);
+}
+
+template <typename PixelParam>
+void TileCache<PixelParam>::
+clear()
+{
+    Threads::Mutex::Lock lock(cacheMutex);
+    for (typename Entries::iterator it=entries.begin(); it!=entries.end(); ++it)
+        delete[] it->data;
+    entries.clear();
+    index.clear();
+}
+
+template <typename PixelParam>
+size_t TileCache<PixelParam>::
+getNumHits() const
+{
+    return numHits;
+}
+
+template <typename PixelParam>
+size_t TileCache<PixelParam>::
+getNumMisses() const
+{
+    return numMisses;
+}
+
+
+template <typename PixelParam>
+void TileCache<PixelParam>::
+store(const Key& key, const PixelType* buffer, bool overwrite)
+{
+    typename Index::iterator it = index.find(key);
+    if (it != index.end())
+    {
+        entries.splice(entries.begin(), entries, it->second);
+        if (overwrite)
+        {
+            std::copy(buffer, buffer+tileNumPixels, it->second->data);
+        }
+        return;
+    }
+
+    //recycle the least recently used entry if the cache is full
+    if (entries.size() >= capacity)
+    {
+        entries.splice(entries.begin(), entries, --entries.end());
+        index.erase(entries.front().key);
+    }
+    else
+    {
+        Entry entry;
+        entry.data = new PixelType[tileNumPixels];
+        entries.push_front(entry);
+    }
+
+    Entry& entry = entries.front();
+    entry.key    = key;
+    std::copy(buffer, buffer+tileNumPixels, entry.data);
+    index.insert(typename Index::value_type(key, entries.begin()));
+}
+
+
+} //namespace crusta
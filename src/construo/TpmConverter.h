@@ -0,0 +1,61 @@
+#ifndef _TpmConverter_H_
+#define _TpmConverter_H_
+
+
+#include <string>
+
+#include <construo/GdalImageFile.h>
+#include <construo/TpmFile.h>
+
+#include <construo/vrui.h>
+
+
+namespace crusta {
+
+
+/**
+    Converts source images readable by GDAL into pre-tiled, uncompressed TPM
+    copies. The raw pixel values are stored (no offset or scale applied), such
+    that a copy can be re-ingested with different settings. The projection of
+    the source, along with its nodata value, is written to the .proj file of
+    the copy, and its explicit coverage, if any, to the .cov file. Copies are
+    written under temporary names and moved into place once complete.
+*/
+template <typename PixelType>
+class TpmConverter
+{
+public:
+    /** size of the tiles of the copy. The footprint of a finest level globe
+        tile in the source is about 1.5 times the globe tile resolution, thus a
+        tile covers the reads of a few neighboring globe tiles */
+    static const unsigned int tileSize = 128;
+
+    /** convert the source into the TPM file unless an up-to-date copy
+        already exists */
+    static void convert(const std::string& sourceName,
+                        const std::string& tpmName);
+
+    /** name of the TPM copy of a source within the given directory. The
+        name is tagged with a hash of the absolute path of the source, such
+        that sources of the same name in different folders don't collide */
+    static std::string getTpmName(const std::string& sourceName,
+                                  const std::string& directory);
+
+protected:
+    /** copy the pixels of the source into the tiles of the copy */
+    static void copyTiles(GdalImageFile<PixelType>& source, TpmFile& tpm);
+    /** copy a text file line by line */
+    static void copyLines(Misc::File& in, Misc::File& out);
+    /** rename a completed temporary file to its final name */
+    static void moveIntoPlace(const std::string& tmpName,
+                              const std::string& name);
+};
+
+
+} //namespace crusta
+
+
+#include <construo/TpmConverter.hpp>
+
+
+#endif //_TpmConverter_H_
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <construo/GdalImageFile.h>
+#include <construo/TpmFile.h>
+
+#include <construo/vrui.h>
+
+
+namespace crusta {
+
+
+///describes the layout of a pixel type in a TPM file
+template <typename PixelType>
+struct TpmPixelTraits;
+
+template <>
+struct TpmPixelTraits<float>
+{
+    static const unsigned int numChannels = 1;
+    static const unsigned int channelSize = sizeof(float);
+};
+
+template <>
+struct TpmPixelTraits<Geometry::Vector<uint8_t,3> >
+{
+    static const unsigned int numChannels = 3;
+    static const unsigned int channelSize = 1;
+};
+
+
+template <typename PixelType>
+void TpmConverter<PixelType>::
+convert(const std::string& sourceName, const std::string& tpmName)
+{
+    //skip the conversion if the copy is more recent than the source
+    struct stat sourceStat, tpmStat;
+    if (stat(sourceName.c_str(), &sourceStat)==0 &&
+        stat(tpmName.c_str(), &tpmStat)==0 &&
+        tpmStat.st_mtime>=sourceStat.st_mtime)
+    {
+        std::cout << "Using existing pre-tiled copy " << tpmName << "\n\n";
+        return;
+    }
+
+    std::cout << "Pre-tiling " << sourceName << " into " << tpmName;
+    std::cout.flush();
+
+    //the source reader also dumps the source's projection if missing
+    GdalImageFile<PixelType> source(sourceName);
+    PixelType sourceNodata = source.getNodata();
+
+    /* the copy is written under temporary names and only moved into place
+       once complete, such that an interrupted conversion is never mistaken
+       for an up-to-date copy */
+    std::string sourceBase(sourceName, 0, sourceName.rfind('.'));
+    std::string tpmBase(tpmName, 0, tpmName.rfind('.'));
+    std::ostringstream tmpOss;
+    tmpOss << tpmBase << "." << getpid() << ".tmp";
+    std::string tmpBase = tmpOss.str();
+
+    //copy the projection and append the nodata value
+    {
+        Misc::File in((sourceBase + ".proj").c_str(), "r");
+        Misc::File out((tmpBase + ".proj").c_str(), "wt");
+        copyLines(in, out);
+
+        std::ostringstream oss;
+        oss << "\nNodata:\n" << sourceNodata << "\n";
+        out.puts(oss.str().c_str());
+    }
+
+    //copy the explicit coverage of the source, if any
+    struct stat covStat;
+    bool hasCoverage = stat((sourceBase + ".cov").c_str(), &covStat) == 0;
+    if (hasCoverage)
+    {
+        Misc::File in((sourceBase + ".cov").c_str(), "r");
+        Misc::File out((tmpBase + ".cov").c_str(), "wt");
+        copyLines(in, out);
+    }
+
+    //copy the pixels tile by tile
+    {
+        typedef TpmPixelTraits<PixelType> Traits;
+        TpmFile::Card imgSize[2] = { TpmFile::Card(size[0]),
+                                     TpmFile::Card(size[1]) };
+        TpmFile::Card tpmTileSize[2] = { tileSize, tileSize };
+        TpmFile tpm((tmpBase + ".tpm").c_str(), Traits::numChannels,
+                    Traits::channelSize, imgSize, tpmTileSize);
+        copyTiles(source, tpm);
+        tpm.writeTileDirectory();
+    }
+
+    /* move the copy into place. The pixels go last, as their modification
+       time marks the copy as up-to-date */
+    moveIntoPlace(tmpBase + ".proj", tpmBase + ".proj");
+    if (hasCoverage)
+        moveIntoPlace(tmpBase + ".cov", tpmBase + ".cov");
+    else
+        unlink((tpmBase + ".cov").c_str());
+    moveIntoPlace(tmpBase + ".tpm", tpmName);
+
+    std::cout << " done\n\n";
+    std::cout.flush();
+}
+
+template <typename PixelType>
+void TpmConverter<PixelType>::
+copyTiles(GdalImageFile<PixelType>& source, TpmFile& tpm)
+{
+    const int* size        = source.getSize();
+    PixelType sourceNodata = source.getNodata();
+
+    std::vector<PixelType> rect(tileSize*tileSize);
+    std::vector<PixelType> tile(tileSize*tileSize);
+    const TpmFile::Card* numTiles = tpm.getNumTiles();
+    TpmFile::Card index[2];
+    for (index[1]=0; index[1]<numTiles[1]; ++index[1])
+    {
+        for (index[0]=0; index[0]<numTiles[0]; ++index[0])
+        {
+            //read the part of the tile that lies within the image
+            int origin[2], rectSize[2];
+            for (int i=0; i<2; ++i)
+            {
+                origin[i]   = index[i] * tileSize;
+                rectSize[i] = std::min(int(tileSize), size[i]-origin[i]);
+            }
+            source.readRectangle(origin, rectSize, &rect[0]);
+
+            //pad the tile with nodata
+            std::fill(tile.begin(), tile.end(), sourceNodata);
+            for (int y=0; y<rectSize[1]; ++y)
+            {
+                std::copy(&rect[y*rectSize[0]], &rect[y*rectSize[0]] +
+                          rectSize[0], &tile[y*tileSize]);
+            }
+
+            tpm.writeTile(index, &tile[0]);
+        }
+
+        std::cout << ".";
+        std::cout.flush();
+    }
+}
+
+template <typename PixelType>
+void TpmConverter<PixelType>::
+copyLines(Misc::File& in, Misc::File& out)
+{
+    char line[1024];
+    while (in.gets(line, sizeof(line)))
+        out.puts(line);
+}
+
+template <typename PixelType>
+void TpmConverter<PixelType>::
+moveIntoPlace(const std::string& tmpName, const std::string& name)
+{
+    if (rename(tmpName.c_str(), name.c_str()) != 0)
+    {
+        Misc::throwStdErr("TpmConverter: Error %d while moving %s to %s",
+                          errno, tmpName.c_str(), name.c_str());
+    }
+}
+
+template <typename PixelType>
+std::string TpmConverter<PixelType>::
+getTpmName(const std::string& sourceName, const std::string& directory)
+{
+    size_t slashPos = sourceName.rfind('/');
+    size_t start    = slashPos==std::string::npos ? 0 : slashPos+1;
+    size_t dotPos   = sourceName.rfind('.');
+    if (dotPos==std::string::npos || dotPos<start)
+        dotPos = sourceName.size();
+
+    /* sources of the same name in different folders must not share a copy.
+       Tag the name with a hash (FNV-1a) of the absolute path of the source */
+    char absolute[PATH_MAX];
+    std::string path = realpath(sourceName.c_str(), absolute)!=NULL ?
+                       std::string(absolute) : sourceName;
+    uint32_t hash = 2166136261u;
+    for (std::string::const_iterator it=path.begin(); it!=path.end(); ++it)
+    {
+        hash ^= uint8_t(*it);
+        hash *= 16777619u;
+    }
+
+    std::ostringstream name;
+    name << directory;
+    if (!directory.empty() && directory[directory.size()-1]!='/')
+        name << "/";
+    name << std::string(sourceName, start, dotPos-start) << "_" << std::hex
+         << std::setw(8) << std::setfill('0') << hash << ".tpm";
+    return name.str();
+}
+
+
+} //namespace crusta
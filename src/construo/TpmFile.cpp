@@ -35,6 +35,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #if defined(__APPLE__)
 #define lseek64 lseek
+#define pread64 pread
 #endif //__APPLE__
 
 namespace {
@@ -389,6 +390,59 @@ bool TpmFile::readTile(const TpmFile::Card tileIndex[2],void* pixelData)
 	return true;
 	}
 
+bool TpmFile::preadTile(const TpmFile::Card tileIndex[2],void* pixelData) const
+	{
+	/* Find the file position of the tile: */
+	Card linearTileIndex=tileDirectory[tileIndex[1]*numTiles[0]+tileIndex[0]];
+	if(linearTileIndex==invalidIndex)
+		{
+		/* Don't read anything */
+		return false;
+		}
+	FilePos fileTilePos=fileTileOffset+FilePos(linearTileIndex)*fileTileSize;
+
+	/* Read the tile's pixel data from the file without moving the file pointer: */
+	unsigned char* dPtr=static_cast<unsigned char*>(pixelData);
+	size_t dataSize=fileTileSize;
+	while(dataSize>0)
+		{
+		ssize_t readResult=pread64(fd,dPtr,dataSize,fileTilePos);
+		if(readResult<0)
+			{
+			if(errno==EINTR)
+				continue;
+			Misc::throwStdErr("TpmFile::preadTile: Error %d while reading from file",errno);
+			}
+		if(readResult==0)
+			Misc::throwStdErr("TpmFile::preadTile: Unexpected end of file");
+
+		/* Go to the unread rest of the data: */
+		dPtr+=readResult;
+		dataSize-=readResult;
+		fileTilePos+=readResult;
+		}
+
+	#if __BYTE_ORDER!=__LITTLE_ENDIAN
+	if(channelSize>1)
+		{
+		/* Byte-swap the tile's pixel data in place: */
+		unsigned char* pixelPtr=static_cast<unsigned char*>(pixelData);
+		size_t tileNumChannels=size_t(tileSize[0])*size_t(tileSize[1])*size_t(numChannels);
+		for(size_t i=0;i<tileNumChannels;++i,pixelPtr+=channelSize)
+			{
+			for(Card j=0;j<channelSize/2;++j)
+				{
+				unsigned char t=pixelPtr[j];
+				pixelPtr[j]=pixelPtr[channelSize-1-j];
+				pixelPtr[channelSize-1-j]=t;
+				}
+			}
+		}
+	#endif
+
+	return true;
+	}
+
 bool TpmFile::readPixel(const TpmFile::Card pixelPosition[2],void* pixelData)
 	{
 	/* Check the pixel position against the image size: */
@@ -126,6 +126,7 @@ class TpmFile
 		return tileDirectory[tileIndex[1]*numTiles[0]+tileIndex[0]]!=invalidIndex;
 		}
 	bool readTile(const Card tileIndex[2],void* pixelData); // Reads a tile from the image file at the given position; does not change pixel data if tile is not used; returns true if pixel data is valid
+	bool preadTile(const Card tileIndex[2],void* pixelData) const; // Same as readTile, but uses positional reads that leave the file position untouched; can be called concurrently
 	bool readPixel(const Card pixelPosition[2],void* pixelData); // Reads a single pixel from the image file at the given position; does not change pixel data if tile containing pixel is not used; returns true if pixel data is valid
 	void readRectangle(const Card rectOrigin[2],const Card rectSize[2],void* rectData); // Reads a rectangle of pixels from the file; does not touch pixels from undefined regions
 	};
@@ -23,6 +23,9 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef _TpmImageFile_H_
 #define _TpmImageFile_H_
 
+#include <string>
+#include <vector>
+
 #include <construo/ImageFile.h>
 #include <construo/TpmFile.h>
 
@@ -33,21 +36,42 @@ namespace crusta {
 
 
 template <typename PixelType>
-class TpmImageFile : public ImageFile<PixelType>
+class TpmImageFileBase : public ImageFile<PixelType>
 {
 public:
     ///opens an image file by name
-    TpmImageFile(const char* imageFileName);
+    TpmImageFileBase(const char* imageFileName);
 
     ///reads a portion of the image
-    void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                       PixelType* rectBuffer) const;
+    virtual void readRectangle(const int rectOrigin[2], const int rectSize[2],
+                               PixelType* rectBuffer) const;
 
 protected:
-    ///mutex protecting the tpm file during reading
+    /** converts a span of pixels from the file's representation and applies
+        the pixel offset and scale */
+    virtual void convertPixels(const unsigned char* src, int numPixels,
+                               PixelType* dst) const = 0;
+
+    ///mutex protecting the tile buffer during reading
     mutable Threads::Mutex tpmFileMutex;
     ///the underlying TPM file driver
-    mutable TpmFile tpmFile;
+    TpmFile tpmFile;
+    ///buffer holding the tile currently being read
+    mutable std::vector<unsigned char> tileBuffer;
+};
+
+template <typename PixelType>
+class TpmImageFile : public TpmImageFileBase<PixelType>
+{
+public:
+    typedef TpmImageFileBase<PixelType> Base;
+
+    TpmImageFile(const char* imageFileName);
+
+//- inherited from TpmImageFileBase
+protected:
+    virtual void convertPixels(const unsigned char* src, int numPixels,
+                               PixelType* dst) const;
 };
 
 
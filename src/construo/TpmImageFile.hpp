@@ -20,7 +20,11 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+
+#include <algorithm>
 #include <cstring>
+#include <iostream>
+#include <sstream>
 
 #include <crustacore/Vector3ui8.h>
 
@@ -30,181 +34,197 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 namespace crusta {
 
 
-//- single channel float -------------------------------------------------------
-
-template <>
-class TpmImageFile<float> : public ImageFile<float>
+template <typename PixelType>
+TpmImageFileBase<PixelType>::
+TpmImageFileBase(const char* imageFileName) :
+    tpmFile(imageFileName), tileBuffer(tpmFile.getTileByteSize())
 {
-public:
-    TpmImageFile(const char* imageFileName) :
-        tpmFile(imageFileName)
+    /* Read the image size: */
+    this->size[0] = tpmFile.getSize(0);
+    this->size[1] = tpmFile.getSize(1);
+
+    /* The converter records the nodata value of the source in the image's
+       projection file */
+    std::string fileName(imageFileName);
+    std::string projectionFileName(fileName, 0, fileName.rfind('.'));
+    projectionFileName.append(".proj");
+    try
     {
-        if (static_cast<int>(tpmFile.getNumChannels()) != 1)
+        Misc::File projectionFile(projectionFileName.c_str(), "r");
+
+        char line[1024];
+        while (projectionFile.gets(line, sizeof(line)))
         {
-            Misc::throwStdErr("TpmImageFile: mismatching pixel type. Expecting "
-                              "1 channel, got %d channels",
-                              tpmFile.getNumChannels());
+            if (strcasecmp(line, "Nodata:\n")==0 &&
+                projectionFile.gets(line, sizeof(line)))
+            {
+                std::istringstream iss(line);
+                iss >> this->nodata;
+
+                std::cout << "Internal nodata value:\n" << line << "\n";
+            }
         }
-        /* Read the image size: */
-        this->size[0] = tpmFile.getSize(0);
-        this->size[1] = tpmFile.getSize(1);
     }
-
-public:
-    void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                       float* rectBuffer) const
+    catch (Misc::File::OpenError openError)
     {
-        /* Lock the image file (no sense in multithreading at this point): */
-        Threads::Mutex::Lock lock(tpmFileMutex);
-
-        assert(rectOrigin[0]>=0 && rectOrigin[0]+rectSize[0]<=this->size[0]);
-        assert(rectOrigin[1]>=0 && rectOrigin[1]+rectSize[1]<=this->size[1]);
-
-        TpmFile::Card ro[2];
-        TpmFile::Card rs[2];
-        for (int i=0; i<2; ++i)
-        {
-            ro[i] = rectOrigin[i];
-            rs[i] = rectSize[i];
-        }
+        //no projection file, the patch will fail to load anyway
+    }
+}
 
-        switch (tpmFile.getChannelSize())
-        {
-            case 8:
-            {
-                int8_t* imgData = new int8_t[rectSize[0]*rectSize[1]];
-                tpmFile.readRectangle(ro, rs, imgData);
+template <typename PixelType>
+void TpmImageFileBase<PixelType>::
+readRectangle(const int rectOrigin[2], const int rectSize[2],
+              PixelType* rectBuffer) const
+{
+    //the tile buffer is shared by all the reads
+    Threads::Mutex::Lock lock(tpmFileMutex);
 
-                for (int i=0; i<rectSize[0]*rectSize[1]; ++i)
-                    rectBuffer[i] = float(imgData[i]);
+    assert(rectOrigin[0]>=0 && rectOrigin[0]+rectSize[0]<=this->size[0]);
+    assert(rectOrigin[1]>=0 && rectOrigin[1]+rectSize[1]<=this->size[1]);
 
-                delete[] imgData;
-            }break;
+    const TpmFile::Card* tileSize = tpmFile.getTileSize();
+    const size_t pixelSize        = tpmFile.getPixelByteSize();
 
-            case 16:
+    //read all the tiles overlapping the rectangle
+    TpmFile::Card first[2], last[2];
+    for (int i=0; i<2; ++i)
+    {
+        first[i] = rectOrigin[i] / tileSize[i];
+        last[i]  = (rectOrigin[i]+rectSize[i]-1) / tileSize[i];
+    }
+    TpmFile::Card tile[2];
+    for (tile[1]=first[1]; tile[1]<=last[1]; ++tile[1])
+    {
+        for (tile[0]=first[0]; tile[0]<=last[0]; ++tile[0])
+        {
+            int origin[2], from[2], to[2];
+            for (int i=0; i<2; ++i)
             {
-                int16_t* imgData = new int16_t[rectSize[0]*rectSize[1]];
-                tpmFile.readRectangle(ro, rs, imgData);
-
-                for (int i=0; i<rectSize[0]*rectSize[1]; ++i)
-                    rectBuffer[i] = float(imgData[i]);
+                origin[i] = tile[i] * tileSize[i];
+                from[i]   = std::max(rectOrigin[i], origin[i]);
+                to[i]     = std::min(rectOrigin[i]+rectSize[i],
+                                     origin[i]+int(tileSize[i]));
+            }
 
-                delete[] imgData;
-            }break;
+            //unused tiles leave the rectangle untouched
+            if (!tpmFile.preadTile(tile, &tileBuffer[0]))
+                continue;
 
-            case 32:
+            for (int y=from[1]; y<to[1]; ++y)
             {
-                int32_t* imgData = new int32_t[rectSize[0]*rectSize[1]];
-                tpmFile.readRectangle(ro, rs, imgData);
-
-                for (int i=0; i<rectSize[0]*rectSize[1]; ++i)
-                    rectBuffer[i] = float(imgData[i]);
-
-                delete[] imgData;
-            }break;
+                const unsigned char* src = &tileBuffer[0] + pixelSize *
+                    ((y-origin[1])*tileSize[0] + (from[0]-origin[0]));
+                PixelType* dst = rectBuffer + (y-rectOrigin[1])*rectSize[0] +
+                                 (from[0]-rectOrigin[0]);
+                convertPixels(src, to[0]-from[0], dst);
+            }
         }
     }
-
-protected:
-    ///mutex protecting the tpm file during reading
-    mutable Threads::Mutex tpmFileMutex;
-    ///the underlying TPM file driver
-    mutable TpmFile tpmFile;
-};
+}
 
 
-//- 3-channel unit8 ------------------------------------------------------------
+//- single channel float -------------------------------------------------------
 
 template <>
-class TpmImageFile<Geometry::Vector<uint8_t,3> > : public ImageFile<Geometry::Vector<uint8_t,3> >
+inline
+TpmImageFile<float>::
+TpmImageFile(const char* imageFileName) :
+    Base(imageFileName)
 {
-public:
-    TpmImageFile(const char* imageFileName) :
-        tpmFile(imageFileName)
+    if (static_cast<int>(tpmFile.getNumChannels()) != 1)
     {
-        if (static_cast<int>(tpmFile.getNumChannels()) != 3)
-        {
-            Misc::throwStdErr("TpmImageFile: mismatching pixel type. Expecting "
-                              "%d channel, got %d channels",
-                              Geometry::Vector<uint8_t,3>::dimension, tpmFile.getNumChannels());
-        }
-        /* Read the image size: */
-        this->size[0] = tpmFile.getSize(0);
-        this->size[1] = tpmFile.getSize(1);
+        Misc::throwStdErr("TpmImageFile: mismatching pixel type. Expecting "
+                          "1 channel, got %d channels",
+                          tpmFile.getNumChannels());
     }
-
-public:
-    void readRectangle(const int rectOrigin[2], const int rectSize[2],
-                       Geometry::Vector<uint8_t,3>* rectBuffer) const
+    int channelSize = static_cast<int>(tpmFile.getChannelSize());
+    if (channelSize!=1 && channelSize!=2 && channelSize!=4)
     {
-        /* Lock the image file (no sense in multithreading at this point): */
-        Threads::Mutex::Lock lock(tpmFileMutex);
+        Misc::throwStdErr("TpmImageFile: unsupported channel size of %d bytes",
+                          channelSize);
+    }
+}
 
-        assert(rectOrigin[0]>=0 && rectOrigin[0]+rectSize[0]<=this->size[0]);
-        assert(rectOrigin[1]>=0 && rectOrigin[1]+rectSize[1]<=this->size[1]);
+template <>
+inline void TpmImageFile<float>::
+convertPixels(const unsigned char* src, int numPixels, float* dst) const
+{
+    //channels of 1 and 2 bytes store integers, 4 bytes floats
+    switch (tpmFile.getChannelSize())
+    {
+        case 1:
+            for (int i=0; i<numPixels; ++i)
+                dst[i] = float(src[i]);
+            break;
 
-        TpmFile::Card ro[2];
-        TpmFile::Card rs[2];
-        for (int i=0; i<2; ++i)
+        case 2:
         {
-            ro[i] = rectOrigin[i];
-            rs[i] = rectSize[i];
-        }
+            const int16_t* s = reinterpret_cast<const int16_t*>(src);
+            for (int i=0; i<numPixels; ++i)
+                dst[i] = float(s[i]);
+        }break;
+
+        case 4:
+            memcpy(dst, src, numPixels*sizeof(float));
+            break;
+    }
 
-        int numPixels   = rectSize[0] * rectSize[1];
-        int numElements = numPixels * tpmFile.getNumChannels();
-        switch (tpmFile.getChannelSize())
+    //scale the pixel values
+    if (pixelOffset!=0.0 || pixelScale!=1.0)
+    {
+        for (float* p=dst; p<dst+numPixels; ++p)
         {
-            case 8:
-            {
-                int8_t* imgData = new int8_t[numElements];
-                tpmFile.readRectangle(ro, rs, imgData);
-
-                for (int p=0, e=0; p<numPixels; ++p)
-                {
-                    for (int c=0; c<Geometry::Vector<uint8_t,3>::dimension; ++c, ++e)
-                        rectBuffer[p][c] = imgData[e];
-                }
-
-                delete[] imgData;
-            }break;
-
-            case 16:
-            {
-                int16_t* imgData = new int16_t[numElements];
-                tpmFile.readRectangle(ro, rs, imgData);
+            if (*p != nodata)
+                *p = pixelOffset + pixelScale * (*p);
+        }
+    }
+}
 
-                for (int p=0, e=0; p<numPixels; ++p)
-                {
-                    for (int c=0; c<Geometry::Vector<uint8_t,3>::dimension; ++c, ++e)
-                        rectBuffer[p][c] = imgData[e];
-                }
 
-                delete[] imgData;
-            }break;
+//- 3-channel unit8 ------------------------------------------------------------
 
-            case 32:
-            {
-                int32_t* imgData = new int32_t[numElements];
-                tpmFile.readRectangle(ro, rs, imgData);
+template <>
+inline
+TpmImageFile<Geometry::Vector<uint8_t,3> >::
+TpmImageFile(const char* imageFileName) :
+    Base(imageFileName)
+{
+    if (static_cast<int>(tpmFile.getNumChannels()) !=
+        Geometry::Vector<uint8_t,3>::dimension)
+    {
+        Misc::throwStdErr("TpmImageFile: mismatching pixel type. Expecting "
+                          "%d channel, got %d channels",
+                          Geometry::Vector<uint8_t,3>::dimension,
+                          tpmFile.getNumChannels());
+    }
+    if (tpmFile.getChannelSize() != 1)
+    {
+        Misc::throwStdErr("TpmImageFile: unsupported channel size of %d bytes",
+                          tpmFile.getChannelSize());
+    }
+}
 
-                for (int p=0, e=0; p<numPixels; ++p)
-                {
-                    for (int c=0; c<Geometry::Vector<uint8_t,3>::dimension; ++c, ++e)
-                        rectBuffer[p][c] = imgData[e];
-                }
+template <>
+inline void TpmImageFile<Geometry::Vector<uint8_t,3> >::
+convertPixels(const unsigned char* src, int numPixels,
+              Geometry::Vector<uint8_t,3>* dst) const
+{
+    for (int p=0; p<numPixels; ++p)
+    {
+        for (int c=0; c<Geometry::Vector<uint8_t,3>::dimension; ++c, ++src)
+            dst[p][c] = *src;
+    }
 
-                delete[] imgData;
-            }break;
+    //scale the pixel values
+    if (pixelOffset!=0.0 || pixelScale!=1.0)
+    {
+        for (Geometry::Vector<uint8_t,3>* p=dst; p<dst+numPixels; ++p)
+        {
+            if (*p != nodata)
+                *p = pixelOffset + pixelScale * (*p);
         }
     }
-
-protected:
-    ///mutex protecting the tpm file during reading
-    mutable Threads::Mutex tpmFileMutex;
-    ///the underlying TPM file driver
-    mutable TpmFile tpmFile;
-};
+}
 
 
 } //namespace crusta
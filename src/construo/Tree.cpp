@@ -16,6 +16,15 @@ GlobeFile<TextureColor>* TreeNode<TextureColor>::globeFile = NULL;
 template <>
 GlobeFile<LayerDataf>* TreeNode<LayerDataf>:: globeFile = NULL;
 
+template <>
+size_t TreeNode<DemHeight>::numNodes    = 0;
+
+template <>
+size_t TreeNode<TextureColor>::numNodes = 0;
+
+template <>
+size_t TreeNode<LayerDataf>::numNodes   = 0;
+
 #if CRUSTA_ENABLE_DEBUG
 template <>
 bool TreeNode<DemHeight>::debugGetKin    = false;
@@ -57,6 +57,10 @@ public:
     /** create in-memory representations for the children nodes if they are
         reflected in the quadtree file */
     void loadMissingChildren();
+    /** release the in-memory representation of the subtrees of the children.
+        Their state is kept in the quadtree file, from which they can be
+        loaded again */
+    void unloadChildren();
     /** determine the approximate resolution of the node. This is only computed
         for the step off the middle of an edge as we assume the sphere to be
         worst approximated away from the corners of the scope */
@@ -70,6 +74,8 @@ public:
 
 //- Construo node data
     static GlobeFile<PixelParam>* globeFile;
+    ///number of non-root nodes currently represented in memory
+    static size_t numNodes;
 
     TreeIndex treeIndex;
     TileIndex tileIndex;
@@ -80,8 +86,6 @@ public:
 
     typename PixelParam::Type* data;
 
-    bool mustBeUpdated;
-
 protected:
     bool isExplicitNeighborNode;
 
@@ -115,7 +119,10 @@ public:
     typedef ExplicitNeighborNode<PixelParam> BaseNode;
     typedef std::vector<BaseNode>            BaseNodes;
 
-    Spheroid(const std::string& baseName, const size_t tileResolution[2]);
+    /** open the globe file. Only the quadtree files of the given subset of
+        base patches are opened (all of them if the subset is empty) */
+    Spheroid(const std::string& baseName, const size_t tileResolution[2],
+             const std::vector<int>& patchSubset=std::vector<int>());
 
     BaseNodes             baseNodes;
     GlobeFile<PixelParam> globeFile;
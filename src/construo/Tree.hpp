@@ -53,20 +53,28 @@ TreeNodeCreateTileHeader(const TreeNode<DemHeight>& node)
     }
 
     /* update to the tree propagate up, but we need to consider the
-       descendance explicitly */
+       descendance explicitly. The children might not be loaded in memory */
+    TileIndex childIndices[4];
     if (node.children != NULL)
+    {
+        for (int i=0; i<4; ++i)
+            childIndices[i] = node.children[i].tileIndex;
+    }
+    else if (!file->readTile(node.tileIndex, childIndices))
+        childIndices[0] = INVALID_TILEINDEX;
+
+    if (childIndices[0] != INVALID_TILEINDEX)
     {
         for (int i=0; i<4; ++i)
         {
-            TreeNode<DemHeight>& child = node.children[i];
-            assert(child.tileIndex != INVALID_TILEINDEX);
+            assert(childIndices[i] != INVALID_TILEINDEX);
             //get the child header
             TileHeader childHeader;
 #if DEBUG
-            bool res = file->readTile(child.tileIndex, childHeader);
+            bool res = file->readTile(childIndices[i], childHeader);
             assert(res==true);
 #else
-            file->readTile(child.tileIndex, childHeader);
+            file->readTile(childIndices[i], childHeader);
 #endif //DEBUG
 
             header.range[0] = std::min(header.range[0],
@@ -84,14 +92,14 @@ TreeNode<PixelParam>::
 TreeNode() :
     parent(NULL), children(NULL),
     tileIndex(INVALID_TILEINDEX),
-    data(NULL), mustBeUpdated(false), isExplicitNeighborNode(false)
+    data(NULL), isExplicitNeighborNode(false)
 {}
 
 template <typename PixelParam>
 TreeNode<PixelParam>::
 ~TreeNode()
 {
-    delete[] children;
+    unloadChildren();
     delete[] data;
 }
 
@@ -309,7 +317,8 @@ createChildren()
     scope.split(childScopes);
 
     //allocate and initialize the children
-    children = new TreeNode<PixelParam>[4];
+    children  = new TreeNode<PixelParam>[4];
+    numNodes += 4;
     for (size_t i=0; i<4; ++i)
     {
         TreeNode<PixelParam>& child = children[i];
@@ -331,6 +340,9 @@ loadMissingChildren()
        children if valid counterparts exist in the file */
     assert(globeFile!=NULL && "uninitialized globe file");
     File* file = globeFile->getPatch(treeIndex.patch());
+    //patches that aren't part of the build have no accessible data
+    if (file == NULL)
+        return;
     TileIndex childIndices[4];
     if (!file->readTile(tileIndex, childIndices))
         return;
@@ -344,6 +356,19 @@ loadMissingChildren()
         children[i].tileIndex = childIndices[i];
 }
 
+template <typename PixelParam>
+void TreeNode<PixelParam>::
+unloadChildren()
+{
+    if (children == NULL)
+        return;
+
+    //the destruction of the children recursively unloads their subtrees
+    delete[] children;
+    children  = NULL;
+    numNodes -= 4;
+}
+
 static Scope::Vertex
 mid(const Scope::Vertex& one, const Scope::Vertex& two,
     const Scope::Scalar& radius)
@@ -404,12 +429,13 @@ setNeighbors(ExplicitNeighborNode* nodes[4], const size_t orients[4])
 
 template <typename PixelParam>
 Spheroid<PixelParam>::
-Spheroid(const std::string& baseName, const size_t tileResolution[2]):
+Spheroid(const std::string& baseName, const size_t tileResolution[2],
+         const std::vector<int>& patchSubset):
     globeFile(true) // Request a writable globe file that is created if it
         // doesn't exist already. TODO: Better way to do this?
 {
     //open the globe file
-    globeFile.open(baseName);
+    globeFile.open(baseName, patchSubset);
 
     //create the base nodes
     int numPatches = globeFile.getNumPatches();
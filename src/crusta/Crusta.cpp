@@ -1,5 +1,7 @@
 #include <crusta/Crusta.h>
 
+#include <algorithm>
+
 #include <crusta/checkGl.h>
 #include <crusta/ColorMapper.h>
 #include <crusta/DataManager.h>
@@ -11,6 +13,7 @@
 #include <crustacore/Section.h>
 #include <crusta/Sphere.h>
 #include <crusta/SurfaceProbeTool.h>
+#include <crusta/SurfaceSampler.h>
 #include <crusta/SliceTool.h>
 #include <crusta/SurfaceTool.h>
 #include <crusta/LayerToggleTool.h>
@@ -142,6 +145,8 @@ CrustaGlData::
 
 Crusta::Crusta(const std::string& exePath, const std::string& resourcePath):
   mapMan(NULL),
+  surfaceSampler(NULL),
+  sharedSurfaceStamp(0),
   sceneGraphViewer(NULL)
 {
 ///\todo split crusta and planet
@@ -178,6 +183,7 @@ Crusta::Crusta(const std::string& exePath, const std::string& resourcePath):
     LayerToggleTool::init();
     SGToggleTool::init();
     mapMan = new MapManager(crustaTool, this);
+    surfaceSampler = new SurfaceSampler(this);
     lightSettings = new LightSettings();
     CRUSTA = this;
 }
@@ -187,6 +193,7 @@ Crusta::~Crusta()
     if (sceneGraphViewer){ delete sceneGraphViewer; sceneGraphViewer=NULL; }
     delete lightSettings;
     delete mapMan;
+    delete surfaceSampler;
     for (RenderPatches::iterator it=renderPatches.begin();
          it!=renderPatches.end(); ++it)
     {
@@ -288,6 +295,16 @@ void Crusta::reset()
     }
     renderPatches.clear();
 
+    //the shared surface references nodes of the destroyed patches
+    {
+        Threads::Mutex::Lock lock(sharedSurfaceMutex);
+        sharedSurface.clear();
+        sharedSurfaceStamp = FrameStamp(0);
+    }
+
+    //abandon the pending samples, they reference the data being unloaded
+    surfaceSampler->reset();
+
     //destroy all the current maps
     mapMan->deleteAllShapes();
 
@@ -625,18 +642,57 @@ std::cerr << "\n" << std::setprecision(std::numeric_limits<double>::digits10) <<
 
 SurfacePoint Crusta::
 intersect(const Geometry::Ray<double,3>& ray) const
+{
+    int patchHint = -1;
+    return intersect(ray, patchHint);
+}
+
+SurfacePoint Crusta::
+intersect(const Geometry::Ray<double,3>& ray, int& patchHint) const
 {
     if (renderPatches.empty())
         return SurfacePoint();
 
+    Scalar gin, gout;
+    int patch = enterGlobe(ray, patchHint, gin, gout);
+    if (patch == -1)
+        return SurfacePoint();
+
+    //traverse terrain patches until intersection or ray exit
+    SurfacePoint surfacePoint;
+    Scalar tin     = gin;
+    Scalar tout    = 0;
+    int    sideIn  = -1;
+    int    sideOut = -1;
+    while (true)
+    {
+        surfacePoint = renderPatches[patch]->intersect(ray, tin, sideIn, tout,
+                                                       sideOut, gout);
+        if (surfacePoint.isValid())
+            break;
+
+        //move to the patch on the exit side
+        tin = tout;
+        if (tin > gout)
+            break;
+
+        patch = exitPatch(patch, sideOut, sideIn);
+    }
+
+    return surfacePoint;
+}
+
+int Crusta::
+enterGlobe(const Geometry::Ray<double,3>& ray, int& patchHint,
+           Scalar& gin, Scalar& gout) const
+{
     const Scalar& verticalScale = getVerticalScale();
 
-    Scalar gin, gout;
     //make sure the ray even intersects the outer shell of the globe
     Sphere shell(Geometry::Point<double,3>(0), SETTINGS->globeRadius +
                  verticalScale*globalElevationRange[1]);
     if (!shell.intersectRay(ray, gin, gout))
-        return SurfacePoint();
+        return -1;
     //don't use a starting point that is behind the origin
     gin = std::max(gin, 0.0);
 
@@ -649,54 +705,213 @@ intersect(const Geometry::Ray<double,3>& ray) const
 
     //find the patch containing the entry point
     Geometry::Point<double,3> entry = ray(gin);
-    const QuadTerrain* patch = NULL;
-    NodeData*          node  = NULL;
-    NodeMainData nodeData;
-    for (RenderPatches::const_iterator it=renderPatches.begin();
-         it!=renderPatches.end(); ++it)
+    int numPatches = static_cast<int>(renderPatches.size());
+    //coherent rays usually enter the same patch as their predecessor
+    if (patchHint>=0 && patchHint<numPatches &&
+        renderPatches[patchHint]->getRootNode().node->scope.contains(entry))
     {
-        nodeData = (*it)->getRootNode();
-        node     = nodeData.node;
-        if (node->scope.contains(entry))
+        return patchHint;
+    }
+    for (int i=0; i<numPatches; ++i)
+    {
+        if (renderPatches[i]->getRootNode().node->scope.contains(entry))
         {
-            patch = *it;
-            break;
+            patchHint = i;
+            return i;
         }
     }
 
-    assert(patch!=NULL && node!=NULL);
-
-    //traverse terrain patches until intersection or ray exit
-    SurfacePoint surfacePoint;
-    Scalar tin           = gin;
-    Scalar tout          = 0;
-    int    sideIn        = -1;
-    int    sideOut       = -1;
-    int    mapSide[4][4] = {{2,3,0,1}, {1,2,3,0}, {0,1,2,3}, {3,0,1,2}};
-    while (true)
-    {
-        surfacePoint = patch->intersect(ray, tin, sideIn, tout, sideOut, gout);
-        if (surfacePoint.isValid())
-            break;
+    assert(false);
+    return -1;
+}
 
+int Crusta::
+exitPatch(int patch, int sideOut, int& sideIn) const
+{
 /**\todo this is problematic because there are valence 5 vertices on the base
 polyhedron (triacontahedron). The neighbor is not necessarily unique. This is
 unlikely to be an issue because we are likely to intersect within the root.
 Still this should be handled more robustly */
-        //move to the patch on the exit side
-        tin = tout;
-        if (tin > gout)
-            break;
+    static const int mapSide[4][4] = {
+        {2,3,0,1}, {1,2,3,0}, {0,1,2,3}, {3,0,1,2} };
+
+    const Polyhedron* const polyhedron = DATAMANAGER->getPolyhedron();
+    Polyhedron::Connectivity neighbors[4];
+    polyhedron->getConnectivity(patch, neighbors);
+    sideIn = mapSide[neighbors[sideOut][1]][sideOut];
+    return neighbors[sideOut][0];
+}
 
-        const Polyhedron* const polyhedron = DATAMANAGER->getPolyhedron();
-        Polyhedron::Connectivity neighbors[4];
-        polyhedron->getConnectivity(patch->getRootNode().node->index.patch(),
-                                    neighbors);
-        patch  = renderPatches[neighbors[sideOut][0]];
-        sideIn = mapSide[neighbors[sideOut][1]][sideOut];
+void Crusta::
+intersectCoherent(const Rays& rays, const size_t* indices, size_t numRays,
+                  SurfacePoints& surfacePoints) const
+{
+    typedef QuadTerrain::BatchRay  BatchRay;
+    typedef QuadTerrain::BatchRays BatchRays;
+
+    //determine the extent of the rays within the globe and their entry patch
+    std::vector<BatchRay> batch;
+    std::vector<int>      patches;
+    batch.reserve(numRays);
+    patches.reserve(numRays);
+    int patchHint = -1;
+    for (size_t i=0; i<numRays; ++i)
+    {
+        BatchRay r;
+        r.ray          = &rays[indices[i]];
+        r.sin          = -1;
+        r.tout         = 0;
+        r.sout         = -1;
+        r.surfacePoint = &surfacePoints[indices[i]];
+        int patch = enterGlobe(*r.ray, patchHint, r.tin, r.gout);
+        if (patch != -1)
+        {
+            batch.push_back(r);
+            patches.push_back(patch);
+        }
     }
 
-    return surfacePoint;
+    /* traverse the patches in rounds. Every round intersects each patch once
+       with all the rays currently entering it, such that the rays share the
+       descent of the cached trees */
+    std::vector<size_t> active(batch.size());
+    for (size_t i=0; i<active.size(); ++i)
+        active[i] = i;
+    std::vector<BatchRays> patchRays(renderPatches.size());
+    while (!active.empty())
+    {
+        for (size_t i=0; i<active.size(); ++i)
+            patchRays[patches[active[i]]].push_back(&batch[active[i]]);
+        for (size_t p=0; p<patchRays.size(); ++p)
+        {
+            if (patchRays[p].empty())
+                continue;
+            renderPatches[p]->intersect(patchRays[p]);
+            patchRays[p].clear();
+        }
+
+        //move the rays that missed on to the patch on their exit side
+        size_t numActive = 0;
+        for (size_t i=0; i<active.size(); ++i)
+        {
+            BatchRay& r = batch[active[i]];
+            if (r.surfacePoint->isValid())
+                continue;
+
+            r.tin = r.tout;
+            if (r.tin > r.gout)
+                continue;
+
+            patches[active[i]] = exitPatch(patches[active[i]], r.sout, r.sin);
+            active[numActive++] = active[i];
+        }
+        active.resize(numActive);
+    }
+}
+
+
+/** interleave the lower 10 bits of the three coordinates into a Morton code */
+static uint32_t
+mortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t code = 0;
+    for (int i=0; i<10; ++i)
+    {
+        code |= ((x>>i) & 0x1) << (3*i);
+        code |= ((y>>i) & 0x1) << (3*i + 1);
+        code |= ((z>>i) & 0x1) << (3*i + 2);
+    }
+    return code;
+}
+
+/** processes a contiguous range of a coherently sorted batch of rays */
+struct RayBatchWorker
+{
+    const Crusta*              crusta;
+    const Crusta::Rays*        rays;
+    const std::vector<size_t>* order;
+    size_t                     begin;
+    size_t                     end;
+    Crusta::SurfacePoints*     surfacePoints;
+
+    void* process()
+    {
+        if (begin < end)
+        {
+            crusta->intersectCoherent(*rays, &(*order)[begin], end-begin,
+                                      *surfacePoints);
+        }
+        return NULL;
+    }
+};
+
+void Crusta::
+intersect(const Rays& rays, SurfacePoints& surfacePoints) const
+{
+    surfacePoints.clear();
+    surfacePoints.resize(rays.size());
+    if (renderPatches.empty() || rays.empty())
+        return;
+
+    const Scalar& verticalScale = getVerticalScale();
+    Sphere shell(Geometry::Point<double,3>(0), SETTINGS->globeRadius +
+                 verticalScale*globalElevationRange[1]);
+
+    /* sort the rays by the Morton code of their entry direction such that
+       consecutive rays traverse the same patches and nodes. Rays missing the
+       globe entirely are resolved right away */
+    typedef std::pair<uint32_t, size_t> KeyedRay;
+    std::vector<KeyedRay> keyed;
+    keyed.reserve(rays.size());
+    for (size_t i=0; i<rays.size(); ++i)
+    {
+        Scalar gin, gout;
+        if (!shell.intersectRay(rays[i], gin, gout))
+            continue;
+
+        Geometry::Vector<double,3> entry(rays[i](std::max(gin, 0.0)) -
+                                         Geometry::Point<double,3>::origin);
+        entry.normalize();
+        uint32_t q[3];
+        for (int j=0; j<3; ++j)
+        {
+            double c = Math::clamp((entry[j]+1.0) * 0.5, 0.0, 1.0);
+            q[j]     = static_cast<uint32_t>(c * 1023.0);
+        }
+        keyed.push_back(KeyedRay(mortonCode(q[0], q[1], q[2]), i));
+    }
+    std::sort(keyed.begin(), keyed.end());
+    std::vector<size_t> order(keyed.size());
+    for (size_t i=0; i<keyed.size(); ++i)
+        order[i] = keyed[i].second;
+
+    //split the sorted rays into contiguous ranges, one per thread
+    size_t minRays    = std::max(SETTINGS->rayBatchMinRaysPerThread, 1);
+    size_t numThreads = std::max(SETTINGS->rayBatchNumThreads, 1);
+    numThreads = std::min(numThreads, (order.size()+minRays-1) / minRays);
+    numThreads = std::max(numThreads, size_t(1));
+    size_t rangeSize = (order.size()+numThreads-1) / numThreads;
+
+    std::vector<RayBatchWorker> workers(numThreads);
+    for (size_t t=0; t<numThreads; ++t)
+    {
+        RayBatchWorker& worker = workers[t];
+        worker.crusta        = this;
+        worker.rays          = &rays;
+        worker.order         = &order;
+        worker.begin         = std::min(t*rangeSize, order.size());
+        worker.end           = std::min(worker.begin+rangeSize, order.size());
+        worker.surfacePoints = &surfacePoints;
+    }
+
+    //the calling thread processes the first range itself
+    Threads::Thread* threads = new Threads::Thread[numThreads-1];
+    for (size_t t=1; t<numThreads; ++t)
+        threads[t-1].start(&workers[t], &RayBatchWorker::process);
+    workers[0].process();
+    for (size_t t=1; t<numThreads; ++t)
+        threads[t-1].join();
+    delete[] threads;
 }
 
 
@@ -712,6 +927,16 @@ segmentCoverage(const Geometry::Point<double,3>& start, const Geometry::Point<do
     }
 }
 
+void Crusta::
+globalCoverage(Shape::IntersectionFunctor& callback) const
+{
+    for (RenderPatches::const_iterator it=renderPatches.begin();
+         it!=renderPatches.end(); ++it)
+    {
+        (*it)->globalCoverage(callback);
+    }
+}
+
 
 const FrameStamp& Crusta::
 getLastScaleStamp() const
@@ -775,6 +1000,12 @@ getMapManager() const
     return mapMan;
 }
 
+SurfaceSampler* Crusta::
+getSurfaceSampler() const
+{
+    return surfaceSampler;
+}
+
 
 void Crusta::
 frame()
@@ -846,29 +1077,42 @@ CRUSTA_DEBUG(8, CRUSTA_DEBUG_OUT <<
 
     //let the map manager update all the mapping stuff
     mapMan->frame();
+
+    //advance the data sampling queries
+    surfaceSampler->frame();
 }
 
-struct DistanceToEyeSorter
+void Crusta::
+prepareSharedSurface(GLContextData& contextData, SurfaceApproximation& surface)
 {
-    DistanceToEyeSorter(SurfaceApproximation* approx, const Geometry::Point<double,3>& eye) :
-        surface(approx), eyePosition(eye)
-    {}
-    void sortVisibles()
+    Threads::Mutex::Lock lock(sharedSurfaceMutex);
+
+    //only the first view of a frame traverses the terrain trees
+    if (sharedSurfaceStamp != CURRENT_FRAME)
     {
-        std::sort(surface->visibles.begin(), surface->visibles.end(), *this);
+        QuadTerrain::Frusta frusta;
+        QuadTerrain::getNodeFrusta(contextData, frusta);
+
+        sharedSurface.clear();
+        for (RenderPatches::const_iterator it=renderPatches.begin();
+             it!=renderPatches.end(); ++it)
+        {
+            (*it)->prepareDisplay(frusta, sharedSurface);
+        }
+        sharedSurfaceStamp = CURRENT_FRAME;
     }
 
-    bool operator()(int i, int j)
+    //filter the shared visible set against the current view only
+    FrustumVisibility visibility;
+    visibility.frusta.push_back(QuadTerrain::getViewFrustum(contextData));
+
+    size_t numVisibles = sharedSurface.numVisibles();
+    for (size_t i=0; i<numVisibles; ++i)
     {
-        double distI = Geometry::dist(eyePosition,
-                                      surface->nodes[i].node->boundingCenter);
-        double distJ = Geometry::dist(eyePosition,
-                                      surface->nodes[j].node->boundingCenter);
-        return distI > distJ;
+        if (visibility.evaluate(sharedSurface.visibleNode(i)))
+            surface.add(sharedSurface.visible(i), true);
     }
-    SurfaceApproximation* surface;
-    Geometry::Point<double,3> eyePosition;
-};
+}
 
 void Crusta::
 display(GLContextData& contextData)
@@ -891,38 +1135,50 @@ display(GLContextData& contextData)
 //- prepare the surface approximation and renderable representation
     SurfaceApproximation surface;
 
-    //generate the terrain representation
-    for (RenderPatches::const_iterator it=renderPatches.begin();
-         it!=renderPatches.end(); ++it)
+    if (SETTINGS->lodSharedCut)
     {
-        (*it)->prepareDisplay(contextData, surface);
+        //reuse the cut computed for all the views of this node
+        prepareSharedSurface(contextData, surface);
         CHECK_GLA
     }
+    else
+    {
+        //generate the terrain representation
+        for (RenderPatches::const_iterator it=renderPatches.begin();
+             it!=renderPatches.end(); ++it)
+        {
+            (*it)->prepareDisplay(contextData, surface);
+            CHECK_GLA
+        }
+    }
 
     //sort the visible tiles with respect to the distance to the camera
     Geometry::Point<double,3> eyePosition =
         Vrui::getDisplayState(contextData).viewer->getHeadPosition();
     eyePosition =
         Vrui::getInverseNavigationTransformation().transform(eyePosition);
-    DistanceToEyeSorter sorter(&surface, eyePosition);
-    sorter.sortVisibles();
+    surface.sortVisibles(eyePosition);
 
 statsMan.extractTileStats(surface);
 
 CRUSTA_DEBUG(9, CRUSTA_DEBUG_OUT <<
-"Number of nodes to render: " << surface.visibles.size() << "\n";)
+"Number of nodes to render: " << surface.numVisibles() << "\n";)
 
     GLint activeTexture;
     glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
     glPushAttrib(GL_TEXTURE_BIT);
 
     //update the map data
+    mapMan->updateLineCoverage(surface);
 ///\todo integrate properly (VIS 2010)
     if (SETTINGS->lineDecorated)
     {
         mapMan->updateLineData(surface);
+        mapMan->updateAreaCoverage(surface);
         CHECK_GLA
     }
+    else
+        mapMan->updateLineVertices(surface);
 
 //- draw the current terrain and map data
     //bind the colormap texture
@@ -12,6 +12,7 @@
 #include <crusta/LightingShader.h>
 #include <crusta/map/Shape.h>
 #include <crusta/QuadCache.h>
+#include <crusta/SurfaceApproximation.h>
 #include <crusta/SurfacePoint.h>
 #include <crusta/LightSettings.h>
 
@@ -37,7 +38,9 @@ class CacheBuffer;
 class MapManager;
 class NodeData;
 class QuadTerrain;
+struct RayBatchWorker;
 class SceneGraphViewer;
+class SurfaceSampler;
 
 struct CrustaGlData : public GLObject::DataItem
 {
@@ -65,6 +68,8 @@ class Crusta : public GLObject
 {
 public:
     typedef std::vector<std::string> Strings;
+    typedef std::vector<Geometry::Ray<double,3> > Rays;
+    typedef std::vector<SurfacePoint> SurfacePoints;
     Crusta(const std::string& exePath, const std::string& resourcePath="");
     ~Crusta();
 
@@ -81,10 +86,24 @@ public:
     SurfacePoint snapToSurface(const Geometry::Point<double,3>& pos, Scalar offset=Scalar(0));
     /** intersect a ray with the crusta globe */
     SurfacePoint intersect(const Geometry::Ray<double,3>& ray) const;
+    /** intersect a ray with the crusta globe. The search for the entry patch
+        starts at the given hint, which is updated to the patch that was
+        entered. Used to exploit the coherence of consecutive rays */
+    SurfacePoint intersect(const Geometry::Ray<double,3>& ray,
+                           int& patchHint) const;
+    /** intersect a batch of rays with the crusta globe. The rays are sorted
+        into a spatially coherent order and split among several threads. The
+        rays of a thread descend the cached trees together, such that every
+        node is visited once for all the rays crossing it. The surface points
+        are returned in the order of the rays */
+    void intersect(const Rays& rays, SurfacePoints& surfacePoints) const;
 
     /** determine the coverage of a single segment with the global hierarchy */
     void segmentCoverage(const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end,
                    Shape::IntersectionFunctor& callback) const;
+    /** traverse all the nodes of the global hierarchy, as if covered by a
+        segment spanning the globe (e.g. after restoring a whole map) */
+    void globalCoverage(Shape::IntersectionFunctor& callback) const;
 
     const FrameStamp& getLastScaleStamp() const;
 
@@ -105,6 +124,8 @@ public:
     Geometry::Point<double,3> mapToUnscaledGlobe(const Geometry::Point<double,3>& pos);
 
     MapManager* getMapManager()  const;
+    /** retrieve the sampler for exact, view-independent data queries */
+    SurfaceSampler* getSurfaceSampler() const;
 
     void frame();
     void display(GLContextData& contextData);
@@ -128,8 +149,30 @@ void confirmLineCoverageRemoval(Shape* shape, Shape::ControlPointHandle cp);
 void validateLineCoverage();
 
 protected:
+    friend struct RayBatchWorker;
+
     typedef std::vector<QuadTerrain*> RenderPatches;
 
+    /** determine the extent of a ray within the elevation shells of the globe
+        and the patch it enters. Returns -1 if the ray misses the globe. The
+        search for the patch starts at the given hint, which is updated to the
+        patch that was entered */
+    int enterGlobe(const Geometry::Ray<double,3>& ray, int& patchHint,
+                   Scalar& gin, Scalar& gout) const;
+    /** determine the patch a ray moves on to when exiting a patch through the
+        given side, and the side it enters that patch through */
+    int exitPatch(int patch, int sideOut, int& sideIn) const;
+    /** intersect the given, coherently ordered, subset of a batch of rays
+        with the globe, traversing the patches and nodes with all the rays at
+        once */
+    void intersectCoherent(const Rays& rays, const size_t* indices,
+                           size_t numRays, SurfacePoints& surfacePoints) const;
+
+    /** compute the surface approximation shared by all the views of this node
+        (once per frame) and extract the part visible from the current view */
+    void prepareSharedSurface(GLContextData& contextData,
+                              SurfaceApproximation& surface);
+
     /** keep track of the last stamp at which the vertical scale was modified.
         The vertical scale affects the bounding primitives for the nodes and
         these must be updated each time the scale changes. Validity of a node's
@@ -146,6 +189,8 @@ protected:
 
     /** the mapping management component */
     MapManager* mapMan;
+    /** the view-independent data sampling component */
+    SurfaceSampler* surfaceSampler;
 
     /** the spheroid base patches used for rendering */
     RenderPatches renderPatches;
@@ -153,6 +198,14 @@ protected:
     /** the global height range */
     Scalar globalElevationRange[2];
 
+    /** conservative surface approximation for the union of all the views of
+        this node. Only used if the shared cut is enabled in the settings */
+    SurfaceApproximation sharedSurface;
+    /** frame for which the shared surface approximation was computed */
+    FrameStamp sharedSurfaceStamp;
+    /** serialize the computation of the shared surface approximation */
+    Threads::Mutex sharedSurfaceMutex;
+
     SceneGraphViewer* sceneGraphViewer;
 
     LightSettings* lightSettings;
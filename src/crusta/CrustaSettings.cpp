@@ -53,15 +53,32 @@ CrustaSettings::CrustaSettings() :
     lineDataStartCoord(0.5f * lineDataCoordStep),
     lineCoverageTexSize(TILE_RESOLUTION>>1),
 
+    // /Crusta/Map
+    mapImportFrameTime(0.005),
+    mapScaleFrameTime(0.002),
+    mapAreaOpacity(0.4f),
+    mapAreaThreads(2),
+    mapPointSize(6.0f),
+    mapAutosaveInterval(0.0),
+    mapAutosaveFile("Crusta_Autosave.cms"),
+
     // /Crusta/SurfaceProjector
     surfaceProjectorRayIntersect(true),
 
+    // /Crusta/RayBatch
+    rayBatchNumThreads(4),
+    rayBatchMinRaysPerThread(256),
+
+    // /Crusta/SurfaceSampler
+    surfaceSamplerTimeout(10.0),
+
     // /Crusta/SliceTool
     sliceToolEnable(false),
 
     // /Crusta/LOD
     lodBias(0.0),
     lodScale(1.0),
+    lodSharedCut(false),
 
     sceneGraphViewerEnabled(true)
 {
@@ -150,14 +167,34 @@ void CrustaSettings::setFromCfg()
     lineDataCoordStep = 1.0f / lineDataTexSize;
     lineDataStartCoord = 0.5f * lineDataCoordStep;
 
+    //try to extract the map settings
+    cfgFile.setCurrentSection("/Crusta/Map");
+    mapImportFrameTime = cfgFile.retrieveValue<double>("importFrameTime", mapImportFrameTime);
+    mapScaleFrameTime = cfgFile.retrieveValue<double>("scaleFrameTime", mapScaleFrameTime);
+    mapAreaOpacity = cfgFile.retrieveValue<float>("areaOpacity", mapAreaOpacity);
+    mapAreaThreads = cfgFile.retrieveValue<int>("areaThreads", mapAreaThreads);
+    mapPointSize = cfgFile.retrieveValue<float>("pointSize", mapPointSize);
+    mapAutosaveInterval = cfgFile.retrieveValue<double>("autosaveInterval", mapAutosaveInterval);
+    mapAutosaveFile = cfgFile.retrieveValue<std::string>("autosaveFile", mapAutosaveFile);
+
     //try to extract the surface projector settings
     cfgFile.setCurrentSection("/Crusta/SurfaceProjector");
     surfaceProjectorRayIntersect = cfgFile.retrieveValue<bool>("rayIntersect", surfaceProjectorRayIntersect);
 
+    //try to extract the batched ray intersection settings
+    cfgFile.setCurrentSection("/Crusta/RayBatch");
+    rayBatchNumThreads = cfgFile.retrieveValue<int>("numThreads", rayBatchNumThreads);
+    rayBatchMinRaysPerThread = cfgFile.retrieveValue<int>("minRaysPerThread", rayBatchMinRaysPerThread);
+
+    //try to extract the surface sampler settings
+    cfgFile.setCurrentSection("/Crusta/SurfaceSampler");
+    surfaceSamplerTimeout = cfgFile.retrieveValue<double>("timeout", surfaceSamplerTimeout);
+
     //try to extract the LOD settings
     cfgFile.setCurrentSection("/Crusta/LOD");
     lodBias = cfgFile.retrieveValue<float>("bias", lodBias);
     lodScale = cfgFile.retrieveValue<float>("scale", lodScale);
+    lodSharedCut = cfgFile.retrieveValue<bool>("sharedCut", lodSharedCut);
 
     //try to extract the slice tool settings
     cfgFile.setCurrentSection("/Crusta/SliceTool");
@@ -77,10 +77,42 @@ public:
     int   lineCoverageTexSize;
     ///\}
 
+    ///\{ map settings
+    /** time in seconds spent each frame turning the features parsed from an
+        imported map into shapes */
+    double mapImportFrameTime;
+    /** time in seconds spent each frame rebuilding the representations of the
+        shapes outdated by a change of the vertical scale */
+    double mapScaleFrameTime;
+    /** opacity of the fill of the polygons */
+    float mapAreaOpacity;
+    /** number of threads rasterizing the area masks of the nodes */
+    int mapAreaThreads;
+    /** size in pixels of the placemarks */
+    float mapPointSize;
+    /** interval in seconds between snapshots of the map (0 to disable) */
+    double mapAutosaveInterval;
+    /** file the periodic snapshots of the map are written to */
+    std::string mapAutosaveFile;
+    ///\}
+
     ///\{ surface projector settings
     bool surfaceProjectorRayIntersect;
     ///\}
 
+    ///\{ batched ray intersection settings
+    /** maximum number of threads used to intersect a batch of rays */
+    int rayBatchNumThreads;
+    /** minimum number of rays assigned to each thread of a batch */
+    int rayBatchMinRaysPerThread;
+    ///\}
+
+    ///\{ surface sampler settings
+    /** time in seconds after which a sample is computed from the finest data
+        available if the data for a finer level doesn't arrive */
+    double surfaceSamplerTimeout;
+    ///\}
+
     ///\{ Slice tool settings
     bool sliceToolEnable;
     ///\}
@@ -88,6 +120,10 @@ public:
     // Level of detail
     float lodBias;
     float lodScale;
+    /** compute a single conservative cut for all the views (windows and eyes)
+        of a node and reuse it for each view, instead of traversing the terrain
+        once per view */
+    bool  lodSharedCut;
 
     bool sceneGraphViewerEnabled;
     Misc::ConfigurationFile cfgFile;
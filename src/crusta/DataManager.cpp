@@ -397,14 +397,24 @@ loadRoot(Crusta* crusta, TreeIndex rootIndex, const Scope& scope)
     nodeData.layerTiles.resize(numFloatLayers);
 
     //clear the old line data
-    nodeData.lineCoverage.clear();
     nodeData.lineNumSegments = 0;
+    nodeData.lineDirtySegments.clear();
     nodeData.lineData.clear();
+    nodeData.lineVertexVersion = 0;
+    nodeData.lineVertices.clear();
+    nodeData.lineNumAreas    = 0;
+    nodeData.lineAreaVersion = 0;
+    nodeData.lineAreaPending = false;
+    nodeData.lineAreaMask.clear();
+    nodeData.lineAreaColors.clear();
 
     //initialize
     nodeData.index = rootIndex;
     nodeData.scope = scope;
 
+//- Line data
+    crusta->getMapManager()->deriveShapeCoverage(nodeData);
+
 //- Geometry data
     {
         DataIndex index(0, rootIndex);
@@ -624,12 +634,12 @@ void DataManager::streamBatchToGpu(GLContextData& contextData, Batch& batch)
 {
     batch.clear();
     //add missing nodes as much as the cache will allow
-    size_t numNodes = curSurface->visibles.size();
+    size_t numNodes = curSurface->numVisibles();
     for (; curBatchIndex < numNodes; ++curBatchIndex) {
         BatchElement batchel;
-        batchel.main = curSurface->visible(curBatchIndex);
+        batchel.main = &curSurface->visible(curBatchIndex);
         NodeGpuBuffer gpuBuf;
-        if (grabGpuBuffer(contextData, batchel.main, gpuBuf))
+        if (grabGpuBuffer(contextData, *batchel.main, gpuBuf))
         {
             //make sure the data is up to date
             streamGpuData(contextData, batchel, gpuBuf);
@@ -645,7 +655,7 @@ void DataManager::streamBatchToGpu(GLContextData& contextData, Batch& batch)
 void DataManager::ageGpuCaches(GLContextData& contextData)
 {
     //try to reset enough cache entries for the remaining nodes
-    size_t numNodes = curSurface->visibles.size() - curBatchIndex;
+    size_t numNodes = curSurface->numVisibles() - curBatchIndex;
     if (numNodes == 0) return;
     GpuCache& gpuCache = CACHE->getGpuCache(contextData);
     gpuCache.geometry.ageMRU(numNodes, LAST_FRAME);
@@ -657,7 +667,7 @@ void DataManager::ageGpuCaches(GLContextData& contextData)
 
 bool DataManager::hasBatchToStreamToGpu()
 {
-    return curBatchIndex < curSurface->visibles.size();
+    return curBatchIndex < curSurface->numVisibles();
 }
 
 
@@ -808,7 +818,8 @@ findGpuBuffer(GLContextData& contextData, const NodeMainData& main,
     for (size_t i=0; i<numFloatLayers; ++i)
         FINDGPUBUFFER(gpuBuf.layers[i], cache.layerf, DataIndex(i+1,index));
     //decorated vector art data
-    if (SETTINGS->lineDecorated && main.node->lineNumSegments!=0)
+    if (SETTINGS->lineDecorated &&
+        (main.node->lineNumSegments!=0 || main.node->lineNumAreas!=0))
     {
         //line data
         FINDGPUBUFFER(gpuBuf.lineData, cache.lineData, DataIndex(0,index));
@@ -853,7 +864,8 @@ grabGpuBuffer(GLContextData &contextData, const NodeMainData &main,
     for (size_t i=0; i<numFloatLayers; ++i)
         GRABGPUBUFFER(gpuBuf.layers[i], cache.layerf, DataIndex(i+1,index));
     //decorated vector art data
-    if (SETTINGS->lineDecorated && main.node->lineNumSegments!=0)
+    if (SETTINGS->lineDecorated &&
+        (main.node->lineNumSegments!=0 || main.node->lineNumAreas!=0))
     {
         //line data
         GRABGPUBUFFER(gpuBuf.lineData, cache.lineData, DataIndex(0,index));
@@ -880,10 +892,10 @@ void DataManager::
 streamGpuData(GLContextData& contextData, BatchElement& batchel,
               NodeGpuBuffer& gpuBuf)
 {
-    GpuCache& cache        = CACHE->getGpuCache(contextData);
-    NodeMainData& main     = batchel.main;
-    NodeGpuData&  gpu      = batchel.gpu;
-    const TreeIndex& index = main.node->index;
+    GpuCache& cache          = CACHE->getGpuCache(contextData);
+    const NodeMainData& main = *batchel.main;
+    NodeGpuData&  gpu        = batchel.gpu;
+    const TreeIndex& index   = main.node->index;
 
     CHECK_GLA;
 //- handle the geometry data
@@ -913,23 +925,51 @@ streamGpuData(GLContextData& contextData, BatchElement& batchel,
     }
 
     //decorated vector art requires up-to-date line data and coverage textures
-    if (SETTINGS->lineDecorated && main.node->lineNumSegments!=0)
+    if (SETTINGS->lineDecorated &&
+        (main.node->lineNumSegments!=0 || main.node->lineNumAreas!=0))
     {
     //- handle the line data
         //update data
         gpu.lineData = &gpuBuf.lineData->getData();
         bool updatedLine = false;
         if (!cache.lineData.isValid(gpuBuf.lineData)  ||
-            gpu.lineData->age < main.node->lineDataStamp)
+            gpu.lineData->age < main.node->lineDataFullStamp ||
+            gpu.lineData->age < main.node->lineAreaStamp)
         {
             //stream the line data from the main representation
+            if (!main.node->lineData.empty())
+            {
+                cache.lineData.subStream(
+                    (SubRegion)(*gpu.lineData), 0, main.node->lineData.size(),
+                    GL_RGBA, GL_FLOAT, &main.node->lineData.front());
+                CHECK_GLA;
+            }
+            //the fills of the areas are stored at the end of the line data
+            if (main.node->lineNumAreas != 0)
+            {
+                cache.lineData.subStream(
+                    (SubRegion)(*gpu.lineData),
+                    SETTINGS->lineDataTexSize - MapManager::MAX_NODE_AREAS,
+                    main.node->lineNumAreas, GL_RGBA, GL_FLOAT,
+                    &main.node->lineAreaColors.front());
+                CHECK_GLA;
+            }
+            //stamp the age of the new data
+            gpu.lineData->age = CURRENT_FRAME;
+            updatedLine = true;
+        }
+        else if (gpu.lineData->age < main.node->lineDataStamp)
+        {
+            /* only stream the modified segments. Their footprint is unchanged
+               hence the coverage map remains valid */
+            int begin = main.node->lineDataDirtyBegin;
             cache.lineData.subStream(
-                (SubRegion)(*gpu.lineData), 0, main.node->lineData.size(),
-                GL_RGBA, GL_FLOAT, &main.node->lineData.front());
+                (SubRegion)(*gpu.lineData), begin,
+                main.node->lineDataDirtyEnd - begin, GL_RGBA, GL_FLOAT,
+                &main.node->lineData[begin]);
             CHECK_GLA;
             //stamp the age of the new data
             gpu.lineData->age = CURRENT_FRAME;
-            updatedLine = true;
         }
         //validate buffer
         cache.lineData.releaseBuffer(DataIndex(0,index), gpuBuf.lineData);
@@ -939,6 +979,12 @@ streamGpuData(GLContextData& contextData, BatchElement& batchel,
         gpu.coverage = &gpuBuf.coverage->getData();
         if (updatedLine || !cache.coverage.isValid(gpuBuf.coverage))
         {
+            //stream the area mask, the lines are rendered on top
+            if (main.node->lineNumAreas != 0)
+            {
+                cache.coverage.stream(*gpu.coverage, GL_RGBA, GL_UNSIGNED_BYTE,
+                                      &main.node->lineAreaMask.front());
+            }
             //render the new coverage into the coverage texture
             CHECK_GLA;
             cache.coverage.beginRender(*gpu.coverage);
@@ -975,14 +1021,26 @@ loadChild(Crusta* crusta, NodeMainData& parent,
     child.layers.resize(numFloatLayers, NULL);
 
     //clear the old line data
-    childNode.lineCoverage.clear();
     childNode.lineNumSegments = 0;
+    childNode.lineDirtySegments.clear();
     childNode.lineData.clear();
+    childNode.lineVertexVersion = 0;
+    childNode.lineVertices.clear();
+    childNode.lineNumAreas    = 0;
+    childNode.lineAreaVersion = 0;
+    childNode.lineAreaPending = false;
+    childNode.lineAreaMask.clear();
+    childNode.lineAreaColors.clear();
 
     //initialize
     childNode.index     = parentNode.index.down(which);
     childNode.scope     = childScopes[which];
 
+//- Line data
+    /* derive the coverage of the shapes here, such that the render traversal
+       doesn't have to propagate it down when refining */
+    crusta->getMapManager()->deriveShapeCoverage(childNode);
+
 //- Geometry data
     generateGeometry(crusta, &childNode, child.geometry);
 
@@ -1076,24 +1134,12 @@ sampleParentBase(int child, PixelType range[2], PixelType* dst,
         PixelType*       wbase = dst + y*2*TILE_RESOLUTION;
         const PixelType* rbase = src + y*TILE_RESOLUTION + offsets[child];
 
-        for (int x=0; x<halfSize[0]; ++x, wbase+=2, ++rbase)
+        po::rowRange(rbase, halfSize[0], nodata, range);
+        po::expandRow(rbase, halfSize[0], nodata, wbase);
+        if (y<halfSize[1]-1)
         {
-            range[0] = po::minimum(range[0], rbase[0], nodata);
-            range[1] = po::maximum(range[1], rbase[0], nodata);
-
-            wbase[0] = rbase[0];
-            if (x<halfSize[0]-1)
-                wbase[1] = po::average(rbase[0], rbase[1], nodata);
-            if (y<halfSize[1]-1)
-            {
-                wbase[TILE_RESOLUTION] =
-                    po::average(rbase[0], rbase[TILE_RESOLUTION], nodata);
-            }
-            if (x<halfSize[0]-1 && y<halfSize[1]-1)
-            {
-                wbase[TILE_RESOLUTION+1] = po::average(rbase[0], rbase[1],
-                    rbase[TILE_RESOLUTION], rbase[TILE_RESOLUTION+1], nodata);
-            }
+            po::expandRowPair(rbase, rbase+TILE_RESOLUTION, halfSize[0],
+                              nodata, wbase+TILE_RESOLUTION);
         }
     }
 }
@@ -1164,6 +1210,10 @@ sourceDem(const NodeData* const parent,
                 childHeight[i] = demNodata;
         }
     }
+
+    /* build the acceleration structure of the ray intersections here, such
+       that the concurrent intersections only ever read it */
+    child->buildHeightPyramid(childHeight);
 }
 
 void DataManager::
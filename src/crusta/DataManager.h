@@ -65,7 +65,8 @@ public:
     /** the relevant main and gpu memory data for a tile */
     struct BatchElement
     {
-        NodeMainData main;
+        /** points into the surface approximation being streamed */
+        const NodeMainData* main;
         NodeGpuData  gpu;
     };
     typedef std::vector<BatchElement> Batch;
@@ -23,13 +23,25 @@ compute(const NodeData& node)
 {
     double weight = 2.0;
 
-    float lod;
-    if (!SETTINGS->sliceToolEnable) {
-        lod = frustum.calcProjectedRadius(node.boundingCenter,
-                                          node.boundingRadius);
-    } else {
-        lod = std::max(frustum.calcProjectedRadius(node.getEffectiveBoundingCenter(), node.boundingRadius),
-                       frustum.calcProjectedRadius(node.boundingCenter, node.boundingRadius));
+    float lod = -1.0f;
+    for (Frusta::const_iterator it=frusta.begin(); it!=frusta.end(); ++it)
+    {
+        const GLFrustum<double>& frustum = *it;
+        float flod;
+        if (!SETTINGS->sliceToolEnable) {
+            flod = frustum.calcProjectedRadius(node.boundingCenter,
+                                               node.boundingRadius);
+        } else {
+            flod = std::max(frustum.calcProjectedRadius(node.getEffectiveBoundingCenter(), node.boundingRadius),
+                            frustum.calcProjectedRadius(node.boundingCenter, node.boundingRadius));
+        }
+        //a negative projection means the eye is inside the bounding sphere
+        if (flod < 0)
+        {
+            lod = flod;
+            break;
+        }
+        lod = std::max(lod, flod);
     }
     if (lod < 0)
         lod = Math::Constants<float>::max;
@@ -1,6 +1,8 @@
 #ifndef _FocusViewEvaluator_H_
 #define _FocusViewEvaluator_H_
 
+#include <vector>
+
 #include <crusta/LodEvaluator.h>
 
 #include <crusta/vrui.h>
@@ -10,16 +12,19 @@ namespace crusta {
 /**
     Specialized evaluator that considers coverage of the screen projection and
     location of a point of focus in determining a scope's level-of-detail (LOD)
-    value.
+    value. When several frusta are specified the projection that demands the
+    most refinement determines the LOD value.
 */
 class FocusViewEvaluator : public LodEvaluator
 {
 public:
+    typedef std::vector<GLFrustum<double> > Frusta;
+
     /** update the focus area from the display center */
     void setFocusFromDisplay();
 
-    /** the specification of the viewing parameters */
-    GLFrustum<double> frustum;
+    /** the specification of the viewing parameters of all the views */
+    Frusta frusta;
     /** the position of the point of focus */
     Geometry::Point<double, 3> focusCenter;
     /** the radius of the focus area */
@@ -8,6 +8,17 @@ namespace crusta {
 
 bool FrustumVisibility::
 evaluate(const NodeData& node)
+{
+    for (Frusta::const_iterator it=frusta.begin(); it!=frusta.end(); ++it)
+    {
+        if (evaluateFrustum(*it, node))
+            return true;
+    }
+    return false;
+}
+
+bool FrustumVisibility::
+evaluateFrustum(const GLFrustum<double>& frustum, const NodeData& node)
 {
     if (!SETTINGS->sliceToolEnable)
     {
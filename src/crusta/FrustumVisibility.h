@@ -1,6 +1,8 @@
 #ifndef _FrustumVisibility_H_
 #define _FrustumVisibility_H_
 
+#include <vector>
+
 #include <crusta/VisibilityEvaluator.h>
 
 #include <crusta/vrui.h>
@@ -8,18 +10,26 @@
 namespace crusta {
 
 /**
-    Specialization of the VisibilityEvaluator that considers a viewing frustum
-    to determine the visibility of a scope.
+    Specialization of the VisibilityEvaluator that considers a set of viewing
+    frusta to determine the visibility of a scope. A scope is visible if it
+    intersects any of the frusta.
 */
 class FrustumVisibility : public VisibilityEvaluator
 {
 public:
-    /** the specification of the viewing parameters */
-    GLFrustum<double> frustum;
+    typedef std::vector<GLFrustum<double> > Frusta;
+
+    /** the specification of the viewing parameters of all the views */
+    Frusta frusta;
 
 //- inherited from VisibilityEvaluator
 public:
     virtual bool evaluate(const NodeData& node);
+
+protected:
+    /** evaluate the visibility of a node with respect to a single frustum */
+    bool evaluateFrustum(const GLFrustum<double>& frustum,
+                         const NodeData& node);
 };
 
 } //namespace crusta
@@ -1,6 +1,8 @@
 #ifndef _IdGenerator_H_
 #define _IdGenerator_H_
 
+#include <algorithm>
+#include <utility>
 
 #include <crustacore/basics.h>
 
@@ -53,6 +55,64 @@ public:
         freeIds.push_back(id);
     }
 
+    /** grab specific ids at once (e.g. to restore saved ids). The ids that
+        are already in use, or requested more than once, aren't claimed,
+        which is flagged in 'claimed'. The requested and the available ids
+        are sorted and matched in a single pass */
+    void claim(const std::vector<UnsignedInteger>& ids,
+               std::vector<bool>& claimed)
+    {
+        typedef std::pair<UnsignedInteger, size_t> Request;
+        typedef typename std::vector<UnsignedInteger>::const_iterator FreeIt;
+
+        //visit the requested ids in ascending order
+        std::vector<Request> requests(ids.size());
+        for (size_t i=0; i<ids.size(); ++i)
+            requests[i] = Request(ids[i], i);
+        std::sort(requests.begin(), requests.end());
+        std::sort(freeIds.begin(), freeIds.end());
+
+        claimed.assign(ids.size(), false);
+        std::vector<UnsignedInteger> remaining;
+        remaining.reserve(freeIds.size());
+        FreeIt free = freeIds.begin();
+        for (size_t i=0; i<requests.size(); ++i)
+        {
+            const UnsignedInteger id = requests[i].first;
+            if (id>=invalid || (i>0 && id==requests[i-1].first))
+                continue;
+
+            if (id >= sequence)
+            {
+                //skip ahead, making the ids in between available
+                for (; sequence<id; ++sequence)
+                    remaining.push_back(sequence);
+                ++sequence;
+                claimed[requests[i].second] = true;
+                continue;
+            }
+
+            //keep the available ids preceding the requested one
+            for (; free!=freeIds.end() && *free<id; ++free)
+                remaining.push_back(*free);
+            if (free!=freeIds.end() && *free==id)
+            {
+                ++free;
+                claimed[requests[i].second] = true;
+            }
+        }
+        remaining.insert(remaining.end(), free, FreeIt(freeIds.end()));
+        freeIds.swap(remaining);
+    }
+
+    /** make all the ids available again.
+        \note all the ids generated so far must no longer be in use */
+    void reset()
+    {
+        sequence = UnsignedInteger(0);
+        freeIds.clear();
+    }
+
 protected:
     const UnsignedInteger max;
     const UnsignedInteger invalid;
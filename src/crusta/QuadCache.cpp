@@ -88,7 +88,7 @@ initContext(GLContextData& contextData) const
                            GL_RGBA32F_ARB, GL_LINEAR);
     gpuCache.coverage.init("GpuCoverage", SETTINGS->cacheGpuCoverageSize,
                            SETTINGS->lineCoverageTexSize,
-                           GL_RG, GL_NEAREST);
+                           GL_RGBA, GL_NEAREST);
 
     contextData.addDataItem(this, glData);
 }
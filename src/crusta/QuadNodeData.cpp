@@ -21,9 +21,16 @@ Tile() :
 
 NodeData::
 NodeData() :
-    lineInheritCoverage(false), lineNumSegments(0), lineDataStamp(0),
+    lineCoverageStamp(0), lineCoverageMinStamp(0), lineInheritStamp(0),
+    lineCoverageDirty(true), lineCoverageDeferred(true),
+    lineCoveragePending(false), lineNumSegments(0), lineDataStamp(0),
+    lineDataFullStamp(0), lineDataDirtyBegin(0), lineDataDirtyEnd(0),
+    lineInheritDataStamp(0), lineVertexVersion(0), lineVertexStamp(0),
+    lineNumAreas(0), lineAreaVersion(0), lineAreaCoverageStamp(0),
+    lineAreaStamp(0), lineAreaPending(false),
     index(TreeIndex::invalid),
-    boundingAge(0), boundingCenter(0,0,0), boundingRadius(0)
+    boundingAge(0), boundingCenter(0,0,0), boundingRadius(0),
+    boundingAxis(0,0,1), boundingSpread(0)
 {
     centroid[0] = centroid[1] = centroid[2] = DemHeight::Type(0.0);
     elevationRange[0] =  Math::Constants<DemHeight::Type>::max;
@@ -39,26 +46,24 @@ computeBoundingSphere(Scalar radius, Scalar verticalScale)
     DemHeight::Type avgElevation = (range[0] + range[1]);
     avgElevation                *= DemHeight::Type(0.5)* verticalScale;
 
-    boundingCenter = scope.getCentroid(radius + avgElevation);
+    Scope::Scalar centerRadius = Scope::Scalar(radius) + avgElevation;
+    boundingCenter[0] = boundingAxis[0] * centerRadius;
+    boundingCenter[1] = boundingAxis[1] * centerRadius;
+    boundingCenter[2] = boundingAxis[2] * centerRadius;
 
+    /* the farthest corners of the scope extruded to the lowest and highest
+       elevation are those at the largest angle from the axis. The squared
+       distance of a corner d*a from the center u*b is (a-b)^2 + a*b*|d-u|^2,
+       which doesn't suffer from cancellation for small nodes */
     boundingRadius = Scope::Scalar(0);
-    for (int i=0; i<4; ++i)
+    for (int j=0; j<2; ++j)
     {
-        for (int j=0; j<2; ++j)
-        {
-            Scope::Vertex corner = scope.corners[i];
-            Scope::Scalar norm   = Scope::Scalar(radius);
-            norm += range[j]*verticalScale;
-            norm /= sqrt(corner[0]*corner[0] + corner[1]*corner[1] +
-                         corner[2]*corner[2]);
-            Scope::Vertex toCorner;
-            toCorner[0] = corner[0]*norm - boundingCenter[0];
-            toCorner[1] = corner[1]*norm - boundingCenter[1];
-            toCorner[2] = corner[2]*norm - boundingCenter[2];
-            norm = sqrt(toCorner[0]*toCorner[0] + toCorner[1]*toCorner[1] +
-                        toCorner[2]*toCorner[2]);
-            boundingRadius = std::max(boundingRadius, norm);
-        }
+        Scope::Scalar shellRadius = Scope::Scalar(radius);
+        shellRadius += range[j]*verticalScale;
+        Scope::Scalar toShell = shellRadius - centerRadius;
+        Scope::Scalar sqrDist = toShell*toShell +
+                                shellRadius*centerRadius*boundingSpread;
+        boundingRadius = std::max(boundingRadius, sqrt(sqrDist));
     }
 
     //stamp the current bounding specification
@@ -79,6 +84,22 @@ init(Scalar radius, Scalar verticalScale)
     centroid[1] = scopeCentroid[1];
     centroid[2] = scopeCentroid[2];
 
+    //derive the parameters of the bounding sphere that are independent of scale
+    boundingAxis = Geometry::Vector<double,3>(scopeCentroid[0],
+                                              scopeCentroid[1],
+                                              scopeCentroid[2]);
+    boundingAxis.normalize();
+    boundingSpread = Scope::Scalar(0);
+    for (int i=0; i<4; ++i)
+    {
+        Geometry::Vector<double,3> corner(scope.corners[i][0],
+                                          scope.corners[i][1],
+                                          scope.corners[i][2]);
+        corner.normalize();
+        corner -= boundingAxis;
+        boundingSpread = std::max(boundingSpread, corner.sqr());
+    }
+
     //update the bounding sphere
     computeBoundingSphere(radius, verticalScale);
 }
@@ -129,6 +150,66 @@ getLayerData(const LayerDataf::Type& test) const
         return test;
 }
 
+void NodeData::
+buildHeightPyramid(const DemHeight::Type* heights)
+{
+    static const int numCells = TILE_RESOLUTION-1;
+
+    size_t size = 0;
+    for (int res=numCells>>1; res>0; res>>=1)
+        size += res*res;
+    heightPyramid.resize(size);
+
+    //finest level: maximum over the 3x3 vertices of each 2x2 block of cells
+    DemHeight::Type* dst = &heightPyramid[0];
+    int res = numCells>>1;
+    for (int y=0; y<res; ++y)
+    {
+        for (int x=0; x<res; ++x, ++dst)
+        {
+            const DemHeight::Type* base = heights + 2*y*TILE_RESOLUTION + 2*x;
+            DemHeight::Type h = getHeight(base[0]);
+            for (int j=0; j<3; ++j)
+            {
+                for (int i=0; i<3; ++i)
+                    h = std::max(h, getHeight(base[j*TILE_RESOLUTION + i]));
+            }
+            *dst = h;
+        }
+    }
+
+    //coarser levels: maximum over 2x2 blocks of the finer level
+    const DemHeight::Type* src = &heightPyramid[0];
+    for (int srcRes=res, dstRes=res>>1; dstRes>0; srcRes=dstRes, dstRes>>=1)
+    {
+        for (int y=0; y<dstRes; ++y)
+        {
+            const DemHeight::Type* s = src + 2*y*srcRes;
+            for (int x=0; x<dstRes; ++x, ++dst, s+=2)
+            {
+                *dst = std::max(std::max(s[0],      s[1]),
+                                std::max(s[srcRes], s[srcRes+1]));
+            }
+        }
+        src += srcRes*srcRes;
+    }
+}
+
+DemHeight::Type NodeData::
+getBlockMaxHeight(int level, int cellX, int cellY) const
+{
+    static const int numCells = TILE_RESOLUTION-1;
+    assert(level>0 && !heightPyramid.empty());
+
+    size_t offset = 0;
+    for (int l=1; l<level; ++l)
+        offset += (numCells>>l) * (numCells>>l);
+
+    int res = numCells>>level;
+    assert(res > 0);
+    return heightPyramid[offset + (cellY>>level)*res + (cellX>>level)];
+}
+
 
 SubRegion::
 SubRegion()
@@ -165,20 +246,10 @@ std::ostream& operator<<(std::ostream&os, const SubRegion& sub)
 std::ostream& operator<<(std::ostream& os,
                          const NodeData::ShapeCoverage& cov)
 {
-    for (NodeData::ShapeCoverage::const_iterator lit=cov.begin();
-         lit!=cov.end(); ++lit)
+    for (NodeData::ShapeCoverage::const_iterator sit=cov.begin();
+         sit!=cov.end(); ++sit)
     {
-        os << "-line " << lit->first->getId() << " XX ";
-        const Shape::ControlPointHandleList& handles = lit->second;
-        for (Shape::ControlPointHandleList::const_iterator
-             hit=handles.begin(); hit!=handles.end(); ++hit)
-        {
-            if (hit==handles.begin())
-                os << *hit;
-            else
-                os << " | " << *hit;
-        }
-        os << "\n";
+        os << "-line " << sit->shape->getId() << " XX " << sit->start << "\n";
     }
 
     return os;
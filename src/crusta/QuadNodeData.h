@@ -1,11 +1,9 @@
 #ifndef _QuadNodeData_H_
 #define _QuadNodeData_H_
 
-#include <map>
-
 #include <crustacore/DemHeight.h>
 #include <crustacore/LayerData.h>
-#include <crusta/map/Shape.h>
+#include <crusta/map/SegmentIndex.h>
 #include <crustacore/TextureColor.h>
 #include <crustacore/TileIndex.h>
 #include <crustacore/TreeIndex.h>
@@ -35,13 +33,15 @@ struct NodeData
     };
     typedef std::vector<Tile> Tiles;
 
-    typedef std::map<const Shape*, Shape::ControlPointHandleList>
-        ShapeCoverage;
+    /** the segments of the shapes overlapping the node */
+    typedef SegmentIndex::Segments ShapeCoverage;
 
     NodeData();
 
     /** compute the bounding sphere. It is dependent on the vertical scale,
-        so this method is a convinient API for such updates */
+        so this method is a convinient API for such updates. Only the scale
+        dependent terms are evaluated, in constant time, from the parameters
+        derived by init */
     void computeBoundingSphere(Scalar radius, Scalar verticalScale);
 
     /** get effective bounding radius considering translations by the slicing tool **/
@@ -60,13 +60,68 @@ struct NodeData
     /** get the layer data value if it is valid or the default */
     LayerDataf::Type getLayerData(const LayerDataf::Type& test) const;
 
+    /** build the maximum height pyramid from the node's height data */
+    void buildHeightPyramid(const DemHeight::Type* heights);
+    /** get the maximum height of the 2^level x 2^level block of cells that
+        contains the given cell. The pyramid must have been built */
+    DemHeight::Type getBlockMaxHeight(int level, int cellX, int cellY) const;
+
 ///\todo integrate me properly into the caching scheme (VIS 2010)
 std::vector<int> lineCoverageOffsets;
 ShapeCoverage    lineCoverage;
-bool             lineInheritCoverage;
+/** version of the segment index the coverage was derived from */
+SegmentIndex::Version lineCoverageStamp;
+/** oldest version of the segment index a deferred derivation of the coverage
+    may be based on */
+SegmentIndex::Version lineCoverageMinStamp;
+/** latest modification of the segment index the coverage of the cached
+    subtree might not reflect (0 if none) */
+SegmentIndex::Version lineInheritStamp;
+/** flags that the coverage must be derived again from the segment index */
+bool             lineCoverageDirty;
+/** flags that the derivation can be left to the background (the node is
+    rendered without its coverage in the meantime) */
+bool             lineCoverageDeferred;
+/** flags that a deferred derivation is in progress */
+bool             lineCoveragePending;
 int              lineNumSegments;
+/** frame at which the line data was last modified */
 FrameStamp       lineDataStamp;
+/** frame at which the line data was last generated in full */
+FrameStamp       lineDataFullStamp;
+/** range of the line data modified since it was generated in full */
+int              lineDataDirtyBegin;
+int              lineDataDirtyEnd;
+/** starting control points of the segments whose line data is outdated */
+std::vector<const Shape::ControlPoint*> lineDirtySegments;
+/** latest modification of the shapes the line data of the cached subtree
+    might not reflect (0 if none) */
+FrameStamp       lineInheritDataStamp;
 Colors           lineData;
+/** vertices (relative to the centroid) of the segments of the coverage, for
+    the undecorated rendering of the lines */
+std::vector<Geometry::Point<float,3> > lineVertices;
+/** colors of the vertices of the visible and hidden fragments */
+Colors           lineVertexColors;
+Colors           lineVertexDimColors;
+/** version of the coverage the vertices were built from (0 if none) */
+SegmentIndex::Version lineVertexVersion;
+/** frame at which the vertices were built */
+FrameStamp       lineVertexStamp;
+/** RGBA coverage mask of the areas overlapping the node. The line data
+    offsets of their fills are stored in the blue and alpha channels */
+std::vector<uint8_t> lineAreaMask;
+/** fill colors of the areas overlapping the node */
+Colors           lineAreaColors;
+int              lineNumAreas;
+/** version of the areas the mask was rasterized from (0 if none) */
+uint64_t         lineAreaVersion;
+/** version of the coverage the outlines of the mask were taken from */
+SegmentIndex::Version lineAreaCoverageStamp;
+/** frame at which the mask was last modified */
+FrameStamp       lineAreaStamp;
+/** flags that a rasterization of the mask is in progress */
+bool             lineAreaPending;
 
     /** uniquely characterize this node's "position" in the tree. The tree
      index must correlate with the global hierarchy of the data
@@ -80,12 +135,23 @@ Colors           lineData;
     Scope::Vertex boundingCenter;
     /** radius of a sphere containing the node */
     Scope::Scalar boundingRadius;
+    /** direction of the center of the bounding sphere (independent of the
+        vertical scale) */
+    Geometry::Vector<double,3> boundingAxis;
+    /** largest squared distance between the axis and the directions of the
+        corners of the scope (independent of the vertical scale) */
+    Scope::Scalar boundingSpread;
 
     /** centroid of the node geometry on the average elevation shell */
     Geometry::Point<float,3> centroid;
     /** the range of the elevation values */
     DemHeight::Type elevationRange[2];
 
+    /** maximum heights over aligned blocks of 2^l x 2^l cells, for l from 1
+        (finest) up to a single block covering the node. Used to accelerate
+        ray intersections and built when the height data is sourced */
+    std::vector<DemHeight::Type> heightPyramid;
+
     /** indices for the DEM tiles in the database */
     Tile demTile;
     /** indices for the Color tiles in the database */
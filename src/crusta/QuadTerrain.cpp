@@ -9,6 +9,7 @@
 #include <crusta/Homography.h>
 #include <crusta/LightingShader.h>
 #include <crusta/map/MapManager.h>
+#include <crusta/map/Polygon.h>
 #include <crusta/map/Polyline.h>
 #include <crusta/QuadCache.h>
 #include <crusta/Triangle.h>
@@ -19,6 +20,7 @@
 #include <crusta/vrui.h>
 
 #define DO_RELATIVE_LEAF_TRIANGLE_INTERSECTIONS 1
+#define DO_HEIGHT_PYRAMID_CELL_SKIPPING 1
 
 #if DEBUG_INTERSECT_CRAP
 #define DEBUG_INTERSECT_SIDES 0
@@ -42,6 +44,15 @@ static const size_t NUM_GEOMETRY_INDICES =
 static const float TEXTURE_COORD_START = TILE_TEXTURE_COORD_STEP * 0.5;
 static const float TEXTURE_COORD_END   = 1.0 - TEXTURE_COORD_START;
 
+/** the sibling a ray moves on to when exiting a child through a side, and the
+    side it enters the sibling through, indexed by child and exit side. -1 for
+    exits from the parent */
+static const int NEXT_CHILD[4][4][2] = {
+    { { 2, 2}, {-1,-1}, {-1,-1}, { 1, 1} },
+    { { 3, 2}, { 0, 3}, {-1,-1}, {-1,-1} },
+    { {-1,-1}, {-1,-1}, { 0, 0}, { 3, 1} },
+    { {-1,-1}, { 2, 3}, { 1, 0}, {-1,-1} } };
+
 bool QuadTerrain::displayDebuggingBoundingSpheres = false;
 bool QuadTerrain::displayDebuggingGrid            = false;
 
@@ -98,6 +109,120 @@ CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT <<
 "Scope exit param: " << param << " side: " << side << "\n";)
 }
 
+/** number of levels of the leaf height pyramids (excluding the cells) */
+static const int NUM_HEIGHT_PYRAMID_LEVELS = 6;
+/** tolerance for the single precision storage of the leaf geometry */
+static const double HEIGHT_PYRAMID_SKIP_EPSILON = 1.0;
+
+static QuadTerrain::Point
+getGridVertex(const NodeMainData& nodeData, int x, int y)
+{
+    const Vertex::Position& p =
+        nodeData.geometry[y*TILE_RESOLUTION + x].position;
+    const Geometry::Point<float,3>& c = nodeData.node->centroid;
+    return QuadTerrain::Point(double(p[0]) + double(c[0]),
+                              double(p[1]) + double(c[1]),
+                              double(p[2]) + double(c[2]));
+}
+
+/** compute the minimum distance to the globe center of the ray points within
+    the parameter interval [t0,t1] */
+static double
+computeMinRadius(const QuadTerrain::Ray& ray, double t0, double t1)
+{
+    Geometry::Vector<double,3> orig(ray.getOrigin());
+    const Geometry::Vector<double,3>& dir = ray.getDirection();
+
+    double dirSqr = dir*dir;
+    double t      = dirSqr>0.0 ? -(orig*dir)/dirSqr : t0;
+    t = std::max(t0, std::min(t, t1));
+
+    return Geometry::mag(orig + t*dir);
+}
+
+/** locate the cell of the row that contains the point among the columns
+    [lo,hi] */
+static int
+locateColumn(const NodeMainData& nodeData, const QuadTerrain::Point& pos,
+             int row, int lo, int hi)
+{
+    while (lo < hi)
+    {
+        int mid = (lo+hi+1) >> 1;
+        Section column(getGridVertex(nodeData, mid, row+1),
+                       getGridVertex(nodeData, mid, row));
+        if (column.isContained(pos))
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return lo;
+}
+
+/** locate the cell of the column that contains the point among the rows
+    [lo,hi] */
+static int
+locateRow(const NodeMainData& nodeData, const QuadTerrain::Point& pos,
+          int column, int lo, int hi)
+{
+    while (lo < hi)
+    {
+        int mid = (lo+hi+1) >> 1;
+        Section row(getGridVertex(nodeData, column,   mid),
+                    getGridVertex(nodeData, column+1, mid));
+        if (row.isContained(pos))
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return lo;
+}
+
+/** find the coarsest block of leaf cells containing the current cell that the
+    ray segment inside it passes entirely above. Returns the level of the block
+    (0 if none) along with the exit parameter and side of the block */
+static int
+computeSkipBlock(const NodeMainData& leafData, const QuadTerrain::Ray& ray,
+                 double param, double verticalScale, int cellX, int cellY,
+                 double& blockParam, int& blockSide)
+{
+    const NodeData& leaf = *leafData.node;
+    double entryRadius   = Geometry::mag(Geometry::Vector<double,3>(ray(param)));
+
+    int skipLevel = 0;
+    for (int level=1; level<=NUM_HEIGHT_PYRAMID_LEVELS; ++level)
+    {
+        double top = SETTINGS->globeRadius + HEIGHT_PYRAMID_SKIP_EPSILON +
+                     verticalScale*leaf.getBlockMaxHeight(level, cellX, cellY);
+        //a block the ray enters below its top can't be skipped, nor any coarser
+        if (entryRadius <= top)
+            break;
+
+        int size = 1<<level;
+        int bx   = cellX & ~(size-1);
+        int by   = cellY & ~(size-1);
+        Scope blockScope(getGridVertex(leafData, bx,      by),
+                         getGridVertex(leafData, bx+size, by),
+                         getGridVertex(leafData, bx,      by+size),
+                         getGridVertex(leafData, bx+size, by+size));
+        double exitParam;
+        int    exitSide = -1;
+        computeExit(ray, param, blockScope, exitParam, exitSide);
+        if (exitParam == Math::Constants<double>::max ||
+            computeMinRadius(ray, param, exitParam) <= top)
+        {
+            break;
+        }
+
+        skipLevel  = level;
+        blockParam = exitParam;
+        blockSide  = exitSide;
+    }
+
+    return skipLevel;
+}
+
+
 QuadTerrain::
 QuadTerrain(uint8_t patch, const Scope& scope, Crusta* iCrusta) :
     CrustaComponent(iCrusta), rootIndex(patch)
@@ -129,6 +254,13 @@ CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT << "\n\nIntersecting Geometry::Ray<double,3> w
     return intersectNode(getRootBuffer(), ray, tin, sin, tout, sout, gout);
 }
 
+void QuadTerrain::
+intersect(BatchRays& rays) const
+{
+    if (!rays.empty())
+        intersectNode(getRootBuffer(), rays);
+}
+
 
 void QuadTerrain::
 segmentCoverage(const QuadTerrain::Point& start, const QuadTerrain::Point& end,
@@ -137,15 +269,18 @@ segmentCoverage(const QuadTerrain::Point& start, const QuadTerrain::Point& end,
     segmentCoverage(getRootBuffer(), start, end, callback);
 }
 
-
 void QuadTerrain::
-renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
+globalCoverage(Shape::IntersectionFunctor& callback) const
 {
-    typedef Homography::HVector HVector;
+    globalCoverage(getRootBuffer(), callback);
+}
 
-    NodeData& node = *nodeData.node;
 
-    //compute projection matrix
+Homography::Projective QuadTerrain::
+computeLineCoverageProjection(const NodeData& node)
+{
+    typedef Homography::HVector HVector;
+
     Homography toNormalized;
 
     //destinations are fll, flr, ful, bll, bur
@@ -211,6 +346,17 @@ renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
                            HVector(srcs[4][0], srcs[4][1], srcs[4][2], 1));
 
     toNormalized.computeProjective();
+    return toNormalized.getProjective();
+}
+
+void QuadTerrain::
+renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
+{
+    const NodeData& node = *nodeData.node;
+
+    //compute projection matrix
+    Homography::Projective toNormalized =
+        computeLineCoverageProjection(node);
 
     //switch to the line coverage rendering shader
 ///\todo this is bad. Just to test GlewObject
@@ -222,7 +368,7 @@ renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
     for (int j=0; j<4; ++j)
     {
         for (int i=0; i<4; ++i)
-            projMat[j*4+i] = toNormalized.getProjective().getMatrix()(i,j);
+            projMat[j*4+i] = toNormalized.getMatrix()(i,j);
     }
     glUniformMatrix4fv(glItem->lineCoverageTransformUniform, 1, false, projMat);
 
@@ -233,6 +379,10 @@ renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
 
     glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_COLOR_BUFFER_BIT);
 
+    //preserve the area mask
+    if (node.lineNumAreas != 0)
+        glColorMask(GL_TRUE, GL_TRUE, GL_FALSE, GL_FALSE);
+
     //clear the old coverage map
     glEnable(GL_SCISSOR_TEST);
     glClearColor(0.0, 0.0, 0.0, 0.0);
@@ -295,12 +445,12 @@ renderLineCoverageMap(GLContextData& contextData, const MainData& nodeData)
 }
 
 
+/** compute the navigational frustum of a view rendered to a viewport of the
+    given size in pixels */
 static GLFrustum<Scalar>
-getFrustumFromVrui(GLContextData& contextData)
+getFrustumFromViewSpec(const Vrui::ViewSpecification& viewSpec,
+                       int viewportWidth, int viewportHeight)
 {
-    const Vrui::DisplayState& displayState = Vrui::getDisplayState(contextData);
-    Vrui::ViewSpecification viewSpec =
-        displayState.window->calcViewSpec(displayState.eyeIndex);
     Vrui::NavTransform inv = Vrui::getInverseNavigationTransformation();
 
     GLFrustum<Scalar> frustum;
@@ -340,27 +490,83 @@ getFrustumFromVrui(GLContextData& contextData)
     /* Use the frustum near plane as the screen plane: */
     frustum.setScreenEye(planes[4], inv.transform(viewSpec.getEye()));
 
+    /* Calculate the inverse pixel size: */
+    frustum.setPixelSize(Math::sqrt((Scalar(viewportWidth)*
+                                     Scalar(viewportHeight))/screenArea));
+
+    return frustum;
+}
+
+
+GLFrustum<Scalar> QuadTerrain::
+getViewFrustum(GLContextData& contextData)
+{
+    const Vrui::DisplayState& displayState = Vrui::getDisplayState(contextData);
+
     /* Get viewport size from OpenGL: */
     GLint viewport[4];
     glGetIntegerv(GL_VIEWPORT,viewport);
 
-    /* Calculate the inverse pixel size: */
-    frustum.setPixelSize(Math::sqrt((Scalar(viewport[2])*Scalar(viewport[3]))/screenArea));
+    return getFrustumFromViewSpec(
+        displayState.window->calcViewSpec(displayState.eyeIndex),
+        viewport[2], viewport[3]);
+}
 
-    return frustum;
+void QuadTerrain::
+getNodeFrusta(GLContextData& contextData, Frusta& frusta)
+{
+    frusta.clear();
+
+    //the current view always contributes, even if it isn't a listed window
+    frusta.push_back(getViewFrustum(contextData));
+
+    const Vrui::DisplayState& displayState = Vrui::getDisplayState(contextData);
+    int numWindows = Vrui::getNumWindows();
+    for (int w=0; w<numWindows; ++w)
+    {
+        Vrui::VRWindow* window = Vrui::getWindow(w);
+        if (window == NULL)
+            continue;
+
+        /* the views of other windows are rendered at the resolution of their
+           own viewport, which may differ from the current one */
+        const int* viewportSize = window->getViewportSize();
+
+        //only stereo windows render the second eye
+        Vrui::VRWindow::WindowType type = window->getWindowType();
+        bool stereo = type!=Vrui::VRWindow::MONO &&
+                      type!=Vrui::VRWindow::LEFT &&
+                      type!=Vrui::VRWindow::RIGHT;
+        int numEyes = stereo ? 2 : 1;
+        for (int eye=0; eye<numEyes; ++eye)
+        {
+            if (window==displayState.window && eye==displayState.eyeIndex)
+                continue;
+            frusta.push_back(getFrustumFromViewSpec(window->calcViewSpec(eye),
+                             viewportSize[0], viewportSize[1]));
+        }
+    }
 }
 
 
 void QuadTerrain::
 prepareDisplay(GLContextData& contextData, SurfaceApproximation& surface)
+{
+    Frusta frusta;
+    frusta.push_back(getViewFrustum(contextData));
+    prepareDisplay(frusta, surface);
+}
+
+void QuadTerrain::
+prepareDisplay(const Frusta& frusta, SurfaceApproximation& surface)
 {
     //setup the evaluators
     FrustumVisibility visibility;
-    visibility.frustum = getFrustumFromVrui(contextData);
+    visibility.frusta = frusta;
     FocusViewEvaluator lod;
     lod.bias = SETTINGS->lodBias;
     lod.scale = SETTINGS->lodScale;
-    lod.frustum = visibility.frustum;
+    lod.frusta = frusta;
     lod.setFocusFromDisplay();
 
     /* display could be multi-threaded. Buffer all the node data requests and
@@ -584,7 +790,7 @@ display(GLContextData& contextData, CrustaGlData* crustaGl,
     {
         DATAMANAGER->streamBatchToGpu(contextData, batch);
         for (DataManager::Batch::const_iterator it=batch.begin(); it!=batch.end(); ++it) {
-            drawNode(contextData, crustaGl, it->main, it->gpu);
+            drawNode(contextData, crustaGl, *it->main, it->gpu);
         }
         DATAMANAGER->ageGpuCaches(contextData);
     }
@@ -1015,13 +1221,8 @@ CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT << "------------------------\n";)
                 }
 
                 //move to the next child
-                static const int next[4][4][2] = {
-                    { { 2, 2}, {-1,-1}, {-1,-1}, { 1, 1} },
-                    { { 3, 2}, { 0, 3}, {-1,-1}, {-1,-1} },
-                    { {-1,-1}, {-1,-1}, { 0, 0}, { 3, 1} },
-                    { {-1,-1}, { 2, 3}, { 1, 0}, {-1,-1} } };
-                csin    = next[childId][csout][1];
-                childId = next[childId][csout][0];
+                csin    = NEXT_CHILD[childId][csout][1];
+                childId = NEXT_CHILD[childId][csout][0];
 CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT <<
 "Next child: " << childId << "\n";)
                 if (childId == -1)
@@ -1051,6 +1252,151 @@ CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT << "------------------------\n";)
     return SurfacePoint();
 }
 
+/** a ray of a batch crossing an inner node: its entry into and exit from the
+    node, and the child of the node it is in */
+struct RayCrossing
+{
+    QuadTerrain::BatchRay* ray;
+    Scalar                 tin;
+    int                    sin;
+    Scalar                 tout;
+    int                    sout;
+    int                    child;
+};
+
+void QuadTerrain::
+intersectNode(const MainBuffer& nodeBuf, BatchRays& rays) const
+{
+    const double& verticalScale = crusta->getVerticalScale();
+
+    MainData mainData = DATAMANAGER->getData(nodeBuf);
+    const NodeData& node = *mainData.node;
+
+//- determine the exit points and cull the rays missing the upper boundary
+    DemHeight::Type elevationRange[2];
+    node.getElevationRange(elevationRange);
+    Sphere shell(Point::origin, SETTINGS->globeRadius +
+                 verticalScale*elevationRange[1]);
+
+    BatchRays hits;
+    hits.reserve(rays.size());
+    for (BatchRays::iterator it=rays.begin(); it!=rays.end(); ++it)
+    {
+        BatchRay& r = **it;
+        computeExit(*r.ray, r.tin, node.scope, r.tout, r.sout);
+        if (r.tout == Math::Constants<double>::max)
+            continue;
+
+        double t0, t1;
+        if (shell.intersectRay(*r.ray, t0, t1) && t0<=r.tout && t1>=r.tin)
+            hits.push_back(&r);
+    }
+    if (hits.empty())
+        return;
+
+//- perform leaf intersection?
+    if (!DATAMANAGER->existsChildData(mainData))
+    {
+        for (BatchRays::iterator it=hits.begin(); it!=hits.end(); ++it)
+        {
+            BatchRay& r = **it;
+            *r.surfacePoint = intersectLeaf(mainData, *r.ray, r.tin, r.sin,
+                                            r.gout);
+        }
+        return;
+    }
+
+//- continue the traversal in the children
+    MainBuffer childBufs[4];
+    bool       childCurrent[4];
+    for (int i=0; i<4; ++i)
+    {
+        childCurrent[i] = DATAMANAGER->find(node.index.down(i), childBufs[i])&&
+                          DATAMANAGER->isCurrent(childBufs[i]);
+    }
+
+    /* the entry and exit of the rays for this node are overwritten by the
+       children, so keep them along with the child each ray is in */
+    std::vector<RayCrossing> crossings(hits.size());
+    for (size_t i=0; i<hits.size(); ++i)
+    {
+        BatchRay& r = *hits[i];
+        RayCrossing& c = crossings[i];
+        c.ray   = &r;
+        c.tin   = r.tin;
+        c.sin   = r.sin;
+        c.tout  = r.tout;
+        c.sout  = r.sout;
+        c.child = computeContainingChild((*r.ray)(r.tin), node.scope);
+    }
+
+    /* every round descends into each child once with all the rays currently
+       in it. A ray crosses each child at most once, in the same order as when
+       traversed on its own */
+    std::vector<RayCrossing*> active(crossings.size());
+    for (size_t i=0; i<crossings.size(); ++i)
+        active[i] = &crossings[i];
+    BatchRays childRays[4];
+    while (!active.empty())
+    {
+        for (int i=0; i<4; ++i)
+            childRays[i].clear();
+
+        size_t numActive = 0;
+        for (size_t i=0; i<active.size(); ++i)
+        {
+            RayCrossing& c = *active[i];
+            if (childCurrent[c.child])
+            {
+                childRays[c.child].push_back(c.ray);
+                active[numActive++] = &c;
+            }
+            else
+            {
+                ///\todo Vis2010 simplify. Don't allow loads of nodes from here
+                *c.ray->surfacePoint = intersectLeaf(mainData, *c.ray->ray,
+                                                     c.tin, c.sin,
+                                                     c.ray->gout);
+            }
+        }
+        active.resize(numActive);
+
+        for (int i=0; i<4; ++i)
+        {
+            if (!childRays[i].empty())
+                intersectNode(childBufs[i], childRays[i]);
+        }
+
+        //move the rays that missed on to the next child
+        numActive = 0;
+        for (size_t i=0; i<active.size(); ++i)
+        {
+            RayCrossing& c = *active[i];
+            BatchRay& r = *c.ray;
+            if (r.surfacePoint->isValid())
+                continue;
+
+            r.tin = r.tout;
+            if (r.tin > r.gout)
+                continue;
+
+            r.sin   = NEXT_CHILD[c.child][r.sout][1];
+            c.child = NEXT_CHILD[c.child][r.sout][0];
+            if (c.child != -1)
+                active[numActive++] = &c;
+        }
+        active.resize(numActive);
+    }
+
+    //report the exits from this node
+    for (std::vector<RayCrossing>::iterator it=crossings.begin();
+         it!=crossings.end(); ++it)
+    {
+        it->ray->tout = it->tout;
+        it->ray->sout = it->sout;
+    }
+}
+
 SurfacePoint QuadTerrain::
 intersectLeaf(const MainData& leafData, const QuadTerrain::Ray& ray,
               double param, int side, const double gout) const
@@ -1120,8 +1466,74 @@ CrustaVisualizer::peek();)
     int offset = cellY*tileRes + cellX;
     Vertex*          cellV = leafData.geometry + offset;
     DemHeight::Type* cellH = leafData.height   + offset;
+
+    static const int next[4][3] = { {0,1,2}, {-1,0,3}, {0,-1,0}, {1,0,1} };
+
+#if DO_HEIGHT_PYRAMID_CELL_SKIPPING
+    bool skipCells = verticalScale > 0.0;
+#endif //DO_HEIGHT_PYRAMID_CELL_SKIPPING
+
     while (true)
     {
+#if DO_HEIGHT_PYRAMID_CELL_SKIPPING
+        //skip over blocks of cells that are entirely below the ray
+        double blockParam = param;
+        int    blockSide  = side;
+        int    blockLevel = !skipCells ? 0 : computeSkipBlock(leafData, ray,
+            param, verticalScale, cellX, cellY, blockParam, blockSide);
+        if (blockLevel > 0)
+        {
+            param = blockParam;
+            side  = blockSide;
+            if (param > gout)
+                return SurfacePoint();
+
+            int size = 1<<blockLevel;
+            int bx   = cellX & ~(size-1);
+            int by   = cellY & ~(size-1);
+            Point pos = ray(param);
+            switch (side)
+            {
+                case 0:
+                    cellY = by+size;
+                    if (cellY > tileRes-2)
+                        return SurfacePoint();
+                    cellX = locateColumn(leafData, pos, cellY, bx, bx+size-1);
+                    break;
+                case 1:
+                    cellX = bx-1;
+                    if (cellX < 0)
+                        return SurfacePoint();
+                    cellY = locateRow(leafData, pos, cellX, by, by+size-1);
+                    break;
+                case 2:
+                    cellY = by-1;
+                    if (cellY < 0)
+                        return SurfacePoint();
+                    cellX = locateColumn(leafData, pos, cellY, bx, bx+size-1);
+                    break;
+                case 3:
+                    cellX = bx+size;
+                    if (cellX > tileRes-2)
+                        return SurfacePoint();
+                    cellY = locateRow(leafData, pos, cellX, by, by+size-1);
+                    break;
+                default:
+                    return SurfacePoint();
+            }
+
+            offset = cellY*tileRes + cellX;
+            cellV  = leafData.geometry + offset;
+            cellH  = leafData.height   + offset;
+
+            side = next[side][2];
+CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT <<
+"Skipped block level " << blockLevel << " to cell: " << cellX << " " <<
+cellY << "side: " << side << "\n";)
+            continue;
+        }
+#endif //DO_HEIGHT_PYRAMID_CELL_SKIPPING
+
         const Vertex::Position* positions[4] = {
             &(cellV->position), &((cellV+1)->position),
             &((cellV+tileRes)->position), &((cellV+tileRes+1)->position) };
@@ -1205,8 +1617,6 @@ CRUSTA_DEBUG(90, CRUSTA_DEBUG_OUT << "No side intersection!\n";)
         if (param > gout)
             return SurfacePoint();
 
-        static const int next[4][3] = { {0,1,2}, {-1,0,3}, {0,-1,0}, {1,0,1} };
-
         cellX += next[side][0];
         cellY += next[side][1];
         if (cellX<0 || cellX>tileRes-2 || cellY<0 || cellY>tileRes-2)
@@ -1259,6 +1669,27 @@ segmentCoverage(const MainBuffer& nodeBuf,
     }
 }
 
+void QuadTerrain::
+globalCoverage(const MainBuffer& nodeBuf,
+               Shape::IntersectionFunctor& callback) const
+{
+    MainData  nodeData = DATAMANAGER->getData(nodeBuf);
+    NodeData& node     = *nodeData.node;
+
+    //recursion to the children should only happen if all children are present
+    bool       allChildren = true;
+    MainBuffer childBuf[4];
+    for (int i=0; i<4; ++i)
+        allChildren &= DATAMANAGER->find(node.index.down(i), childBuf[i]);
+
+    callback(node, !allChildren);
+    if (allChildren)
+    {
+        for (int i=0; i<4; ++i)
+            globalCoverage(childBuf[i], callback);
+    }
+}
+
 
 void QuadTerrain::
 drawNode(GLContextData& contextData, CrustaGlData* crustaGl,
@@ -1312,7 +1743,8 @@ drawNode(GLContextData& contextData, CrustaGlData* crustaGl,
         ShaderDecoratedLineRenderer& decorated =
             crustaGl->terrainShader.getDecoratedLineRenderer();
         decorated.setNumSegments(main.lineNumSegments);
-        if (main.lineNumSegments > 0)
+        decorated.setNumAreas(main.lineNumAreas);
+        if (main.lineNumSegments>0 || main.lineNumAreas>0)
         {
             dataSources.coverage.setSubRegion(*gpuData.coverage);
             dataSources.lineData.setSubRegion((SubRegion)(*gpuData.lineData));
@@ -1446,9 +1878,10 @@ prepareDisplay(FrustumVisibility& visibility, FocusViewEvaluator& lod,
                 }
             }
 
-/**\todo horrible Vis2010 HACK: integrate this in the proper way? I.e. don't
-stall here, but defer the update. */
-if (allgood && data.node->lineInheritCoverage)
+/* propagate outdated coverage and line data to the children. This only flags
+them, their coverage is derived from the segment index in the background */
+if (allgood &&
+    (data.node->lineInheritStamp!=0 || data.node->lineInheritDataStamp!=0))
 {
     for (int i=0; i<4; ++i)
     {
@@ -1456,10 +1889,10 @@ if (allgood && data.node->lineInheritCoverage)
 CRUSTA_DEBUG(60, std::cerr << "***COVDOWN parent(" << data.node->index <<
 ")    " << "n(" << data.node->index << ")\n\n";)
         mapMan->inheritShapeCoverage(*data.node, *child.node);
-        child.node->lineInheritCoverage = true;
     }
 
-    data.node->lineInheritCoverage = false;
+    data.node->lineInheritStamp     = 0;
+    data.node->lineInheritDataStamp = 0;
 }
 
             //still all good then recurse to the children
@@ -1494,23 +1927,17 @@ void QuadTerrain::
 confirmLineCoverageRemoval(const MainData& nodeData, Shape* shape,
                            Shape::ControlPointHandle cp)
 {
-    typedef NodeData::ShapeCoverage        Coverage;
-    typedef Shape::ControlPointHandleList  HandleList;
-    //typedef Shape::ControlPointConstHandle Handle;
+    typedef NodeData::ShapeCoverage Coverage;
 
     NodeData& node = *nodeData.node;
 
-    //validate current node's coverage
-    Coverage::const_iterator lit = node.lineCoverage.find(shape);
-    if (lit != node.lineCoverage.end())
+    //validate current node's coverage (outdated ones are derived anew)
+    if (!node.lineCoverageDirty)
     {
-        //check all the control point handles
-        const HandleList& handles = lit->second;
-        if (!handles.empty())
+        for (Coverage::const_iterator sit=node.lineCoverage.begin();
+             sit!=node.lineCoverage.end(); ++sit)
         {
-            HandleList::const_iterator hit;
-            for (hit=handles.begin(); hit!=handles.end() && *hit!=cp; ++hit);
-            assert(hit == handles.end());
+            assert(sit->shape!=shape || sit->start!=cp);
         }
     }
 
@@ -1541,46 +1968,43 @@ void QuadTerrain::
 validateLineCoverage(const MainData& nodeData)
 {
     typedef NodeData::ShapeCoverage        Coverage;
-    typedef Shape::ControlPointHandleList  HandleList;
     typedef Shape::ControlPointConstHandle Handle;
 
     NodeData& node = *nodeData.node;
 
-    MapManager*               mapMan = crusta->getMapManager();
-    MapManager::PolylinePtrs& lines  = mapMan->getPolylines();
+    MapManager*               mapMan   = crusta->getMapManager();
+    MapManager::PolylinePtrs& lines    = mapMan->getPolylines();
+    MapManager::PolygonPtrs&  polygons = mapMan->getPolygons();
 
-    //validate current node's coverage
-    for (Coverage::const_iterator lit=node.lineCoverage.begin();
-         lit!=node.lineCoverage.end(); ++lit)
+    //validate current node's coverage (outdated ones are derived anew)
+    if (!node.lineCoverageDirty)
     {
-        //check that this line exists
-        MapManager::PolylinePtrs::iterator lfit = std::find(lines.begin(),
-            lines.end(), lit->first);
-        assert(lfit != lines.end());
-
-        //grab the polyline's controlpoints
-        const Shape::ControlPointList& cpl = (*lfit)->getControlPoints();
+        for (Coverage::const_iterator sit=node.lineCoverage.begin();
+             sit!=node.lineCoverage.end(); ++sit)
+        {
+            //check that this line (or polygon outline) exists
+            MapManager::PolylinePtrs::iterator lfit = std::find(lines.begin(),
+                lines.end(), sit->shape);
+            MapManager::PolygonPtrs::iterator pfit = std::find(
+                polygons.begin(), polygons.end(), sit->shape);
+            assert(lfit!=lines.end() || pfit!=polygons.end());
 
-        //check all the control point handles
-        const HandleList& handles = lit->second;
-        assert(!handles.empty());
+            //grab the shape's controlpoints
+            const Shape::ControlPointList& cpl = sit->shape->getControlPoints();
 
-        for (HandleList::const_iterator hit=handles.begin(); hit!=handles.end();
-             ++hit)
-        {
             //check existance
             Handle cfit;
-            for (cfit=cpl.begin(); cfit!=cpl.end() && cfit!=*hit; ++cfit);
+            for (cfit=cpl.begin(); cfit!=cpl.end() && cfit!=sit->start; ++cfit);
             assert(cfit != cpl.end());
 
             //check overlap
-            Handle end = *hit; ++end;
-            assert(node.scope.intersects((*hit)->pos, end->pos));
+            Handle end = sit->start; ++end;
+            assert(node.scope.intersects(sit->start->pos, end->pos));
 
             //check duplicates
-            HandleList::const_iterator nhit = hit;
-            for (++nhit; nhit!=handles.end(); ++nhit)
-                assert(*hit != *nhit);
+            Coverage::const_iterator nsit = sit;
+            for (++nsit; nsit!=node.lineCoverage.end(); ++nsit)
+                assert(nsit->shape!=sit->shape || nsit->start!=sit->start);
         }
     }
 
@@ -4,6 +4,7 @@
 #include <crustavrui/GL/VruiGlew.h> //must be included before gl.h
 
 #include <list>
+#include <vector>
 
 #include <crusta/GlProgram.h>
 
@@ -12,6 +13,7 @@
 #include <crusta/DataManager.h>
 #include <crusta/FrustumVisibility.h>
 #include <crusta/FocusViewEvaluator.h>
+#include <crusta/Homography.h>
 #include <crusta/map/Shape.h>
 #include <crusta/QuadCache.h>
 #include <crusta/SurfaceApproximation.h>
@@ -45,6 +47,26 @@ public:
     typedef NodeGpuData          GpuData;
     typedef NodeGpuDatas         GpuDatas;
 
+    typedef FrustumVisibility::Frusta Frusta;
+
+    /** state of a ray traversing the patches as part of a batch */
+    struct BatchRay
+    {
+        /** the ray */
+        const Ray* ray;
+        /** parameter and side of the entry into the current node */
+        Scalar tin;
+        int    sin;
+        /** parameter and side of the exit from the current node */
+        Scalar tout;
+        int    sout;
+        /** parameter at which the traversal stops */
+        Scalar gout;
+        /** receives the intersection, which must be initially invalid */
+        SurfacePoint* surfacePoint;
+    };
+    typedef std::vector<BatchRay*> BatchRays;
+
     QuadTerrain(uint8_t patch, const Scope& scope, Crusta* iCrusta);
 
     /** query the patch's root node buffer */
@@ -55,20 +77,42 @@ public:
     /** ray patch intersection */
     SurfacePoint intersect(const Ray& ray, Scalar tin, int sin,
                         Scalar& tout, int& sout, const Scalar gout) const;
+    /** ray patch intersection for a batch of rays entering the patch. The
+        rays crossing the same node descend into it together, such that each
+        node is visited once per batch. The rays that miss the patch are left
+        with their exit parameter and side */
+    void intersect(BatchRays& rays) const;
 
     /** traverse the cached representation for nodes that overlap a segment */
     void segmentCoverage(const Point& start, const Point& end,
                          Shape::IntersectionFunctor& callback) const;
-
-    /** render the coverage map for the given node */
+    /** traverse all the nodes of the cached representation */
+    void globalCoverage(Shape::IntersectionFunctor& callback) const;
+
+    /** compute the projection of centroid-relative positions of a node onto
+        its normalized coverage map */
+    static Homography::Projective computeLineCoverageProjection(
+        const NodeData& node);
+    /** render the coverage map for the given node. The area masks are
+        expected to be streamed into the blue and alpha channels already */
     static void renderLineCoverageMap(GLContextData& contextData,
                                       const MainData& nodeData);
 
+    /** compute the frustum of the view currently being rendered */
+    static GLFrustum<Scalar> getViewFrustum(GLContextData& contextData);
+    /** compute the frusta of all the views of this node: every window, and
+        both eyes of the stereo windows, at their own resolution */
+    static void getNodeFrusta(GLContextData& contextData, Frusta& frusta);
+
     /** prepareDiplay has several functions:
         1. issue requests for loading in new nodes (from splits or merges)
         2. provide the list of nodes that will be rendered for the frame */
     void prepareDisplay(GLContextData& contextData,
                         SurfaceApproximation& surface);
+    /** prepare the display for a set of views at once. The resulting surface
+        approximation is conservative: the nodes visible in any of the frusta
+        are refined as required by the most demanding frustum */
+    void prepareDisplay(const Frusta& frusta, SurfaceApproximation& surface);
 
     /** draw slicing plane and setup corresponding shader uniforms **/
     static void initSlicingPlane(GLContextData& contextData, CrustaGlData* crustaGl, const Geometry::Vector<double,3> &center);
@@ -141,6 +185,9 @@ protected:
     SurfacePoint intersectNode(const MainBuffer& nodeBuf, const Ray& ray,
                             Scalar tin, int sin, Scalar& tout, int& sout,
                             const Scalar gout) const;
+    /** ray patch traversal function for inner nodes of the quadtree and a
+        batch of rays */
+    void intersectNode(const MainBuffer& nodeBuf, BatchRays& rays) const;
     /** ray patch traversal function for leaf nodes of the quadtree */
     SurfacePoint intersectLeaf(const MainData& leaf, const Ray& ray,
                             Scalar param, int side, const Scalar gout) const;
@@ -150,6 +197,10 @@ protected:
     void segmentCoverage(const MainBuffer& nodeBuf,
                          const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end,
                          Shape::IntersectionFunctor& callback) const;
+    /** traverse all the nodes of the cached representation starting at the
+        given node */
+    void globalCoverage(const MainBuffer& nodeBuf,
+                        Shape::IntersectionFunctor& callback) const;
 
     /** issue the drawing commands for displaying a node. The video cache
         operations to stream data from the main cache are performed at this
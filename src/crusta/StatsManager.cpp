@@ -70,12 +70,12 @@ extractTileStats(const SurfaceApproximation& surface)
 #if CRUSTA_RECORD_STATS
     typedef NodeData::ShapeCoverage Coverage;
 
-    numTiles = static_cast<int>(surface.visibles.size());
+    numTiles = static_cast<int>(surface.numVisibles());
 
     //go through all the nodes provided
     for (int i=0; i<numTiles; ++i))
     {
-        const NodeData& node     = *surface.visible(i).node;
+        const NodeData& node     = surface.visibleNode(i);
         const Coverage& coverage = node.lineCoverage;
 
         if (coverage.empty())
@@ -83,13 +83,9 @@ extractTileStats(const SurfaceApproximation& surface)
 
         ++numData;
 
-        for (Coverage::const_iterator lit=coverage.begin();
-             lit!=coverage.end(); ++lit)
-        {
-            int segsInTile     = static_cast<int>(lit->second.size());
-            numSegments       += segsInTile;
-            maxSegmentsPerTile = std::max(maxSegmentsPerTile, segsInTile);
-        }
+        int segsInTile     = static_cast<int>(coverage.size());
+        numSegments       += segsInTile;
+        maxSegmentsPerTile = std::max(maxSegmentsPerTile, segsInTile);
     }
 #endif //CRUSTA_RECORD_STATS
 }
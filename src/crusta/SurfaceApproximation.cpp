@@ -1,37 +1,107 @@
 #include <crusta/SurfaceApproximation.h>
 
+#include <algorithm>
+
 
 namespace crusta {
 
 
+/** exchange the data of two nodes without copying their buffer lists */
+static void
+swapMainData(NodeMainData& a, NodeMainData& b)
+{
+    std::swap(a.node, b.node);
+    std::swap(a.geometry, b.geometry);
+    std::swap(a.height, b.height);
+    a.colors.swap(b.colors);
+    a.layers.swap(b.layers);
+}
+
+
 void SurfaceApproximation::
 clear()
 {
-    nodes.clear();;
-    visibles.clear();;
+    nodes.clear();
+    visibleMains.clear();
+    visibleCenters.clear();
     //neighbors.clear();
 }
 
 void SurfaceApproximation::
 add(const NodeMainData& node, bool isVisible)
 {
-    nodes.push_back(node);
     if (isVisible)
-        visibles.push_back(nodes.size()-1);
+    {
+        visibleMains.push_back(node);
+        visibleCenters.push_back(node.node->boundingCenter);
+    }
+    else
+        nodes.push_back(node);
+}
+
+size_t SurfaceApproximation::
+numVisibles() const
+{
+    return visibleMains.size();
 }
 
 NodeMainData& SurfaceApproximation::
 visible(size_t index)
 {
-    assert(index<visibles.size());
-    return nodes[visibles[index]];
+    assert(index<visibleMains.size());
+    return visibleMains[index];
 }
 
 const NodeMainData& SurfaceApproximation::
 visible(size_t index) const
 {
-    assert(index<visibles.size());
-    return nodes[visibles[index]];
+    assert(index<visibleMains.size());
+    return visibleMains[index];
+}
+
+NodeData& SurfaceApproximation::
+visibleNode(size_t index)
+{
+    assert(index<visibleMains.size());
+    return *visibleMains[index].node;
+}
+
+const NodeData& SurfaceApproximation::
+visibleNode(size_t index) const
+{
+    assert(index<visibleMains.size());
+    return *visibleMains[index].node;
+}
+
+void SurfaceApproximation::
+sortVisibles(const Geometry::Point<double,3>& eyePosition)
+{
+    typedef std::pair<double, int> KeyedSlot;
+    typedef std::vector<KeyedSlot> KeyedSlots;
+
+    //compute the keys in a single pass over the contiguous centers
+    const size_t numVisible = visibleMains.size();
+    KeyedSlots order(numVisible);
+    for (size_t i=0; i<numVisible; ++i)
+    {
+        /* the squared distance is negated such that the ascending sort yields
+           a back to front ordering */
+        order[i].first  = -Geometry::sqrDist(eyePosition, visibleCenters[i]);
+        order[i].second = static_cast<int>(i);
+    }
+    std::sort(order.begin(), order.end());
+
+    //permute the draw records into the new order
+    NodeMainDatas sortedMains(numVisible);
+    Points        sortedCenters(numVisible);
+    for (size_t i=0; i<numVisible; ++i)
+    {
+        int slot         = order[i].second;
+        swapMainData(sortedMains[i], visibleMains[slot]);
+        sortedCenters[i] = visibleCenters[slot];
+    }
+    visibleMains.swap(sortedMains);
+    visibleCenters.swap(sortedCenters);
 }
 
 void SurfaceApproximation::
@@ -12,7 +12,7 @@ namespace crusta {
     of a globe surface */
 struct SurfaceApproximation
 {
-    typedef std::vector<int>       Indices;
+    typedef std::vector<Geometry::Point<double,3> > Points;
     // DISABLED as not used, and array should be replaced with struct
     //typedef int                    Neighbors[4];
     //typedef std::vector<Neighbors> NeighborIndices;
@@ -23,22 +23,39 @@ struct SurfaceApproximation
     /** add a node to the representation as contributing to the display or
         not */
     void add(const NodeMainData& node, bool isVisible);
+    /** returns the number of visible nodes */
+    size_t numVisibles() const;
     /** returns the data of the index'th visible node */
     NodeMainData& visible(size_t index);
     const NodeMainData& visible(size_t index) const;
+    /** returns the node of the index'th visible node */
+    NodeData& visibleNode(size_t index);
+    const NodeData& visibleNode(size_t index) const;
 /**\todo Rolf, please add a meaningful convenience function for accessing
 neighbors*/
 
+    /** order the visible nodes back to front with respect to the eye. The
+        sort keys are computed once for all the nodes and the draw records are
+        permuted in a single pass */
+    void sortVisibles(const Geometry::Point<double,3>& eyePosition);
+
     /** generate neighborhood information for the visible part of the
         representation */
     void processNeighborhood();
 
-    /** stores the nodes making up a gap- and overlap free tiling of the global
-        surface defined by a LOD scheme */
+    /** stores the nodes not contributing to the display. Together with the
+        visible subset they make up a gap- and overlap free tiling of the
+        global surface defined by a LOD scheme */
     NodeMainDatas nodes;
-    /** stores indices to nodes of the surface representation that are part of
-        the visibile subset */
-    Indices visibles;
+
+    /**\{ draw records of the visible subset, stored as parallel arrays in
+          draw order */
+    /** the data of the nodes */
+    NodeMainDatas visibleMains;
+    /** centers of the bounding spheres of the nodes */
+    Points visibleCenters;
+    /**\}*/
+
     /** stores sets of indices to neighbors nodes in the surface representation
         for the visible subset */
     // DISABLED as not yet used anywhere
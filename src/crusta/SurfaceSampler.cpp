@@ -0,0 +1,454 @@
+#include <crusta/SurfaceSampler.h>
+
+#include <assert.h>
+
+#include <crustacore/Polyhedron.h>
+#include <crusta/Crusta.h>
+
+
+namespace crusta {
+
+
+SurfaceSample::
+SurfaceSample() :
+    height(0), nodeIndex(TreeIndex::invalid)
+{
+}
+
+bool SurfaceSample::
+isValid() const
+{
+    return nodeIndex != TreeIndex::invalid;
+}
+
+
+SurfaceSampleFuture::State::
+State() :
+    refCount(1), ready(false)
+{
+}
+
+
+SurfaceSampleFuture::
+SurfaceSampleFuture() :
+    state(NULL)
+{
+}
+
+SurfaceSampleFuture::
+SurfaceSampleFuture(State* iState) :
+    state(iState)
+{
+}
+
+SurfaceSampleFuture::
+SurfaceSampleFuture(const SurfaceSampleFuture& other) :
+    state(other.state)
+{
+    if (state != NULL)
+    {
+        Threads::Mutex::Lock lock(state->mutex);
+        ++state->refCount;
+    }
+}
+
+SurfaceSampleFuture::
+~SurfaceSampleFuture()
+{
+    release();
+}
+
+SurfaceSampleFuture& SurfaceSampleFuture::
+operator =(const SurfaceSampleFuture& other)
+{
+    if (state != other.state)
+    {
+        release();
+        state = other.state;
+        if (state != NULL)
+        {
+            Threads::Mutex::Lock lock(state->mutex);
+            ++state->refCount;
+        }
+    }
+    return *this;
+}
+
+bool SurfaceSampleFuture::
+isReady() const
+{
+    if (state == NULL)
+        return false;
+
+    Threads::Mutex::Lock lock(state->mutex);
+    return state->ready;
+}
+
+const SurfaceSample& SurfaceSampleFuture::
+get() const
+{
+    if (state == NULL)
+        Misc::throwStdErr("SurfaceSampleFuture::get: no pending sample");
+
+    Threads::Mutex::Lock lock(state->mutex);
+    while (!state->ready)
+        state->cond.wait(state->mutex);
+    return state->sample;
+}
+
+void SurfaceSampleFuture::
+set(const SurfaceSample& sample)
+{
+    assert(state != NULL);
+    {
+        Threads::Mutex::Lock lock(state->mutex);
+        state->sample = sample;
+        state->ready  = true;
+    }
+    state->cond.broadcast();
+}
+
+void SurfaceSampleFuture::
+release()
+{
+    if (state == NULL)
+        return;
+
+    bool last;
+    {
+        Threads::Mutex::Lock lock(state->mutex);
+        last = --state->refCount == 0;
+    }
+    if (last)
+        delete state;
+    state = NULL;
+}
+
+
+SurfaceSampler::Query::
+Query(const Geometry::Point<double,3>& iPoint, int iLevel,
+      const SurfaceSampleFuture& iFuture) :
+    point(iPoint), level(iLevel), levelReached(-1),
+    progressTime(Vrui::getApplicationTime()), future(iFuture)
+{
+}
+
+
+SurfaceSampler::
+SurfaceSampler(Crusta* iCrusta) :
+    CrustaComponent(iCrusta)
+{
+}
+
+SurfaceSampler::
+~SurfaceSampler()
+{
+    //make sure no thread is left waiting for a sample
+    reset();
+}
+
+
+SurfaceSampleFuture SurfaceSampler::
+sample(const Geometry::Point<double,3>& point, int level)
+{
+    SurfaceSampleFuture future(new SurfaceSampleFuture::State);
+    {
+        Threads::Mutex::Lock lock(submitMutex);
+        submittedQueries.push_back(Query(point, level, future));
+    }
+    Vrui::requestUpdate();
+    return future;
+}
+
+void SurfaceSampler::
+sample(const Points& points, int level, SurfaceSampleFutures& futures)
+{
+    futures.clear();
+    futures.reserve(points.size());
+    {
+        Threads::Mutex::Lock lock(submitMutex);
+        for (Points::const_iterator it=points.begin(); it!=points.end(); ++it)
+        {
+            futures.push_back(
+                SurfaceSampleFuture(new SurfaceSampleFuture::State));
+            submittedQueries.push_back(Query(*it, level, futures.back()));
+        }
+    }
+    Vrui::requestUpdate();
+}
+
+
+void SurfaceSampler::
+frame()
+{
+    //grab the newly submitted queries
+    {
+        Threads::Mutex::Lock lock(submitMutex);
+        pendingQueries.splice(pendingQueries.end(), submittedQueries);
+    }
+
+    if (pendingQueries.empty())
+        return;
+
+    //without a globe there is nothing to sample
+    if (DATAMANAGER->getPolyhedron() == NULL)
+    {
+        reset();
+        return;
+    }
+
+    /* advance all the queries as far as the cached data allows and gather the
+       fetches for the missing nodes into a single batch */
+    DataManager::Requests requests;
+    const double now = Vrui::getApplicationTime();
+    for (Queries::iterator it=pendingQueries.begin();
+         it!=pendingQueries.end();)
+    {
+        NodeMainData nodeData;
+        bool complete = descend(*it, nodeData, requests);
+
+        //give up on refining queries whose data doesn't arrive
+        if (!complete &&
+            now-it->progressTime > SETTINGS->surfaceSamplerTimeout)
+        {
+            requests.pop_back();
+            complete = true;
+        }
+
+        if (complete)
+        {
+            it->future.set(nodeData.node!=NULL ? evaluate(nodeData, it->point) :
+                                                 SurfaceSample());
+            pendingQueries.erase(it++);
+        }
+        else
+            ++it;
+    }
+
+    if (!requests.empty())
+        DATAMANAGER->request(requests);
+
+    //keep the frames coming until all the queries are answered
+    if (!pendingQueries.empty())
+        Vrui::requestUpdate();
+}
+
+void SurfaceSampler::
+reset()
+{
+    {
+        Threads::Mutex::Lock lock(submitMutex);
+        pendingQueries.splice(pendingQueries.end(), submittedQueries);
+    }
+
+    for (Queries::iterator it=pendingQueries.begin(); it!=pendingQueries.end();
+         ++it)
+    {
+        it->future.set(SurfaceSample());
+    }
+    pendingQueries.clear();
+}
+
+
+bool SurfaceSampler::
+descend(Query& query, NodeMainData& nodeData, DataManager::Requests& requests)
+{
+//- find the base patch containing the point
+    const Polyhedron* const polyhedron = DATAMANAGER->getPolyhedron();
+    const int numPatches = static_cast<int>(polyhedron->getNumPatches());
+
+    NodeMainBuffer buf;
+    nodeData.node = NULL;
+    for (int i=0; i<numPatches; ++i)
+    {
+        if (DATAMANAGER->find(TreeIndex(i), buf) &&
+            buf.node->getData().scope.contains(query.point))
+        {
+            nodeData = DATAMANAGER->getData(buf);
+            break;
+        }
+    }
+
+    //the point doesn't map onto the globe
+    if (nodeData.node == NULL)
+        return true;
+
+//- descend through the cached nodes
+    while (static_cast<int>(nodeData.node->index.level()) < query.level)
+    {
+        //is it even possible to retrieve higher res data?
+        if (!DATAMANAGER->existsChildData(nodeData))
+            break;
+
+        //find the child containing the point
+        Scope childScopes[4];
+        nodeData.node->scope.split(childScopes);
+        uint8_t childId = 0;
+        for (; childId<3; ++childId)
+        {
+            if (childScopes[childId].contains(query.point))
+                break;
+        }
+
+        TreeIndex childIndex = nodeData.node->index.down(childId);
+        NodeMainBuffer childBuf;
+        if (!DATAMANAGER->find(childIndex, childBuf))
+        {
+            //request the data with top priority and retry next frame
+            requests.push_back(DataManager::Request(crusta, 0.0f, buf,
+                                                    childId));
+            int level = static_cast<int>(nodeData.node->index.level());
+            if (level > query.levelReached)
+            {
+                query.levelReached = level;
+                query.progressTime = Vrui::getApplicationTime();
+            }
+            return false;
+        }
+
+        //keep the data from being recycled before it is evaluated
+        DATAMANAGER->touch(childBuf);
+        buf      = childBuf;
+        nodeData = DATAMANAGER->getData(buf);
+    }
+
+    return true;
+}
+
+
+/** intersect the ray with a triangle and provide the barycentric coordinates
+    of the hit wrt. the second and third vertex */
+static bool
+intersectTriangle(const Geometry::Ray<double,3>& ray,
+                  const Geometry::Vector<double,3>& v0,
+                  const Geometry::Vector<double,3>& v1,
+                  const Geometry::Vector<double,3>& v2, double& u, double& v)
+{
+    static const double EPSILON = 0.000001;
+
+    Geometry::Vector<double,3> edge1 = v1 - v0;
+    Geometry::Vector<double,3> edge2 = v2 - v0;
+
+    const Geometry::Vector<double,3>& dir = ray.getDirection();
+    Geometry::Vector<double,3> pvec = Geometry::cross(dir, edge2);
+    double det = edge1 * pvec;
+    if (Math::abs(det) < EPSILON)
+        return false;
+    double invDet = 1.0 / det;
+
+    Geometry::Vector<double,3> tvec = ray.getOrigin() -
+                                      Geometry::Point<double,3>::origin - v0;
+    u = (tvec * pvec) * invDet;
+
+    Geometry::Vector<double,3> qvec = Geometry::cross(tvec, edge1);
+    v = (dir * qvec) * invDet;
+
+    return u>=-EPSILON && v>=-EPSILON && u+v<=1.0+EPSILON;
+}
+
+SurfaceSample SurfaceSampler::
+evaluate(const NodeMainData& nodeData,
+         const Geometry::Point<double,3>& point) const
+{
+    static const int tileRes = TILE_RESOLUTION;
+
+    const NodeData& node = *nodeData.node;
+
+//- locate the cell of the refinement containing the point
+    Geometry::Point<int,2> offset(0, 0);
+    Scope scope = node.scope;
+    for (int shift=(tileRes-1)>>1; shift>0; shift>>=1)
+    {
+        Scope childScopes[4];
+        scope.split(childScopes);
+        for (int i=0; i<4; ++i)
+        {
+            if (childScopes[i].contains(point))
+            {
+                offset[0] += i&0x1 ? shift : 0;
+                offset[1] += i&0x2 ? shift : 0;
+                scope      = childScopes[i];
+                break;
+            }
+        }
+    }
+
+//- find the triangle of the cell below the point
+    const int cellOffsets[4] = { 0, 1, tileRes, tileRes+1 };
+    const int linearOffset   = offset[1]*tileRes + offset[0];
+    Geometry::Vector<double,3> corners[4];
+    for (int i=0; i<4; ++i)
+    {
+        const Vertex::Position& p =
+            nodeData.geometry[linearOffset + cellOffsets[i]].position;
+        for (int j=0; j<3; ++j)
+            corners[i][j] = double(p[j]) + double(node.centroid[j]);
+    }
+
+    Geometry::Vector<double,3> up = point - Geometry::Point<double,3>::origin;
+    up.normalize();
+    Geometry::Ray<double,3> ray(Geometry::Point<double,3>::origin +
+                                up*(2.0*SETTINGS->globeRadius), -up);
+
+    //the triangulation of the cell matches the one used for rendering
+    static const int triangles[2][3] = { {0,3,2}, {0,1,3} };
+    int    tri = 0;
+    double u   = 0.0;
+    double v   = 0.0;
+    if (!intersectTriangle(ray, corners[0], corners[3], corners[2], u, v))
+    {
+        tri = 1;
+        if (!intersectTriangle(ray, corners[0], corners[1], corners[3], u, v))
+        {
+            //numerical miss on the cell boundary: clamp to the first triangle
+            tri = 0;
+            intersectTriangle(ray, corners[0], corners[3], corners[2], u, v);
+            u = Math::clamp(u, 0.0, 1.0);
+            v = Math::clamp(v, 0.0, 1.0-u);
+        }
+    }
+    const double weights[3] = { 1.0-u-v, u, v };
+    int vertexOffsets[3];
+    for (int i=0; i<3; ++i)
+        vertexOffsets[i] = linearOffset + cellOffsets[triangles[tri][i]];
+
+//- interpolate the data
+    SurfaceSample sample;
+    sample.nodeIndex = node.index;
+
+    double height = 0.0;
+    for (int i=0; i<3; ++i)
+        height += weights[i] * node.getHeight(nodeData.height[vertexOffsets[i]]);
+    sample.height = DemHeight::Type(height);
+
+    Geometry::Vector<double,3> hit(0.0, 0.0, 0.0);
+    for (int i=0; i<3; ++i)
+        hit += weights[i] * corners[triangles[tri][i]];
+    hit.normalize();
+    sample.position = Geometry::Point<double,3>::origin +
+                      hit*(SETTINGS->globeRadius + height);
+
+    const LayerDataf::Type nodata = DATAMANAGER->getLayerfNodata();
+    sample.layers.resize(nodeData.layers.size(), nodata);
+    for (size_t l=0; l<nodeData.layers.size(); ++l)
+    {
+        double sum        = 0.0;
+        double sumWeights = 0.0;
+        for (int i=0; i<3; ++i)
+        {
+            LayerDataf::Type value = nodeData.layers[l][vertexOffsets[i]];
+            if (value != nodata)
+            {
+                sum        += weights[i] * value;
+                sumWeights += weights[i];
+            }
+        }
+        if (sumWeights > 0.0)
+            sample.layers[l] = LayerDataf::Type(sum / sumWeights);
+    }
+
+    return sample;
+}
+
+
+} //namespace crusta
@@ -0,0 +1,159 @@
+#ifndef _SurfaceSampler_H_
+#define _SurfaceSampler_H_
+
+
+#include <list>
+#include <vector>
+
+#include <crusta/CrustaComponent.h>
+#include <crusta/DataManager.h>
+
+#include <crusta/vrui.h>
+
+
+namespace crusta {
+
+
+/** the values of the terrain data sampled at a point */
+struct SurfaceSample
+{
+    typedef std::vector<LayerDataf::Type> Layers;
+
+    SurfaceSample();
+
+    bool isValid() const;
+
+    /** the sampled point on the unscaled terrain surface */
+    Geometry::Point<double,3> position;
+    /** the elevation of the terrain at the point */
+    DemHeight::Type height;
+    /** the values of the layerf data layers at the point */
+    Layers layers;
+    /** the node that provided the sample. Its level is coarser than the
+        requested one if no finer data exists for the point */
+    TreeIndex nodeIndex;
+};
+
+
+/** handle to a sample that is computed asynchronously by the sampler */
+class SurfaceSampleFuture
+{
+    friend class SurfaceSampler;
+
+public:
+    SurfaceSampleFuture();
+    SurfaceSampleFuture(const SurfaceSampleFuture& other);
+    ~SurfaceSampleFuture();
+
+    SurfaceSampleFuture& operator =(const SurfaceSampleFuture& other);
+
+    /** check if the sample has been computed */
+    bool isReady() const;
+    /** block until the sample has been computed. The samples are computed in
+        the frame callback, thus this must not be called from the main
+        thread */
+    const SurfaceSample& get() const;
+
+protected:
+    /** the state shared by all the copies of a future */
+    struct State
+    {
+        State();
+
+        /** serialize access to the state */
+        Threads::Mutex mutex;
+        /** allows waiting for the sample */
+        Threads::Cond cond;
+        /** number of futures referencing the state */
+        int refCount;
+        /** flags the availability of the sample */
+        bool ready;
+        /** the computed sample */
+        SurfaceSample sample;
+    };
+
+    /** create a future with a fresh state */
+    explicit SurfaceSampleFuture(State* iState);
+
+    /** provide the sample and wake up any waiting threads */
+    void set(const SurfaceSample& sample);
+    /** drop the reference to the shared state */
+    void release();
+
+    State* state;
+};
+typedef std::vector<SurfaceSampleFuture> SurfaceSampleFutures;
+
+
+/**
+    Samples the elevation and layerf data at arbitrary points to a requested
+    level of the hierarchy, independently of the surface approximation used for
+    rendering. Nodes that are not cached are requested from the fetch pipeline
+    of the data manager and the samples are completed asynchronously as the
+    data arrives. The queries are processed in the frame callback, where the
+    fetches required by all the pending queries are issued as a single batch.
+*/
+class SurfaceSampler : public CrustaComponent
+{
+public:
+    typedef std::vector<Geometry::Point<double,3> > Points;
+
+    SurfaceSampler(Crusta* iCrusta);
+    ~SurfaceSampler();
+
+    /** queue the sampling of a point on the globe to the given level of the
+        hierarchy. Can be called from any thread */
+    SurfaceSampleFuture sample(const Geometry::Point<double,3>& point,
+                               int level);
+    /** queue the sampling of a set of points to the given level of the
+        hierarchy. Can be called from any thread */
+    void sample(const Points& points, int level,
+                SurfaceSampleFutures& futures);
+
+    /** advance the pending queries and issue the required fetches */
+    void frame();
+    /** abandon all the pending queries. Their samples become invalid */
+    void reset();
+
+protected:
+    /** a sampling request */
+    struct Query
+    {
+        Query(const Geometry::Point<double,3>& iPoint, int iLevel,
+              const SurfaceSampleFuture& iFuture);
+
+        /** the point to be sampled */
+        Geometry::Point<double,3> point;
+        /** the level of the hierarchy to sample */
+        int level;
+        /** the deepest level reached so far */
+        int levelReached;
+        /** time at which the query last made progress */
+        double progressTime;
+        /** the handle to the result */
+        SurfaceSampleFuture future;
+    };
+    typedef std::list<Query> Queries;
+
+    /** descend towards the query's level through the cached nodes. Returns
+        true if the descent is complete, otherwise the missing child is added
+        to the requests */
+    bool descend(Query& query, NodeMainData& nodeData,
+                 DataManager::Requests& requests);
+    /** evaluate the data of the node at the point */
+    SurfaceSample evaluate(const NodeMainData& nodeData,
+                           const Geometry::Point<double,3>& point) const;
+
+    /** serialize the submission of new queries */
+    Threads::Mutex submitMutex;
+    /** queries submitted since the last frame */
+    Queries submittedQueries;
+    /** queries waiting for data (only accessed from the frame callback) */
+    Queries pendingQueries;
+};
+
+
+} //namespace crusta
+
+
+#endif //_SurfaceSampler_H_
@@ -0,0 +1,237 @@
+#include <crusta/map/AreaRasterizer.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <crusta/CrustaSettings.h>
+
+
+namespace crusta {
+
+
+///smallest homogeneous weight of a projected point
+static const double MIN_PROJECTED_W = 1e-3;
+
+
+AreaRasterizer::
+AreaRasterizer() :
+    terminate(false), workers(NULL), numWorkers(0)
+{
+}
+
+AreaRasterizer::
+~AreaRasterizer()
+{
+    if (workers == NULL)
+        return;
+
+    //let the worker threads know that they should terminate
+    {
+        Threads::Mutex::Lock lock(mutex);
+        terminate = true;
+    }
+    //make sure none is stuck waiting for jobs
+    cond.broadcast();
+    //wait for the termination
+    for (int i=0; i<numWorkers; ++i)
+        workers[i].join();
+    delete[] workers;
+}
+
+void AreaRasterizer::
+push(Jobs& newJobs)
+{
+    if (newJobs.empty())
+        return;
+    if (workers == NULL)
+        startWorkers();
+
+    Threads::Mutex::Lock lock(mutex);
+    jobs.splice(jobs.end(), newJobs);
+    cond.broadcast();
+}
+
+void AreaRasterizer::
+pop(Jobs& processed)
+{
+    Threads::Mutex::Lock lock(mutex);
+    processed.splice(processed.end(), results);
+}
+
+
+void AreaRasterizer::
+rasterize(Job& job)
+{
+    typedef Homography::Projective::Matrix Matrix;
+
+    const int size = job.size;
+    job.mask.assign(size*size*4, 0);
+
+    //project the reference point (the origin) onto the mask
+    const Matrix& m = job.projection.getMatrix();
+    double refW = m(3,3);
+    if (refW < MIN_PROJECTED_W)
+        return;
+    float refX  = (m(0,3)/refW + 1.0) * 0.5 * size;
+    float refY  = (m(1,3)/refW + 1.0) * 0.5 * size;
+
+    Edges edges;
+    std::vector<float> crossings;
+    int numAreas = static_cast<int>(job.areas.size());
+    for (int a=0; a<numAreas; ++a)
+    {
+        const Area& area = job.areas[a];
+        projectEdges(job, area, edges);
+
+        //the offset of the fill, encoded like the offsets of the segments
+        int offset = job.firstOffset + a;
+        uint8_t code[2] = { uint8_t(offset & 0xFF),
+                            uint8_t(((offset>>8) & 0xFF) + 64) };
+
+        for (int j=0; j<size; ++j)
+        {
+            float y = j + 0.5f;
+
+            /* the parity at the start of the row's sweep is that of the
+               reference, flipped by the crossings of the vertical path from
+               the reference to the row and of the row up to the reference */
+            bool inside = area.inside;
+            float lo = std::min(refY, y);
+            float hi = std::max(refY, y);
+            crossings.clear();
+            for (Edges::const_iterator e=edges.begin(); e!=edges.end(); ++e)
+            {
+                if ((e->x0<=refX) != (e->x1<=refX))
+                {
+                    float ey = e->y0 + (refX-e->x0) * (e->y1-e->y0) /
+                                       (e->x1-e->x0);
+                    if (ey>=lo && ey<hi)
+                        inside = !inside;
+                }
+                if ((e->y0<=y) != (e->y1<=y))
+                {
+                    float ex = e->x0 + (y-e->y0) * (e->x1-e->x0) /
+                                       (e->y1-e->y0);
+                    crossings.push_back(ex);
+                    if (ex < refX)
+                        inside = !inside;
+                }
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            //fill the spans between the crossings that lie inside
+            uint8_t* row = &job.mask[j*size*4];
+            float start  = 0.0f;
+            size_t numCrossings = crossings.size();
+            for (size_t c=0; c<=numCrossings; ++c)
+            {
+                float end = c<numCrossings ? crossings[c] : float(size);
+                if (inside)
+                {
+                    int first = std::max(int(std::ceil(start-0.5f)), 0);
+                    int last  = std::min(int(std::ceil(end-0.5f)), size);
+                    for (int i=first; i<last; ++i)
+                    {
+                        row[i*4+2] = code[0];
+                        row[i*4+3] = code[1];
+                    }
+                }
+                inside = !inside;
+                start  = std::max(start, end);
+            }
+        }
+    }
+}
+
+
+void AreaRasterizer::
+projectEdges(const Job& job, const Area& area, Edges& edges)
+{
+    typedef Homography::Projective::Matrix Matrix;
+
+    const Matrix& m    = job.projection.getMatrix();
+    const float   half = 0.5f * job.size;
+
+    edges.clear();
+    size_t numPoints = area.edges.size();
+    for (size_t i=0; i+1<numPoints; i+=2)
+    {
+        //transform the end points to homogeneous coordinates
+        double h[2][3];
+        for (int p=0; p<2; ++p)
+        {
+            const Geometry::Point<float,3>& pos = area.edges[i+p];
+            int rows[3] = {0, 1, 3};
+            for (int r=0; r<3; ++r)
+            {
+                h[p][r] = m(rows[r],0)*pos[0] + m(rows[r],1)*pos[1] +
+                          m(rows[r],2)*pos[2] + m(rows[r],3);
+            }
+        }
+
+        //clip the edge to the front of the projection
+        if (h[0][2]<MIN_PROJECTED_W && h[1][2]<MIN_PROJECTED_W)
+            continue;
+        for (int p=0; p<2; ++p)
+        {
+            if (h[p][2] < MIN_PROJECTED_W)
+            {
+                const double* o = h[1-p];
+                double t = (o[2]-MIN_PROJECTED_W) / (o[2]-h[p][2]);
+                for (int r=0; r<3; ++r)
+                    h[p][r] = o[r] + t*(h[p][r]-o[r]);
+            }
+        }
+
+        Edge edge;
+        edge.x0 = (h[0][0]/h[0][2] + 1.0) * half;
+        edge.y0 = (h[0][1]/h[0][2] + 1.0) * half;
+        edge.x1 = (h[1][0]/h[1][2] + 1.0) * half;
+        edge.y1 = (h[1][1]/h[1][2] + 1.0) * half;
+        edges.push_back(edge);
+    }
+}
+
+
+void AreaRasterizer::
+startWorkers()
+{
+    numWorkers = std::max(SETTINGS->mapAreaThreads, 1);
+    workers    = new Threads::Thread[numWorkers];
+    for (int i=0; i<numWorkers; ++i)
+        workers[i].start(this, &AreaRasterizer::workerThreadFunc);
+}
+
+void* AreaRasterizer::
+workerThreadFunc()
+{
+    Jobs job;
+    while (true)
+    {
+    //-- grab a job from the pending list
+        {
+            Threads::Mutex::Lock lock(mutex);
+            while (jobs.empty() && !terminate)
+                cond.wait(mutex);
+            if (terminate)
+                return NULL;
+
+            job.splice(job.end(), jobs, jobs.begin());
+        }
+
+    //-- rasterize the areas
+        rasterize(job.front());
+
+    //-- hand it back to the main thread
+        {
+            Threads::Mutex::Lock lock(mutex);
+            results.splice(results.end(), job);
+        }
+        Vrui::requestUpdate();
+    }
+
+    return NULL;
+}
+
+
+} //namespace crusta
@@ -0,0 +1,124 @@
+#ifndef _AreaRasterizer_H_
+#define _AreaRasterizer_H_
+
+#include <list>
+#include <vector>
+
+#include <crustacore/TreeIndex.h>
+#include <crusta/glbasics.h>
+#include <crusta/Homography.h>
+#include <crusta/map/SegmentIndex.h>
+
+#include <crusta/vrui.h>
+
+
+namespace crusta {
+
+
+struct NodeData;
+
+/**
+    Rasterizes the areas of the polygons overlapping the nodes into their
+    coverage masks, on a pool of worker threads. The mask of a node has the
+    resolution of its line coverage map and records, for every texel, the
+    line data offset of the fill of the topmost area covering it, encoded like
+    the offsets of the segments in the line coverage.
+
+    Only the edges of the outlines that cross a node are supplied. The
+    interior is determined by the parity of the crossings along a path from a
+    reference point (the centroid of the node), for which it is known whether
+    it lies within the area.
+*/
+class AreaRasterizer
+{
+public:
+    /** an area overlapping a node */
+    struct Area
+    {
+        /** flags whether the reference point lies within the area */
+        bool inside;
+        /** end points of the edges of the outline crossing the node, relative
+            to the node's centroid */
+        std::vector<Geometry::Point<float,3> > edges;
+    };
+    typedef std::vector<Area> Areas;
+
+    /** a rasterization of the areas of a node */
+    struct Job
+    {
+        /** node the mask is rasterized for */
+        NodeData* node;
+        /** index of the node (the node buffer might be reused meanwhile) */
+        TreeIndex index;
+        /** version of the areas the mask is rasterized from */
+        uint64_t version;
+        /** version of the coverage the edges were taken from */
+        SegmentIndex::Version coverageStamp;
+        /** projection of the centroid-relative positions onto the normalized
+            coverage map */
+        Homography::Projective projection;
+        /** resolution of the mask */
+        int size;
+        /** line data offset of the fill of the first area. Those of the
+            following areas are consecutive */
+        int firstOffset;
+        /** the areas in drawing order */
+        Areas areas;
+        /** fill colors of the areas */
+        Colors colors;
+        /** the rasterized RGBA mask. The offsets are stored in the blue and
+            alpha channels */
+        std::vector<uint8_t> mask;
+    };
+    typedef std::list<Job> Jobs;
+
+    AreaRasterizer();
+    ~AreaRasterizer();
+
+    /** queue rasterizations. The jobs are moved out of the list */
+    void push(Jobs& jobs);
+    /** retrieve the processed rasterizations */
+    void pop(Jobs& results);
+
+    /** rasterize the areas of a job into its mask */
+    static void rasterize(Job& job);
+
+protected:
+    /** edge of an outline projected onto the mask */
+    struct Edge
+    {
+        float x0, y0, x1, y1;
+    };
+    typedef std::vector<Edge> Edges;
+
+    /** project the edges of an area onto the mask, clipping them to the
+        front of the projection */
+    static void projectEdges(const Job& job, const Area& area, Edges& edges);
+
+    /** start the worker threads. They are started with the first jobs, such
+        that the settings are final */
+    void startWorkers();
+    /** entry point of the worker threads */
+    void* workerThreadFunc();
+
+    /** flags the worker threads to terminate */
+    bool terminate;
+    /** rasterizations waiting to be processed */
+    Jobs jobs;
+    /** rasterizations processed but not yet retrieved */
+    Jobs results;
+    /** guards the jobs and results */
+    Threads::Mutex mutex;
+    /** signals the worker threads that jobs are available */
+    Threads::Cond cond;
+    /** the worker threads */
+    Threads::Thread* workers;
+    /** number of worker threads */
+    int numWorkers;
+};
+
+
+} //namespace crusta
+
+
+#endif //_AreaRasterizer_H_
@@ -4,7 +4,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <sstream>
 
 #include <ogr_api.h>
@@ -12,7 +15,10 @@
 
 #include <crusta/checkGl.h>
 #include <crusta/Crusta.h>
+#include <crusta/map/MapSnapshot.h>
 #include <crusta/map/MapTool.h>
+#include <crusta/map/Placemark.h>
+#include <crusta/map/Polygon.h>
 #include <crusta/map/Polyline.h>
 #include <crusta/map/PolylineRenderer.h>
 #include <crusta/map/PolylineTool.h>
@@ -20,6 +26,8 @@
 #include <crusta/QuadNodeData.h>
 #include <crusta/QuadTerrain.h>
 #include <crusta/ResourceLocator.h>
+#include <crusta/Timer.h>
+#include <crustacore/Polyhedron.h>
 
 #include <crusta/vrui.h>
 
@@ -35,10 +43,111 @@
 namespace crusta {
 
 
+/** create a layer of a saved map, with a field for the symbol ids */
+static OGRLayer*
+createShapeLayer(OGRDataSource* source, const char* name,
+                 OGRSpatialReference& crustaSys, OGRwkbGeometryType type)
+{
+    OGRLayer* layer = source->CreateLayer(name, &crustaSys, type);
+    if (layer == NULL)
+    {
+        std::cout << "MapManager::Save: Error creating the " << name <<
+                     " layer: " << CPLGetLastErrorMsg() << std::endl;
+        return NULL;
+    }
+
+    //create a layer-field definition for outputting the symbol id
+    OGRFieldDefn fieldDef("Symbol", OFTInteger);
+    if (layer->CreateField(&fieldDef) != OGRERR_NONE)
+    {
+        std::cout << "MapManager::Save: Error creating the symbol Field:" <<
+                     CPLGetLastErrorMsg() << std::endl;
+        return NULL;
+    }
+
+    return layer;
+}
+
+/** add a feature with the given geometry and the symbol of a shape to a layer
+    of a saved map */
+static bool
+saveShapeFeature(OGRLayer* layer, const Shape* shape, OGRGeometry& geometry)
+{
+    OGRFeature* feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
+    if (feature == NULL)
+    {
+        std::cout << "MapManager::Save: Error creating feature: " <<
+                     CPLGetLastErrorMsg() << std::endl;
+        return false;
+    }
+
+    //output the symbol id and the geometry
+    feature->SetField("Symbol", shape->getSymbol().id);
+    feature->SetGeometry(&geometry);
+
+    if (layer->CreateFeature(feature) != OGRERR_NONE)
+    {
+        std::cout << "MapManager::Save: Error adding feature to layer: " <<
+                     CPLGetLastErrorMsg() << std::endl;
+        OGRFeature::DestroyFeature(feature);
+        return false;
+    }
+
+    OGRFeature::DestroyFeature(feature);
+    return true;
+}
+
+/** convert the control points of a shape to the lon,lat,elevation points of a
+    line string */
+static void
+saveControlPoints(const Shape* shape, const Geometry::Geoid<double>& sphere,
+                  OGRLineString& out)
+{
+    const Shape::ControlPointList& controlPoints = shape->getControlPoints();
+    for (Shape::ControlPointConstHandle cp=controlPoints.begin();
+         cp!=controlPoints.end(); ++cp)
+    {
+        Geometry::Point<double,3> lle = sphere.cartesianToGeodetic(cp->pos);
+        out.addPoint(Math::deg(lle[0]), Math::deg(lle[1]), lle[2]);
+    }
+}
+
+/** orders segments by their shape and starting control point */
+struct SegmentStartLess
+{
+    bool operator()(const SegmentIndex::Segment& a,
+                    const SegmentIndex::Segment& b) const
+    {
+        if (a.shape != b.shape)
+            return std::less<const Shape*>()(a.shape, b.shape);
+        return std::less<const Shape::ControlPoint*>()(&(*a.start),
+                                                       &(*b.start));
+    }
+};
+
+/** create a shape restored from a snapshot, with its saved id if it could be
+    claimed */
+template <class ShapeType>
+static ShapeType*
+restoreShape(Crusta* iCrusta, IdGenerator32& ids, uint32_t id, bool claimed,
+             std::vector<ShapeType*>& shapes)
+{
+    ShapeType* shape = new ShapeType(iCrusta);
+    shape->setId(claimed ? id : ids.grab());
+    shapes.push_back(shape);
+    return shape;
+}
+
+
 MapManager::
 MapManager(Vrui::ToolFactory* parentToolFactory, Crusta* iCrusta) :
     CrustaComponent(iCrusta), selectDistance(0.2), pointSelectionBias(0.1),
-    polylineIds(uint32_t(~0)), polylineRenderer(iCrusta)
+    polylineIds(uint32_t(~0)), polygonIds(uint32_t(~0)),
+    placemarkIds(uint32_t(~0)), terminateCoverage(false),
+    lineDataEditStamp(0), lineDataResetStamp(0), polylineRenderer(iCrusta),
+    areaVersion(1), terminateImport(false), importParsed(false),
+    importNext(0), importNumShapes(0), importNumSegments(0), snapshot(NULL),
+    lastAutosave(0.0)
 {
     Vrui::ToolFactory* factory = MapTool::init(parentToolFactory);
     PolylineTool::init(factory);
@@ -47,11 +156,26 @@ MapManager(Vrui::ToolFactory* parentToolFactory, Crusta* iCrusta) :
     activeShape = NULL;
 
     OGRRegisterAll();
+
+    coverageThread.start(this, &MapManager::coverageThreadFunc);
 }
 
 MapManager::
 ~MapManager()
 {
+    //let the coverage thread know that it should terminate
+    {
+        Threads::Mutex::Lock lock(coverageMutex);
+        terminateCoverage = true;
+    }
+    //make sure the thread is not stuck waiting for jobs
+    coverageCond.signal();
+    //wait for the termination
+    coverageThread.join();
+
+    //make sure a snapshot being written is complete
+    finishSnapshot();
+
     deleteAllShapes();
 
     OGRCleanupAll();
@@ -60,12 +184,35 @@ MapManager::
 void MapManager::
 deleteAllShapes()
 {
+    cancelImport();
+
     for (PolylinePtrs::iterator it=polylines.begin(); it!=polylines.end(); ++it)
     {
         polylineIds.release((*it)->getId());
         delete *it;
     }
     polylines.clear();
+    for (PolygonPtrs::iterator it=polygons.begin(); it!=polygons.end(); ++it)
+    {
+        polygonIds.release((*it)->getId());
+        delete *it;
+    }
+    polygons.clear();
+    for (PlacemarkPtrs::iterator it=placemarks.begin(); it!=placemarks.end();
+         ++it)
+    {
+        placemarkIds.release((*it)->getId());
+        delete *it;
+    }
+    placemarks.clear();
+    polylineIds.reset();
+    polygonIds.reset();
+    placemarkIds.reset();
+    {
+        Threads::Mutex::Lock lock(segmentIndexMutex);
+        segmentIndex.clear();
+    }
+    ++areaVersion;
 
 ///\todo actually track multiple tools
     activeShape = NULL;
@@ -74,99 +221,34 @@ deleteAllShapes()
 void MapManager::
 load(const char* filename)
 {
-    //get rid of any existing shapes
+    //get rid of any existing shapes (and any import still in progress)
     deleteAllShapes();
 
-    OGRDataSource* source = OGRSFDriverRegistrar::Open(filename);
-    if (source == NULL)
+    //snapshots are restored right away
+    if (MapSnapshot::isSnapshot(filename))
     {
-        std::cout << "MapManager::Load: Error opening file: " <<
-                     CPLGetLastErrorMsg() << std::endl;
-        return;
-    }
-
-    //for now just look at the first layer
-    OGRLayer* layer = source->GetLayerByName("Crusta_Polylines");
-    if (layer == NULL)
-    {
-        std::cout << "MapManager::Load: Error retrieving Crusta_Polylines" <<
-                     "Layer: " << CPLGetLastErrorMsg() << std::endl;
-        OGRDataSource::DestroyDataSource(source);
+        loadSnapshot(filename);
         return;
     }
 
-    //grab the index of the symbol field from the layer
-    OGRFeatureDefn* featureDef       = layer->GetLayerDefn();
-    int             symbolFieldIndex = featureDef->GetFieldIndex("Symbol");
-
-///\todo check the feature set of the layer here to make sure it has the needed
-
-    //create a sphere-geoid to convert the cartesian points to lat,lon,elevation
-    Geometry::Geoid<double> sphere(SETTINGS->globeRadius, 0.0);
-
-    //grab all the features and their control points (we assume polylines only)
-    OGRFeature* feature = NULL;
-
-///\todo do not restrict number of features read in
-int numFeatureLimit = 5000;
-int numFeature = 0;
-
-    layer->ResetReading();
-    while ( (feature = layer->GetNextFeature()) != NULL  && numFeature<numFeatureLimit)
-//    while ( (feature = layer->GetNextFeature()) != NULL)
-    {
-        OGRGeometry* geo = feature->GetGeometryRef();
-
-        if (geo!=NULL && geo->getGeometryType()==wkbLineString25D)
-        {
-            OGRLineString* in = (OGRLineString*)geo;
-            int numPoints = in->getNumPoints();
-
-///\todo figure out how to extract the shapes without the MapManager having to know all the shapes
-            std::vector<Geometry::Point<double,3> > cps;
-            for (int i=0; i<numPoints; ++i)
-            {
-                Geometry::Point<double,3> pos;
-                pos[0] = Math::rad(in->getX(i));
-                pos[1] = Math::rad(in->getY(i));
-                pos[2] = in->getZ(i);
-                pos = sphere.geodeticToCartesian(pos);
-
-                cps.push_back(pos);
-            }
-            if (!cps.empty())
-            {
-                //create new polyline and assign the control points
-                Polyline* out = createPolyline();
-                out->setControlPoints(cps);
-
-                //read in the symbol field and assign it
-                int symbolId = feature->GetFieldAsInteger(symbolFieldIndex);
-                SymbolMap::iterator symbol = symbolMap.find(symbolId);
-                if (symbol != symbolMap.end())
-                    out->setSymbol(symbol->second);
-                else
-                    out->setSymbol(Shape::DEFAULT_SYMBOL);
-            }
-        }
-
-        OGRFeature::DestroyFeature(feature);
-///\todo do not restrict number of features read in
-++numFeature;
-    }
-
-
-int numSegments = 0;
-for (PolylinePtrs::iterator pit=polylines.begin(); pit!=polylines.end(); ++pit)
-    numSegments += (*pit)->getControlPoints().size()-1;
-std::cerr << "Crusta: imported " << numSegments << " polyline segments\n";
-
-    OGRDataSource::DestroyDataSource(source);
+    //parse the features in the background and build the shapes as they come
+    importFile        = filename;
+    terminateImport   = false;
+    importParsed      = false;
+    importNumShapes   = 0;
+    importNumSegments = 0;
+    importThread.start(this, &MapManager::importThreadFunc);
 }
 
 void MapManager::
 save(const char* fileName, const char* format)
 {
+    if (strcmp(format, MapSnapshot::FORMAT_NAME) == 0)
+    {
+        saveSnapshot(fileName);
+        return;
+    }
+
 ///\todo change all the std::cout to throwing exceptions
     //initialize the output driver
     OGRSFDriver* driver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName(
@@ -187,11 +269,7 @@ save(const char* fileName, const char* format)
         return;
     }
 
-    //create a layer-field definition for outputting the symbol id
-    OGRFieldDefn fieldDef("Symbol", OFTInteger);
-
-///\todo create layers for all the different shape types to export
-    //create a (georeferenced) layer for the polylines
+    //create (georeferenced) layers for the different shape types
     OGRSpatialReference crustaSys;
     crustaSys.SetGeogCS((std::string("Crusta_")+SETTINGS->globeName).c_str(),
                         "Crusta_Sphere_Datum", SETTINGS->globeName.c_str(),
@@ -199,20 +277,23 @@ save(const char* fileName, const char* format)
                         "Reference_Meridian", 0.0, SRS_UA_DEGREE,
                         atof(SRS_UA_DEGREE_CONV));
 
-    OGRLayer* layer = source->CreateLayer("Crusta_Polylines", &crustaSys,
-                                          wkbLineString25D);
-    if (layer == NULL)
+    OGRLayer* lineLayer = createShapeLayer(source, "Crusta_Polylines",
+                                           crustaSys, wkbLineString25D);
+    OGRLayer* areaLayer = NULL;
+    if (lineLayer!=NULL && !polygons.empty())
     {
-        std::cout << "MapManager::Save: Error creating the Crusta_Polylines " <<
-                     "layer: " <<CPLGetLastErrorMsg() << std::endl;
-        OGRDataSource::DestroyDataSource(source);
-        return;
+        areaLayer = createShapeLayer(source, "Crusta_Polygons", crustaSys,
+                                     wkbPolygon25D);
     }
-
-    if (layer->CreateField(&fieldDef) != OGRERR_NONE)
+    OGRLayer* pointLayer = NULL;
+    if (lineLayer!=NULL && !placemarks.empty())
+    {
+        pointLayer = createShapeLayer(source, "Crusta_Points", crustaSys,
+                                      wkbPoint25D);
+    }
+    if (lineLayer==NULL || (areaLayer==NULL && !polygons.empty()) ||
+        (pointLayer==NULL && !placemarks.empty()))
     {
-        std::cout << "MapManager::Save: Error creating the symbol Field:" <<
-                     CPLGetLastErrorMsg() << std::endl;
         OGRDataSource::DestroyDataSource(source);
         return;
     }
@@ -222,45 +303,138 @@ save(const char* fileName, const char* format)
 
     for (PolylinePtrs::iterator in=polylines.begin(); in!=polylines.end(); ++in)
     {
-        OGRFeature* feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
-        if (feature == NULL)
+        //output the polyline geometry
+        OGRLineString out;
+        saveControlPoints(*in, sphere, out);
+        if (!saveShapeFeature(lineLayer, *in, out))
         {
-            std::cout << "MapManager::Save: Error creating feature: " <<
-                         CPLGetLastErrorMsg() << std::endl;
             OGRDataSource::DestroyDataSource(source);
             return;
         }
+    }
 
-        //output the symbol id
-        feature->SetField("Symbol", (*in)->getSymbol().id);
-
-        //output the polyline geometry
-        OGRLineString out;
-        Shape::ControlPointList& controlPoints = (*in)->getControlPoints();
-        for (Shape::ControlPointHandle cp=controlPoints.begin();
-             cp!=controlPoints.end(); ++cp)
-         {
-            Geometry::Point<double,3> lle = sphere.cartesianToGeodetic(cp->pos);
-            out.addPoint(Math::deg(lle[0]), Math::deg(lle[1]), lle[2]);
-         }
-
-        feature->SetGeometry(&out);
-
-        if (layer->CreateFeature(feature) != OGRERR_NONE)
+    for (PolygonPtrs::iterator in=polygons.begin(); in!=polygons.end(); ++in)
+    {
+        //output the outline as the exterior ring of the polygon geometry
+        OGRLinearRing ring;
+        saveControlPoints(*in, sphere, ring);
+        OGRPolygon out;
+        out.addRing(&ring);
+        if (!saveShapeFeature(areaLayer, *in, out))
         {
-            std::cout << "MapManager::Save: Error adding feature to layer: " <<
-                         CPLGetLastErrorMsg() << std::endl;
-            OGRFeature::DestroyFeature(feature);
             OGRDataSource::DestroyDataSource(source);
             return;
         }
+    }
 
-        OGRFeature::DestroyFeature(feature);
+    for (PlacemarkPtrs::iterator in=placemarks.begin(); in!=placemarks.end();
+         ++in)
+    {
+        //output the point geometry
+        Geometry::Point<double,3> lle =
+            sphere.cartesianToGeodetic((*in)->getPosition());
+        OGRPoint out(Math::deg(lle[0]), Math::deg(lle[1]), lle[2]);
+        if (!saveShapeFeature(pointLayer, *in, out))
+        {
+            OGRDataSource::DestroyDataSource(source);
+            return;
+        }
     }
 
     OGRDataSource::DestroyDataSource(source);
 }
 
+void MapManager::
+saveSnapshot(const char* fileName, bool saveKeys)
+{
+    //wait for the previous snapshot to be written
+    finishSnapshot();
+
+    //gather the shapes in the order they are restored
+    std::vector<Shape*>   shapes;
+    std::vector<uint32_t> types;
+    shapes.insert(shapes.end(), polylines.begin(), polylines.end());
+    types.resize(shapes.size(), MapSnapshot::POLYLINE);
+    shapes.insert(shapes.end(), polygons.begin(), polygons.end());
+    types.resize(shapes.size(), MapSnapshot::POLYGON);
+    shapes.insert(shapes.end(), placemarks.begin(), placemarks.end());
+    types.resize(shapes.size(), MapSnapshot::PLACEMARK);
+
+    uint64_t numPoints = 0;
+    for (std::vector<Shape*>::iterator it=shapes.begin(); it!=shapes.end();
+         ++it)
+    {
+        numPoints += (*it)->getControlPoints().size();
+    }
+
+    //the keys of the segments are only valid for the same base polyhedron
+    const Polyhedron* polyhedron = DATAMANAGER->getPolyhedron();
+    std::string polyhedronType = polyhedron!=NULL ? polyhedron->getType() :
+                                                    std::string();
+
+    //sort the segments of the index for the look up of their keys
+    SegmentIndex::Segments segments;
+    if (saveKeys)
+    {
+        {
+            Threads::Mutex::Lock lock(segmentIndexMutex);
+            segmentIndex.getSegments(segments);
+        }
+        std::sort(segments.begin(), segments.end(), SegmentStartLess());
+    }
+
+    snapshot = new MapSnapshot;
+    snapshot->create(shapes.size(), numPoints, saveKeys, SETTINGS->globeRadius,
+                     polyhedronType);
+
+    MapSnapshot::ShapeRecord* record = snapshot->getShapes();
+    double*   point = snapshot->getPoints();
+    uint64_t* key   = saveKeys ? snapshot->getKeys() : NULL;
+    for (size_t i=0; i<shapes.size(); ++i, ++record)
+    {
+        Shape* shape = shapes[i];
+        Shape::ControlPointList& controlPoints = shape->getControlPoints();
+
+        record->type      = types[i];
+        record->id        = shape->getId();
+        record->symbolId  = shape->getSymbol().id;
+        record->numPoints = controlPoints.size();
+
+        for (Shape::ControlPointHandle cp=controlPoints.begin();
+             cp!=controlPoints.end(); ++cp, point+=3)
+        {
+            point[0] = cp->pos[0];
+            point[1] = cp->pos[1];
+            point[2] = cp->pos[2];
+
+            if (key == NULL)
+                continue;
+
+            //the last point of the shape doesn't start a segment
+            Shape::ControlPointHandle next = cp; ++next;
+            if (next == controlPoints.end())
+            {
+                *(key++) = 0;
+                continue;
+            }
+
+            /* segments missing from the index (e.g. added since the copy of
+               its segments) have their key computed */
+            SegmentIndex::Segments::const_iterator seg = std::lower_bound(
+                segments.begin(), segments.end(),
+                SegmentIndex::Segment(0, shape, cp), SegmentStartLess());
+            bool found = seg!=segments.end() && seg->shape==shape &&
+                         seg->start==cp;
+            *(key++) = found ? seg->key :
+                               SegmentIndex::computeKey(cp->pos, next->pos);
+        }
+    }
+
+    //write the snapshot in the background
+    snapshotFile = fileName;
+    snapshotThread.start(this, &MapManager::snapshotThreadFunc);
+}
+
 
 int MapManager::
 registerMappingTool()
@@ -346,6 +520,63 @@ deletePolyline(Polyline* line)
     }
 }
 
+Polygon* MapManager::
+createPolygon()
+{
+    Polygon* polygon = new Polygon(crusta);
+    polygon->setId(polygonIds.grab());
+    polygons.push_back(polygon);
+    return polygon;
+}
+
+MapManager::PolygonPtrs& MapManager::
+getPolygons()
+{
+    return polygons;
+}
+
+void MapManager::
+deletePolygon(Polygon* polygon)
+{
+    PolygonPtrs::iterator it =
+        std::find(polygons.begin(), polygons.end(), polygon);
+    if (it != polygons.end())
+    {
+        polygonIds.release((*it)->getId());
+        delete *it;
+        polygons.erase(it);
+        ++areaVersion;
+    }
+}
+
+Placemark* MapManager::
+createPlacemark()
+{
+    Placemark* placemark = new Placemark(crusta);
+    placemark->setId(placemarkIds.grab());
+    placemarks.push_back(placemark);
+    return placemark;
+}
+
+MapManager::PlacemarkPtrs& MapManager::
+getPlacemarks()
+{
+    return placemarks;
+}
+
+void MapManager::
+deletePlacemark(Placemark* placemark)
+{
+    PlacemarkPtrs::iterator it =
+        std::find(placemarks.begin(), placemarks.end(), placemark);
+    if (it != placemarks.end())
+    {
+        placemarkIds.release((*it)->getId());
+        delete *it;
+        placemarks.erase(it);
+    }
+}
+
 
 void MapManager::
 addShapeCoverage(Shape* shape, const Shape::ControlPointHandle& startCP,
@@ -362,389 +593,1296 @@ for (Shape::ControlPointHandle s=startCP; s!=endCP; ++s)
 std::cerr << " )\n\n";
 )
 
-    Shape::ControlPointHandle end = startCP;
-    if (end != endCP) ++end;
+    Shape::ControlPointHandle end = startCP;
+    if (end != endCP) ++end;
+
+    //traverse all the segments of the specified range
+    for (Shape::ControlPointHandle start=startCP; end!=endCP; ++start, ++end)
+    {
+CRUSTA_DEBUG(42, std::cerr << "adding segment " << start << "\n";)
+        //index the segment
+        SegmentIndex::Version version;
+        {
+            Threads::Mutex::Lock lock(segmentIndexMutex);
+            segmentIndex.add(shape, start);
+            version = segmentIndex.getVersion();
+        }
+        //invalidate the coverage of the active nodes
+        ShapeCoverageInvalidator invalidator(version);
+        crusta->segmentCoverage(start->pos, end->pos, invalidator);
+CRUSTA_DEBUG(42, std::cerr << "\n";)
+    }
+
+CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
+CRUSTA_DEBUG(41, std::cerr << "--ADD\n\n";)
+}
+
+void MapManager::
+removeShapeCoverage(Shape* shape, const Shape::ControlPointHandle& startCP,
+    const Shape::ControlPointHandle& endCP)
+{
+CRUSTA_DEBUG(41, std::cerr << "++REM line " << shape->getId() << " ( ";
+for (Shape::ControlPointHandle s=startCP; s!=endCP; ++s)
+{
+    if (s==startCP)
+        std::cerr << s;
+    else
+        std::cerr << " | " << s;
+}
+std::cerr << " )\n";
+)
+
+    Shape::ControlPointHandle end = startCP;
+    if (end != endCP) ++end;
+
+    //traverse all the segments of the specified range
+    for (Shape::ControlPointHandle start=startCP; end!=endCP; ++start, ++end)
+    {
+CRUSTA_DEBUG(42, std::cerr << "removing segment " << start << "\n";)
+        //drop the segment
+        SegmentIndex::Version version;
+        {
+            Threads::Mutex::Lock lock(segmentIndexMutex);
+            segmentIndex.remove(shape, start);
+            version = segmentIndex.getVersion();
+        }
+        //invalidate the coverage of the active nodes
+        ShapeCoverageInvalidator invalidator(version);
+        crusta->segmentCoverage(start->pos, end->pos, invalidator);
+CRUSTA_DEBUG(49, crusta->confirmLineCoverageRemoval(shape, start);)
+CRUSTA_DEBUG(42, std::cerr << "\n";)
+    }
+
+CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
+CRUSTA_DEBUG(41, std::cerr << "--REM\n\n";)
+}
+
+void MapManager::
+updateShapeData(Shape* shape, const Shape::ControlPointHandle& startCP,
+    const Shape::ControlPointHandle& endCP)
+{
+    if (!SETTINGS->lineDecorated)
+    {
+        /* the line data isn't maintained without decoration, have it all
+           generated once decoration is enabled */
+        lineDataResetStamp = CURRENT_FRAME;
+        return;
+    }
+
+    {
+        Threads::Mutex::Lock lock(segmentIndexMutex);
+        lineDataEditStamp = CURRENT_FRAME;
+    }
+
+    Shape::ControlPointHandle end = startCP;
+    if (end != endCP) ++end;
+
+    //flag the segments in the line data of the nodes they overlap
+    ShapeDataInvalidator invalidator(dirtyLineNodes);
+    for (Shape::ControlPointHandle start=startCP; end!=endCP; ++start, ++end)
+    {
+        invalidator.setSegment(&(*start));
+        crusta->segmentCoverage(start->pos, end->pos, invalidator);
+    }
+}
+
+void MapManager::
+updateShapeSymbol(Shape* shape)
+{
+    //shapes without segments (e.g. being created) have nothing to update
+    Shape::ControlPointList& controlPoints = shape->getControlPoints();
+    if (controlPoints.size() < 2)
+        return;
+
+    //the fill of polygons is derived from the symbol
+    if (dynamic_cast<Polygon*>(shape) != NULL)
+        updateShapeArea(shape);
+
+    //the colors of the symbols are part of the vertices of all the nodes
+    polylineRenderer.invalidate();
+    updateShapeData(shape, controlPoints.begin(), controlPoints.end());
+}
+
+void MapManager::
+updateShapeArea(Shape*)
+{
+    ++areaVersion;
+}
+
+void MapManager::
+inheritShapeCoverage(const NodeData& parent, NodeData& child)
+{
+    //pass on the outdated state of the subtree
+    child.lineInheritStamp = std::max(child.lineInheritStamp,
+                                      parent.lineInheritStamp);
+    child.lineInheritDataStamp = std::max(child.lineInheritDataStamp,
+                                          parent.lineInheritDataStamp);
+
+    /* the child's line data is outdated if generated before the
+       modifications (tool stamps are a frame behind, hence <=) */
+    if (child.lineDataStamp <= parent.lineInheritDataStamp)
+    {
+        child.lineNumSegments = 0;
+        child.lineData.clear();
+    }
+
+    //the child's coverage is up to date if derived after the modifications
+    if (child.lineCoverageStamp >= parent.lineInheritStamp)
+        return;
+
+    /* leave the derivation to the background, as this happens as the
+       terrain is refined. The child is rendered without coverage meanwhile */
+    child.lineCoverage.clear();
+    child.lineCoverageMinStamp = std::max(child.lineCoverageMinStamp,
+                                          parent.lineInheritStamp);
+    if (!child.lineCoverageDirty)
+        child.lineCoverageDeferred = true;
+    child.lineCoverageDirty = true;
+    child.lineNumSegments   = 0;
+    child.lineData.clear();
+}
+
+void MapManager::
+deriveShapeCoverage(NodeData& node)
+{
+    {
+        Threads::Mutex::Lock lock(segmentIndexMutex);
+        segmentIndex.query(node.index, node.scope, node.lineCoverage);
+        node.lineCoverageStamp    = segmentIndex.getVersion();
+        node.lineInheritDataStamp = lineDataEditStamp;
+    }
+
+    /* the cached subtree might have missed modifications while the node
+       wasn't available, have it checked when the node is refined */
+    node.lineCoverageMinStamp = node.lineCoverageStamp;
+    node.lineInheritStamp     = node.lineCoverageStamp;
+    node.lineCoverageDirty    = false;
+    node.lineCoverageDeferred = false;
+    node.lineCoveragePending  = false;
+
+    //invalidate the node's line data
+    node.lineNumSegments = 0;
+    node.lineData.clear();
+}
+
+
+void MapManager::
+updateLineCoverage(SurfaceApproximation& surface)
+{
+statsMan.start(StatsManager::INHERITSHAPECOVERAGE);
+
+    //install the coverages derived in the background
+    CoverageJobs results;
+    {
+        Threads::Mutex::Lock lock(coverageMutex);
+        results.splice(results.end(), coverageResults);
+    }
+    for (CoverageJobs::iterator it=results.begin(); it!=results.end(); ++it)
+    {
+        NodeData& node = *it->node;
+        //make sure the buffer still holds the same node
+        if (node.index != it->index)
+            continue;
+        node.lineCoveragePending = false;
+
+        /* the coverage might have been derived in the meantime or modified
+           after the derivation (in which case it is scheduled again) */
+        if (!node.lineCoverageDirty || !node.lineCoverageDeferred ||
+            it->stamp<node.lineCoverageMinStamp)
+        {
+            continue;
+        }
+
+        node.lineCoverage.swap(it->coverage);
+        node.lineCoverageStamp = it->stamp;
+        node.lineCoverageDirty = false;
+
+        //invalidate the node's line data
+        node.lineNumSegments = 0;
+        node.lineData.clear();
+    }
+
+    //update the outdated coverages of the visible nodes
+    CoverageJobs jobs;
+    size_t numNodes = surface.numVisibles();
+    for (size_t i=0; i<numNodes; ++i)
+    {
+        NodeData& node = surface.visibleNode(i);
+        if (!node.lineCoverageDirty)
+            continue;
+
+        if (!node.lineCoverageDeferred)
+        {
+            /* coverage modified by editing the shapes is derived right away,
+               such that the modifications show up immediately */
+            SegmentIndex::Version inherit     = node.lineInheritStamp;
+            FrameStamp            inheritData = node.lineInheritDataStamp;
+            deriveShapeCoverage(node);
+            //the subtree was invalidated along with the node if necessary
+            node.lineInheritStamp     = inherit;
+            node.lineInheritDataStamp = inheritData;
+        }
+        else if (!node.lineCoveragePending)
+        {
+            jobs.push_back(CoverageJob());
+            CoverageJob& job = jobs.back();
+            job.node  = &node;
+            job.index = node.index;
+            job.scope = node.scope;
+            job.stamp = 0;
+            node.lineCoveragePending = true;
+        }
+    }
+    if (!jobs.empty())
+    {
+        Threads::Mutex::Lock lock(coverageMutex);
+        coverageJobs.splice(coverageJobs.end(), jobs);
+        coverageCond.signal();
+    }
+
+CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
+
+statsMan.stop(StatsManager::INHERITSHAPECOVERAGE);
+}
+
+
+void MapManager::
+updateLineData(SurfaceApproximation& surface)
+{
+statsMan.start(StatsManager::UPDATELINEDATA);
+
+    //generate the data of the render nodes that have none
+    size_t numNodes = surface.numVisibles();
+    for (size_t i=0; i<numNodes; ++i)
+    {
+        NodeData& node = surface.visibleNode(i);
+
+        /* there is coverage but no line data (result of coverage
+           modifications since the mapmanager clears the data) or all the
+           data has been outdated */
+        if (!node.lineCoverage.empty() &&
+            (node.lineData.empty() ||
+             node.lineDataFullStamp<=lineDataResetStamp))
+        {
+            generateLineData(node);
+        }
+    }
+
+    //rewrite the outdated segments of the nodes flagged by modifications
+    for (DirtyNodes::iterator it=dirtyLineNodes.begin();
+         it!=dirtyLineNodes.end(); ++it)
+    {
+        //make sure the buffer still holds the same node
+        if (it->node->index == it->index)
+            rewriteLineData(*it->node);
+    }
+    dirtyLineNodes.clear();
+
+statsMan.stop(StatsManager::UPDATELINEDATA);
+}
+
+void MapManager::
+updateLineVertices(SurfaceApproximation& surface)
+{
+statsMan.start(StatsManager::UPDATELINEDATA);
+    polylineRenderer.update(surface);
+statsMan.stop(StatsManager::UPDATELINEDATA);
+}
+
+
+void MapManager::
+updateAreaCoverage(SurfaceApproximation& surface)
+{
+statsMan.start(StatsManager::UPDATELINEDATA);
+
+    //install the masks rasterized in the background
+    AreaRasterizer::Jobs results;
+    areaRasterizer.pop(results);
+    for (AreaRasterizer::Jobs::iterator it=results.begin(); it!=results.end();
+         ++it)
+    {
+        NodeData& node = *it->node;
+        //make sure the buffer still holds the same node
+        if (node.index != it->index)
+            continue;
+        node.lineAreaPending = false;
+
+        /* the outlines must stem from the current coverage. Masks of outdated
+           areas still replace older ones, the node is scheduled again */
+        if (node.lineCoverageDirty ||
+            it->coverageStamp!=node.lineCoverageStamp)
+        {
+            continue;
+        }
+        installAreaMask(node, *it);
+    }
+
+    //schedule the rasterization of the outdated masks of the visible nodes
+    AreaRasterizer::Jobs jobs;
+    size_t numNodes = surface.numVisibles();
+    for (size_t i=0; i<numNodes; ++i)
+    {
+        NodeData& node = surface.visibleNode(i);
+
+        //the outlines are taken from the coverage, which must be current
+        if (node.lineCoverageDirty || node.lineAreaPending)
+            continue;
+        if (node.lineAreaVersion==areaVersion &&
+            node.lineAreaCoverageStamp==node.lineCoverageStamp)
+        {
+            continue;
+        }
+
+        jobs.push_back(AreaRasterizer::Job());
+        AreaRasterizer::Job& job = jobs.back();
+        if (prepareAreaJob(node, job))
+            node.lineAreaPending = true;
+        else
+        {
+            //no areas overlap the node, there is nothing to rasterize
+            installAreaMask(node, job);
+            jobs.pop_back();
+        }
+    }
+    areaRasterizer.push(jobs);
+
+statsMan.stop(StatsManager::UPDATELINEDATA);
+}
+
+
+void MapManager::
+processVerticalScaleChange()
+{
+statsMan.start(StatsManager::PROCESSVERTICALSCALE);
+
+    /* the line data, its coordinates and the area masks are independent of
+       the scale. Only the vertices of the undecorated lines are outdated */
+    polylineRenderer.rescale();
+
+statsMan.stop(StatsManager::PROCESSVERTICALSCALE);
+}
+
+void MapManager::
+frame()
+{
+    processImport();
+
+    /* take periodic snapshots of the map, unless an import is in progress or
+       there is nothing to save (that would overwrite a previous session) */
+    bool hasShapes = !polylines.empty() || !polygons.empty() ||
+                     !placemarks.empty();
+    if (SETTINGS->mapAutosaveInterval>0.0 && importThread.isJoined() &&
+        hasShapes)
+    {
+        double now = Vrui::getApplicationTime();
+        if (now-lastAutosave >= SETTINGS->mapAutosaveInterval)
+        {
+            lastAutosave = now;
+            saveSnapshot(SETTINGS->mapAutosaveFile.c_str());
+        }
+    }
+}
+
+void MapManager::
+display(GLContextData& contextData, const SurfaceApproximation& surface) const
+{
+    if (!SETTINGS->lineDecorated)
+        polylineRenderer.display(contextData, surface);
+    displayPlacemarks(contextData);
+}
+
+
+void MapManager::
+displayPlacemarks(GLContextData& contextData) const
+{
+    if (placemarks.empty())
+        return;
+
+    CHECK_GLA
+
+    //the points are specified relative to the viewer to preserve precision
+    const Vrui::DisplayState& displayState =
+        Vrui::getDisplayState(contextData);
+    Vrui::Point origin = displayState.viewer->getHeadPosition();
+    origin = Vrui::getInverseNavigationTransformation().transform(origin);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_DEPTH_BUFFER_BIT |
+                 GL_COLOR_BUFFER_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_POINT_SMOOTH);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_BLEND);
+
+    glPushMatrix();
+    Vrui::NavTransform nav = displayState.modelviewNavigational;
+    nav *= Vrui::NavTransform::translate(origin - Vrui::Point::origin);
+    glLoadMatrix(nav);
+
+    //draw the visible placemarks, then the hidden ones dimmed
+    for (int pass=0; pass<2; ++pass)
+    {
+        glDepthFunc(pass==0 ? GL_LEQUAL : GL_GREATER);
+        glPointSize(pass==0 ? SETTINGS->mapPointSize :
+                              0.5f*SETTINGS->mapPointSize);
+
+        glBegin(GL_POINTS);
+        for (PlacemarkPtrs::const_iterator it=placemarks.begin();
+             it!=placemarks.end(); ++it)
+        {
+            if ((*it)->getControlPoints().empty())
+                continue;
+
+            Color color = (*it)->getSymbol().color;
+            if (pass == 1)
+                color[3] *= 0.33f;
+            glColor(color);
+
+            const Geometry::Point<double,3> pos =
+                crusta->mapToScaledGlobe((*it)->getPosition());
+            glVertex3f(pos[0]-origin[0], pos[1]-origin[1], pos[2]-origin[2]);
+        }
+        glEnd();
+    }
+
+    glPopMatrix();
+    glPopAttrib();
+    CHECK_GLA
+}
+
+
+void MapManager::
+addMenuEntry(GLMotif::Menu* mainMenu)
+{
+    //add the control dialog
+    produceMapControlDialog(mainMenu);
+    //add the symbols submenu
+    produceMapSymbolSubMenu(mainMenu);
+}
+
+void MapManager::
+openSymbolsGroupCallback(GLMotif::Button::SelectCallbackData* cbData)
+{
+    //open the dialog at the same position as the main menu
+    Vrui::popupPrimaryWidget(symbolGroupMap[cbData->button->getName()]);
+}
+
+void MapManager::
+symbolChangedCallback(GLMotif::ListBox::ItemSelectedCallbackData* cbData)
+{
+    std::string symbolName(cbData->listBox->getParent()->getName());
+    symbolName  += std::string("-");
+    symbolName  += std::string(cbData->listBox->getItem(cbData->selectedItem));
+    int symbolId = symbolNameMap[symbolName];
+    activeSymbol = symbolMap[symbolId];
+
+///\todo process the change for multiple activeShapes
+    if (activeShape != NULL)
+    {
+        activeShape->setSymbol(activeSymbol);
+        mapSymbolLabel->setString(symbolName.c_str());
+    }
+}
+
+void MapManager::
+closeSymbolsGroupCallback(GLMotif::Button::SelectCallbackData* cbData)
+{
+    Vrui::popdownPrimaryWidget(symbolGroupMap[cbData->button->getName()]);
+}
+
+
+MapManager::DirtyNode::
+DirtyNode(NodeData* iNode) :
+    node(iNode), index(iNode->index)
+{
+}
+
+
+MapManager::ShapeDataInvalidator::
+ShapeDataInvalidator(DirtyNodes& iDirtyNodes) :
+    dirtyNodes(iDirtyNodes), segment(NULL)
+{
+}
+
+void MapManager::ShapeDataInvalidator::
+setSegment(const Shape::ControlPoint* iSegment)
+{
+    segment = iSegment;
+}
+
+void MapManager::ShapeDataInvalidator::
+operator()(NodeData& node, bool isLeaf)
+{
+    //make sure that the cached subtree updates its data when refined
+    if (isLeaf)
+        node.lineInheritDataStamp = CURRENT_FRAME;
+
+    //data that has not been generated yet is generated in full
+    if (node.lineData.empty())
+        return;
+
+    //queue the node with its first outdated segment
+    if (node.lineDirtySegments.empty())
+        dirtyNodes.push_back(DirtyNode(&node));
+    node.lineDirtySegments.push_back(segment);
+}
+
+
+MapManager::ShapeCoverageInvalidator::
+ShapeCoverageInvalidator(SegmentIndex::Version iVersion) :
+    version(iVersion)
+{
+}
+
+void MapManager::ShapeCoverageInvalidator::
+operator()(NodeData& node, bool isLeaf)
+{
+CRUSTA_DEBUG(43, std::cerr << "~" << node.index;)
+
+    //the coverage has to be derived again from the segment index
+    node.lineCoverage.clear();
+    node.lineCoverageMinStamp = version;
+    node.lineCoverageDirty    = true;
+    node.lineCoverageDeferred = false;
+
+    //invalidate current line data
+    node.lineNumSegments = 0;
+    node.lineData.clear();
+
+    //make sure that the subtree updates its coverage when refined
+    if (isLeaf)
+    {
+CRUSTA_DEBUG(44, std::cerr << "~";)
+        node.lineInheritStamp = version;
+    }
+CRUSTA_DEBUG(44, std::cerr << "\n";)
+}
+
+
+void MapManager::
+generateLineData(NodeData& node)
+{
+    typedef NodeData::ShapeCoverage Coverage;
+
+    const int lineTexSize = SETTINGS->lineDataTexSize;
+
+    Coverage&         coverage = node.lineCoverage;
+    std::vector<int>& offsets  = node.lineCoverageOffsets;
+    Colors&           data     = node.lineData;
+
+CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
+
+//record the update to this node
+statsMan.incrementDataUpdated();
+
+CRUSTA_DEBUG(50, std::cerr << "###REGEN n(" << node.index << ") :\n" <<
+coverage << "\n\n";)
 
-    //setup the segment invariant part of the adder
-    ShapeCoverageAdder adder;
-    adder.setShape(shape);
+//- reset the current data offsets
+    data.clear();
+    offsets.clear();
+    node.lineDirtySegments.clear();
+    int curOff = 0;
 
-    //traverse all the segments of the specified range
-    for (Shape::ControlPointHandle start=startCP; end!=endCP; ++start, ++end)
+//- go through all the segments for that node and dump the data
+    //the end of the data is reserved for the fills of the areas
+    for (Coverage::iterator sit=coverage.begin(); sit!=coverage.end() &&
+         curOff+SEGMENT_TEXELS<=lineTexSize-MAX_NODE_AREAS; ++sit)
     {
-CRUSTA_DEBUG(42, std::cerr << "adding segment " << start << "\n";)
-        //setup the current segment and traverse
-        adder.setSegment(start);
-        crusta->segmentCoverage(start->pos, end->pos, adder);
-CRUSTA_DEBUG(42, std::cerr << "\n";)
+        //save the offset to the data
+        offsets.push_back(curOff);
+
+        data.resize(curOff + SEGMENT_TEXELS);
+        encodeSegment(node, *sit, &data[curOff]);
+        curOff += SEGMENT_TEXELS;
     }
 
-CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
-CRUSTA_DEBUG(41, std::cerr << "--ADD\n\n";)
+    //update the stamps of the line data and the segment count
+    node.lineNumSegments    = static_cast<int>(offsets.size());
+    node.lineDataStamp      = CURRENT_FRAME;
+    node.lineDataFullStamp  = CURRENT_FRAME;
+    node.lineDataDirtyBegin = 0;
+    node.lineDataDirtyEnd   = 0;
 }
 
 void MapManager::
-removeShapeCoverage(Shape* shape, const Shape::ControlPointHandle& startCP,
-    const Shape::ControlPointHandle& endCP)
-{
-CRUSTA_DEBUG(41, std::cerr << "++REM line " << shape->getId() << " ( ";
-for (Shape::ControlPointHandle s=startCP; s!=endCP; ++s)
+rewriteLineData(NodeData& node)
 {
-    if (s==startCP)
-        std::cerr << s;
-    else
-        std::cerr << " | " << s;
-}
-std::cerr << " )\n";
-)
+    typedef std::vector<const Shape::ControlPoint*> ControlPoints;
 
-    Shape::ControlPointHandle end = startCP;
-    if (end != endCP) ++end;
+    ControlPoints& dirty = node.lineDirtySegments;
+    if (dirty.empty())
+        return;
 
-    //setup the segment invariant part the remover
-    ShapeCoverageRemover remover;
-    remover.setShape(shape);
+    /* data that is missing or outdated altogether is generated in full when
+       the node is rendered */
+    if (node.lineData.empty() || node.lineDataFullStamp<=lineDataResetStamp)
+    {
+        dirty.clear();
+        return;
+    }
 
-    //traverse all the segments of the specified range
-    for (Shape::ControlPointHandle start=startCP; end!=endCP; ++start, ++end)
+CRUSTA_DEBUG(50, std::cerr << "###REWRITE n(" << node.index << ") : " <<
+dirty.size() << " segments\n\n";)
+
+    //look up the segments of the coverage in the sorted dirty ones
+    std::sort(dirty.begin(), dirty.end());
+
+    const NodeData::ShapeCoverage& coverage = node.lineCoverage;
+    int& begin = node.lineDataDirtyBegin;
+    int& end   = node.lineDataDirtyEnd;
+    bool rewritten = false;
+    for (int i=0; i<node.lineNumSegments; ++i)
     {
-CRUSTA_DEBUG(42, std::cerr << "removing segment " << start << "\n";)
-        //setup the current segment and traverse
-        remover.setSegment(start);
-        crusta->segmentCoverage(start->pos, end->pos, remover);
-CRUSTA_DEBUG(49, crusta->confirmLineCoverageRemoval(shape, start);)
-CRUSTA_DEBUG(42, std::cerr << "\n";)
+        const Shape::ControlPoint* start = &(*coverage[i].start);
+        if (!std::binary_search(dirty.begin(), dirty.end(), start))
+            continue;
+
+        int offset = node.lineCoverageOffsets[i];
+        encodeSegment(node, coverage[i], &node.lineData[offset]);
+
+        //extend the range of modified data
+        if (begin == end)
+        {
+            begin = offset;
+            end   = offset + SEGMENT_TEXELS;
+        }
+        else
+        {
+            begin = std::min(begin, offset);
+            end   = std::max(end, offset + SEGMENT_TEXELS);
+        }
+        rewritten = true;
     }
+    dirty.clear();
 
-CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
-CRUSTA_DEBUG(41, std::cerr << "--REM\n\n";)
+    if (rewritten)
+        node.lineDataStamp = CURRENT_FRAME;
 }
 
 void MapManager::
-inheritShapeCoverage(const NodeData& parent, NodeData& child)
+encodeSegment(const NodeData& node, const SegmentIndex::Segment& segment,
+              Color* texels) const
 {
-statsMan.start(StatsManager::INHERITSHAPECOVERAGE);
-
-    typedef NodeData::ShapeCoverage        Coverage;
-    typedef Shape::ControlPointHandleList  HandleList;
-    typedef Shape::ControlPointConstHandle Handle;
+    typedef Shape::ControlPointHandle Handle;
+
+    const Polyline* line = dynamic_cast<const Polyline*>(segment.shape);
+    assert(line != NULL);
+    const Shape::Symbol& symbol = line->getSymbol();
+
+    Handle cur  = segment.start;
+    Handle next = cur; ++cur;
+
+    const Geometry::Point<double,3>& curP  = cur->pos;
+    const Geometry::Point<double,3>& nextP = next->pos;
+    Geometry::Point<float,3> curPf(curP[0] - node.centroid[0],
+                  curP[1] - node.centroid[1],
+                  curP[2] - node.centroid[2]);
+    Geometry::Point<float,3> nextPf(nextP[0] - node.centroid[0],
+                   nextP[1] - node.centroid[1],
+                   nextP[2] - node.centroid[2]);
+
+    const Scalar& curC  = cur->coord;
+    const Scalar& nextC = next->coord;
+
+    //the atlas information for this segment
+    texels[0] = symbol.originSize;
+
+    //segment control points on the unscaled globe
+    texels[1] = Color( curPf[0],  curPf[1],  curPf[2],  curC);
+    texels[2] = Color(nextPf[0], nextPf[1], nextPf[2], nextC);
+
+    /* elevations of the control points, for the shader to apply the vertical
+       scale. The section normal is invariant to it and derived there too */
+    Scalar curE  = Geometry::Vector<double,3>(curP).mag()  -
+                   SETTINGS->globeRadius;
+    Scalar nextE = Geometry::Vector<double,3>(nextP).mag() -
+                   SETTINGS->globeRadius;
+    texels[3] = Color(curE, nextE, 0.0, 0.0);
+}
 
-    child.lineCoverage.clear();
 
-    //go through all lines from the parent's coverage
-    for (Coverage::const_iterator lit=parent.lineCoverage.begin();
-         lit!=parent.lineCoverage.end(); ++lit)
+bool MapManager::
+prepareAreaJob(NodeData& node, AreaRasterizer::Job& job) const
+{
+    typedef Geometry::Point<float,3>         Vertex;
+    typedef std::vector<Vertex>              Vertices;
+    typedef std::map<const Shape*, Vertices> Outlines;
+
+    job.node          = &node;
+    job.index         = node.index;
+    job.version       = areaVersion;
+    job.coverageStamp = node.lineCoverageStamp;
+    if (polygons.empty())
+        return false;
+
+    const Geometry::Point<double,3> centroid(node.centroid);
+
+    //gather the edges of the outlines crossing the node from its coverage
+    Outlines outlines;
+    const NodeData::ShapeCoverage& coverage = node.lineCoverage;
+    for (NodeData::ShapeCoverage::const_iterator sit=coverage.begin();
+         sit!=coverage.end(); ++sit)
     {
-        const Shape* const shape      = lit->first;
-        const HandleList&  srcHandles = lit->second;
-        HandleList*        dstHandles = NULL;
+        if (dynamic_cast<const Polygon*>(sit->shape) == NULL)
+            continue;
 
-        assert(shape!=NULL);
-        assert(srcHandles.size()>0);
+        Shape::ControlPointConstHandle start = sit->start;
+        Shape::ControlPointConstHandle end   = start; ++end;
+        /* the mask is a projection from the center of the globe, hence is
+           independent of the vertical scale */
+        const Geometry::Point<double,3>& startP = start->pos;
+        const Geometry::Point<double,3>& endP   = end->pos;
+
+        Vertices& edges = outlines[sit->shape];
+        edges.push_back(Vertex(startP[0]-centroid[0], startP[1]-centroid[1],
+                               startP[2]-centroid[2]));
+        edges.push_back(Vertex(endP[0]-centroid[0], endP[1]-centroid[1],
+                               endP[2]-centroid[2]));
+    }
 
-        //intersect all the segments
-        for (HandleList::const_iterator hit=srcHandles.begin();
-             hit!=srcHandles.end(); ++hit)
-        {
-            Handle start = *hit;
-            Handle end   = start; ++end;
-            assert(start!=shape->getControlPoints().end() &&
-                   end  !=shape->getControlPoints().end());
+    //bound the node by a spherical cap around its centroid
+    Geometry::Vector<double,3> capCenter(centroid);
+    capCenter.normalize();
+    double capCos = 1.0;
+    for (int i=0; i<4; ++i)
+    {
+        Geometry::Vector<double,3> corner(node.scope.corners[i]);
+        capCos = std::min(capCos, corner.normalize() * capCenter);
+    }
+    double capAngle = acos(std::max(-1.0, capCos));
 
-            //check for segment overlap
-            if (!child.scope.intersects(start->pos, end->pos))
-                continue;
+    //the areas are drawn in order of creation, the later ones on top
+    for (PolygonPtrs::const_iterator it=polygons.begin();
+         it!=polygons.end() && int(job.areas.size())<MAX_NODE_AREAS; ++it)
+    {
+        /* polygons whose outline doesn't cross the node either cover it
+           altogether or not at all */
+        Outlines::iterator outline = outlines.find(*it);
+        bool crossed = outline != outlines.end();
+        if (!crossed && !(*it)->overlaps(capCenter, capAngle))
+            continue;
+        bool inside = (*it)->contains(centroid);
+        if (!crossed && !inside)
+            continue;
 
-            //insert segment into child coverage
-            if (dstHandles == NULL)
-                dstHandles = &child.lineCoverage[shape];
+        job.areas.push_back(AreaRasterizer::Area());
+        AreaRasterizer::Area& area = job.areas.back();
+        area.inside = inside;
+        if (crossed)
+            area.edges.swap(outline->second);
 
-            dstHandles->push_back(*hit);
-        }
+        Color fill = (*it)->getSymbol().color;
+        fill[3]   *= SETTINGS->mapAreaOpacity;
+        job.colors.push_back(fill);
     }
+    if (job.areas.empty())
+        return false;
 
-    //invalidate the child's line data
-    child.lineNumSegments = 0;
-    child.lineData.clear();
-
-CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
-
-statsMan.stop(StatsManager::INHERITSHAPECOVERAGE);
+    job.projection  = QuadTerrain::computeLineCoverageProjection(node);
+    job.size        = SETTINGS->lineCoverageTexSize;
+    job.firstOffset = SETTINGS->lineDataTexSize - MAX_NODE_AREAS;
+    return true;
 }
 
-
 void MapManager::
-updateLineData(SurfaceApproximation& surface)
+installAreaMask(NodeData& node, AreaRasterizer::Job& job)
 {
-statsMan.start(StatsManager::UPDATELINEDATA);
+    bool hadAreas = node.lineNumAreas != 0;
 
-    typedef NodeData::ShapeCoverage       Coverage;
-    typedef Shape::ControlPointHandleList HandleList;
-    typedef Shape::ControlPointHandle     Handle;
+    node.lineAreaMask.swap(job.mask);
+    node.lineAreaColors.swap(job.colors);
+    node.lineNumAreas          = static_cast<int>(node.lineAreaColors.size());
+    node.lineAreaVersion       = job.version;
+    node.lineAreaCoverageStamp = job.coverageStamp;
 
-    const int lineTexSize = SETTINGS->lineDataTexSize;
+    //only stream masks that have changed
+    if (hadAreas || node.lineNumAreas!=0)
+        node.lineAreaStamp = CURRENT_FRAME;
+}
 
-    //go through all the nodes provided
-    size_t numNodes = surface.visibles.size();
-    for (size_t i=0; i<numNodes; ++i)
+
+void* MapManager::
+coverageThreadFunc()
+{
+    CoverageJob job;
+    while (true)
     {
-        NodeData&         node          = *surface.visible(i).node;
-        Coverage&         coverage      = node.lineCoverage;
-        std::vector<int>& offsets       = node.lineCoverageOffsets;
-        int&              numSegments   = node.lineNumSegments;
-        Colors&           data          = node.lineData;
-        FrameStamp&       dataStamp     = node.lineDataStamp;
-
-        /* 1 trigger: there is coverage but no line data (result of coverage
-           modifications since the mapmanager clears the data) */
-        bool needToUpdate = !coverage.empty() && data.empty();
-        //2 trigger: properties of specific segments have changed
-        if (!needToUpdate)
-        {
-            for (Coverage::iterator lit=coverage.begin();
-                 lit!=coverage.end() && !needToUpdate; ++lit)
-            {
-                HandleList& handles = lit->second;
+    //-- grab a job from the pending list
+        {
+            Threads::Mutex::Lock lock(coverageMutex);
+            while (coverageJobs.empty() && !terminateCoverage)
+                coverageCond.wait(coverageMutex);
+            if (terminateCoverage)
+                return NULL;
+
+            job = coverageJobs.front();
+            coverageJobs.pop_front();
+        }
 
-                for (HandleList::iterator hit=handles.begin();
-                     hit!=handles.end(); ++hit)
-                {
-                    //current tool stamps are a frame behind, hence <=
-                    if (dataStamp <= (*hit)->stamp)
-                    {
-CRUSTA_DEBUG(51, std::cerr << "~~~INV n(" << node.index << ") has old " <<
-"segment from line " << lit->first->getId() << " (stamps " << dataStamp <<
-" vs " << (*hit)->stamp << ")\n\n";)
-                        needToUpdate = true;
-                        break;
-                    }
-                }
-            }
+    //-- derive the coverage
+        {
+            Threads::Mutex::Lock lock(segmentIndexMutex);
+            segmentIndex.query(job.index, job.scope, job.coverage);
+            job.stamp = segmentIndex.getVersion();
         }
 
-        //we're done here if none of the triggers fired
-        if (!needToUpdate)
-            continue;
+    //-- hand it back to the main thread
+        {
+            Threads::Mutex::Lock lock(coverageMutex);
+            coverageResults.push_back(CoverageJob());
+            CoverageJob& result = coverageResults.back();
+            result.node  = job.node;
+            result.index = job.index;
+            result.stamp = job.stamp;
+            result.coverage.swap(job.coverage);
+        }
+        Vrui::requestUpdate();
+    }
 
-CRUSTA_DEBUG(49, crusta->validateLineCoverage();)
+    return NULL;
+}
 
-//record the update to this node
-statsMan.incrementDataUpdated();
+void MapManager::
+loadSnapshot(const char* fileName)
+{
+    MapSnapshot in;
+    if (!in.open(fileName))
+    {
+        std::cout << "MapManager::Load: Error reading snapshot " << fileName <<
+                     std::endl;
+        return;
+    }
+    const MapSnapshot::Header& header = in.getHeader();
 
-CRUSTA_DEBUG(50, std::cerr << "###REGEN n(" << node.index << ") :\n" <<
-coverage << "\n\n";)
+    //reject snapshots referring to symbols that aren't defined
+    const MapSnapshot::ShapeRecord* record = in.getShapes();
+    for (uint64_t i=0; i<header.numShapes; ++i)
+    {
+        int symbolId = record[i].symbolId;
+        if (symbolId!=Shape::DEFAULT_SYMBOL.id &&
+            symbolMap.find(symbolId)==symbolMap.end())
+        {
+            std::cout << "MapManager::Load: Unknown symbol " << symbolId <<
+                         " in snapshot " << fileName << std::endl;
+            return;
+        }
+    }
 
-    //- reset the current data offsets
-        numSegments = 0;
-        data.clear();
-        offsets.clear();
-        int curOff = 0;
+    /* the control points are converted if the snapshot was taken on a globe
+       of different radius. The keys of the segments then have to be
+       recomputed, as they do for a hierarchy based on a different
+       polyhedron */
+    const Polyhedron* polyhedron = DATAMANAGER->getPolyhedron();
+    std::string polyhedronType = polyhedron!=NULL ? polyhedron->getType() :
+                                                    std::string();
+    std::string savedType(header.polyhedron,
+                          strnlen(header.polyhedron, sizeof(header.polyhedron)));
+    bool convert = header.globeRadius != SETTINGS->globeRadius;
+    bool useKeys = (header.flags & MapSnapshot::HAS_KEYS)!=0 && !convert &&
+                   savedType==polyhedronType;
+
+    Geometry::Geoid<double> savedSphere(header.globeRadius, 0.0);
+    Geometry::Geoid<double> sphere(SETTINGS->globeRadius, 0.0);
 
-    //- go through all the lines for that node and dump the data
-        for (Coverage::iterator lit=coverage.begin();
-             lit!=coverage.end() && curOff<lineTexSize; ++lit)
+    //claim the saved ids of all the shapes of each type at once
+    std::vector<uint32_t> savedIds[3];
+    for (uint64_t i=0; i<header.numShapes; ++i)
+        savedIds[record[i].type].push_back(record[i].id);
+    std::vector<bool> claimedIds[3];
+    polylineIds.claim(savedIds[MapSnapshot::POLYLINE],
+                      claimedIds[MapSnapshot::POLYLINE]);
+    polygonIds.claim(savedIds[MapSnapshot::POLYGON],
+                     claimedIds[MapSnapshot::POLYGON]);
+    placemarkIds.claim(savedIds[MapSnapshot::PLACEMARK],
+                       claimedIds[MapSnapshot::PLACEMARK]);
+    size_t claimedNext[3] = { 0, 0, 0 };
+
+    const double*   point = in.getPoints();
+    const uint64_t* key   = useKeys ? in.getKeys() : NULL;
+    std::vector<Geometry::Point<double,3> > controlPoints;
+    SegmentIndex::Segments segments;
+    segments.reserve(header.numPoints);
+    for (uint64_t i=0; i<header.numShapes; ++i, ++record)
+    {
+        Shape* shape = NULL;
+        bool claimed = claimedIds[record->type][claimedNext[record->type]++];
+        switch (record->type)
         {
-            const Polyline* line = dynamic_cast<const Polyline*>(lit->first);
-            assert(line != NULL);
-            HandleList& handles = lit->second;
-            const Shape::Symbol& symbol = line->getSymbol();
+            case MapSnapshot::POLYGON:
+                shape = restoreShape(crusta, polygonIds, record->id, claimed,
+                                     polygons);
+                break;
+            case MapSnapshot::PLACEMARK:
+                shape = restoreShape(crusta, placemarkIds, record->id, claimed,
+                                     placemarks);
+                break;
+            default:
+                shape = restoreShape(crusta, polylineIds, record->id, claimed,
+                                     polylines);
+                break;
+        }
+
+        //assign the symbol first, as there are no segments to update yet
+        SymbolMap::iterator symbol = symbolMap.find(record->symbolId);
+        if (symbol != symbolMap.end())
+            shape->setSymbol(symbol->second);
+        else
+            shape->setSymbol(Shape::DEFAULT_SYMBOL);
 
-        //- dump all the segments for the current line
-            for (HandleList::iterator hit=handles.begin();
-                 hit!=handles.end() && curOff<lineTexSize; ++hit)
+        controlPoints.resize(record->numPoints);
+        for (uint32_t p=0; p<record->numPoints; ++p, point+=3)
+        {
+            Geometry::Point<double,3> pos(point[0], point[1], point[2]);
+            if (convert)
             {
-                //dump the data
-                Handle cur  = *hit;
-                Handle next = cur; ++cur;
-
-                Geometry::Point<double,3> curP  = crusta->mapToScaledGlobe(cur->pos);
-                Geometry::Point<double,3> nextP = crusta->mapToScaledGlobe(next->pos);
-                Geometry::Point<float,3> curPf(curP[0] - node.centroid[0],
-                              curP[1] - node.centroid[1],
-                              curP[2] - node.centroid[2]);
-                Geometry::Point<float,3> nextPf(nextP[0] - node.centroid[0],
-                               nextP[1] - node.centroid[1],
-                               nextP[2] - node.centroid[2]);
-
-                const Scalar& curC  = cur->coord;
-                const Scalar& nextC = next->coord;
-
-                //save the offset to the data
-                offsets.push_back(curOff);
-
-                //the atlas information for this segment
-                data.push_back(symbol.originSize);
-                ++curOff;
-
-                //segment control points
-                data.push_back(Color( curPf[0],  curPf[1],  curPf[2],  curC));
-                ++curOff;
-                data.push_back(Color(nextPf[0], nextPf[1], nextPf[2], nextC));
-                ++curOff;
-
-                //section normal
-                Geometry::Vector<double,3> normal = Geometry::cross(Geometry::Vector<double,3>(curP), Geometry::Vector<double,3>(nextP));
-                normal.normalize();
-                data.push_back(Color(normal[0], normal[1], normal[2], 0.0));
-                ++curOff;
+                pos = sphere.geodeticToCartesian(
+                    savedSphere.cartesianToGeodetic(pos));
             }
+            controlPoints[p] = pos;
+        }
+        shape->restoreControlPoints(controlPoints);
+
+        //gather the segments of the shape for the index
+        Shape::ControlPointList& cps = shape->getControlPoints();
+        Shape::ControlPointHandle end = cps.begin();
+        if (end != cps.end()) ++end;
+        for (Shape::ControlPointHandle start=cps.begin(); end!=cps.end();
+             ++start, ++end)
+        {
+            uint64_t segKey = key!=NULL ? *(key++) :
+                SegmentIndex::computeKey(start->pos, end->pos);
+            segments.push_back(SegmentIndex::Segment(segKey, shape, start));
         }
+        //skip the unused key of the last point
+        if (key!=NULL && !cps.empty())
+            ++key;
+    }
 
-        //update the stamp of the line data and the segment count
-        numSegments = static_cast<int>(offsets.size());
-        dataStamp   = CURRENT_FRAME;
+    /* index all the segments at once and have the coverage of all the nodes
+       derived again, instead of updating it for every segment */
+    SegmentIndex::Version version;
+    {
+        Threads::Mutex::Lock lock(segmentIndexMutex);
+        segmentIndex.add(segments);
+        version = segmentIndex.getVersion();
     }
+    ShapeCoverageInvalidator invalidator(version);
+    crusta->globalCoverage(invalidator);
+    polylineRenderer.invalidate();
+    ++areaVersion;
 
-statsMan.stop(StatsManager::UPDATELINEDATA);
+    std::cerr << "Crusta: restored " << header.numShapes << " shapes (" <<
+                 segments.size() << " segments)\n";
 }
 
-
 void MapManager::
-processVerticalScaleChange()
+finishSnapshot()
 {
-statsMan.start(StatsManager::PROCESSVERTICALSCALE);
-
-    //need to recompute all the polylines' coordinates
-    for (PolylinePtrs::iterator it=polylines.begin(); it!=polylines.end(); ++it)
-        (*it)->recomputeCoords((*it)->getControlPoints().begin());
+    if (!snapshotThread.isJoined())
+        snapshotThread.join();
 
-statsMan.stop(StatsManager::PROCESSVERTICALSCALE);
+    delete snapshot;
+    snapshot = NULL;
 }
 
-void MapManager::
-frame()
+void* MapManager::
+snapshotThreadFunc()
 {
-}
+    if (!snapshot->write(snapshotFile.c_str()))
+    {
+        std::cout << "MapManager::SaveSnapshot: Error writing file " <<
+                     snapshotFile << std::endl;
+    }
 
-void MapManager::
-display(GLContextData& contextData, const SurfaceApproximation& surface) const
-{
-    if (!SETTINGS->lineDecorated)
-        polylineRenderer.display(contextData, surface);
+    return NULL;
 }
 
 
 void MapManager::
-addMenuEntry(GLMotif::Menu* mainMenu)
+cancelImport()
 {
-    //add the control dialog
-    produceMapControlDialog(mainMenu);
-    //add the symbols submenu
-    produceMapSymbolSubMenu(mainMenu);
-}
+    if (!importThread.isJoined())
+    {
+        //let the import thread know that it should terminate
+        {
+            Threads::Mutex::Lock lock(importMutex);
+            terminateImport = true;
+        }
+        //make sure the thread is not stuck waiting for the main thread
+        importCond.signal();
+        //wait for the termination
+        importThread.join();
+    }
 
-void MapManager::
-openSymbolsGroupCallback(GLMotif::Button::SelectCallbackData* cbData)
-{
-    //open the dialog at the same position as the main menu
-    Vrui::popupPrimaryWidget(symbolGroupMap[cbData->button->getName()]);
+    importChunks.clear();
+    importCurrent.clear();
+    importNext = 0;
 }
 
 void MapManager::
-symbolChangedCallback(GLMotif::ListBox::ItemSelectedCallbackData* cbData)
+processImport()
 {
-    std::string symbolName(cbData->listBox->getParent()->getName());
-    symbolName  += std::string("-");
-    symbolName  += std::string(cbData->listBox->getItem(cbData->selectedItem));
-    int symbolId = symbolNameMap[symbolName];
-    activeSymbol = symbolMap[symbolId];
+    if (importThread.isJoined())
+        return;
 
-///\todo process the change for multiple activeShapes
-    if (activeShape != NULL)
+    Timer timer;
+    timer.start();
+    do
     {
-        activeShape->setSymbol(activeSymbol);
-        mapSymbolLabel->setString(symbolName.c_str());
-    }
-}
+        //grab the next chunk of parsed lines once the current one is done
+        if (importNext == importCurrent.size())
+        {
+            Threads::Mutex::Lock lock(importMutex);
+            if (importChunks.empty())
+            {
+                //wait for more lines unless all of them have been parsed
+                if (!importParsed)
+                    return;
+
+                importThread.join();
+                importCurrent.clear();
+                importNext = 0;
+                std::cerr << "Crusta: imported " << importNumShapes <<
+                             " shapes (" << importNumSegments <<
+                             " segments)\n";
+                return;
+            }
 
-void MapManager::
-closeSymbolsGroupCallback(GLMotif::Button::SelectCallbackData* cbData)
-{
-    Vrui::popdownPrimaryWidget(symbolGroupMap[cbData->button->getName()]);
-}
+            importCurrent.swap(importChunks.front());
+            importChunks.pop_front();
+            importNext = 0;
+            importCond.signal();
+        }
 
+        //create new shape and assign the symbol and control points
+        const ImportShape& in = importCurrent[importNext++];
+        Shape* out = NULL;
+        switch (in.type)
+        {
+            case ImportShape::POLYGON:
+                out = createPolygon();
+                break;
+            case ImportShape::PLACEMARK:
+                out = createPlacemark();
+                break;
+            default:
+                out = createPolyline();
+                break;
+        }
 
-void MapManager::ShapeCoverageManipulator::
-setShape(Shape* nShape)
-{
-    shape   = nShape;
-}
+        //assign the symbol first, as there are no segments to update yet
+        SymbolMap::iterator symbol = symbolMap.find(in.symbolId);
+        if (symbol != symbolMap.end())
+            out->setSymbol(symbol->second);
+        else
+            out->setSymbol(Shape::DEFAULT_SYMBOL);
 
-void MapManager::ShapeCoverageManipulator::
-setSegment(const Shape::ControlPointHandle& nSegment)
-{
-    segment = nSegment;
-}
+        out->setControlPoints(in.controlPoints);
 
+        ++importNumShapes;
+        importNumSegments += in.controlPoints.size() - 1;
 
-void MapManager::ShapeCoverageAdder::
-operator()(NodeData& node, bool isLeaf)
+        timer.stop();
+        timer.resume();
+    } while (timer.seconds() < SETTINGS->mapImportFrameTime);
+
+    //carry on with the remaining lines during the next frame
+    Vrui::requestUpdate();
+}
+
+void* MapManager::
+importThreadFunc()
 {
-    Shape::ControlPointHandleList& handles = node.lineCoverage[shape];
+    importFeatures();
+
+    //let the main thread know that all the features have been parsed
+    {
+        Threads::Mutex::Lock lock(importMutex);
+        importParsed = true;
+    }
+    Vrui::requestUpdate();
 
-CRUSTA_DEBUG(43, std::cerr << "+" << node.index;)
+    return NULL;
+}
 
-CRUSTA_DEBUG(49,
-    Shape::ControlPointHandleList::const_iterator fit;
-    for (fit=handles.begin(); fit!=handles.end() && *fit!=segment; ++fit);
-    if (fit != handles.end())
+void MapManager::
+importFeatures()
+{
+    OGRDataSource* source = OGRSFDriverRegistrar::Open(importFile.c_str());
+    if (source == NULL)
     {
-        std::cerr << "DUPLICATE FOUND: node(" << node.index << ") " <<
-            "contains:\n" << node.lineCoverage << "Offending segment is "
-            "fit." << *fit << " segment." << segment << "\n";
+        std::cout << "MapManager::Load: Error opening file: " <<
+                     CPLGetLastErrorMsg() << std::endl;
+        return;
     }
-)
 
-    //add the segment to the coverage
-    handles.push_back(segment);
+    //look for the layers crusta saves, otherwise just look at the first layer
+    static const char* crustaLayers[] = {
+        "Crusta_Polylines", "Crusta_Polygons", "Crusta_Points" };
+    std::vector<OGRLayer*> layers;
+    for (int i=0; i<3; ++i)
+    {
+        OGRLayer* layer = source->GetLayerByName(crustaLayers[i]);
+        if (layer != NULL)
+            layers.push_back(layer);
+    }
+    if (layers.empty() && source->GetLayerCount()>0)
+        layers.push_back(source->GetLayer(0));
+    if (layers.empty())
+    {
+        std::cout << "MapManager::Load: Error retrieving a map layer: " <<
+                     CPLGetLastErrorMsg() << std::endl;
+        OGRDataSource::DestroyDataSource(source);
+        return;
+    }
 
-    //invalidate current line data
-    node.lineNumSegments = 0;
-    node.lineData.clear();
+    //create a sphere-geoid to convert lat,lon,elevation to cartesian points
+    Geometry::Geoid<double> sphere(SETTINGS->globeRadius, 0.0);
 
-    //make sure that the subtree inherits the proper coverage when refined
-    if (isLeaf)
+    ImportChunk chunk;
+    bool proceed = true;
+    for (std::vector<OGRLayer*>::iterator it=layers.begin();
+         it!=layers.end() && proceed; ++it)
     {
-CRUSTA_DEBUG(44, std::cerr << "~";)
-        node.lineInheritCoverage = true;
+        proceed = importLayer(*it, sphere, chunk);
     }
-CRUSTA_DEBUG(44, std::cerr << "\n";)
+    if (proceed && !chunk.empty())
+        pushImportChunk(chunk);
+
+    OGRDataSource::DestroyDataSource(source);
 }
 
-void MapManager::ShapeCoverageRemover::
-operator()(NodeData& node, bool isLeaf)
+bool MapManager::
+importLayer(OGRLayer* layer, const Geometry::Geoid<double>& sphere,
+            ImportChunk& chunk)
 {
-    //find the shape in the coverage
-    NodeData::ShapeCoverage::iterator lit = node.lineCoverage.find(shape);
-    assert(lit != node.lineCoverage.end());
-    Shape::ControlPointHandleList& handles = lit->second;
-    assert(handles.size() > 0);
+    //grab the index of the symbol field from the layer (if there is one)
+    OGRFeatureDefn* featureDef       = layer->GetLayerDefn();
+    int             symbolFieldIndex = featureDef->GetFieldIndex("Symbol");
+
+    //grab all the features and their control points
+    OGRFeature* feature = NULL;
+    layer->ResetReading();
+    while ((feature = layer->GetNextFeature()) != NULL)
+    {
+        int symbolId = symbolFieldIndex>=0 ?
+            feature->GetFieldAsInteger(symbolFieldIndex) :
+            Shape::DEFAULT_SYMBOL.id;
+
+///\todo figure out how to extract the shapes without the MapManager having to know all the shapes
+        OGRGeometry* geo = feature->GetGeometryRef();
+        if (geo != NULL)
+        {
+            /* 2D geometries are simply placed at zero elevation. Collections
+               are split into separate shapes and only the exterior rings of
+               polygons are retained */
+            OGRwkbGeometryType type = wkbFlatten(geo->getGeometryType());
+            OGRGeometryCollection* multi = NULL;
+            int numParts = 1;
+            if (type==wkbMultiLineString || type==wkbMultiPolygon ||
+                type==wkbMultiPoint)
+            {
+                multi    = (OGRGeometryCollection*)geo;
+                numParts = multi->getNumGeometries();
+            }
+
+            for (int i=0; i<numParts; ++i)
+            {
+                OGRGeometry* part = multi!=NULL ? multi->getGeometryRef(i) :
+                                                  geo;
+                switch (wkbFlatten(part->getGeometryType()))
+                {
+                    case wkbLineString:
+                        importLineString((OGRLineString*)part, sphere,
+                                         symbolId, ImportShape::POLYLINE,
+                                         chunk);
+                        break;
 
-CRUSTA_DEBUG(43, std::cerr << "-" << node.index;)
+                    case wkbPolygon:
+                    {
+                        OGRLinearRing* ring =
+                            ((OGRPolygon*)part)->getExteriorRing();
+                        if (ring != NULL)
+                        {
+                            importLineString(ring, sphere, symbolId,
+                                             ImportShape::POLYGON, chunk);
+                        }
+                        break;
+                    }
 
-    //find the specific segment
-    Shape::ControlPointHandleList::iterator fit;
-    for (fit=handles.begin(); fit!=handles.end() && *fit!=segment; ++fit);
-    assert(fit != handles.end());
+                    case wkbPoint:
+                        importPoint((OGRPoint*)part, sphere, symbolId, chunk);
+                        break;
 
-    //remove the segment from the coverage
-    handles.erase(fit);
+                    default:
+                        break;
+                }
+            }
+        }
 
-    //clean up emptied coverages
-    if (handles.empty())
-        node.lineCoverage.erase(lit);
+        OGRFeature::DestroyFeature(feature);
 
-    //invalidate current line data
-    node.lineNumSegments = 0;
-    node.lineData.clear();
+        if (chunk.size()>=IMPORT_CHUNK_SIZE && !pushImportChunk(chunk))
+            return false;
+    }
 
-    //make sure that the subtree inherits the proper coverage when refined
-    if (isLeaf)
+    return true;
+}
+
+bool MapManager::
+pushImportChunk(ImportChunk& chunk)
+{
+    Threads::Mutex::Lock lock(importMutex);
+    //don't run too far ahead of the main thread
+    while (!terminateImport && importChunks.size()>=IMPORT_MAX_PENDING_CHUNKS)
+        importCond.wait(importMutex);
+    if (terminateImport)
+        return false;
+
+    importChunks.push_back(ImportChunk());
+    importChunks.back().swap(chunk);
+    Vrui::requestUpdate();
+    return true;
+}
+
+void MapManager::
+importLineString(const OGRLineString* in, const Geometry::Geoid<double>& sphere,
+                 int symbolId, ImportShape::Type type, ImportChunk& chunk)
+{
+    int numPoints = in->getNumPoints();
+    if (numPoints == 0)
+        return;
+
+    chunk.push_back(ImportShape());
+    ImportShape& line = chunk.back();
+    line.type        = type;
+    line.symbolId    = symbolId;
+    line.controlPoints.reserve(numPoints);
+    for (int i=0; i<numPoints; ++i)
     {
-CRUSTA_DEBUG(44, std::cerr << "~";)
-        node.lineInheritCoverage = true;
+        Geometry::Point<double,3> pos;
+        pos[0] = Math::rad(in->getX(i));
+        pos[1] = Math::rad(in->getY(i));
+        pos[2] = in->getZ(i);
+        line.controlPoints.push_back(sphere.geodeticToCartesian(pos));
     }
-CRUSTA_DEBUG(44, std::cerr << "\n";)
+}
+
+void MapManager::
+importPoint(const OGRPoint* in, const Geometry::Geoid<double>& sphere,
+            int symbolId, ImportChunk& chunk)
+{
+    chunk.push_back(ImportShape());
+    ImportShape& point = chunk.back();
+    point.type         = ImportShape::PLACEMARK;
+    point.symbolId     = symbolId;
+
+    Geometry::Point<double,3> pos;
+    pos[0] = Math::rad(in->getX());
+    pos[1] = Math::rad(in->getY());
+    pos[2] = in->getZ();
+    point.controlPoints.push_back(sphere.geodeticToCartesian(pos));
 }
 
 
@@ -775,7 +1913,8 @@ produceMapControlDialog(GLMotif::Menu* mainMenu)
 
     OGRSFDriverRegistrar* ogrRegistrar = OGRSFDriverRegistrar::GetRegistrar();
     int numDrivers = ogrRegistrar->GetDriverCount();
-    std::vector<std::string> formats;
+    //the native snapshots come first
+    std::vector<std::string> formats(1, MapSnapshot::FORMAT_NAME);
     for (int i=0; i<numDrivers; ++i)
     {
         OGRSFDriver* driver = ogrRegistrar->GetDriver(i);
@@ -955,7 +2094,10 @@ saveMapCallback(GLMotif::Button::SelectCallbackData* cbData)
     int selected       = mapOutputFormat->getSelectedItem();
     const char* format = mapOutputFormat->getItem(selected);
     std::string fileName("Crusta_Map.");
-    fileName.append(format);
+    if (strcmp(format, MapSnapshot::FORMAT_NAME) == 0)
+        fileName.append(MapSnapshot::EXTENSION);
+    else
+        fileName.append(format);
     fileName = Misc::createNumberedFileName(fileName, 4);
     save(fileName.c_str(), format);
 }
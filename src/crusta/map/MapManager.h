@@ -1,18 +1,25 @@
 #ifndef _MapManager_H_
 #define _MapManager_H_
 
+#include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <crusta/CrustaComponent.h>
 #include <crusta/DataManager.h>
+#include <crusta/map/AreaRasterizer.h>
 #include <crusta/map/PolylineRenderer.h>
+#include <crusta/map/SegmentIndex.h>
 #include <crusta/map/Shape.h>
 
 #include <crusta/vrui.h>
 
 
 class GLContextData;
+class OGRLayer;
+class OGRLineString;
+class OGRPoint;
 
 namespace GLMotif {
     class Menu;
@@ -26,13 +33,18 @@ namespace Vrui {
 namespace crusta {
 
 
+class MapSnapshot;
+class Placemark;
+class Polygon;
 class Polyline;
 
 
 class MapManager : public CrustaComponent
 {
 public:
-    typedef std::vector<Polyline*> PolylinePtrs;
+    typedef std::vector<Polyline*>  PolylinePtrs;
+    typedef std::vector<Polygon*>   PolygonPtrs;
+    typedef std::vector<Placemark*> PlacemarkPtrs;
 
 
     MapManager(Vrui::ToolFactory* parentToolFactory, Crusta* iCrusta);
@@ -41,10 +53,17 @@ public:
     /** Destroy all the current map features */
     void deleteAllShapes();
 
-    /** Load a new mapping dataset */
+    /** Load a new mapping dataset. Snapshots are restored right away, the
+        features of other formats are parsed on a background thread and
+        turned into shapes over the following frames */
     void load(const char* filename);
     /** Save the current mapping dataset */
     void save(const char* filename, const char* format);
+    /** Save a snapshot of the current mapping dataset. The snapshot is taken
+        right away and written in the background. The keys of the segments in
+        the index can be left out, at the cost of recomputing them when the
+        snapshot is restored */
+    void saveSnapshot(const char* filename, bool saveKeys=true);
 
     /** Register a mapping tool with the manager to receive a registration id */
     int registerMappingTool();
@@ -65,6 +84,14 @@ public:
     PolylinePtrs& getPolylines();
     void deletePolyline(Polyline* line);
 
+    Polygon* createPolygon();
+    PolygonPtrs& getPolygons();
+    void deletePolygon(Polygon* polygon);
+
+    Placemark* createPlacemark();
+    PlacemarkPtrs& getPlacemarks();
+    void deletePlacemark(Placemark* placemark);
+
 ///\todo Vis2010 testing: update line coverage for given line sections
     void addShapeCoverage(Shape* shape,
                           const Shape::ControlPointHandle& startCP,
@@ -72,11 +99,43 @@ public:
     void removeShapeCoverage(Shape* shape,
                              const Shape::ControlPointHandle& startCP,
                              const Shape::ControlPointHandle& endCP);
+    /** flag the line data of the segments of the given range as outdated.
+        Used for modifications that preserve the coverage of the nodes (e.g.
+        of the coordinates or of the symbol) */
+    void updateShapeData(Shape* shape,
+                         const Shape::ControlPointHandle& startCP,
+                         const Shape::ControlPointHandle& endCP);
+    /** flag the representations of a shape as outdated after its symbol has
+        changed */
+    void updateShapeSymbol(Shape* shape);
+    /** flag the area masks as outdated after a polygon has been modified */
+    void updateShapeArea(Shape* shape);
+    /** flag the coverage or line data of a child as outdated, if that of the
+        parent's subtree was modified after the child's was derived. The
+        coverage is then derived again in the background */
     void inheritShapeCoverage(const NodeData& parent, NodeData& child);
-
-    /** generate line data for the subset of render nodes that are outdated */
+    /** derive the coverage of a node from the segment index. May be called
+        from the fetch thread for nodes that are being loaded */
+    void deriveShapeCoverage(NodeData& node);
+
+    /** derive the coverage of the render nodes whose coverage is outdated
+        from the segment index, or schedule the derivation in the
+        background, and install the coverages derived in the background */
+    void updateLineCoverage(SurfaceApproximation& surface);
+    /** rewrite the outdated segments of the line data of the nodes flagged
+        by modifications of the shapes, and generate the line data of the
+        render nodes that have none */
     void updateLineData(SurfaceApproximation& surface);
-
+    /** build the vertices of the render nodes that are outdated, for the
+        undecorated rendering of the lines */
+    void updateLineVertices(SurfaceApproximation& surface);
+    /** schedule the rasterization of the outdated area masks of the render
+        nodes, and install the masks rasterized in the background */
+    void updateAreaCoverage(SurfaceApproximation& surface);
+
+    /** update the representations that depend on the vertical scale. The
+        line data and area masks do not, only the vertices of the undecorated
+        lines are rebuilt, spread over several frames */
     void processVerticalScaleChange();
 
     void frame();
@@ -89,31 +148,26 @@ public:
         GLMotif::ListBox::ItemSelectedCallbackData* cbData);
     void closeSymbolsGroupCallback(GLMotif::Button::SelectCallbackData* cbData);
 
-    class ShapeCoverageManipulator : public Shape::IntersectionFunctor
+    /** invalidates the coverage and line data of the nodes overlapped by
+        modified segments */
+    class ShapeCoverageInvalidator : public Shape::IntersectionFunctor
     {
     public:
-        void setShape(Shape* nShape);
-        void setSegment(const Shape::ControlPointHandle& nSegment);
-    protected:
-        Shape*                    shape;
-        Shape::ControlPointHandle segment;
-    };
+        ShapeCoverageInvalidator(SegmentIndex::Version iVersion);
 
-    class ShapeCoverageAdder : public ShapeCoverageManipulator
-    {
     //- inherited from Shape::IntersectionFunctor
     public:
         virtual void operator()(NodeData& node, bool isLeaf);
-    };
 
-    class ShapeCoverageRemover : public ShapeCoverageManipulator
-    {
-    //- inherited from Shape::IntersectionFunctor
-    public:
-        virtual void operator()(NodeData& node, bool isLeaf);
+    protected:
+        /** version of the segment index after the modification */
+        SegmentIndex::Version version;
     };
 
     static const int BAD_TOOLID = -1;
+    /** number of texels reserved at the end of the line data of a node for
+        the fills of the areas overlapping it */
+    static const int MAX_NODE_AREAS = 16;
 
 protected:
     typedef std::map<std::string, int>                   SymbolNameMap;
@@ -121,6 +175,137 @@ protected:
     typedef std::map<int,         Shape::Symbol>         SymbolMap;
     typedef std::map<std::string, GLMotif::PopupWindow*> SymbolGroupMap;
 
+    /** a derivation of the coverage of a node left to the background */
+    struct CoverageJob
+    {
+        /** node the coverage is derived for */
+        NodeData*              node;
+        /** index of the node (the node buffer might be reused meanwhile) */
+        TreeIndex              index;
+        /** scope of the node */
+        Scope                  scope;
+        /** version of the segment index the coverage was derived from */
+        SegmentIndex::Version  stamp;
+        /** the derived coverage */
+        SegmentIndex::Segments coverage;
+    };
+    typedef std::list<CoverageJob> CoverageJobs;
+
+    /** entry point of the thread deriving coverages in the background */
+    void* coverageThreadFunc();
+
+    /** a node whose line data has outdated segments */
+    struct DirtyNode
+    {
+        DirtyNode(NodeData* iNode);
+
+        /** node the line data belongs to */
+        NodeData* node;
+        /** index of the node (the node buffer might be reused meanwhile) */
+        TreeIndex index;
+    };
+    typedef std::vector<DirtyNode> DirtyNodes;
+
+    /** flags the segments of the line data of the nodes overlapped by the
+        segments of modified properties */
+    class ShapeDataInvalidator : public Shape::IntersectionFunctor
+    {
+    public:
+        ShapeDataInvalidator(DirtyNodes& iDirtyNodes);
+
+        /** set the segment that is being traversed */
+        void setSegment(const Shape::ControlPoint* iSegment);
+
+    //- inherited from Shape::IntersectionFunctor
+    public:
+        virtual void operator()(NodeData& node, bool isLeaf);
+
+    protected:
+        /** nodes with outdated segments */
+        DirtyNodes& dirtyNodes;
+        /** starting control point of the segment being traversed */
+        const Shape::ControlPoint* segment;
+    };
+
+    /** number of texels of the line data of a segment */
+    static const int SEGMENT_TEXELS = 4;
+
+    /** generate the line data of a node from its coverage */
+    void generateLineData(NodeData& node);
+    /** rewrite the outdated segments of the line data of a node */
+    void rewriteLineData(NodeData& node);
+    /** encode the line data of a segment relative to the node. The data is
+        independent of the vertical scale, which is applied by the shader to
+        the unscaled end points using their elevations */
+    void encodeSegment(const NodeData& node,
+                       const SegmentIndex::Segment& segment,
+                       Color* texels) const;
+
+    /** gather the areas overlapping a node for rasterization. Returns false
+        if there are none */
+    bool prepareAreaJob(NodeData& node, AreaRasterizer::Job& job) const;
+    /** install a rasterized area mask */
+    void installAreaMask(NodeData& node, AreaRasterizer::Job& job);
+
+    /** draw the placemarks */
+    void displayPlacemarks(GLContextData& contextData) const;
+
+    /** a shape parsed from an imported map, not yet turned into a shape */
+    struct ImportShape
+    {
+        enum Type
+        {
+            POLYLINE,
+            POLYGON,
+            PLACEMARK
+        };
+
+        Type                                    type;
+        std::vector<Geometry::Point<double,3> > controlPoints;
+        int                                     symbolId;
+    };
+    typedef std::vector<ImportShape> ImportChunk;
+    typedef std::list<ImportChunk>   ImportChunks;
+
+    /** number of shapes parsed before they are handed to the main thread */
+    static const size_t IMPORT_CHUNK_SIZE = 256;
+    /** number of parsed chunks after which the parsing waits for the main
+        thread to catch up */
+    static const size_t IMPORT_MAX_PENDING_CHUNKS = 16;
+
+    /** restore the shapes of a snapshot */
+    void loadSnapshot(const char* filename);
+    /** wait for the snapshot being written in the background, if any */
+    void finishSnapshot();
+    /** entry point of the thread writing snapshots */
+    void* snapshotThreadFunc();
+
+    /** stop any import in progress and discard its pending shapes */
+    void cancelImport();
+    /** turn pending imported shapes into map shapes within the frame budget */
+    void processImport();
+    /** entry point of the import thread */
+    void* importThreadFunc();
+    /** parse all the features of the imported map (on the import thread) */
+    void importFeatures();
+    /** parse the features of a layer of the imported map. Returns false if
+        the import has been cancelled */
+    bool importLayer(OGRLayer* layer, const Geometry::Geoid<double>& sphere,
+                     ImportChunk& chunk);
+    /** hand a chunk of parsed shapes over to the main thread. Returns false
+        if the import has been cancelled */
+    bool pushImportChunk(ImportChunk& chunk);
+    /** convert the points of a line string (or the ring of a polygon) to
+        cartesian control points */
+    static void importLineString(const OGRLineString* in,
+                                 const Geometry::Geoid<double>& sphere,
+                                 int symbolId, ImportShape::Type type,
+                                 ImportChunk& chunk);
+    /** convert a point to a cartesian control point */
+    static void importPoint(const OGRPoint* in,
+                            const Geometry::Geoid<double>& sphere,
+                            int symbolId, ImportChunk& chunk);
+
     void produceMapControlDialog(GLMotif::Menu* mainMenu);
     void produceMapSymbolSubMenu(GLMotif::Menu* mainMenu);
 
@@ -142,14 +327,93 @@ protected:
 
     IdGenerator32     polylineIds;
     PolylinePtrs      polylines;
+    IdGenerator32     polygonIds;
+    PolygonPtrs       polygons;
+    IdGenerator32     placemarkIds;
+    PlacemarkPtrs     placemarks;
 
     SymbolNameMap        symbolNameMap;
     SymbolReverseNameMap symbolReverseNameMap;
     SymbolMap            symbolMap;
     SymbolGroupMap       symbolGroupMap;
 
+    /** the segments of all the shapes from which the coverage of the nodes
+        is derived */
+    SegmentIndex segmentIndex;
+    /** guards the segment index, which is also queried by the fetch and
+        coverage threads */
+    Threads::Mutex segmentIndexMutex;
+
+    ///\{ background coverage derivation
+    /** flags the coverage thread to terminate */
+    bool terminateCoverage;
+    /** derivations waiting to be processed */
+    CoverageJobs coverageJobs;
+    /** derivations processed but not yet installed */
+    CoverageJobs coverageResults;
+    /** guards the jobs and results */
+    Threads::Mutex coverageMutex;
+    /** signals the coverage thread that jobs are available */
+    Threads::Cond coverageCond;
+    /** thread deriving the coverages */
+    Threads::Thread coverageThread;
+    ///\}
+
+    ///\{ line data updates
+    /** nodes with outdated segments of line data */
+    DirtyNodes dirtyLineNodes;
+    /** frame of the last modification of properties of the segments */
+    FrameStamp lineDataEditStamp;
+    /** line data generated up to this frame is outdated altogether */
+    FrameStamp lineDataResetStamp;
+    ///\}
+
     PolylineRenderer polylineRenderer;
 
+    ///\{ area masks
+    /** version of the areas, incremented with every modification of the
+        polygons */
+    uint64_t areaVersion;
+    /** rasterizes the area masks in the background */
+    AreaRasterizer areaRasterizer;
+    ///\}
+
+    ///\{ map import
+    /** file from which features are being imported */
+    std::string importFile;
+    /** flags the import thread to stop parsing */
+    bool terminateImport;
+    /** flags that the import thread has parsed all the features */
+    bool importParsed;
+    /** chunks of shapes parsed but not yet processed by the main thread */
+    ImportChunks importChunks;
+    /** chunk whose shapes are currently turned into map shapes */
+    ImportChunk importCurrent;
+    /** next shape of the current chunk to turn into a map shape */
+    size_t importNext;
+    /** number of shapes imported so far */
+    size_t importNumShapes;
+    /** number of segments imported so far */
+    size_t importNumSegments;
+    /** guards the exchange of chunks with the import thread */
+    Threads::Mutex importMutex;
+    /** signals the import thread that parsed chunks have been consumed */
+    Threads::Cond importCond;
+    /** thread parsing the features of the imported map */
+    Threads::Thread importThread;
+    ///\}
+
+    ///\{ map snapshots
+    /** snapshot being written in the background */
+    MapSnapshot* snapshot;
+    /** file the snapshot is written to */
+    std::string snapshotFile;
+    /** thread writing the snapshot */
+    Threads::Thread snapshotThread;
+    /** application time of the last periodic snapshot */
+    double lastAutosave;
+    ///\}
+
     GLMotif::PopupWindow* mapControlDialog;
     GLMotif::Label*       mapSymbolLabel;
     GLMotif::DropdownBox* mapOutputFormat;
@@ -0,0 +1,236 @@
+#include <crusta/map/MapSnapshot.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace crusta {
+
+
+const char*    MapSnapshot::FORMAT_NAME = "Crusta Snapshot";
+const char*    MapSnapshot::EXTENSION   = "cms";
+const char     MapSnapshot::MAGIC[8]    = { 'C','R','U','S','T','A','M','S' };
+const uint32_t MapSnapshot::VERSION;
+
+
+MapSnapshot::
+MapSnapshot() :
+    mapped(NULL), mappedSize(0), data(NULL)
+{
+}
+
+MapSnapshot::
+~MapSnapshot()
+{
+    close();
+}
+
+
+bool MapSnapshot::
+isSnapshot(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[sizeof(MAGIC)];
+    bool ret = fread(magic, sizeof(magic), 1, file)==1 &&
+               memcmp(magic, MAGIC, sizeof(MAGIC))==0;
+    fclose(file);
+    return ret;
+}
+
+
+void MapSnapshot::
+create(uint64_t numShapes, uint64_t numPoints, bool hasKeys,
+       double globeRadius, const std::string& polyhedron)
+{
+    close();
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.flags       = hasKeys ? HAS_KEYS : 0;
+    header.numShapes   = numShapes;
+    header.numPoints   = numPoints;
+    header.globeRadius = globeRadius;
+    strncpy(header.polyhedron, polyhedron.c_str(),
+            sizeof(header.polyhedron)-1);
+
+    uint64_t size = computeSize(header);
+    buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    data = reinterpret_cast<uint8_t*>(&buffer.front());
+    memcpy(data, &header, sizeof(Header));
+}
+
+bool MapSnapshot::
+write(const char* filename) const
+{
+    if (data == NULL)
+        return false;
+
+    //write to a temporary file first, such that a previous snapshot survives
+    std::string tmpName = std::string(filename) + ".tmp";
+    FILE* file = fopen(tmpName.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    size_t size    = computeSize(getHeader());
+    bool   written = fwrite(data, 1, size, file) == size;
+    written       &= fclose(file) == 0;
+    if (!written || rename(tmpName.c_str(), filename)!=0)
+    {
+        remove(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool MapSnapshot::
+open(const char* filename)
+{
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat)!=0 || size_t(fileStat.st_size)<sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mappedSize = fileStat.st_size;
+    mapped     = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    //the mapping remains valid after the descriptor is closed
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        mapped     = NULL;
+        mappedSize = 0;
+        return false;
+    }
+    data = static_cast<uint8_t*>(mapped);
+
+    /* make sure the file is a complete snapshot of the current version. The
+       counts are bounded by the size of the file before computing the
+       expected size, which could overflow otherwise */
+    const Header& header = getHeader();
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC))!=0 ||
+        header.version!=VERSION ||
+        header.numShapes>mappedSize/sizeof(ShapeRecord) ||
+        header.numPoints>mappedSize/(3*sizeof(double)) ||
+        computeSize(header)!=mappedSize)
+    {
+        close();
+        return false;
+    }
+
+    //the records must be of known types and account for all the points
+    const ShapeRecord* record = getShapes();
+    uint64_t numPoints = 0;
+    for (uint64_t i=0; i<header.numShapes; ++i, ++record)
+    {
+        numPoints += record->numPoints;
+        if (record->type>PLACEMARK || numPoints>header.numPoints)
+        {
+            close();
+            return false;
+        }
+    }
+    if (numPoints != header.numPoints)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MapSnapshot::
+close()
+{
+    if (mapped != NULL)
+        munmap(mapped, mappedSize);
+    mapped     = NULL;
+    mappedSize = 0;
+    buffer.clear();
+    data = NULL;
+}
+
+
+const MapSnapshot::Header& MapSnapshot::
+getHeader() const
+{
+    return *reinterpret_cast<const Header*>(data);
+}
+
+MapSnapshot::ShapeRecord* MapSnapshot::
+getShapes()
+{
+    return reinterpret_cast<ShapeRecord*>(data + sizeof(Header));
+}
+
+const MapSnapshot::ShapeRecord* MapSnapshot::
+getShapes() const
+{
+    return reinterpret_cast<const ShapeRecord*>(data + sizeof(Header));
+}
+
+double* MapSnapshot::
+getPoints()
+{
+    return reinterpret_cast<double*>(data + pointsOffset());
+}
+
+const double* MapSnapshot::
+getPoints() const
+{
+    return reinterpret_cast<const double*>(data + pointsOffset());
+}
+
+uint64_t* MapSnapshot::
+getKeys()
+{
+    return reinterpret_cast<uint64_t*>(data + keysOffset());
+}
+
+const uint64_t* MapSnapshot::
+getKeys() const
+{
+    return reinterpret_cast<const uint64_t*>(data + keysOffset());
+}
+
+
+uint64_t MapSnapshot::
+computeSize(const Header& header)
+{
+    uint64_t size = sizeof(Header) + header.numShapes*sizeof(ShapeRecord) +
+                    header.numPoints*3*sizeof(double);
+    if (header.flags & HAS_KEYS)
+        size += header.numPoints*sizeof(uint64_t);
+    return size;
+}
+
+uint64_t MapSnapshot::
+pointsOffset() const
+{
+    return sizeof(Header) + getHeader().numShapes*sizeof(ShapeRecord);
+}
+
+uint64_t MapSnapshot::
+keysOffset() const
+{
+    return pointsOffset() + getHeader().numPoints*3*sizeof(double);
+}
+
+
+} //namespace crusta
@@ -0,0 +1,138 @@
+#ifndef _MapSnapshot_H_
+#define _MapSnapshot_H_
+
+#include <string>
+#include <vector>
+
+#include <crustacore/basics.h>
+
+
+namespace crusta {
+
+
+/**
+    Native binary snapshot of a mapping session. It holds the ids, symbols and
+    (cartesian) control points of all the shapes and, optionally, the keys of
+    their segments in the segment index, such that a session is restored
+    without any coordinate conversion nor a descent of the hierarchy for every
+    segment.
+
+    The file consists of flat, 8-byte aligned arrays in native byte order: the
+    header, a record per shape, the control points of all the shapes (those of
+    a shape being consecutive) and the key of the segment starting at every
+    control point. Snapshots are thus memory-mapped for reading and written as
+    a single block, prepared in memory such that the writing can be left to
+    the background.
+*/
+class MapSnapshot
+{
+public:
+    enum ShapeType
+    {
+        POLYLINE,
+        POLYGON,
+        PLACEMARK
+    };
+
+    enum Flags
+    {
+        /** the keys of the segments are part of the snapshot */
+        HAS_KEYS = 0x1
+    };
+
+    struct Header
+    {
+        /** identifies snapshot files */
+        char     magic[8];
+        /** version of the format */
+        uint32_t version;
+        /** combination of Flags */
+        uint32_t flags;
+        /** number of shapes */
+        uint64_t numShapes;
+        /** number of control points of all the shapes */
+        uint64_t numPoints;
+        /** radius of the globe the control points lie on */
+        double   globeRadius;
+        /** type of the polyhedron the keys of the segments refer to */
+        char     polyhedron[32];
+    };
+
+    struct ShapeRecord
+    {
+        /** type of the shape (ShapeType) */
+        uint32_t type;
+        /** id of the shape */
+        uint32_t id;
+        /** id of the symbol of the shape */
+        int32_t  symbolId;
+        /** number of control points of the shape */
+        uint32_t numPoints;
+    };
+
+    /** name under which the format is listed among the OGR formats */
+    static const char* FORMAT_NAME;
+    /** extension of the snapshot files */
+    static const char* EXTENSION;
+
+    MapSnapshot();
+    ~MapSnapshot();
+
+    /** check whether a file is a snapshot */
+    static bool isSnapshot(const char* filename);
+
+    /** prepare a snapshot of given size in memory */
+    void create(uint64_t numShapes, uint64_t numPoints, bool hasKeys,
+                double globeRadius, const std::string& polyhedron);
+    /** write the snapshot to a file. The file is replaced only once the
+        snapshot is completely written. Returns false on failure */
+    bool write(const char* filename) const;
+
+    /** map a snapshot file for reading. Returns false if the file can't be
+        opened or isn't a valid snapshot, i.e. it isn't of the current
+        version, is truncated, or its records are of unknown types or don't
+        account for all of the control points */
+    bool open(const char* filename);
+    /** release the snapshot */
+    void close();
+
+    const Header&      getHeader() const;
+    ShapeRecord*       getShapes();
+    const ShapeRecord* getShapes() const;
+    /** the control points as consecutive x,y,z triples */
+    double*            getPoints();
+    const double*      getPoints() const;
+    /** the key of the segment starting at every control point. Those of the
+        last points of the shapes are unused */
+    uint64_t*          getKeys();
+    const uint64_t*    getKeys() const;
+
+protected:
+    /** compute the size of the file of a snapshot */
+    static uint64_t computeSize(const Header& header);
+
+    /** offset of the control points */
+    uint64_t pointsOffset() const;
+    /** offset of the keys */
+    uint64_t keysOffset() const;
+
+    /** identifies snapshot files */
+    static const char     MAGIC[8];
+    /** current version of the format */
+    static const uint32_t VERSION = 1;
+
+    /** storage of a snapshot prepared in memory (8-byte aligned) */
+    std::vector<uint64_t> buffer;
+    /** the mapped snapshot file */
+    void*  mapped;
+    /** size of the mapping */
+    size_t mappedSize;
+    /** start of the snapshot data */
+    uint8_t* data;
+};
+
+
+} //namespace crusta
+
+
+#endif //_MapSnapshot_H_
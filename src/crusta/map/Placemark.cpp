@@ -0,0 +1,37 @@
+#include <crusta/map/Placemark.h>
+
+#include <cassert>
+
+#include <crusta/vrui.h>
+
+
+namespace crusta {
+
+
+Placemark::
+Placemark(Crusta* iCrusta) :
+    Shape(iCrusta)
+{
+}
+
+
+const Geometry::Point<double,3>& Placemark::
+getPosition() const
+{
+    assert(!controlPoints.empty());
+    return controlPoints.front().pos;
+}
+
+
+void Placemark::
+setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
+{
+    //only the first point is retained
+    std::vector<Geometry::Point<double,3> > position;
+    if (!newControlPoints.empty())
+        position.push_back(newControlPoints.front());
+    Shape::setControlPoints(position);
+}
+
+
+} //namespace crusta
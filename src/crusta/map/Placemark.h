@@ -0,0 +1,31 @@
+#ifndef _Placemark_H_
+#define _Placemark_H_
+
+#include <crusta/map/Shape.h>
+
+
+namespace crusta {
+
+
+/**
+    Point feature of the map (e.g. a sample site). It consists of a single
+    control point, hence has no segments and no coverage.
+*/
+class Placemark : public Shape
+{
+public:
+    Placemark(Crusta* iCrusta);
+
+    /** position of the placemark */
+    const Geometry::Point<double,3>& getPosition() const;
+
+//- Inherited from Shape
+public:
+    virtual void setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
+};
+
+
+} //namespace crusta
+
+
+#endif //_Placemark_H_
@@ -0,0 +1,190 @@
+#include <crusta/map/Polygon.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <crusta/Crusta.h>
+#include <crusta/map/MapManager.h>
+
+#include <crusta/vrui.h>
+
+
+namespace crusta {
+
+
+///minimum cosine of the angle between the center and the outline points
+static const double MIN_CAP_COS = 0.01;
+
+
+Polygon::
+Polygon(Crusta* iCrusta) :
+    Polyline(iCrusta), center(0,0,1), tangentU(1,0,0), tangentV(0,1,0),
+    capAngle(0.0)
+{
+}
+
+
+bool Polygon::
+contains(const Geometry::Point<double,3>& pos) const
+{
+    Geometry::Point<double,2> p;
+    if (ring.empty() || !project(pos, p))
+        return false;
+
+    //even-odd test against the (closed) projected ring
+    bool inside = false;
+    for (size_t i=1; i<ring.size(); ++i)
+    {
+        const Geometry::Point<double,2>& a = ring[i-1];
+        const Geometry::Point<double,2>& b = ring[i];
+        if ((a[1]<=p[1]) != (b[1]<=p[1]))
+        {
+            double x = a[0] + (p[1]-a[1]) * (b[0]-a[0]) / (b[1]-a[1]);
+            if (x < p[0])
+                inside = !inside;
+        }
+    }
+    return inside;
+}
+
+bool Polygon::
+overlaps(const Geometry::Vector<double,3>& capCenter, double iCapAngle) const
+{
+    if (ring.empty())
+        return false;
+
+    double cosAngle = std::max(-1.0, std::min(1.0, center * capCenter));
+    return acos(cosAngle) <= capAngle + iCapAngle;
+}
+
+
+void Polygon::
+setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
+{
+    //make sure the ring is closed
+    if (newControlPoints.size()>2 &&
+        newControlPoints.front()!=newControlPoints.back())
+    {
+        std::vector<Geometry::Point<double,3> > closed(newControlPoints);
+        closed.push_back(closed.front());
+        Polyline::setControlPoints(closed);
+    }
+    else
+        Polyline::setControlPoints(newControlPoints);
+
+    updateBounds();
+}
+
+void Polygon::
+restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
+{
+    Polyline::restoreControlPoints(newControlPoints);
+    updateBounds();
+}
+
+Shape::ControlId Polygon::
+addControlPoint(const Geometry::Point<double,3>& pos, End end)
+{
+    Shape::ControlId ret = Polyline::addControlPoint(pos, end);
+    updateBounds();
+    return ret;
+}
+
+void Polygon::
+moveControlPoint(const ControlId& id, const Geometry::Point<double,3>& pos)
+{
+    Polyline::moveControlPoint(id, pos);
+    updateBounds();
+}
+
+void Polygon::
+removeControlPoint(const ControlId& id)
+{
+    Polyline::removeControlPoint(id);
+    updateBounds();
+}
+
+Shape::ControlId Polygon::
+refine(const ControlId& id, const Geometry::Point<double,3>& pos)
+{
+    Shape::ControlId ret = Polyline::refine(id, pos);
+    updateBounds();
+    return ret;
+}
+
+
+void Polygon::
+updateBounds()
+{
+    typedef Geometry::Vector<double,3> Vector;
+
+    ring.clear();
+    capAngle = 0.0;
+
+    //a closed ring needs at least three distinct points
+    if (controlPoints.size() >= 4)
+    {
+        //the center of the cap is the average direction of the ring's points
+        ControlPointHandle last = --controlPoints.end();
+        Vector sum(0,0,0);
+        for (ControlPointHandle cp=controlPoints.begin(); cp!=last; ++cp)
+        {
+            Vector dir(cp->pos);
+            sum += dir.normalize();
+        }
+
+        if (sum.mag() > 0.0)
+        {
+            center = sum;
+            center.normalize();
+            Vector axis = Math::abs(center[0])<0.9 ? Vector(1,0,0) :
+                                                     Vector(0,1,0);
+            tangentU = Geometry::cross(center, axis);
+            tangentU.normalize();
+            tangentV = Geometry::cross(center, tangentU);
+
+            //the cap spans the point furthest from the center
+            double minCos = 1.0;
+            for (ControlPointHandle cp=controlPoints.begin();
+                 cp!=controlPoints.end(); ++cp)
+            {
+                Vector dir(cp->pos);
+                minCos = std::min(minCos, dir.normalize() * center);
+            }
+            capAngle = acos(std::max(-1.0, minCos));
+
+            //the projection is only defined for points near the center
+            if (minCos > MIN_CAP_COS)
+            {
+                ring.resize(controlPoints.size());
+                std::vector<Geometry::Point<double,2> >::iterator r =
+                    ring.begin();
+                for (ControlPointHandle cp=controlPoints.begin();
+                     cp!=controlPoints.end(); ++cp, ++r)
+                {
+                    project(cp->pos, *r);
+                }
+            }
+        }
+    }
+
+    crusta->getMapManager()->updateShapeArea(this);
+}
+
+bool Polygon::
+project(const Geometry::Point<double,3>& pos,
+        Geometry::Point<double,2>& projected) const
+{
+    Geometry::Vector<double,3> dir(pos);
+    dir.normalize();
+    double t = dir * center;
+    if (t <= 0.0)
+        return false;
+
+    projected[0] = (dir * tangentU) / t;
+    projected[1] = (dir * tangentV) / t;
+    return true;
+}
+
+
+} //namespace crusta
@@ -0,0 +1,67 @@
+#ifndef _Polygon_H_
+#define _Polygon_H_
+
+#include <vector>
+
+#include <crusta/map/Polyline.h>
+
+
+namespace crusta {
+
+
+/**
+    Closed area of the map (e.g. the outline of a landslide). The outline is
+    kept as a closed ring of control points, whose last point repeats the
+    first, such that its segments are indexed and drawn like those of the
+    polylines. The fill of the area is rasterized separately into the coverage
+    masks of the nodes. Polygons are expected to be smaller than a
+    hemisphere.
+*/
+class Polygon : public Polyline
+{
+public:
+    Polygon(Crusta* iCrusta);
+
+    /** returns whether the given position lies within the area */
+    bool contains(const Geometry::Point<double,3>& pos) const;
+    /** returns whether the area might overlap the spherical cap of given
+        (normalized) center and opening angle */
+    bool overlaps(const Geometry::Vector<double,3>& capCenter,
+                  double capAngle) const;
+
+//- Inherited from Shape
+public:
+    virtual void setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
+    virtual void restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
+
+    virtual ControlId addControlPoint(const Geometry::Point<double,3>& pos, End end=END_BACK);
+    virtual void moveControlPoint(const ControlId& id, const Geometry::Point<double,3>& pos);
+    virtual void removeControlPoint(const ControlId& id);
+    virtual ControlId refine(const ControlId& id, const Geometry::Point<double,3>& pos);
+
+protected:
+    /** recompute the bounding cap and the projected ring of the outline and
+        flag the area masks as outdated */
+    void updateBounds();
+    /** project a position onto the plane tangent to the center of the
+        bounding cap. Returns false if it lies on the opposite hemisphere */
+    bool project(const Geometry::Point<double,3>& pos,
+                 Geometry::Point<double,2>& projected) const;
+
+    /** center of the bounding cap */
+    Geometry::Vector<double,3> center;
+    /** basis of the plane tangent to the center */
+    Geometry::Vector<double,3> tangentU;
+    Geometry::Vector<double,3> tangentV;
+    /** opening angle of the bounding cap */
+    double capAngle;
+    /** gnomonic projection of the ring onto the tangent plane. Empty if the
+        outline doesn't enclose any area */
+    std::vector<Geometry::Point<double,2> > ring;
+};
+
+
+} //namespace crusta
+
+
+#endif //_Polygon_H_
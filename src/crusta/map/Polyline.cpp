@@ -3,6 +3,7 @@
 #include <cassert>
 
 #include <crusta/Crusta.h>
+#include <crusta/map/MapManager.h>
 
 #include <crusta/vrui.h>
 
@@ -21,7 +22,6 @@ void Polyline::
 recomputeCoords(ControlPointHandle cur)
 {
     assert(cur != controlPoints.end());
-    FrameStamp curStamp = CURRENT_FRAME;
 
     Geometry::Point<double,3> prevP, curP;
     ControlPointHandle prev = cur;
@@ -29,19 +29,29 @@ recomputeCoords(ControlPointHandle cur)
         --prev;
     else
     {
-        prev->stamp = curStamp;
         prev->coord = 0.0;
         ++cur;
     }
-    prevP = crusta->mapToScaledGlobe(prev->pos);
+    //measured on the unscaled globe, such that they don't depend on the scale
+    prevP = prev->pos;
     for (; cur!=controlPoints.end(); ++prev, ++cur, prevP=curP)
     {
-        cur->stamp = curStamp;
-        curP = crusta->mapToScaledGlobe(cur->pos);
+        curP = cur->pos;
         cur->coord  = prev->coord + Geometry::dist(prevP, curP);
     }
 }
 
+void Polyline::
+updateCoords(ControlPointHandle cur)
+{
+    recomputeCoords(cur);
+
+    //the coordinates of all the segments following the point have changed
+    if (cur != controlPoints.begin())
+        --cur;
+    crusta->getMapManager()->updateShapeData(this, cur, controlPoints.end());
+}
+
 void Polyline::
 setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
 {
@@ -49,12 +59,20 @@ setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints
     recomputeCoords(controlPoints.begin());
 }
 
+void Polyline::
+restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
+{
+    Shape::restoreControlPoints(newControlPoints);
+    if (!controlPoints.empty())
+        recomputeCoords(controlPoints.begin());
+}
+
 Shape::ControlId Polyline::
 addControlPoint(const Geometry::Point<double,3>& pos, End end)
 {
     Shape::ControlId ret = Shape::addControlPoint(pos, end);
     assert(ret.isValid());
-    recomputeCoords(ret.handle);
+    updateCoords(ret.handle);
     return ret;
 }
 
@@ -62,7 +80,7 @@ void Polyline::
 moveControlPoint(const ControlId& id, const Geometry::Point<double,3>& pos)
 {
     Shape::moveControlPoint(id, pos);
-    recomputeCoords(id.handle);
+    updateCoords(id.handle);
 }
 
 void Polyline::
@@ -79,7 +97,7 @@ removeControlPoint(const ControlId& id)
         ControlPointHandle next = id.handle;
         ++next;
         Shape::removeControlPoint(id);
-        recomputeCoords(next);
+        updateCoords(next);
     }
 }
 
@@ -88,7 +106,7 @@ refine(const ControlId& id, const Geometry::Point<double,3>& pos)
 {
     Shape::ControlId ret = Shape::refine(id, pos);
     assert(ret.isValid());
-    recomputeCoords(ret.handle);
+    updateCoords(ret.handle);
     return ret;
 }
 
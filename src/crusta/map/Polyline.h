@@ -19,11 +19,17 @@ public:
 //- Inherited from Shape
 public:
     virtual void setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
+    virtual void restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
 
     virtual ControlId addControlPoint(const Geometry::Point<double,3>& pos, End end=END_BACK);
     virtual void moveControlPoint(const ControlId& id, const Geometry::Point<double,3>& pos);
     virtual void removeControlPoint(const ControlId& id);
     virtual ControlId refine(const ControlId& id, const Geometry::Point<double,3>& pos);
+
+protected:
+    /** recompute the coordinates starting at the given control point and
+        flag the line data of the affected segments as outdated */
+    void updateCoords(ControlPointHandle start);
 };
 
 
@@ -4,6 +4,7 @@
 #include <crusta/Crusta.h>
 #include <crusta/map/Polyline.h>
 #include <crusta/QuadNodeData.h>
+#include <crusta/Timer.h>
 
 #include <crusta/vrui.h>
 
@@ -13,21 +14,71 @@ namespace crusta {
 
 PolylineRenderer::
 PolylineRenderer(Crusta* iCrusta) :
-    CrustaComponent(iCrusta)
+    CrustaComponent(iCrusta), resetStamp(0), scaleStamp(0)
 {
 }
 
 
 void PolylineRenderer::
-display(GLContextData& contextData, const SurfaceApproximation& surface) const
+invalidate()
+{
+    resetStamp = CURRENT_FRAME;
+}
+
+void PolylineRenderer::
+rescale()
 {
-    typedef NodeData::ShapeCoverage        Coverage;
-    typedef Shape::ControlPointHandleList  HandleList;
-    typedef Shape::ControlPointConstHandle Handle;
+    scaleStamp = CURRENT_FRAME;
+}
+
+void PolylineRenderer::
+update(SurfaceApproximation& surface)
+{
+    Timer timer;
+    timer.start();
+    bool rescaled = true;
+
+    size_t numNodes = surface.numVisibles();
+    for (size_t i=0; i<numNodes; ++i)
+    {
+        NodeData& node = surface.visibleNode(i);
+
+        //outdated coverage isn't drawn until it is derived again
+        if (node.lineCoverageDirty)
+            continue;
+
+        /* rebuild the vertices if the coverage has changed since or all of
+           them have been outdated (tool stamps are a frame behind, hence
+           <=) */
+        if (node.lineVertexVersion!=node.lineCoverageStamp ||
+            node.lineVertexStamp<=resetStamp)
+        {
+            buildVertices(node);
+        }
+        //rebuild vertices outdated by the scale within the time budget
+        else if (node.lineVertexStamp<=scaleStamp)
+        {
+            timer.stop();
+            timer.resume();
+            if (timer.seconds() < SETTINGS->mapScaleFrameTime)
+                buildVertices(node);
+            else
+                rescaled = false;
+        }
+    }
 
+    //carry on with the remaining nodes during the next frame
+    if (!rescaled)
+        Vrui::requestUpdate();
+}
+
+void PolylineRenderer::
+display(GLContextData& contextData, const SurfaceApproximation& surface) const
+{
     CHECK_GLA
 
     glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_POLYGON_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
     glDisable(GL_LIGHTING);
     glDisable(GL_TEXTURE_2D);
     glEnable(GL_POLYGON_OFFSET_LINE);
@@ -36,13 +87,20 @@ display(GLContextData& contextData, const SurfaceApproximation& surface) const
 
     glPolygonOffset(1.0f, 50.0f);
 
+    //the vertices are sourced from client memory
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
     //draw the fragments of each node
-    size_t numNodes = surface.visibles.size();
+    size_t numNodes = surface.numVisibles();
     for (size_t i=0; i<numNodes; ++i)
     {
-        const NodeData&                node     = *surface.visible(i).node;
-        const NodeData::ShapeCoverage& coverage = node.lineCoverage;
-        const Geometry::Point<double,3>&                  centroid = node.centroid;
+        const NodeData& node = surface.visibleNode(i);
+        if (node.lineCoverageDirty || node.lineVertices.empty())
+            continue;
+
+        const Geometry::Point<double,3>& centroid = node.centroid;
 
         //setup the transformation for the given node
         glPushMatrix();
@@ -52,64 +110,87 @@ display(GLContextData& contextData, const SurfaceApproximation& surface) const
         nav *= Vrui::NavTransform::translate(centroidTranslation);
         glLoadMatrix(nav);
 
+        GLsizei numVertices = static_cast<GLsizei>(node.lineVertices.size());
+        glVertexPointer(3, GL_FLOAT, 0, &node.lineVertices.front());
 
-        //iterate through all the lines for the given node
-        for (Coverage::const_iterator lit=coverage.begin(); lit!=coverage.end();
-             ++lit)
-        {
-            const Shape* const shape  = lit->first;
-            const HandleList& handles = lit->second;
-            assert(handles.size() > 0);
-            assert(dynamic_cast<const Polyline*>(shape) != NULL);
-
-            const Color& symbolColor = shape->getSymbol().color;
-            Color symbolColorDim     = symbolColor;
-            symbolColorDim[3]       *= 0.33f;
-
-            //iterate over all the fragments of a line
-            for (HandleList::const_iterator hit=handles.begin();
-                 hit!=handles.end(); ++hit)
-            {
-                Handle cur  = *hit;
-                Handle next = cur; ++cur;
-
-                //generate proper coordinates for the fragment
-                const Geometry::Point<double,3> curP  = crusta->mapToScaledGlobe(cur->pos);
-                const Geometry::Point<double,3> nextP = crusta->mapToScaledGlobe(next->pos);
-                Geometry::Point<float,3> curPf(curP[0]-centroid[0], curP[1]-centroid[1],
-                              curP[2]-centroid[2]);
-                Geometry::Point<float,3> nextPf(nextP[0]-centroid[0], nextP[1]-centroid[1],
-                               nextP[2]-centroid[2]);
-
-                //draw visible fragment
-                glDepthFunc(GL_LEQUAL);
-                glLineWidth(2.0);
-                glColor(symbolColor);
-                glBegin(GL_LINES);
-                    glVertex(curPf);
-                    glVertex(nextPf);
-                glEnd();
-
-                //display hidden fragment
-                glDepthFunc(GL_GREATER);
-                glLineWidth(1.0);
-                glColor(symbolColorDim);
-                glBegin(GL_LINES);
-                    glVertex(curPf);
-                    glVertex(nextPf);
-                glEnd();
-
-                CHECK_GLA
-            }
-        }
+        //draw visible fragments
+        glDepthFunc(GL_LEQUAL);
+        glLineWidth(2.0);
+        glColorPointer(4, GL_FLOAT, 0, &node.lineVertexColors.front());
+        glDrawArrays(GL_LINES, 0, numVertices);
+
+        //display hidden fragments
+        glDepthFunc(GL_GREATER);
+        glLineWidth(1.0);
+        glColorPointer(4, GL_FLOAT, 0, &node.lineVertexDimColors.front());
+        glDrawArrays(GL_LINES, 0, numVertices);
+
+        CHECK_GLA
 
         //restore the transformation
         glPopMatrix();
     }
 
+    glPopClientAttrib();
     glPopAttrib();
     CHECK_GLA
 }
 
 
+void PolylineRenderer::
+buildVertices(NodeData& node) const
+{
+    typedef NodeData::ShapeCoverage Coverage;
+    typedef Geometry::Point<float,3> Vertex;
+
+    const Coverage&                  coverage = node.lineCoverage;
+    const Geometry::Point<double,3>& centroid = node.centroid;
+
+    std::vector<Vertex>& vertices  = node.lineVertices;
+    Colors&              colors    = node.lineVertexColors;
+    Colors&              dimColors = node.lineVertexDimColors;
+    vertices.clear();
+    colors.clear();
+    dimColors.clear();
+    vertices.reserve(2*coverage.size());
+    colors.reserve(2*coverage.size());
+    dimColors.reserve(2*coverage.size());
+
+    //convert all the segments for the given node
+    for (Coverage::const_iterator sit=coverage.begin(); sit!=coverage.end();
+         ++sit)
+    {
+        const Shape* const shape = sit->shape;
+        assert(dynamic_cast<const Polyline*>(shape) != NULL);
+
+        const Color& symbolColor = shape->getSymbol().color;
+        Color symbolColorDim     = symbolColor;
+        symbolColorDim[3]       *= 0.33f;
+
+        Shape::ControlPointConstHandle start = sit->start;
+        Shape::ControlPointConstHandle end   = start; ++end;
+
+        //generate proper coordinates for the fragment
+        const Geometry::Point<double,3> startP =
+            crusta->mapToScaledGlobe(start->pos);
+        const Geometry::Point<double,3> endP =
+            crusta->mapToScaledGlobe(end->pos);
+        vertices.push_back(Vertex(startP[0]-centroid[0],
+                                  startP[1]-centroid[1],
+                                  startP[2]-centroid[2]));
+        vertices.push_back(Vertex(endP[0]-centroid[0],
+                                  endP[1]-centroid[1],
+                                  endP[2]-centroid[2]));
+
+        colors.push_back(symbolColor);
+        colors.push_back(symbolColor);
+        dimColors.push_back(symbolColorDim);
+        dimColors.push_back(symbolColorDim);
+    }
+
+    node.lineVertexVersion = node.lineCoverageStamp;
+    node.lineVertexStamp   = CURRENT_FRAME;
+}
+
+
 } //namespace crusta
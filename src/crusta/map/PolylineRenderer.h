@@ -13,13 +13,39 @@ class GLContextData;
 namespace crusta {
 
 
+/**
+    Renders the polylines without decoration. The segments covering each node
+    are converted to arrays of centroid-relative vertices that are only
+    rebuilt when the coverage of the node changes, or after modifications that
+    affect all of them, and are drawn with a single call per node and pass.
+*/
 class PolylineRenderer : public CrustaComponent
 {
 public:
     PolylineRenderer(Crusta* iCrusta);
 
+    /** flag the vertices of all the nodes as outdated (e.g. after changes of
+        the symbols) */
+    void invalidate();
+    /** flag the vertices of all the nodes as outdated after a change of the
+        vertical scale. They are rebuilt over several frames, the outdated
+        ones being drawn in the meantime */
+    void rescale();
+    /** build the vertices of the render nodes that are outdated */
+    void update(SurfaceApproximation& surface);
+
     void display(GLContextData& contextData,
                  const SurfaceApproximation& surface) const;
+
+protected:
+    /** build the vertices of a node from its coverage */
+    void buildVertices(NodeData& node) const;
+
+    /** vertices built up to this frame are outdated */
+    FrameStamp resetStamp;
+    /** vertices built up to this frame are outdated by a change of the
+        vertical scale */
+    FrameStamp scaleStamp;
 };
 
 
@@ -0,0 +1,346 @@
+#include <crusta/map/SegmentIndex.h>
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+#include <crusta/DataManager.h>
+#include <crustacore/Polyhedron.h>
+
+
+namespace crusta {
+
+
+const int      SegmentIndex::MAX_LEVEL;
+const size_t   SegmentIndex::MIN_RECENT_SIZE;
+const uint64_t SegmentIndex::GLOBAL_KEY;
+
+///number of bits of the key used to encode the level
+static const int KEY_LEVEL_BITS = 6;
+
+
+/** orders segments by their key */
+struct SegmentKeyLess
+{
+    bool operator()(const SegmentIndex::Segment& a,
+                    const SegmentIndex::Segment& b) const
+    {
+        return a.key < b.key;
+    }
+    bool operator()(const SegmentIndex::Segment& a, uint64_t b) const
+    {
+        return a.key < b;
+    }
+    bool operator()(uint64_t a, const SegmentIndex::Segment& b) const
+    {
+        return a < b.key;
+    }
+};
+
+/** identifies the removed segments */
+struct SegmentIsRemoved
+{
+    bool operator()(const SegmentIndex::Segment& s) const
+    {
+        return s.shape == NULL;
+    }
+};
+
+
+SegmentIndex::Segment::
+Segment() :
+    key(GLOBAL_KEY), shape(NULL)
+{
+}
+
+SegmentIndex::Segment::
+Segment(uint64_t iKey, const Shape* iShape,
+        const Shape::ControlPointHandle& iStart) :
+    key(iKey), shape(iShape), start(iStart)
+{
+}
+
+
+SegmentIndex::
+SegmentIndex() :
+    recentSorted(true), numRemoved(0), version(1)
+{
+}
+
+void SegmentIndex::
+add(const Shape* shape, const Shape::ControlPointHandle& start)
+{
+    Shape::ControlPointHandle end = start; ++end;
+    recent.push_back(Segment(computeKey(start->pos, end->pos), shape, start));
+    recentSorted = false;
+    ++version;
+
+    //fold the recent additions into the main segments once they pile up
+    if (recent.size() > std::max(MIN_RECENT_SIZE, segments.size()/16))
+        merge();
+}
+
+void SegmentIndex::
+add(const Segments& newSegments)
+{
+    if (newSegments.empty())
+        return;
+
+    recent.insert(recent.end(), newSegments.begin(), newSegments.end());
+    recentSorted = false;
+    ++version;
+
+    //fold them into the main segments right away
+    merge();
+}
+
+void SegmentIndex::
+remove(const Shape* shape, const Shape::ControlPointHandle& start)
+{
+    Shape::ControlPointHandle end = start; ++end;
+    uint64_t key = computeKey(start->pos, end->pos);
+
+    sortRecent();
+    if (!markRemoved(recent, key, shape, start) &&
+        !markRemoved(segments, key, shape, start))
+    {
+        /* the key of the segment has changed (e.g. the base patches were not
+           available when it was added), fall back to looking at all of
+           them */
+        bool found = false;
+        for (int i=0; i<2 && !found; ++i)
+        {
+            Segments& segs = i==0 ? recent : segments;
+            for (Segments::iterator it=segs.begin(); it!=segs.end(); ++it)
+            {
+                if (it->shape==shape && it->start==start)
+                {
+                    it->shape = NULL;
+                    found     = true;
+                    break;
+                }
+            }
+        }
+        assert(found);
+    }
+    ++numRemoved;
+    ++version;
+
+    //purge the removed segments once they make up a good part of the index
+    if (numRemoved > (segments.size()+recent.size())/4)
+        merge();
+}
+
+void SegmentIndex::
+clear()
+{
+    segments.clear();
+    recent.clear();
+    recentSorted = true;
+    numRemoved   = 0;
+    ++version;
+}
+
+void SegmentIndex::
+query(const TreeIndex& node, const Scope& scope, Segments& coverage)
+{
+    coverage.clear();
+    sortRecent();
+
+    const uint64_t patch = node.patch();
+    const int      level = node.level();
+    const uint64_t path  = node.index();
+
+    //the segments of the subtree are all contained in the node
+    uint64_t first = makeKey(patch, level, path);
+    uint64_t last  = first | ((uint64_t(1) << (2*(MAX_LEVEL-level) +
+                                               KEY_LEVEL_BITS)) - 1);
+    gatherRange(segments, first, last, coverage);
+    gatherRange(recent,   first, last, coverage);
+
+    //those of the ancestors and the global ones only might overlap the node
+    ScopeEdges edges(scope);
+    for (int l=0; l<level; ++l)
+    {
+        uint64_t ancestorPath = path & ((uint64_t(1) << (2*l)) - 1);
+        uint64_t ancestor     = makeKey(patch, l, ancestorPath);
+        gatherOverlapping(segments, ancestor, edges, coverage);
+        gatherOverlapping(recent,   ancestor, edges, coverage);
+    }
+    gatherOverlapping(segments, GLOBAL_KEY, edges, coverage);
+    gatherOverlapping(recent,   GLOBAL_KEY, edges, coverage);
+}
+
+void SegmentIndex::
+getSegments(Segments& all) const
+{
+    all.clear();
+    all.reserve(size());
+    for (int i=0; i<2; ++i)
+    {
+        const Segments& segs = i==0 ? segments : recent;
+        for (Segments::const_iterator it=segs.begin(); it!=segs.end(); ++it)
+        {
+            if (it->shape != NULL)
+                all.push_back(*it);
+        }
+    }
+}
+
+size_t SegmentIndex::
+size() const
+{
+    return segments.size() + recent.size() - numRemoved;
+}
+
+SegmentIndex::Version SegmentIndex::
+getVersion() const
+{
+    return version;
+}
+
+
+uint64_t SegmentIndex::
+makeKey(uint64_t patch, int level, uint64_t path)
+{
+    /* the path is reversed such that the child-index of the first level
+       makes up the most significant bits. The level follows the path, such
+       that a node precedes its subtree */
+    uint64_t key = 0;
+    for (int l=0; l<level; ++l)
+    {
+        uint64_t child = (path >> (2*l)) & 0x3;
+        key |= child << (2*(MAX_LEVEL-1-l));
+    }
+    key  |= patch << (2*MAX_LEVEL);
+    key <<= KEY_LEVEL_BITS;
+    key  |= static_cast<uint64_t>(level);
+    return key;
+}
+
+uint64_t SegmentIndex::
+computeKey(const Geometry::Point<double,3>& start,
+           const Geometry::Point<double,3>& end)
+{
+    const Polyhedron* polyhedron = DATAMANAGER->getPolyhedron();
+    if (polyhedron == NULL)
+        return GLOBAL_KEY;
+
+    //find the base patch containing the segment
+    const ScopeEdges::Point points[2] = { start, end };
+    Scope      scope;
+    ScopeEdges edges;
+    size_t numPatches = polyhedron->getNumPatches();
+    size_t patch;
+    for (patch=0; patch<numPatches; ++patch)
+    {
+        scope = polyhedron->getScope(patch);
+        edges.set(scope);
+        if (edges.contains(2, points) == 2)
+            break;
+    }
+    if (patch == numPatches)
+        return GLOBAL_KEY;
+
+    //descend to the deepest node containing the segment
+    int      level = 0;
+    uint64_t path  = 0;
+    Scope    children[4];
+    while (level < MAX_LEVEL)
+    {
+        scope.split(children);
+        int i;
+        for (i=0; i<4; ++i)
+        {
+            edges.set(children[i]);
+            if (edges.contains(2, points) == 2)
+                break;
+        }
+        if (i == 4)
+            break;
+
+        path |= static_cast<uint64_t>(i) << (2*level);
+        scope = children[i];
+        ++level;
+    }
+
+    return makeKey(patch, level, path);
+}
+
+
+void SegmentIndex::
+sortRecent()
+{
+    if (!recentSorted)
+    {
+        std::sort(recent.begin(), recent.end(), SegmentKeyLess());
+        recentSorted = true;
+    }
+}
+
+void SegmentIndex::
+merge()
+{
+    sortRecent();
+
+    Segments merged;
+    merged.reserve(segments.size() + recent.size());
+    std::merge(segments.begin(), segments.end(), recent.begin(), recent.end(),
+               std::back_inserter(merged), SegmentKeyLess());
+    merged.erase(std::remove_if(merged.begin(), merged.end(),
+                                SegmentIsRemoved()), merged.end());
+
+    segments.swap(merged);
+    recent.clear();
+    numRemoved = 0;
+}
+
+bool SegmentIndex::
+markRemoved(Segments& segs, uint64_t key, const Shape* shape,
+            const Shape::ControlPointHandle& start)
+{
+    std::pair<Segments::iterator, Segments::iterator> range =
+        std::equal_range(segs.begin(), segs.end(), key, SegmentKeyLess());
+    for (Segments::iterator it=range.first; it!=range.second; ++it)
+    {
+        if (it->shape==shape && it->start==start)
+        {
+            it->shape = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SegmentIndex::
+gatherRange(const Segments& segs, uint64_t first, uint64_t last,
+            Segments& coverage)
+{
+    Segments::const_iterator it = std::lower_bound(segs.begin(), segs.end(),
+                                                   first, SegmentKeyLess());
+    for (; it!=segs.end() && it->key<=last; ++it)
+    {
+        if (it->shape != NULL)
+            coverage.push_back(*it);
+    }
+}
+
+void SegmentIndex::
+gatherOverlapping(const Segments& segs, uint64_t key,
+                  const ScopeEdges& edges, Segments& coverage)
+{
+    std::pair<Segments::const_iterator, Segments::const_iterator> range =
+        std::equal_range(segs.begin(), segs.end(), key, SegmentKeyLess());
+    for (Segments::const_iterator it=range.first; it!=range.second; ++it)
+    {
+        if (it->shape == NULL)
+            continue;
+
+        Shape::ControlPointHandle end = it->start; ++end;
+        if (edges.intersects(it->start->pos, end->pos))
+            coverage.push_back(*it);
+    }
+}
+
+
+} //namespace crusta
@@ -0,0 +1,127 @@
+#ifndef _SegmentIndex_H_
+#define _SegmentIndex_H_
+
+#include <vector>
+
+#include <crustacore/Scope.h>
+#include <crustacore/ScopeEdges.h>
+#include <crustacore/TreeIndex.h>
+#include <crusta/map/Shape.h>
+
+
+namespace crusta {
+
+
+/**
+    Global index of the segments of all the shapes. Each segment is stored
+    under the key of the deepest node of the global quadtree hierarchy whose
+    scope contains it. The keys order the nodes depth-first, such that the
+    segments of a subtree are stored contiguously. The coverage of a node is
+    thus derived by a range lookup of its subtree, plus the segments of its
+    ancestors that overlap it.
+
+    The segments are kept in flat arrays sorted by key: a main one and a
+    smaller one receiving the recent additions, which is merged into the main
+    one when it grows too large. Removed segments are only marked and are
+    purged when merging.
+*/
+class SegmentIndex
+{
+public:
+    /** a segment of a shape, identified by its starting control point */
+    struct Segment
+    {
+        Segment();
+        Segment(uint64_t iKey, const Shape* iShape,
+                const Shape::ControlPointHandle& iStart);
+
+        /** key of the node the segment is stored at */
+        uint64_t                  key;
+        /** shape of the segment. NULL if the segment has been removed */
+        const Shape*              shape;
+        /** starting control point of the segment */
+        Shape::ControlPointHandle start;
+    };
+    typedef std::vector<Segment> Segments;
+    /** counts the modifications of the index */
+    typedef uint64_t Version;
+
+    SegmentIndex();
+
+    /** add the segment starting at the given control point */
+    void add(const Shape* shape, const Shape::ControlPointHandle& start);
+    /** add segments whose keys are known already (e.g. those of a restored
+        map) in bulk */
+    void add(const Segments& newSegments);
+    /** remove the segment starting at the given control point. The control
+        points must not have moved since the segment was added */
+    void remove(const Shape* shape, const Shape::ControlPointHandle& start);
+    /** remove all the segments */
+    void clear();
+
+    /** retrieve the segments overlapping the given node */
+    void query(const TreeIndex& node, const Scope& scope,
+               Segments& coverage);
+    /** retrieve all the segments of the index (in no particular order) */
+    void getSegments(Segments& all) const;
+
+    /** number of segments in the index */
+    size_t size() const;
+    /** version of the index, incremented with every modification. Starts
+        at 1 such that 0 can flag the absence of modifications */
+    Version getVersion() const;
+
+    /** compute the key of the deepest node containing a segment */
+    static uint64_t computeKey(const Geometry::Point<double,3>& start,
+                               const Geometry::Point<double,3>& end);
+
+protected:
+    /** deepest level of the hierarchy segments are stored at. It is limited
+        by the number of path bits of the TreeIndex */
+    static const int MAX_LEVEL = 23;
+    /** minimum size the recent additions are allowed to grow to before they
+        are merged with the main segments */
+    static const size_t MIN_RECENT_SIZE = 4096;
+    /** key of the segments that do not fit in any base patch */
+    static const uint64_t GLOBAL_KEY = ~uint64_t(0);
+
+    /** compute the key of the node with given patch, level and path (a
+        sequence of two-bit child-indices starting with the least significant
+        bits, as for the TreeIndex) */
+    static uint64_t makeKey(uint64_t patch, int level, uint64_t path);
+
+    /** make sure the recent additions are sorted */
+    void sortRecent();
+    /** merge the recent additions into the main segments, purging the
+        removed ones */
+    void merge();
+    /** mark the segment with given key as removed in the sorted segments.
+        Returns false if the segment is not found */
+    static bool markRemoved(Segments& segs, uint64_t key, const Shape* shape,
+                            const Shape::ControlPointHandle& start);
+    /** append the segments of the given key range [first, last] */
+    static void gatherRange(const Segments& segs, uint64_t first,
+                            uint64_t last, Segments& coverage);
+    /** append the segments of the given key that overlap the scope of the
+        given edges */
+    static void gatherOverlapping(const Segments& segs, uint64_t key,
+                                  const ScopeEdges& edges,
+                                  Segments& coverage);
+
+    /** the segments sorted by key */
+    Segments segments;
+    /** the segments added since the last merge */
+    Segments recent;
+    /** flags whether the recent additions are sorted */
+    bool recentSorted;
+    /** number of segments marked removed */
+    size_t numRemoved;
+    /** current version of the index */
+    Version version;
+};
+
+
+} //namespace crusta
+
+
+#endif //_SegmentIndex_H_
@@ -15,33 +15,26 @@ namespace crusta {
 const Shape::ControlId Shape::BAD_ID(CONTROL_INVALID, ControlPointHandle());
 
 
-/* the default stamp for a control point is one that will never prompt an
-   update */
 Shape::ControlPoint::
 ControlPoint() :
-    stamp(Math::Constants<FrameStamp>::max), pos(0), coord(0)
+    pos(0), coord(0)
 {}
 
 Shape::ControlPoint::
 ControlPoint(const ControlPoint& other) :
-    stamp(other.stamp), pos(other.pos), coord(other.coord)
+    pos(other.pos), coord(other.coord)
 {}
 
 Shape::ControlPoint::
 ControlPoint(const Geometry::Point<double,3>& iPos) :
-    stamp(Math::Constants<FrameStamp>::max), pos(iPos), coord(0)
-{}
-
-Shape::ControlPoint::
-ControlPoint(const FrameStamp& iStamp, const Geometry::Point<double,3>& iPos) :
-    stamp(iStamp), pos(iPos), coord(0)
+    pos(iPos), coord(0)
 {}
 
 
 std::ostream&
 operator<<(std::ostream& os, const Shape::ControlPointHandle& cph)
 {
-    os << "cph(" << cph->stamp << "." << &(*cph) << ")";
+    os << "cph(" << &(*cph) << ")";
     return os;
 }
 
@@ -264,6 +257,18 @@ setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints
     mapMan->addShapeCoverage(this, controlPoints.begin(), controlPoints.end());
 }
 
+void Shape::
+restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints)
+{
+    assert(controlPoints.empty());
+
+    for (std::vector<Geometry::Point<double,3> >::const_iterator it=newControlPoints.begin();
+         it!=newControlPoints.end(); ++it)
+    {
+        controlPoints.push_back(ControlPoint(*it));
+    }
+}
+
 Shape::ControlId Shape::
 addControlPoint(const Geometry::Point<double,3>& pos, End end)
 {
@@ -456,12 +461,7 @@ setSymbol(const Symbol& nSymbol)
 {
     symbol = nSymbol;
     //dirty the whole shape to prompt an update of the display representation
-    FrameStamp curStamp = CURRENT_FRAME;
-    for (ControlPointList::iterator it=controlPoints.begin();
-         it!=controlPoints.end(); ++it)
-    {
-        it->stamp = curStamp;
-    }
+    crusta->getMapManager()->updateShapeSymbol(this);
 }
 
 const Shape::Symbol& Shape::
@@ -29,15 +29,7 @@ public:
         ControlPoint();
         ControlPoint(const ControlPoint& other);
         ControlPoint(const Geometry::Point<double,3>& position);
-        ControlPoint(const FrameStamp& attributeStamp, const Geometry::Point<double,3>& iPos);
-
-        /** stamp used to age parts of the line segment. In particular, the line
-            data needs to be regenerated if its stamp is older than this stamp.
-            Such cases occur after moving a control point where all subsequent
-            points need to have their coordinate updated. Changing the symbol
-            of a shape is a case where all the overlaped node's line data must
-            be updated. */
-        FrameStamp stamp;
+
         Geometry::Point<double,3>     pos;
         Scalar     coord;
     };
@@ -108,6 +100,10 @@ friend std::ostream& operator<<(std::ostream& os, const ControlId& cid);
     ControlId selectExtremity(const Geometry::Point<double,3>& pos, double& dist, End& end);
 
     virtual void setControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
+    /** assign the control points of a shape restored from a snapshot. Unlike
+        setControlPoints, the segments are not added to the index: the caller
+        restores them separately */
+    virtual void restoreControlPoints(const std::vector<Geometry::Point<double,3> >& newControlPoints);
 
     virtual ControlId addControlPoint(const Geometry::Point<double,3>& pos, End end=END_BACK);
     virtual void moveControlPoint(const ControlId& id, const Geometry::Point<double,3>& pos);
@@ -13,7 +13,8 @@ namespace crusta {
 ShaderDecoratedLineRenderer::
 ShaderDecoratedLineRenderer(const std::string& shaderFileName_) :
     ShaderFileFragment(shaderFileName_), coverageSrc(NULL), lineDataSrc(NULL),
-    numSegmentsUniform(-2), symbolLengthUniform(-2), symbolWidthUniform(-2)
+    numSegmentsUniform(-2), numAreasUniform(-2), symbolLengthUniform(-2),
+    symbolWidthUniform(-2)
 {
 }
 
@@ -35,6 +36,15 @@ CRUSTA_DEBUG(80, assert(numSegmentsUniform>=0);)
     CHECK_GLA
 }
 
+void ShaderDecoratedLineRenderer::
+setNumAreas(int numAreas)
+{
+CRUSTA_DEBUG(80, assert(numAreasUniform>=0);)
+    if (numAreasUniform >= 0)
+        glUniform1i(numAreasUniform, numAreas);
+    CHECK_GLA
+}
+
 void ShaderDecoratedLineRenderer::
 setSymbolLength(float length)
 {
@@ -90,6 +100,7 @@ reset()
     ShaderFileFragment::reset();
 
     numSegmentsUniform  = -2;
+    numAreasUniform     = -2;
     symbolLengthUniform = -2;
     symbolWidthUniform  = -2;
 }
@@ -116,6 +127,7 @@ initUniforms(GLuint programObj)
     glUniform1f(uniform, crusta::SETTINGS->lineDataCoordStep);
 
     numSegmentsUniform  = glGetUniformLocation(programObj,  "lineNumSegments");
+    numAreasUniform     = glGetUniformLocation(programObj,     "lineNumAreas");
     symbolLengthUniform = glGetUniformLocation(programObj, "lineSymbolLength");
     symbolWidthUniform  = glGetUniformLocation(programObj,  "lineSymbolWidth");
 }
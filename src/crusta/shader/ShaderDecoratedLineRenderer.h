@@ -18,6 +18,7 @@ public:
 
     /**\{ uniform setters */
     void setNumSegments(int numSegments);
+    void setNumAreas(int numAreas);
     void setSymbolLength(float length);
     void setSymbolWidth(float width);
     /**\}*/
@@ -28,6 +29,7 @@ protected:
 
 ///\todo comment the various uniforms
     GLint numSegmentsUniform;
+    GLint numAreasUniform;
     GLint symbolLengthUniform;
     GLint symbolWidthUniform;
 
@@ -3,6 +3,7 @@
 
 
 #include <string>
+#include <vector>
 
 #include <crustacore/GlobeData.h>
 #include <crustacore/Polyhedron.h>
@@ -19,6 +20,7 @@ public:
     typedef typename PixelParam::Type PixelType;
     typedef GlobeData<PixelParam>     gd;
     typedef typename gd::File         File;
+    typedef std::vector<int>          PatchIds;
 
 ///\todo when moving to Vrui 2.0 no need to initialize the cfg pointer anymore
     GlobeFile(bool writable);
@@ -27,10 +29,17 @@ public:
     /** check that the file is a valid wrt PixelParam */
     static bool isCompatible(const std::string& path);
 
-    void open(const std::string& path);
+    /** open the globe file. If a subset of the patches is specified, only
+        the quadtree files of those patches are opened (and created). This
+        allows independent processes to update disjoint patches of the same
+        globe file */
+    void open(const std::string& path, const PatchIds& subset=PatchIds());
     void close();
+    /** force the data written to the open patches to disk */
+    void flush();
 
-    /** get access to a specific patch of the globe file */
+    /** get access to a specific patch of the globe file. Returns NULL for
+        patches outside the subset the file was opened with */
     File* getPatch(uint8_t patch);
 
     /** retrieve the nodata value filled data buffer */
@@ -53,7 +62,10 @@ public:
 protected:
     typedef std::vector<File*> PatchFiles;
 
-    void loadConfiguration(const std::string& cfgName);
+    /** load the configuration of the globe file, creating it if necessary.
+        The configuration is only kept for saving on close if the file was
+        opened for all of its patches */
+    void loadConfiguration(const std::string& cfgName, bool patchSubset);
     void createBaseFolder(std::string path, bool parent=false);
 
     bool writable;
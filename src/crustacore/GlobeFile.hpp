@@ -3,10 +3,12 @@
 
 
 #include <cassert>
+#include <cerrno>
 #include <iomanip>
 #include <limits>
 #include <sstream>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <crustacore/PolyhedronLoader.h>
 
@@ -46,7 +48,7 @@ isCompatible(const std::string& path)
 
 template <typename PixelParam>
 void GlobeFile<PixelParam>::
-open(const std::string& path)
+open(const std::string& path, const PatchIds& subset)
 {
     close();
 
@@ -57,7 +59,8 @@ open(const std::string& path)
     }
 
     //open configuration
-    loadConfiguration(path + std::string("/crustaGlobeFile.cfg"));
+    loadConfiguration(path + std::string("/crustaGlobeFile.cfg"),
+                      !subset.empty());
 
     //prepare a "blank region"
     blank.resize(tileSize[0]*tileSize[1], nodata);
@@ -66,14 +69,31 @@ open(const std::string& path)
     Polyhedron* polyhedron = PolyhedronLoader::load(polyhedronType, 1.0);
     numPatches = polyhedron->getNumPatches();
 
+    //validate the subset of patches to be opened
+    std::vector<bool> openPatch(numPatches, subset.empty());
+    for (PatchIds::const_iterator it=subset.begin(); it!=subset.end(); ++it)
+    {
+        if (*it<0 || *it>=numPatches)
+        {
+            delete polyhedron;
+            Misc::throwStdErr("GlobeFile::open: invalid patch %d requested "
+                              "(globe file %s has %d patches)", *it,
+                              path.c_str(), numPatches);
+        }
+        openPatch[*it] = true;
+    }
+
     //create the base nodes and open the corresponding quadtree file
-    patches.reserve(numPatches);
+    patches.resize(numPatches, NULL);
     for (int i=0; i<numPatches; ++i)
     {
+        if (!openPatch[i])
+            continue;
+
         std::ostringstream oss;
         oss << path << "/patch_" << i << ".qtf";
         uint32_t utileSize[2] = {uint32_t(tileSize[0]), uint32_t(tileSize[1])};
-        patches.push_back(new File(oss.str().c_str(), utileSize, writable));
+        patches[i] = new File(oss.str().c_str(), utileSize, writable);
 
         if (writable)
         {
@@ -112,6 +132,18 @@ close()
     blank.clear();
 }
 
+template <typename PixelParam>
+void GlobeFile<PixelParam>::
+flush()
+{
+    typedef typename PatchFiles::iterator PatchFileIterator;
+    for (PatchFileIterator it=patches.begin(); it!=patches.end(); ++it)
+    {
+        if (*it != NULL)
+            (*it)->flush();
+    }
+}
+
 template <typename PixelParam>
 typename GlobeFile<PixelParam>::File* GlobeFile<PixelParam>::
 getPatch(uint8_t patch)
@@ -172,7 +204,7 @@ getTileSize() const
 
 template <typename PixelParam>
 void GlobeFile<PixelParam>::
-loadConfiguration(const std::string& cfgName)
+loadConfiguration(const std::string& cfgName, bool patchSubset)
 {
     bool create = false;
 
@@ -228,10 +260,14 @@ loadConfiguration(const std::string& cfgName)
 
     if (create)
     {
-        //create the file
-        delete new Misc::File(cfgName.c_str(), "wt");
-        //open it
-        cfg = new Misc::ConfigurationFile(cfgName.c_str());
+        /* several processes building disjoint patches may create the file
+           at once. Write it under a name private to this process and publish
+           it atomically, such that the others never see a partial file */
+        std::ostringstream tmpOss;
+        tmpOss << cfgName << "." << getpid() << ".tmp";
+        std::string tmpName = tmpOss.str();
+        delete new Misc::File(tmpName.c_str(), "wt");
+        cfg = new Misc::ConfigurationFile(tmpName.c_str());
 
         //setup the configuration properties
         Polyhedron* polyhedron =
@@ -256,9 +292,31 @@ loadConfiguration(const std::string& cfgName)
         cfg->storeString("nodata", oss.str().c_str());
         cfg->storeString("polyhedronType", polyhedronType.c_str());
         cfg->storeValue<Geometry::Point<int,2> >("tileSize",Geometry::Point<int,2>(tileSize[0], tileSize[1]));
-    }
+        cfg->save();
+        delete cfg;
+        cfg = NULL;
 
-    if (!create && cfg)
+        //link fails if another process has published its file first
+        bool published = link(tmpName.c_str(), cfgName.c_str()) == 0;
+        int  linkError = errno;
+        unlink(tmpName.c_str());
+        if (!published)
+        {
+            if (linkError != EEXIST)
+            {
+                Misc::throwStdErr("Could not create the globe file metadata "
+                                  "(%s)", cfgName.c_str());
+            }
+            //validate the configuration of the other process instead
+            loadConfiguration(cfgName, patchSubset);
+            return;
+        }
+
+        //only the process updating the whole globe saves it on close
+        if (!patchSubset)
+            cfg = new Misc::ConfigurationFile(cfgName.c_str());
+    }
+    else if (cfg)
     {
         delete cfg;
         cfg = NULL;
@@ -309,8 +367,9 @@ createBaseFolder(std::string path, bool parent)
             createBaseFolder(parentPath, true);
         }
 
-        //create the base folder
-        if(mkdir(path.c_str(), 0777) < 0)
+        /* create the base folder. Another process building a different
+           subset of the patches may have created it in the meantime */
+        if(mkdir(path.c_str(), 0777)<0 && errno!=EEXIST)
         {
             Misc::throwStdErr("Could not create output globe file path %s",
                               path.c_str());
@@ -0,0 +1,654 @@
+#include <crustacore/PixelKernels.h>
+
+
+#include <cfloat>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRUSTA_PIXELKERNELS_X86 1
+#include <immintrin.h>
+#define CRUSTA_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CRUSTA_PIXELKERNELS_X86 0
+#endif //x86
+
+
+namespace crusta {
+
+
+namespace {
+
+
+//- scalar ---------------------------------------------------------------------
+
+/* The scalar kernels perform exactly the same operations, in the same order,
+   as the vectorized ones. They process the tails of the rows for the vector
+   implementations, such that results do not depend on the instruction set.
+   Sums are accumulated in double precision and rounded to float once. */
+
+inline float
+average2(float a, float b, float nodata)
+{
+    if (a == nodata)
+        return b;
+    else if (b == nodata)
+        return a;
+    else
+        return float((double(a)+double(b)) * 0.5);
+}
+
+inline void
+accumulate(float v, double weight, float nodata, double& sum,
+           double& sumWeights)
+{
+    bool valid  = v != nodata;
+    sum        += valid ? double(v)*weight : 0.0;
+    sumWeights += valid ? weight : 0.0;
+}
+
+inline float
+average4(float a, float b, float c, float d, float nodata)
+{
+    double sum        = 0.0;
+    double sumWeights = 0.0;
+    accumulate(a, 0.25, nodata, sum, sumWeights);
+    accumulate(b, 0.25, nodata, sum, sumWeights);
+    accumulate(c, 0.25, nodata, sum, sumWeights);
+    accumulate(d, 0.25, nodata, sum, sumWeights);
+
+    return sumWeights==0.0 ? nodata : float(sum / sumWeights);
+}
+
+void
+expandRowScalar(int start, const float* src, int numSrc, float nodata,
+                float* dst)
+{
+    for (int i=start; i<numSrc-1; ++i)
+    {
+        dst[2*i]   = src[i];
+        dst[2*i+1] = average2(src[i], src[i+1], nodata);
+    }
+    dst[2*(numSrc-1)] = src[numSrc-1];
+}
+
+void
+expandRowPairScalar(int start, const float* a, const float* b, int numSrc,
+                    float nodata, float* dst)
+{
+    for (int i=start; i<numSrc-1; ++i)
+    {
+        dst[2*i]   = average2(a[i], b[i], nodata);
+        dst[2*i+1] = average4(a[i], a[i+1], b[i], b[i+1], nodata);
+    }
+    dst[2*(numSrc-1)] = average2(a[numSrc-1], b[numSrc-1], nodata);
+}
+
+void
+subsampleRowScalar(int start, const float* at, int rowLen, int numDst,
+                   const double* weights, int radius, float nodata, float* dst)
+{
+    for (int i=start; i<numDst; ++i)
+    {
+        const float* center = at + 2*i;
+
+        double sum        = 0.0;
+        double sumWeights = 0.0;
+        for (int y=-radius; y<=radius; ++y)
+        {
+            const float* atY = center + y*rowLen;
+            for (int x=-radius; x<=radius; ++x)
+                accumulate(atY[x], weights[y]*weights[x], nodata, sum,
+                           sumWeights);
+        }
+
+        dst[i] = sumWeights==0.0 ? nodata : float(sum / sumWeights);
+    }
+}
+
+void
+rowRangeScalar(int start, const float* src, int num, float nodata,
+               float range[2])
+{
+    for (int i=start; i<num; ++i)
+    {
+        if (src[i] != nodata)
+        {
+            range[0] = src[i]<range[0] ? src[i] : range[0];
+            range[1] = src[i]>range[1] ? src[i] : range[1];
+        }
+    }
+}
+
+void
+expandRowGeneric(const float* src, int numSrc, float nodata, float* dst)
+{
+    expandRowScalar(0, src, numSrc, nodata, dst);
+}
+
+void
+expandRowPairGeneric(const float* a, const float* b, int numSrc, float nodata,
+                     float* dst)
+{
+    expandRowPairScalar(0, a, b, numSrc, nodata, dst);
+}
+
+void
+subsampleRowGeneric(const float* at, int rowLen, int numDst,
+                    const double* weights, int radius, float nodata, float* dst)
+{
+    subsampleRowScalar(0, at, rowLen, numDst, weights, radius, nodata, dst);
+}
+
+void
+rowRangeGeneric(const float* src, int num, float nodata, float range[2])
+{
+    rowRangeScalar(0, src, num, nodata, range);
+}
+
+
+#if CRUSTA_PIXELKERNELS_X86
+
+//- SSE2 -----------------------------------------------------------------------
+
+CRUSTA_TARGET("sse2") inline __m128
+selectSse2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+CRUSTA_TARGET("sse2") inline __m128d
+selectSse2(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+/** widen the lower two values to double precision */
+CRUSTA_TARGET("sse2") inline __m128d
+lowerSse2(__m128 v)
+{
+    return _mm_cvtps_pd(v);
+}
+
+/** widen the upper two values to double precision */
+CRUSTA_TARGET("sse2") inline __m128d
+upperSse2(__m128 v)
+{
+    return _mm_cvtps_pd(_mm_movehl_ps(v, v));
+}
+
+/** round two pairs of double precision values back to four floats */
+CRUSTA_TARGET("sse2") inline __m128
+narrowSse2(__m128d lower, __m128d upper)
+{
+    return _mm_movelh_ps(_mm_cvtpd_ps(lower), _mm_cvtpd_ps(upper));
+}
+
+CRUSTA_TARGET("sse2") inline void
+accumulateSse2(__m128d v, __m128d weight, __m128d nodata, __m128d& sum,
+               __m128d& sumWeights)
+{
+    __m128d valid = _mm_cmpneq_pd(v, nodata);
+    sum        = _mm_add_pd(sum, _mm_and_pd(valid, _mm_mul_pd(v, weight)));
+    sumWeights = _mm_add_pd(sumWeights, _mm_and_pd(valid, weight));
+}
+
+CRUSTA_TARGET("sse2") inline __m128d
+normalizeSse2(__m128d sum, __m128d sumWeights, __m128d nodata)
+{
+    __m128d empty = _mm_cmpeq_pd(sumWeights, _mm_setzero_pd());
+    return selectSse2(empty, nodata, _mm_div_pd(sum, sumWeights));
+}
+
+CRUSTA_TARGET("sse2") inline __m128
+average2Sse2(__m128 a, __m128 b, __m128 nodata)
+{
+    const __m128d half = _mm_set1_pd(0.5);
+
+    __m128 validA = _mm_cmpneq_ps(a, nodata);
+    __m128 validB = _mm_cmpneq_ps(b, nodata);
+    __m128 avg    = narrowSse2(
+        _mm_mul_pd(_mm_add_pd(lowerSse2(a), lowerSse2(b)), half),
+        _mm_mul_pd(_mm_add_pd(upperSse2(a), upperSse2(b)), half));
+    return selectSse2(validA, selectSse2(validB, avg, a), b);
+}
+
+CRUSTA_TARGET("sse2") inline __m128d
+average4Sse2(__m128d a, __m128d b, __m128d c, __m128d d, __m128d nodata)
+{
+    const __m128d quarter = _mm_set1_pd(0.25);
+
+    __m128d sum        = _mm_setzero_pd();
+    __m128d sumWeights = _mm_setzero_pd();
+    accumulateSse2(a, quarter, nodata, sum, sumWeights);
+    accumulateSse2(b, quarter, nodata, sum, sumWeights);
+    accumulateSse2(c, quarter, nodata, sum, sumWeights);
+    accumulateSse2(d, quarter, nodata, sum, sumWeights);
+
+    return normalizeSse2(sum, sumWeights, nodata);
+}
+
+CRUSTA_TARGET("sse2") inline __m128
+average4Sse2(__m128 a, __m128 b, __m128 c, __m128 d, __m128d nodata)
+{
+    return narrowSse2(
+        average4Sse2(lowerSse2(a), lowerSse2(b), lowerSse2(c), lowerSse2(d),
+                     nodata),
+        average4Sse2(upperSse2(a), upperSse2(b), upperSse2(c), upperSse2(d),
+                     nodata));
+}
+
+CRUSTA_TARGET("sse2") void
+expandRowSse2(const float* src, int numSrc, float nodata, float* dst)
+{
+    const __m128 nd = _mm_set1_ps(nodata);
+
+    int i = 0;
+    for (; i+4<numSrc; i+=4)
+    {
+        __m128 s   = _mm_loadu_ps(src + i);
+        __m128 avg = average2Sse2(s, _mm_loadu_ps(src + i + 1), nd);
+        _mm_storeu_ps(dst + 2*i,     _mm_unpacklo_ps(s, avg));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(s, avg));
+    }
+    expandRowScalar(i, src, numSrc, nodata, dst);
+}
+
+CRUSTA_TARGET("sse2") void
+expandRowPairSse2(const float* a, const float* b, int numSrc, float nodata,
+                  float* dst)
+{
+    const __m128  nd  = _mm_set1_ps(nodata);
+    const __m128d ndd = _mm_set1_pd(nodata);
+
+    int i = 0;
+    for (; i+4<numSrc; i+=4)
+    {
+        __m128 a0  = _mm_loadu_ps(a + i);
+        __m128 a1  = _mm_loadu_ps(a + i + 1);
+        __m128 b0  = _mm_loadu_ps(b + i);
+        __m128 b1  = _mm_loadu_ps(b + i + 1);
+        __m128 vertical = average2Sse2(a0, b0, nd);
+        __m128 center   = average4Sse2(a0, a1, b0, b1, ndd);
+        _mm_storeu_ps(dst + 2*i,     _mm_unpacklo_ps(vertical, center));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(vertical, center));
+    }
+    expandRowPairScalar(i, a, b, numSrc, nodata, dst);
+}
+
+CRUSTA_TARGET("sse2") void
+subsampleRowSse2(const float* at, int rowLen, int numDst,
+                 const double* weights, int radius, float nodata, float* dst)
+{
+    const __m128d nd   = _mm_set1_pd(nodata);
+    const __m128d zero = _mm_setzero_pd();
+
+    /* the de-interleaving loads read one value past the last tap of the group,
+       hence the last output is always left to the scalar tail */
+    int i = 0;
+    for (; i+4<numDst; i+=4)
+    {
+        const float* center = at + 2*i;
+
+        __m128d sumLower        = zero;
+        __m128d sumUpper        = zero;
+        __m128d sumWeightsLower = zero;
+        __m128d sumWeightsUpper = zero;
+        for (int y=-radius; y<=radius; ++y)
+        {
+            const float* atY = center + y*rowLen;
+            for (int x=-radius; x<=radius; ++x)
+            {
+                //gather the taps of 4 consecutive outputs (stride 2)
+                __m128 lo = _mm_loadu_ps(atY + x);
+                __m128 hi = _mm_loadu_ps(atY + x + 4);
+                __m128 v  = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0));
+
+                __m128d weight = _mm_set1_pd(weights[y] * weights[x]);
+                accumulateSse2(lowerSse2(v), weight, nd, sumLower,
+                               sumWeightsLower);
+                accumulateSse2(upperSse2(v), weight, nd, sumUpper,
+                               sumWeightsUpper);
+            }
+        }
+
+        _mm_storeu_ps(dst + i, narrowSse2(
+            normalizeSse2(sumLower, sumWeightsLower, nd),
+            normalizeSse2(sumUpper, sumWeightsUpper, nd)));
+    }
+    subsampleRowScalar(i, at, rowLen, numDst, weights, radius, nodata, dst);
+}
+
+CRUSTA_TARGET("sse2") void
+rowRangeSse2(const float* src, int num, float nodata, float range[2])
+{
+    const __m128 nd      = _mm_set1_ps(nodata);
+    const __m128 highest = _mm_set1_ps(FLT_MAX);
+    const __m128 lowest  = _mm_set1_ps(-FLT_MAX);
+
+    __m128 rangeMin = highest;
+    __m128 rangeMax = lowest;
+    int    anyValid = 0;
+
+    int i = 0;
+    for (; i+4<=num; i+=4)
+    {
+        __m128 v     = _mm_loadu_ps(src + i);
+        __m128 valid = _mm_cmpneq_ps(v, nd);
+        anyValid    |= _mm_movemask_ps(valid);
+        rangeMin     = _mm_min_ps(rangeMin, selectSse2(valid, v, highest));
+        rangeMax     = _mm_max_ps(rangeMax, selectSse2(valid, v, lowest));
+    }
+
+    if (anyValid != 0)
+    {
+        float mins[4], maxs[4];
+        _mm_storeu_ps(mins, rangeMin);
+        _mm_storeu_ps(maxs, rangeMax);
+        for (int j=0; j<4; ++j)
+        {
+            range[0] = mins[j]<range[0] ? mins[j] : range[0];
+            range[1] = maxs[j]>range[1] ? maxs[j] : range[1];
+        }
+    }
+    rowRangeScalar(i, src, num, nodata, range);
+}
+
+
+//- AVX2 -----------------------------------------------------------------------
+
+CRUSTA_TARGET("avx2") inline __m256
+selectAvx2(__m256 mask, __m256 a, __m256 b)
+{
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+CRUSTA_TARGET("avx2") inline __m256d
+selectAvx2(__m256d mask, __m256d a, __m256d b)
+{
+    return _mm256_blendv_pd(b, a, mask);
+}
+
+/** widen the lower four values to double precision */
+CRUSTA_TARGET("avx2") inline __m256d
+lowerAvx2(__m256 v)
+{
+    return _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+}
+
+/** widen the upper four values to double precision */
+CRUSTA_TARGET("avx2") inline __m256d
+upperAvx2(__m256 v)
+{
+    return _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+}
+
+/** round two quadruples of double precision values back to eight floats */
+CRUSTA_TARGET("avx2") inline __m256
+narrowAvx2(__m256d lower, __m256d upper)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lower)),
+                                _mm256_cvtpd_ps(upper), 1);
+}
+
+CRUSTA_TARGET("avx2") inline void
+accumulateAvx2(__m256d v, __m256d weight, __m256d nodata, __m256d& sum,
+               __m256d& sumWeights)
+{
+    __m256d valid = _mm256_cmp_pd(v, nodata, _CMP_NEQ_UQ);
+    sum        = _mm256_add_pd(sum,
+                     _mm256_and_pd(valid, _mm256_mul_pd(v, weight)));
+    sumWeights = _mm256_add_pd(sumWeights, _mm256_and_pd(valid, weight));
+}
+
+CRUSTA_TARGET("avx2") inline __m256d
+normalizeAvx2(__m256d sum, __m256d sumWeights, __m256d nodata)
+{
+    __m256d empty = _mm256_cmp_pd(sumWeights, _mm256_setzero_pd(), _CMP_EQ_OQ);
+    return selectAvx2(empty, nodata, _mm256_div_pd(sum, sumWeights));
+}
+
+CRUSTA_TARGET("avx2") inline __m256
+average2Avx2(__m256 a, __m256 b, __m256 nodata)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    __m256 validA = _mm256_cmp_ps(a, nodata, _CMP_NEQ_UQ);
+    __m256 validB = _mm256_cmp_ps(b, nodata, _CMP_NEQ_UQ);
+    __m256 avg    = narrowAvx2(
+        _mm256_mul_pd(_mm256_add_pd(lowerAvx2(a), lowerAvx2(b)), half),
+        _mm256_mul_pd(_mm256_add_pd(upperAvx2(a), upperAvx2(b)), half));
+    return selectAvx2(validA, selectAvx2(validB, avg, a), b);
+}
+
+CRUSTA_TARGET("avx2") inline __m256d
+average4Avx2(__m256d a, __m256d b, __m256d c, __m256d d, __m256d nodata)
+{
+    const __m256d quarter = _mm256_set1_pd(0.25);
+
+    __m256d sum        = _mm256_setzero_pd();
+    __m256d sumWeights = _mm256_setzero_pd();
+    accumulateAvx2(a, quarter, nodata, sum, sumWeights);
+    accumulateAvx2(b, quarter, nodata, sum, sumWeights);
+    accumulateAvx2(c, quarter, nodata, sum, sumWeights);
+    accumulateAvx2(d, quarter, nodata, sum, sumWeights);
+
+    return normalizeAvx2(sum, sumWeights, nodata);
+}
+
+CRUSTA_TARGET("avx2") inline __m256
+average4Avx2(__m256 a, __m256 b, __m256 c, __m256 d, __m256d nodata)
+{
+    return narrowAvx2(
+        average4Avx2(lowerAvx2(a), lowerAvx2(b), lowerAvx2(c), lowerAvx2(d),
+                     nodata),
+        average4Avx2(upperAvx2(a), upperAvx2(b), upperAvx2(c), upperAvx2(d),
+                     nodata));
+}
+
+/** interleave two vectors into a contiguous run of 16 values */
+CRUSTA_TARGET("avx2") inline void
+storeInterleavedAvx2(float* dst, __m256 even, __m256 odd)
+{
+    __m256 lo = _mm256_unpacklo_ps(even, odd);
+    __m256 hi = _mm256_unpackhi_ps(even, odd);
+    _mm256_storeu_ps(dst,     _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+CRUSTA_TARGET("avx2") void
+expandRowAvx2(const float* src, int numSrc, float nodata, float* dst)
+{
+    const __m256 nd = _mm256_set1_ps(nodata);
+
+    int i = 0;
+    for (; i+8<numSrc; i+=8)
+    {
+        __m256 s   = _mm256_loadu_ps(src + i);
+        __m256 avg = average2Avx2(s, _mm256_loadu_ps(src + i + 1), nd);
+        storeInterleavedAvx2(dst + 2*i, s, avg);
+    }
+    expandRowScalar(i, src, numSrc, nodata, dst);
+}
+
+CRUSTA_TARGET("avx2") void
+expandRowPairAvx2(const float* a, const float* b, int numSrc, float nodata,
+                  float* dst)
+{
+    const __m256  nd  = _mm256_set1_ps(nodata);
+    const __m256d ndd = _mm256_set1_pd(nodata);
+
+    int i = 0;
+    for (; i+8<numSrc; i+=8)
+    {
+        __m256 a0  = _mm256_loadu_ps(a + i);
+        __m256 a1  = _mm256_loadu_ps(a + i + 1);
+        __m256 b0  = _mm256_loadu_ps(b + i);
+        __m256 b1  = _mm256_loadu_ps(b + i + 1);
+        storeInterleavedAvx2(dst + 2*i, average2Avx2(a0, b0, nd),
+                             average4Avx2(a0, a1, b0, b1, ndd));
+    }
+    expandRowPairScalar(i, a, b, numSrc, nodata, dst);
+}
+
+CRUSTA_TARGET("avx2") void
+subsampleRowAvx2(const float* at, int rowLen, int numDst,
+                 const double* weights, int radius, float nodata, float* dst)
+{
+    const __m256d nd   = _mm256_set1_pd(nodata);
+    const __m256d zero = _mm256_setzero_pd();
+
+    int i = 0;
+    for (; i+8<numDst; i+=8)
+    {
+        const float* center = at + 2*i;
+
+        __m256d sumLower        = zero;
+        __m256d sumUpper        = zero;
+        __m256d sumWeightsLower = zero;
+        __m256d sumWeightsUpper = zero;
+        for (int y=-radius; y<=radius; ++y)
+        {
+            const float* atY = center + y*rowLen;
+            for (int x=-radius; x<=radius; ++x)
+            {
+                //gather the taps of 8 consecutive outputs (stride 2)
+                __m256 lo = _mm256_loadu_ps(atY + x);
+                __m256 hi = _mm256_loadu_ps(atY + x + 8);
+                __m256 v  = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0));
+                v = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                    _mm256_castps_pd(v), _MM_SHUFFLE(3,1,2,0)));
+
+                __m256d weight = _mm256_set1_pd(weights[y] * weights[x]);
+                accumulateAvx2(lowerAvx2(v), weight, nd, sumLower,
+                               sumWeightsLower);
+                accumulateAvx2(upperAvx2(v), weight, nd, sumUpper,
+                               sumWeightsUpper);
+            }
+        }
+
+        _mm256_storeu_ps(dst + i, narrowAvx2(
+            normalizeAvx2(sumLower, sumWeightsLower, nd),
+            normalizeAvx2(sumUpper, sumWeightsUpper, nd)));
+    }
+    subsampleRowScalar(i, at, rowLen, numDst, weights, radius, nodata, dst);
+}
+
+CRUSTA_TARGET("avx2") void
+rowRangeAvx2(const float* src, int num, float nodata, float range[2])
+{
+    const __m256 nd      = _mm256_set1_ps(nodata);
+    const __m256 highest = _mm256_set1_ps(FLT_MAX);
+    const __m256 lowest  = _mm256_set1_ps(-FLT_MAX);
+
+    __m256 rangeMin = highest;
+    __m256 rangeMax = lowest;
+    int    anyValid = 0;
+
+    int i = 0;
+    for (; i+8<=num; i+=8)
+    {
+        __m256 v     = _mm256_loadu_ps(src + i);
+        __m256 valid = _mm256_cmp_ps(v, nd, _CMP_NEQ_UQ);
+        anyValid    |= _mm256_movemask_ps(valid);
+        rangeMin     = _mm256_min_ps(rangeMin, selectAvx2(valid, v, highest));
+        rangeMax     = _mm256_max_ps(rangeMax, selectAvx2(valid, v, lowest));
+    }
+
+    if (anyValid != 0)
+    {
+        float mins[8], maxs[8];
+        _mm256_storeu_ps(mins, rangeMin);
+        _mm256_storeu_ps(maxs, rangeMax);
+        for (int j=0; j<8; ++j)
+        {
+            range[0] = mins[j]<range[0] ? mins[j] : range[0];
+            range[1] = maxs[j]>range[1] ? maxs[j] : range[1];
+        }
+    }
+    rowRangeScalar(i, src, num, nodata, range);
+}
+
+#endif //CRUSTA_PIXELKERNELS_X86
+
+
+//- dispatch -------------------------------------------------------------------
+
+/** the implementation of the kernels selected for the processor */
+struct KernelTable
+{
+    void (*expandRow)(const float*, int, float, float*);
+    void (*expandRowPair)(const float*, const float*, int, float, float*);
+    void (*subsampleRow)(const float*, int, int, const double*, int, float,
+                         float*);
+    void (*rowRange)(const float*, int, float, float[2]);
+    const char* instructionSet;
+};
+
+KernelTable
+selectKernels()
+{
+#if CRUSTA_PIXELKERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        KernelTable table = { expandRowAvx2, expandRowPairAvx2,
+                              subsampleRowAvx2, rowRangeAvx2, "AVX2" };
+        return table;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        KernelTable table = { expandRowSse2, expandRowPairSse2,
+                              subsampleRowSse2, rowRangeSse2, "SSE2" };
+        return table;
+    }
+#endif //CRUSTA_PIXELKERNELS_X86
+
+    KernelTable table = { expandRowGeneric, expandRowPairGeneric,
+                          subsampleRowGeneric, rowRangeGeneric, "scalar" };
+    return table;
+}
+
+const KernelTable&
+kernels()
+{
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+
+} //anonymous namespace
+
+
+void PixelKernels::
+expandRow(const float* src, int numSrc, float nodata, float* dst)
+{
+    kernels().expandRow(src, numSrc, nodata, dst);
+}
+
+void PixelKernels::
+expandRowPair(const float* a, const float* b, int numSrc, float nodata,
+              float* dst)
+{
+    kernels().expandRowPair(a, b, numSrc, nodata, dst);
+}
+
+void PixelKernels::
+subsampleRow(const float* at, int rowLen, int numDst, const double* weights,
+             int radius, float nodata, float* dst)
+{
+    kernels().subsampleRow(at, rowLen, numDst, weights, radius, nodata, dst);
+}
+
+void PixelKernels::
+rowRange(const float* src, int num, float nodata, float range[2])
+{
+    kernels().rowRange(src, num, nodata, range);
+}
+
+const char* PixelKernels::
+getInstructionSet()
+{
+    return kernels().instructionSet;
+}
+
+
+} //namespace crusta
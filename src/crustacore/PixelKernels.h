@@ -0,0 +1,49 @@
+#ifndef _PixelKernels_H_
+#define _PixelKernels_H_
+
+
+namespace crusta {
+
+
+/**
+    Row kernels for the single channel float pixel operations that run over
+    every texel of a tile (parent expansion, subsampling filters and value
+    ranges). Nodata values are handled through comparison masks instead of
+    branches, and sums are accumulated in double precision and rounded to
+    float once when stored. The implementation is selected at run-time from
+    the instruction sets supported by the processor (AVX2, SSE2 or a scalar
+    fallback); all the implementations produce identical results.
+*/
+struct PixelKernels
+{
+    /** expand a row of the parent into a row of the child: dst[2i] = src[i]
+        and dst[2i+1] = PixelOps::average(src[i], src[i+1]). 'dst' receives
+        2*numSrc-1 values */
+    static void expandRow(const float* src, int numSrc, float nodata,
+                          float* dst);
+    /** expand the space between two rows of the parent into a row of the
+        child: dst[2i] = PixelOps::average(a[i], b[i]) and dst[2i+1] =
+        PixelOps::average(a[i], a[i+1], b[i], b[i+1]). 'dst' receives
+        2*numSrc-1 values */
+    static void expandRowPair(const float* a, const float* b, int numSrc,
+                              float nodata, float* dst);
+    /** evaluate a separable filter of the given radius at every other pixel
+        of a row: dst[i] is the filtered value centered at at[2i], where
+        weights[-radius..radius] are the 1D weights. Nodata taps are excluded
+        and the remaining weights renormalized */
+    static void subsampleRow(const float* at, int rowLen, int numDst,
+                             const double* weights, int radius, float nodata,
+                             float* dst);
+    /** grow the range to include the non-nodata values of the row */
+    static void rowRange(const float* src, int num, float nodata,
+                         float range[2]);
+
+    /** name of the instruction set of the selected implementation */
+    static const char* getInstructionSet();
+};
+
+
+} //namespace crusta
+
+
+#endif //_PixelKernels_H_
@@ -24,6 +24,20 @@ struct PixelOps
     /** compute the maximum of two values */
     static PixelType maximum(const PixelType& a, const PixelType& b,
                              const PixelType& nodata);
+
+    /** expand a row of a parent tile into a row of a child: dst[2i] = src[i]
+        and dst[2i+1] = average(src[i], src[i+1]) */
+    static void expandRow(const PixelType* src, int numSrc,
+                          const PixelType& nodata, PixelType* dst);
+    /** expand the space between two rows of a parent tile into a row of a
+        child: dst[2i] = average(a[i], b[i]) and dst[2i+1] = average(a[i],
+        a[i+1], b[i], b[i+1]) */
+    static void expandRowPair(const PixelType* a, const PixelType* b,
+                              int numSrc, const PixelType& nodata,
+                              PixelType* dst);
+    /** grow a [minimum, maximum] range to include the values of a row */
+    static void rowRange(const PixelType* src, int num,
+                         const PixelType& nodata, PixelType range[2]);
 };
 
 
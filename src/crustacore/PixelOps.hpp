@@ -4,6 +4,8 @@
 
 #include <crustacore/PixelOps.h>
 
+#include <crustacore/PixelKernels.h>
+
 
 namespace crusta {
 
@@ -21,7 +23,7 @@ struct PixelOps<float>
         else if (b==nodata)
             return a;
         else
-            return (a+b) * float(0.5);
+            return float((double(a)+double(b)) * 0.5);
     }
 
     static float average(const float& a, const float& b,
@@ -30,21 +32,21 @@ struct PixelOps<float>
     {
         const float p[4] = {a,b,c,d};
 
-        float sum = 0;
-        float sumWeights = 0;
+        double sum = 0;
+        double sumWeights = 0;
         for (int i=0; i<4; ++i)
         {
             if (p[i] != nodata)
             {
-                sum        += p[i] * float(0.25);
-                sumWeights += float(0.25);
+                sum        += double(p[i]) * 0.25;
+                sumWeights += 0.25;
             }
         }
 
         if (sumWeights == 0)
             return nodata;
         else
-            return sum / sumWeights;
+            return float(sum / sumWeights);
     }
 
     static float minimum(const float& a, const float& b,
@@ -68,6 +70,24 @@ struct PixelOps<float>
         else
             return std::max(a, b);
     }
+
+    static void expandRow(const float* src, int numSrc, const float& nodata,
+                          float* dst)
+    {
+        PixelKernels::expandRow(src, numSrc, nodata, dst);
+    }
+
+    static void expandRowPair(const float* a, const float* b, int numSrc,
+                              const float& nodata, float* dst)
+    {
+        PixelKernels::expandRowPair(a, b, numSrc, nodata, dst);
+    }
+
+    static void rowRange(const float* src, int num, const float& nodata,
+                         float range[2])
+    {
+        PixelKernels::rowRange(src, num, nodata, range);
+    }
 };
 
 
@@ -145,6 +165,42 @@ struct PixelOps<Geometry::Vector<uint8_t,3> >
             res[i] = std::max(a[i], b[i]);
         return res;
     }
+
+    static void expandRow(const Geometry::Vector<uint8_t,3>* src, int numSrc,
+                          const Geometry::Vector<uint8_t,3>& nodata,
+                          Geometry::Vector<uint8_t,3>* dst)
+    {
+        for (int i=0; i<numSrc-1; ++i)
+        {
+            dst[2*i]   = src[i];
+            dst[2*i+1] = average(src[i], src[i+1], nodata);
+        }
+        dst[2*(numSrc-1)] = src[numSrc-1];
+    }
+
+    static void expandRowPair(const Geometry::Vector<uint8_t,3>* a,
+                              const Geometry::Vector<uint8_t,3>* b, int numSrc,
+                              const Geometry::Vector<uint8_t,3>& nodata,
+                              Geometry::Vector<uint8_t,3>* dst)
+    {
+        for (int i=0; i<numSrc-1; ++i)
+        {
+            dst[2*i]   = average(a[i], b[i], nodata);
+            dst[2*i+1] = average(a[i], a[i+1], b[i], b[i+1], nodata);
+        }
+        dst[2*(numSrc-1)] = average(a[numSrc-1], b[numSrc-1], nodata);
+    }
+
+    static void rowRange(const Geometry::Vector<uint8_t,3>* src, int num,
+                         const Geometry::Vector<uint8_t,3>& nodata,
+                         Geometry::Vector<uint8_t,3> range[2])
+    {
+        for (int i=0; i<num; ++i)
+        {
+            range[0] = minimum(range[0], src[i], nodata);
+            range[1] = maximum(range[1], src[i], nodata);
+        }
+    }
 };
 
 
@@ -82,6 +82,8 @@ public:
     void readHeader();
     ///writes the quadtree file header to the file again
     void writeHeader();
+    ///writes the header and forces all the written tiles to disk
+    void flush();
 
     ///appends a new tile to the file (only reserves the space for it)
     TileIndex appendTile(const Pixel* const blank=NULL);
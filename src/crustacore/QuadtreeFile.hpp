@@ -22,7 +22,9 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+#include <cstdio>
 #include <string>
+#include <unistd.h>
 
 
 namespace crusta {
@@ -114,6 +116,18 @@ QuadtreeFile(const char* quadtreeFileName, const uint32_t iTileSize[2], bool wri
                     Misc::LargeFile::Offset(tileNumPixels);
     fileTileSize += Misc::LargeFile::Offset(4*sizeof(TileIndex));
     fileTileSize += Misc::LargeFile::Offset(TileHeader::getSize());
+
+    /* tiles appended after the header was last written (e.g. by an update
+       that was interrupted) are recovered from the size of the file, such
+       that they aren't appended again */
+    if (writable)
+    {
+        quadtreeFile->seekEnd(0);
+        Misc::LargeFile::Offset numFileTiles =
+            (quadtreeFile->tell() - firstTileOffset) / fileTileSize;
+        if (numFileTiles > Misc::LargeFile::Offset(getNumTiles()))
+            header.maxTileIndex = TileIndex(numFileTiles - 1);
+    }
 }
 
 template <class PixelType,class FileHeaderParam,class TileHeaderParam>
@@ -199,6 +213,23 @@ writeHeader()
     fileHeader.write(quadtreeFile);
 }
 
+template <class PixelType,class FileHeaderParam,class TileHeaderParam>
+void
+QuadtreeFile<PixelType,FileHeaderParam,TileHeaderParam>::
+flush()
+{
+    if(!writable)
+        Misc::throwStdErr("QuadtreeFile: Attempted write operation on non-writable instance.");
+
+    if(quadtreeFile == NULL)
+        return;
+
+    writeHeader();
+    FILE* filePtr = quadtreeFile->getFilePtr();
+    fflush(filePtr);
+    fsync(fileno(filePtr));
+}
+
 template <class PixelType,class FileHeaderParam,class TileHeaderParam>
 TileIndex QuadtreeFile<PixelType,FileHeaderParam,TileHeaderParam>::
 appendTile(const Pixel* const blank)
@@ -1,12 +1,15 @@
 #include <crustacore/Scope.h>
 
 
-#include <crustacore/Section.h>
+#include <crustacore/ScopeEdges.h>
 
 
 namespace crusta {
 
 
+const int Scope::EDGE_CORNERS[4][2] = {{3,2}, {2,0}, {0,1}, {1,3}};
+
+
 Scope::
 Scope()
 {
@@ -107,25 +110,30 @@ split(Scope scopes[4]) const
     scopes[3].corners[3] = corners[3];
 }
 
+Geometry::Vector<double,3> Scope::
+getEdgeNormal(int edge) const
+{
+    Geometry::Vector<double,3> one(corners[EDGE_CORNERS[edge][0]]);
+    Geometry::Vector<double,3> two(corners[EDGE_CORNERS[edge][1]]);
+    two -= one;
+    one.normalize();
+    two.normalize();
+    Geometry::Vector<double,3> normal = Geometry::cross(one, two);
+    normal.normalize();
+    return normal;
+}
+
 bool Scope::
 contains(const Scope::Vertex& point) const
 {
     Geometry::Vector<double,3> p(point);
 
-    //compute face normals
-    static const int remap[4][2] = {{3,2}, {2,0}, {0,1}, {1,3}};
+    //check the point against the edge planes
     for (int i=0; i<4; ++i)
     {
-        Geometry::Vector<double,3> one(corners[remap[i][0]]);
-        Geometry::Vector<double,3> toP = p - one;
-        Geometry::Vector<double,3> two(corners[remap[i][1]]);
-        two -= one;
-        one.normalize();
-        two.normalize();
-        Geometry::Vector<double,3> normal = Geometry::cross(one, two);
-        normal.normalize();
-
-        if (toP*normal < 0)
+        Geometry::Vector<double,3> toP = p -
+            Geometry::Vector<double,3>(corners[EDGE_CORNERS[i][0]]);
+        if (toP*getEdgeNormal(i) < 0)
             return false;
     }
 
@@ -133,29 +141,9 @@ contains(const Scope::Vertex& point) const
 }
 
 bool Scope::
-intersects(const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end)
+intersects(const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end) const
 {
-    Geometry::Ray<double,3> ray(start, end);
-
-    static const int remap[4][2] = {{3,2}, {2,0}, {0,1}, {1,3}};
-    //check all the edge sections
-    double entry =  Math::Constants<double>::max;
-    double exit  = -Math::Constants<double>::max;
-    for (int i=0; i<4; ++i)
-    {
-        Section section(corners[remap[i][0]], corners[remap[i][1]]);
-        Geometry::HitResult<double> hit   = section.intersect(ray, false);
-        double hitParam = hit.getParameter();
-        if (hit.isValid())
-        {
-            entry = std::min(entry, hitParam);
-            exit  = std::max( exit, hitParam);
-        }
-    }
-    if (exit<0.0 || entry>1.0)
-        return false;
-    else
-        return true;
+    return ScopeEdges(*this).intersects(start, end);
 }
 
 
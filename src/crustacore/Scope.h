@@ -60,12 +60,20 @@ public:
     /** generate the next refinement of the scope */
     void split(Scope scopes[4]) const;
 
+    /** compute the normal of the plane through the center of the globe and
+        an edge (see EDGE_CORNERS). The scope lies on its positive side */
+    Geometry::Vector<double,3> getEdgeNormal(int edge) const;
+
     /** check if a point is contained in the solid angle subtended by the
-        scope */
+        scope. Use ScopeEdges to test many points against the same scope */
     bool contains(const Scope::Vertex& p) const;
     /** check if a line segment intersects the solid angle subtended by the
-        scope */
-    bool intersects(const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end);
+        scope. Use ScopeEdges to test many segments against the same scope */
+    bool intersects(const Geometry::Point<double,3>& start, const Geometry::Point<double,3>& end) const;
+
+    /** indices of the start and end corners of the edges, in order top,
+        left, bottom, right */
+    static const int EDGE_CORNERS[4][2];
 
     /** corner points of the scope in cartesian space in order lower-left,
         lower-right, upper-left, upper-right*/
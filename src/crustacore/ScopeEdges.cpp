@@ -0,0 +1,242 @@
+#include <crustacore/ScopeEdges.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#define CRUSTA_SCOPEEDGES_SSE2 1
+#include <emmintrin.h>
+#else
+#define CRUSTA_SCOPEEDGES_SSE2 0
+#endif //__SSE2__
+
+
+namespace crusta {
+
+
+///tolerance for segments parallel to the edge planes (as for the Section)
+static const double EPSILON = 0.000000000001;
+
+
+ScopeEdges::
+ScopeEdges()
+{
+    set(Scope());
+}
+
+ScopeEdges::
+ScopeEdges(const Scope& scope)
+{
+    set(scope);
+}
+
+
+void ScopeEdges::
+set(const Scope& scope)
+{
+    for (int i=0; i<4; ++i)
+    {
+        const Scope::Vertex& s = scope.corners[Scope::EDGE_CORNERS[i][0]];
+        const Scope::Vertex& e = scope.corners[Scope::EDGE_CORNERS[i][1]];
+        Geometry::Vector<double,3> n = scope.getEdgeNormal(i);
+
+        //tangents bounding the edge, as for the Section
+        Geometry::Vector<double,3> sv(s);
+        Geometry::Vector<double,3> ev(e);
+        Geometry::Vector<double,3> startUp = sv;
+        startUp.normalize();
+        Geometry::Vector<double,3> startToEnd = ev - sv;
+        Geometry::Vector<double,3> startTan   =
+            startToEnd - (startToEnd*startUp)*startUp;
+        Geometry::Vector<double,3> endUp = ev;
+        endUp.normalize();
+        Geometry::Vector<double,3> endToStart = -startToEnd;
+        Geometry::Vector<double,3> endTan     =
+            endToStart - (endToStart*endUp)*endUp;
+
+        for (int j=0; j<3; ++j)
+        {
+            normal[j][i]       = n[j];
+            start[j][i]        = s[j];
+            end[j][i]          = e[j];
+            startTangent[j][i] = startTan[j];
+            endTangent[j][i]   = endTan[j];
+        }
+    }
+}
+
+
+#if CRUSTA_SCOPEEDGES_SSE2
+
+bool ScopeEdges::
+contains(const Point& p) const
+{
+    const __m128d p0 = _mm_set1_pd(p[0]);
+    const __m128d p1 = _mm_set1_pd(p[1]);
+    const __m128d p2 = _mm_set1_pd(p[2]);
+    const __m128d zero = _mm_setzero_pd();
+
+    //evaluate two edges at a time
+    int outside = 0;
+    for (int i=0; i<4; i+=2)
+    {
+        __m128d d = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(_mm_sub_pd(p0, _mm_loadu_pd(&start[0][i])),
+                       _mm_loadu_pd(&normal[0][i])),
+            _mm_mul_pd(_mm_sub_pd(p1, _mm_loadu_pd(&start[1][i])),
+                       _mm_loadu_pd(&normal[1][i]))),
+            _mm_mul_pd(_mm_sub_pd(p2, _mm_loadu_pd(&start[2][i])),
+                       _mm_loadu_pd(&normal[2][i])));
+        outside |= _mm_movemask_pd(_mm_cmplt_pd(d, zero));
+    }
+
+    return outside == 0;
+}
+
+bool ScopeEdges::
+intersects(const Point& s, const Point& e) const
+{
+    const __m128d o0 = _mm_set1_pd(s[0]);
+    const __m128d o1 = _mm_set1_pd(s[1]);
+    const __m128d o2 = _mm_set1_pd(s[2]);
+    const __m128d d0 = _mm_set1_pd(e[0]-s[0]);
+    const __m128d d1 = _mm_set1_pd(e[1]-s[1]);
+    const __m128d d2 = _mm_set1_pd(e[2]-s[2]);
+    const __m128d eps    = _mm_set1_pd(EPSILON);
+    const __m128d negEps = _mm_set1_pd(-EPSILON);
+    const __m128d zero   = _mm_setzero_pd();
+    const __m128d allSet = _mm_cmpeq_pd(zero, zero);
+
+    __m128d entry = _mm_set1_pd( Math::Constants<double>::max);
+    __m128d exit  = _mm_set1_pd(-Math::Constants<double>::max);
+    for (int i=0; i<4; i+=2)
+    {
+        __m128d n0 = _mm_loadu_pd(&normal[0][i]);
+        __m128d n1 = _mm_loadu_pd(&normal[1][i]);
+        __m128d n2 = _mm_loadu_pd(&normal[2][i]);
+        __m128d s0 = _mm_loadu_pd(&start[0][i]);
+        __m128d s1 = _mm_loadu_pd(&start[1][i]);
+        __m128d s2 = _mm_loadu_pd(&start[2][i]);
+
+        //intersect the plane (the segment might lie in it)
+        __m128d nDotDir = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(n0, d0), _mm_mul_pd(n1, d1)), _mm_mul_pd(n2, d2));
+        __m128d nDotTo  = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(n0, _mm_sub_pd(s0, o0)),
+            _mm_mul_pd(n1, _mm_sub_pd(s1, o1))),
+            _mm_mul_pd(n2, _mm_sub_pd(s2, o2)));
+        __m128d parallel   = _mm_and_pd(_mm_cmpgt_pd(nDotDir, negEps),
+                                        _mm_cmplt_pd(nDotDir, eps));
+        __m128d coincident = _mm_and_pd(_mm_cmpgt_pd(nDotTo, negEps),
+                                        _mm_cmplt_pd(nDotTo, eps));
+        __m128d t     = _mm_andnot_pd(parallel, _mm_div_pd(nDotTo, nDotDir));
+        __m128d valid = _mm_or_pd(_mm_andnot_pd(parallel, allSet),
+                                  _mm_and_pd(parallel, coincident));
+
+        //bound the plane to the edge
+        __m128d h0 = _mm_add_pd(o0, _mm_mul_pd(d0, t));
+        __m128d h1 = _mm_add_pd(o1, _mm_mul_pd(d1, t));
+        __m128d h2 = _mm_add_pd(o2, _mm_mul_pd(d2, t));
+        __m128d startSide = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(_mm_loadu_pd(&startTangent[0][i]), _mm_sub_pd(h0, s0)),
+            _mm_mul_pd(_mm_loadu_pd(&startTangent[1][i]), _mm_sub_pd(h1, s1))),
+            _mm_mul_pd(_mm_loadu_pd(&startTangent[2][i]), _mm_sub_pd(h2, s2)));
+        __m128d endSide = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(_mm_loadu_pd(&endTangent[0][i]),
+                       _mm_sub_pd(h0, _mm_loadu_pd(&end[0][i]))),
+            _mm_mul_pd(_mm_loadu_pd(&endTangent[1][i]),
+                       _mm_sub_pd(h1, _mm_loadu_pd(&end[1][i])))),
+            _mm_mul_pd(_mm_loadu_pd(&endTangent[2][i]),
+                       _mm_sub_pd(h2, _mm_loadu_pd(&end[2][i]))));
+        valid = _mm_andnot_pd(_mm_cmplt_pd(startSide, zero), valid);
+        valid = _mm_andnot_pd(_mm_cmplt_pd(endSide,   zero), valid);
+
+        //track the range of the valid hits
+        entry = _mm_min_pd(entry, _mm_or_pd(_mm_and_pd(valid, t),
+                                            _mm_andnot_pd(valid, entry)));
+        exit  = _mm_max_pd(exit,  _mm_or_pd(_mm_and_pd(valid, t),
+                                            _mm_andnot_pd(valid, exit)));
+    }
+
+    entry = _mm_min_sd(entry, _mm_unpackhi_pd(entry, entry));
+    exit  = _mm_max_sd(exit,  _mm_unpackhi_pd(exit,  exit));
+    return !(_mm_cvtsd_f64(exit)<0.0 || _mm_cvtsd_f64(entry)>1.0);
+}
+
+#else
+
+bool ScopeEdges::
+contains(const Point& p) const
+{
+    bool outside = false;
+    for (int i=0; i<4; ++i)
+    {
+        double d = (p[0]-start[0][i])*normal[0][i] +
+                   (p[1]-start[1][i])*normal[1][i] +
+                   (p[2]-start[2][i])*normal[2][i];
+        outside |= d < 0.0;
+    }
+
+    return !outside;
+}
+
+bool ScopeEdges::
+intersects(const Point& s, const Point& e) const
+{
+    const double d[3] = { e[0]-s[0], e[1]-s[1], e[2]-s[2] };
+
+    double entry =  Math::Constants<double>::max;
+    double exit  = -Math::Constants<double>::max;
+    for (int i=0; i<4; ++i)
+    {
+        //intersect the plane (the segment might lie in it)
+        double nDotDir = normal[0][i]*d[0] + normal[1][i]*d[1] +
+                         normal[2][i]*d[2];
+        double nDotTo  = normal[0][i]*(start[0][i]-s[0]) +
+                         normal[1][i]*(start[1][i]-s[1]) +
+                         normal[2][i]*(start[2][i]-s[2]);
+        bool parallel   = nDotDir>-EPSILON && nDotDir<EPSILON;
+        bool coincident = nDotTo>-EPSILON  && nDotTo<EPSILON;
+        double t   = parallel ? 0.0 : nDotTo / nDotDir;
+        bool valid = !parallel || coincident;
+
+        //bound the plane to the edge
+        double h[3] = { s[0] + d[0]*t, s[1] + d[1]*t, s[2] + d[2]*t };
+        double startSide = startTangent[0][i]*(h[0]-start[0][i]) +
+                           startTangent[1][i]*(h[1]-start[1][i]) +
+                           startTangent[2][i]*(h[2]-start[2][i]);
+        double endSide   = endTangent[0][i]*(h[0]-end[0][i]) +
+                           endTangent[1][i]*(h[1]-end[1][i]) +
+                           endTangent[2][i]*(h[2]-end[2][i]);
+        valid &= !(startSide < 0.0);
+        valid &= !(endSide   < 0.0);
+
+        //track the range of the valid hits
+        if (valid)
+        {
+            entry = std::min(entry, t);
+            exit  = std::max(exit,  t);
+        }
+    }
+
+    return !(exit<0.0 || entry>1.0);
+}
+
+#endif //CRUSTA_SCOPEEDGES_SSE2
+
+
+size_t ScopeEdges::
+contains(size_t numPoints, const Point* points, bool* inside) const
+{
+    size_t numInside = 0;
+    for (size_t i=0; i<numPoints; ++i)
+    {
+        bool in    = contains(points[i]);
+        numInside += in ? 1 : 0;
+        if (inside != NULL)
+            inside[i] = in;
+    }
+    return numInside;
+}
+
+
+} //namespace crusta
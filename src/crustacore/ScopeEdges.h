@@ -0,0 +1,66 @@
+#ifndef _ScopeEdges_H_
+#define _ScopeEdges_H_
+
+
+#include <crustacore/Scope.h>
+
+
+namespace crusta {
+
+
+/**
+    The planes through the center of the globe and the edges of a scope,
+    derived once for testing many points or segments against the same scope
+    (e.g. all the segments that might overlap a node). The scope itself has to
+    derive them for every test, as its corners are freely modifiable.
+
+    The data of the planes is stored per component across the four edges,
+    such that the tests evaluate all the edges at once. They are vectorized
+    with SSE2 where available. Both implementations perform the same
+    operations in the same order, hence produce identical results, which also
+    match those of the tests of the scope.
+*/
+class ScopeEdges
+{
+public:
+    typedef Geometry::Point<double,3> Point;
+
+    ScopeEdges();
+    ScopeEdges(const Scope& scope);
+
+    /** derive the edge planes of a scope */
+    void set(const Scope& scope);
+
+    /** check if a point is contained in the solid angle subtended by the
+        scope */
+    bool contains(const Point& p) const;
+    /** check if a line segment intersects the solid angle subtended by the
+        scope */
+    bool intersects(const Point& start, const Point& end) const;
+
+    /** convenience to check an array of points for containment. The
+        individual results are stored in 'inside', if provided. Returns the
+        number of points contained */
+    size_t contains(size_t numPoints, const Point* points,
+                    bool* inside=NULL) const;
+
+protected:
+    /** normals of the planes */
+    double normal[3][4];
+    /** corners at the start of the edges */
+    double start[3][4];
+    /** corners at the end of the edges */
+    double end[3][4];
+    /** tangents of the planes at the start corners, pointing along the
+        edges */
+    double startTangent[3][4];
+    /** tangents of the planes at the end corners, pointing back along the
+        edges */
+    double endTangent[3][4];
+};
+
+
+} //namespace crusta
+
+
+#endif //_ScopeEdges_H_